@@ -0,0 +1,112 @@
+// Measures message throughput of many concurrent SnapClient sessions on
+// loopback. The socket backend is selected at configure time, compare a build
+// with BRILLIANT_CMAKE_USE_IO_URING=ON to one without it.
+
+#include <benchmark/benchmark.h>
+
+#include <boost/asio.hpp>
+#include <memory>
+#include <vector>
+
+#include "BrilliantSnapcast/ProtocolSession.hpp"
+#include "BrilliantSnapcast/RegisteredBuffers.hpp"
+#include "BrilliantSnapcast/SnapClient.hpp"
+
+namespace {
+  using Socket = boost::asio::ip::tcp::socket;
+  using TcpClient = brilliant::snapcast::TcpClient<Socket>;
+  using SnapClient = brilliant::snapcast::SnapClient<Socket>;
+
+  constexpr std::size_t FRAMES_PER_ITERATION = 64;
+  constexpr std::size_t FRAME_SIZE =
+      brilliant::snapcast::HEADER_SIZE + sizeof(brilliant::snapcast::Time);
+  constexpr std::size_t BUFFER_SIZE = 256;
+
+  struct Session {
+    Session(Socket client, Socket server, std::pmr::memory_resource* mr)
+        : tcpClient(std::move(client), mr),
+          snapClient(tcpClient),
+          peer(std::move(server)) {}
+
+    TcpClient tcpClient;
+    SnapClient snapClient;
+    Socket peer;
+  };
+
+  struct Loopback {
+    explicit Loopback(std::size_t count)
+        : acceptor(context, {boost::asio::ip::address_v4::loopback(), 0}),
+          storage(count * BUFFER_SIZE),
+          registered(context, std::span(storage), count, mr) {
+      std::vector<std::byte> frame(FRAME_SIZE);
+      for (std::size_t i = 0; i < FRAMES_PER_ITERATION; ++i) {
+        brilliant::snapcast::Message message = brilliant::snapcast::Time{};
+        std::ignore = brilliant::snapcast::ProtocolSession::encode(
+            0, message, {}, std::span(frame));
+        payload.insert(payload.end(), frame.begin(), frame.end());
+      }
+
+      for (std::size_t i = 0; i < count; ++i) {
+        Socket client(context);
+        client.connect(acceptor.local_endpoint());
+        auto server = acceptor.accept();
+        server.set_option(boost::asio::ip::tcp::no_delay(true));
+        sessions.push_back(std::make_unique<Session>(std::move(client),
+                                                     std::move(server), mr));
+      }
+    }
+
+    template <bool Registered>
+    void run() {
+      for (std::size_t i = 0; i < sessions.size(); ++i) {
+        auto& session = *sessions[i];
+        boost::asio::async_write(session.peer, boost::asio::buffer(payload),
+                                 boost::asio::detached);
+        boost::asio::co_spawn(
+            context,
+            // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+            [this, &session, i] -> boost::asio::awaitable<void> {
+              for (std::size_t n = 0; n < FRAMES_PER_ITERATION; ++n) {
+                if constexpr (Registered) {
+                  co_await session.snapClient.read(registered[i]);
+                } else {
+                  co_await session.snapClient.read(registered.span(i));
+                }
+              }
+            },
+            boost::asio::detached);
+      }
+      context.run();
+      context.restart();
+    }
+
+    std::pmr::memory_resource* mr = std::pmr::get_default_resource();
+    boost::asio::io_context context;
+    boost::asio::ip::tcp::acceptor acceptor;
+    std::vector<std::byte> storage;
+    brilliant::snapcast::RegisteredBuffers registered;
+    std::vector<std::byte> payload;
+    std::vector<std::unique_ptr<Session>> sessions;
+  };
+
+  template <bool Registered>
+  void benchLoopbackSessions(benchmark::State& state) {
+    const auto sessions = static_cast<std::size_t>(state.range(0));
+    if (sessions == 0) {
+      state.SkipWithError("needs at least one session");
+      return;
+    }
+    Loopback loopback(sessions);
+    for (auto _ : state) {
+      loopback.run<Registered>();
+    }
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<std::int64_t>(sessions) *
+                            static_cast<std::int64_t>(FRAMES_PER_ITERATION));
+  }
+}  // namespace
+
+// NOLINTBEGIN
+BENCHMARK(benchLoopbackSessions<false>)->Arg(1)->Arg(100)->Arg(400);
+BENCHMARK(benchLoopbackSessions<true>)->Arg(1)->Arg(100)->Arg(400);
+// NOLINTEND
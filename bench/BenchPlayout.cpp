@@ -0,0 +1,125 @@
+// Wakeups and CPU cost of scheduling playout from a shared PCM ring. One
+// second of 20 ms frames is queued ahead like the network buffer, then the
+// consumer runs in real time until the end marker. Wakeups are the voluntary
+// context switches of the consuming thread, CPU time is its thread CPU time,
+// both per second of audio. consumePcm() waits for every frame,
+// PlayoutScheduler writes up to the slack ahead.
+
+#include <benchmark/benchmark.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <stop_token>
+#include <vector>
+
+#include "BrilliantSnapcast/PlayoutScheduler.hpp"
+#include "BrilliantSnapcast/SharedPcmRing.hpp"
+
+namespace {
+  constexpr int FRAMES = 50;
+  constexpr auto FRAME_DURATION = std::chrono::milliseconds(20);
+  constexpr std::size_t FRAME_SIZE = 3840;
+
+  // voluntary context switches and CPU time of the calling thread
+  struct ThreadUsage {
+    std::int64_t switches;
+    std::chrono::nanoseconds cpu;
+  };
+
+  auto threadUsage() -> ThreadUsage {
+    rusage usage{};
+    ::getrusage(RUSAGE_THREAD, &usage);
+    timespec ts{};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return {usage.ru_nvcsw, std::chrono::seconds(ts.tv_sec) +
+                                std::chrono::nanoseconds(ts.tv_nsec)};
+  }
+
+  // queues one second of audio starting shortly after now and an empty end
+  // marker
+  auto queueAudio(brilliant::snapcast::SharedPcmRing& ring) -> void {
+    const std::vector<std::byte> frame(FRAME_SIZE, std::byte{1});
+    const auto start =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+    for (int i = 0; i < FRAMES; ++i) {
+      ring.tryPublish(frame, start + i * FRAME_DURATION);
+    }
+    ring.tryPublish({}, start + FRAMES * FRAME_DURATION);
+  }
+
+  template <class Consume>
+  void measure(benchmark::State& state, Consume consume) {
+    auto producer = brilliant::snapcast::SharedPcmRing::create(64, FRAME_SIZE);
+    if (!producer) {
+      state.SkipWithError("cannot create the shared ring");
+      return;
+    }
+    auto consumer =
+        brilliant::snapcast::SharedPcmRing::open(::dup(producer->fd()));
+
+    std::int64_t switches = 0;
+    std::chrono::nanoseconds cpu{};
+    for (auto _ : state) {
+      queueAudio(*producer);
+      const auto before = threadUsage();
+      consume(*consumer);
+      const auto after = threadUsage();
+      switches += after.switches - before.switches;
+      cpu += after.cpu - before.cpu;
+    }
+
+    const auto audioSeconds = static_cast<double>(state.iterations()) *
+                              FRAMES *
+                              std::chrono::duration<double>(FRAME_DURATION)
+                                  .count();
+    state.counters["wakeups_per_s"] =
+        static_cast<double>(switches) / audioSeconds;
+    state.counters["cpu_us_per_audio_s"] =
+        std::chrono::duration<double, std::micro>(cpu).count() / audioSeconds;
+  }
+
+  void benchTimerPerFrame(benchmark::State& state) {
+    measure(state, [](brilliant::snapcast::SharedPcmRing& ring) {
+      std::stop_source done;
+      brilliant::snapcast::consumePcm(
+          ring,
+          [&](const brilliant::snapcast::PcmSlot& slot) {
+            benchmark::DoNotOptimize(slot.samples.data());
+            if (slot.samples.empty()) {
+              done.request_stop();
+            }
+          },
+          done.get_token());
+    });
+  }
+
+  void benchCoalescedPlayout(benchmark::State& state) {
+    brilliant::snapcast::PlayoutOptions options;
+    options.period = FRAME_DURATION;
+    options.slack = std::chrono::milliseconds(state.range(0));
+    measure(state, [options](brilliant::snapcast::SharedPcmRing& ring) {
+      brilliant::snapcast::PlayoutScheduler scheduler(ring, options);
+      std::stop_source done;
+      scheduler.run(
+          [&](const brilliant::snapcast::PcmSlot& slot) {
+            benchmark::DoNotOptimize(slot.samples.data());
+            if (slot.samples.empty()) {
+              done.request_stop();
+            }
+          },
+          done.get_token());
+    });
+  }
+}  // namespace
+
+BENCHMARK(benchTimerPerFrame)->Iterations(3)->UseRealTime();
+// slack in milliseconds, the sink period is one frame
+BENCHMARK(benchCoalescedPlayout)
+    ->Arg(60)
+    ->Arg(200)
+    ->Arg(500)
+    ->Iterations(3)
+    ->UseRealTime();
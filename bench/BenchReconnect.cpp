@@ -0,0 +1,210 @@
+// Time to first audio after a reconnect. A SnapServerSession on a Unix domain
+// socket stands in for the server: it answers Time messages, sends settings
+// and a codec header after the Hello and then a chunk every 20 ms, like a
+// playing stream. Each iteration connects, waits for the first queued chunk
+// and disconnects. Cold iterations use a new supervisor and decoder, like the
+// hand-written connect, sendHello, wait for settings sequence, and drop chunks
+// until the first Time reply; warm iterations reuse the clock offset and the
+// decoder stream of the previous connection. The iteration time is the time
+// to first audio measured by the supervisor.
+
+#include <benchmark/benchmark.h>
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "BrilliantSnapcast/ReconnectSupervisor.hpp"
+#include "BrilliantSnapcast/SnapServerSession.hpp"
+
+namespace {
+  using Protocol = boost::asio::local::stream_protocol;
+  using Socket = Protocol::socket;
+
+  constexpr auto CHUNK_INTERVAL = std::chrono::milliseconds(20);
+  constexpr std::size_t BUFFER_SIZE = 4096;
+
+  class PcmDecoder : public brilliant::snapcast::Decoder {
+  public:
+    [[nodiscard]] auto format() const
+        -> brilliant::snapcast::AudioFormat override {
+      return {48000, 16, 2};  // NOLINT
+    }
+
+    auto decode(std::span<const std::byte> payload,
+                std::pmr::vector<std::byte>& out)
+        -> boost::system::error_code override {
+      out.insert(out.end(), payload.begin(), payload.end());
+      return {};
+    }
+  };
+
+  class Factory : public brilliant::snapcast::DecoderFactory {
+  public:
+    auto create(const brilliant::snapcast::CodecHeader&,
+                std::pmr::memory_resource* mr)
+        -> std::expected<brilliant::snapcast::Decoder*,
+                         boost::system::error_code> override {
+      return std::pmr::polymorphic_allocator<>(mr).new_object<PcmDecoder>();
+    }
+  };
+
+  class HelloProvider : public brilliant::snapcast::UtilProvider {
+  public:
+    auto getMacAddress(int, std::pmr::memory_resource* mr)
+        -> std::pmr::string override {
+      return {"00:11:22:33:44:55", mr};
+    }
+
+    auto getOS(std::pmr::memory_resource* mr) -> std::pmr::string override {
+      return {"Linux", mr};
+    }
+
+    auto getArch(std::pmr::memory_resource* mr) -> std::pmr::string override {
+      return {"x86_64", mr};
+    }
+  };
+
+  // the client side state which a warm reconnect keeps
+  struct Client {
+    Client(boost::asio::io_context& context, std::pmr::memory_resource* mr)
+        : tcpClient(Socket(context), mr),
+          output(64, mr),  // NOLINT
+          chunks(64, mr),  // NOLINT
+          decoder(factory, output, 4096, mr),  // NOLINT
+          supervisor(tcpClient, decoder, chunks, {}) {
+      boost::json::serializer serializer;
+      HelloProvider provider;
+      supervisor.cacheHello(provider, serializer);
+    }
+
+    brilliant::snapcast::TcpClient<Socket> tcpClient;
+    Factory factory;
+    brilliant::snapcast::StageQueue<brilliant::snapcast::PcmFrame> output;
+    brilliant::snapcast::StageQueue<brilliant::snapcast::StreamChunk> chunks;
+    brilliant::snapcast::StreamDecoder decoder;
+    brilliant::snapcast::ReconnectSupervisor<Socket> supervisor;
+  };
+
+  // serves one connection until the client queued a chunk, then stops the
+  // client
+  auto serve(Protocol::acceptor& acceptor, Client& client)
+      -> boost::asio::awaitable<void> {
+    auto* mr = std::pmr::get_default_resource();
+    brilliant::snapcast::TcpClient<Socket> peer(
+        co_await acceptor.async_accept(boost::asio::use_awaitable), mr);
+    brilliant::snapcast::SnapServerSession<Socket> session(peer);
+    auto exec = co_await boost::asio::this_coro::executor;
+
+    std::vector<std::byte> readBuffer(BUFFER_SIZE);
+    if (!co_await session.read(std::span(readBuffer))) {
+      co_return;
+    }
+    // answers Time messages while chunks are sent, cancels readerDone when
+    // the connection ends
+    boost::asio::steady_timer readerDone(
+        exec, boost::asio::steady_timer::time_point::max());
+    boost::asio::co_spawn(
+        exec,
+        // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+        [&session, &readBuffer, &readerDone] -> boost::asio::awaitable<void> {
+          std::vector<std::byte> replyBuffer(BUFFER_SIZE);
+          while (auto message = co_await session.read(std::span(readBuffer))) {
+            if (std::get<0>(*message).type ==
+                brilliant::snapcast::MessageType::TIME) {
+              co_await session.replyTime(std::get<0>(*message),
+                                         std::span(replyBuffer));
+            }
+          }
+          readerDone.cancel();
+        },
+        boost::asio::detached);
+
+    std::vector<std::byte> buffer(BUFFER_SIZE);
+    std::vector<std::byte> payload(960);  // NOLINT
+    std::vector<std::byte> codecPayload(44);  // NOLINT
+    co_await session.send(0,
+                          brilliant::snapcast::ServerSettings(
+                              R"({"bufferMs":1000,"latency":0})"),
+                          std::span(buffer));
+    co_await session.send(
+        0, brilliant::snapcast::CodecHeader("pcm", std::span(codecPayload)),
+        std::span(buffer));
+    boost::asio::steady_timer timer(exec);
+    while (client.chunks.size() == 0) {
+      brilliant::snapcast::WireChunk chunk{std::span(payload)};
+      chunk.timestamp = brilliant::snapcast::SnapClient<Socket>::currentTime();
+      if (!co_await session.send(0, chunk, std::span(buffer))) {
+        break;
+      }
+      timer.expires_after(CHUNK_INTERVAL);
+      co_await timer.async_wait(
+          boost::asio::as_tuple(boost::asio::use_awaitable));
+    }
+    client.supervisor.stop();
+    co_await readerDone.async_wait(
+        boost::asio::as_tuple(boost::asio::use_awaitable));
+  }
+
+  template <bool Warm>
+  void benchTimeToFirstAudio(benchmark::State& state) {
+    const auto path = std::string("/tmp/BenchReconnect.sock");
+    std::remove(path.c_str());
+    boost::asio::io_context context;
+    Protocol::acceptor acceptor(context, Protocol::endpoint(path));
+    std::vector<std::byte> buffer(BUFFER_SIZE);
+    std::optional<Client> client;
+    std::uint64_t dropped = 0;
+
+    for (auto _ : state) {
+      if (!Warm || !client) {
+        if (client) {
+          brilliant::snapcast::ReconnectSupervisor<Socket>::Snapshot stats;
+          client->supervisor.snapshot(stats);
+          dropped += stats.dropped;
+        }
+        client.emplace(context, std::pmr::get_default_resource());
+      }
+      boost::asio::co_spawn(context, serve(acceptor, *client),
+                            boost::asio::detached);
+      boost::asio::co_spawn(
+          context,
+          client->supervisor.run(Protocol::endpoint(path), std::span(buffer)),
+          boost::asio::detached);
+      context.run();
+      context.restart();
+
+      brilliant::snapcast::ReconnectSupervisor<Socket>::Snapshot stats;
+      client->supervisor.snapshot(stats);
+      state.SetIterationTime(
+          std::chrono::duration<double>(
+              std::chrono::microseconds(stats.lastTimeToFirstAudio))
+              .count());
+      std::pmr::vector<brilliant::snapcast::StreamChunk> drained;
+      if (client->chunks.size() > 0) {
+        client->chunks.popBatch(drained, client->chunks.size(), {});
+      }
+    }
+
+    brilliant::snapcast::ReconnectSupervisor<Socket>::Snapshot stats;
+    client->supervisor.snapshot(stats);
+    dropped += stats.dropped;
+    state.counters["dropped_chunks"] = benchmark::Counter(
+        static_cast<double>(dropped), benchmark::Counter::kAvgIterations);
+    std::remove(path.c_str());
+  }
+}  // namespace
+
+// NOLINTBEGIN
+BENCHMARK(benchTimeToFirstAudio<false>)
+    ->Iterations(20)
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(benchTimeToFirstAudio<true>)
+    ->Iterations(20)
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+// NOLINTEND
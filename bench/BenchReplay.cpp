@@ -0,0 +1,80 @@
+// Measures end to end decode throughput by replaying a capture of WireChunks
+// through TcpClient and SnapClient as fast as possible.
+
+#include <benchmark/benchmark.h>
+
+#include <boost/asio.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "BrilliantSnapcast/Capture.hpp"
+#include "BrilliantSnapcast/ProtocolSession.hpp"
+#include "BrilliantSnapcast/ReplaySocket.hpp"
+#include "BrilliantSnapcast/SnapClient.hpp"
+
+namespace {
+  constexpr std::size_t CHUNK_COUNT = 4096;
+  constexpr std::size_t BUFFER_SIZE = 8192;
+
+  void writeCapture(const char* path, const char* indexPath,
+                    std::size_t payloadSize) {
+    auto writer = brilliant::snapcast::CaptureWriter::open(path, indexPath);
+    std::vector<std::byte> payload(payloadSize);
+    std::vector<std::byte> frame(BUFFER_SIZE);
+    for (std::size_t i = 0; i < CHUNK_COUNT; ++i) {
+      brilliant::snapcast::Message message =
+          brilliant::snapcast::WireChunk{std::span(payload)};
+      auto encoded = brilliant::snapcast::ProtocolSession::encode(
+          0, message, {}, std::span(frame));
+      const auto header = brilliant::snapcast::HEADER_SIZE;
+      writer->record(brilliant::snapcast::Time{}, encoded->first(header),
+                     encoded->subspan(header));
+    }
+  }
+
+  void benchReplay(benchmark::State& state) {
+    const auto payloadSize = static_cast<std::size_t>(state.range(0));
+    const std::string path = "BenchReplay.cap";
+    const std::string indexPath = "BenchReplay.idx";
+    std::remove(path.c_str());
+    std::remove(indexPath.c_str());
+    writeCapture(path.c_str(), indexPath.c_str(), payloadSize);
+    auto capture = brilliant::snapcast::CaptureFile::open(path.c_str());
+
+    using Socket = brilliant::snapcast::ReplaySocket<>;
+    std::vector<std::byte> buffer(BUFFER_SIZE);
+    for (auto _ : state) {
+      boost::asio::io_context context;
+      brilliant::snapcast::TcpClient<Socket> tcpClient(
+          Socket(context.get_executor(), capture.value(),
+                 brilliant::snapcast::ReplayMode::FAST),
+          std::pmr::get_default_resource());
+      brilliant::snapcast::SnapClient<Socket> snapClient(tcpClient);
+      boost::asio::co_spawn(
+          context,
+          // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+          [&snapClient, &buffer] -> boost::asio::awaitable<void> {
+            while (true) {
+              auto result = co_await snapClient.read(std::span(buffer));
+              if (!result) {
+                break;
+              }
+              benchmark::DoNotOptimize(result);
+            }
+          },
+          boost::asio::detached);
+      context.run();
+    }
+
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<std::int64_t>(CHUNK_COUNT));
+    state.SetBytesProcessed(static_cast<std::int64_t>(capture->size()) *
+                            state.iterations());
+    std::remove(path.c_str());
+    std::remove(indexPath.c_str());
+  }
+}  // namespace
+
+// NOLINTNEXTLINE
+BENCHMARK(benchReplay)->Arg(64)->Arg(1024)->Arg(4096);
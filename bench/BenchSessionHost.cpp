@@ -0,0 +1,81 @@
+// Measures how message throughput scales with the number of shards of a
+// SessionHost. Every session reads frames from a local socket pair created on
+// its home shard.
+
+#include <benchmark/benchmark.h>
+
+#include <boost/asio.hpp>
+#include <latch>
+#include <vector>
+
+#include "BrilliantSnapcast/ProtocolSession.hpp"
+#include "BrilliantSnapcast/SessionHost.hpp"
+#include "BrilliantSnapcast/SnapClient.hpp"
+
+namespace {
+  using Socket = boost::asio::local::stream_protocol::socket;
+
+  constexpr std::size_t SESSIONS_PER_SHARD = 64;
+  constexpr std::size_t FRAMES_PER_SESSION = 256;
+  constexpr std::size_t BUFFER_SIZE = 256;
+
+  auto makePayload() -> std::vector<std::byte> {
+    std::vector<std::byte> payload;
+    std::vector<std::byte> frame(brilliant::snapcast::HEADER_SIZE +
+                                 sizeof(brilliant::snapcast::Time));
+    for (std::size_t i = 0; i < FRAMES_PER_SESSION; ++i) {
+      brilliant::snapcast::Message message = brilliant::snapcast::Time{};
+      std::ignore = brilliant::snapcast::ProtocolSession::encode(
+          0, message, {}, std::span(frame));
+      payload.insert(payload.end(), frame.begin(), frame.end());
+    }
+    return payload;
+  }
+
+  void benchSessionsPerCore(benchmark::State& state) {
+    const auto shards = static_cast<std::size_t>(state.range(0));
+    const auto sessions = shards * SESSIONS_PER_SHARD;
+    const auto payload = makePayload();
+
+    brilliant::snapcast::SessionHost host(shards,
+                                          std::pmr::new_delete_resource(),
+                                          std::pmr::get_default_resource());
+    host.start();
+
+    for (auto _ : state) {
+      std::latch done(static_cast<std::ptrdiff_t>(sessions));
+      for (std::size_t i = 0; i < sessions; ++i) {
+        host.spawn(
+            // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+            [&payload](brilliant::snapcast::SessionHost::Shard& shard)
+                -> boost::asio::awaitable<void> {
+              Socket client(shard.getExecutor());
+              Socket peer(shard.getExecutor());
+              boost::asio::local::connect_pair(client, peer);
+
+              brilliant::snapcast::TcpClient<Socket> tcpClient(
+                  std::move(client), shard.resource());
+              brilliant::snapcast::SnapClient<Socket> snapClient(tcpClient);
+              boost::asio::async_write(peer, boost::asio::buffer(payload),
+                                       boost::asio::detached);
+
+              std::pmr::vector<std::byte> buffer(BUFFER_SIZE,
+                                                 shard.resource());
+              for (std::size_t n = 0; n < FRAMES_PER_SESSION; ++n) {
+                co_await snapClient.read(std::span(buffer));
+              }
+            },
+            [&done](const std::exception_ptr&) { done.count_down(); });
+      }
+      done.wait();
+    }
+
+    host.stop();
+    state.SetItemsProcessed(state.iterations() *
+                            static_cast<std::int64_t>(sessions) *
+                            static_cast<std::int64_t>(FRAMES_PER_SESSION));
+  }
+}  // namespace
+
+// NOLINTNEXTLINE
+BENCHMARK(benchSessionsPerCore)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
@@ -0,0 +1,115 @@
+// Throughput and latency of the shared PCM ring between two processes. The
+// consumer is forked and runs the reference consumer on its own mapping, each
+// frame's playout time is its publish time so the consumer measures the
+// handoff latency. An empty frame ends the run.
+
+#include <benchmark/benchmark.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <stop_token>
+#include <vector>
+
+#include "BrilliantSnapcast/SharedPcmRing.hpp"
+
+namespace {
+  // written by the consumer process, read by the benchmark after it exited
+  struct LatencyStats {
+    std::uint64_t frames;
+    std::int64_t totalNs;
+    std::int64_t maxNs;
+  };
+
+  // publishes a frame, false if the consumer process exited instead of
+  // making space
+  auto publish(brilliant::snapcast::SharedPcmRing& ring,
+               std::span<const std::byte> frame,
+               std::chrono::steady_clock::time_point playout, pid_t child)
+      -> bool {
+    while (!ring.tryPublish(frame, playout)) {
+      if (!ring.waitForSpace(std::chrono::milliseconds(10)) &&
+          ::waitpid(child, nullptr, WNOHANG) == child) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void benchSharedPcmRing(benchmark::State& state) {
+    const auto frameSize = static_cast<std::size_t>(state.range(0));
+    auto ring = brilliant::snapcast::SharedPcmRing::create(64, frameSize);
+    void* shared = ::mmap(nullptr, sizeof(LatencyStats),
+                          PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                          -1, 0);
+    if (!ring || shared == MAP_FAILED) {
+      state.SkipWithError("cannot create the shared ring");
+      return;
+    }
+    auto* stats = ::new (shared) LatencyStats{};
+
+    const pid_t child = ::fork();
+    if (child < 0) {
+      state.SkipWithError("cannot fork the consumer");
+      ::munmap(shared, sizeof(LatencyStats));
+      return;
+    }
+    if (child == 0) {
+      auto consumer =
+          brilliant::snapcast::SharedPcmRing::open(::dup(ring->fd()));
+      if (!consumer) {
+        ::_exit(1);
+      }
+      std::stop_source done;
+      brilliant::snapcast::consumePcm(
+          *consumer,
+          [&](const brilliant::snapcast::PcmSlot& slot) {
+            if (slot.samples.empty()) {
+              done.request_stop();
+              return;
+            }
+            const auto latency = (std::chrono::steady_clock::now() -
+                                  slot.playout) /
+                                 std::chrono::nanoseconds(1);
+            ++stats->frames;
+            stats->totalNs += latency;
+            stats->maxNs = std::max(stats->maxNs, latency);
+          },
+          done.get_token());
+      ::_exit(0);
+    }
+
+    const std::vector<std::byte> frame(frameSize, std::byte{1});
+    bool consumerExited = false;
+    for (auto _ : state) {
+      if (!publish(*ring, frame, std::chrono::steady_clock::now(), child)) {
+        consumerExited = true;
+        break;
+      }
+    }
+    if (consumerExited || !publish(*ring, {}, {}, child)) {
+      state.SkipWithError("the consumer process exited early");
+      ::munmap(shared, sizeof(LatencyStats));
+      return;
+    }
+    int status = 0;
+    ::waitpid(child, &status, 0);
+
+    state.SetBytesProcessed(state.iterations() *
+                            static_cast<std::int64_t>(frameSize));
+    if (stats->frames > 0) {
+      state.counters["latency_ns"] = static_cast<double>(stats->totalNs) /
+                                     static_cast<double>(stats->frames);
+      state.counters["max_latency_ns"] = static_cast<double>(stats->maxNs);
+    }
+    state.counters["stalls"] = static_cast<double>(ring->stalls());
+    ::munmap(shared, sizeof(LatencyStats));
+  }
+}  // namespace
+
+// 20 ms of 48 kHz stereo 16 bit PCM is 3840 bytes
+BENCHMARK(benchSharedPcmRing)->Arg(480)->Arg(3840)->Arg(15360);
@@ -0,0 +1,145 @@
+// Time message round trips on TCP loopback for each socket tuning profile.
+// Every iteration writes a small ClientInfo message followed by a Time
+// message, like a volume change racing a Time probe, and waits for the Time
+// reply of a SnapServerSession on an untuned socket. Without TCP_NODELAY the
+// Time message waits for the ACK of the ClientInfo message, which the server
+// may delay. The iteration time is the round trip, the counters report the
+// distribution in microseconds.
+
+#include <benchmark/benchmark.h>
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <optional>
+#include <vector>
+
+#include "BrilliantSnapcast/SessionMetrics.hpp"
+#include "BrilliantSnapcast/SnapClient.hpp"
+#include "BrilliantSnapcast/SnapServerSession.hpp"
+#include "BrilliantSnapcast/SocketTuning.hpp"
+
+namespace {
+  using Socket = boost::asio::ip::tcp::socket;
+
+  constexpr std::size_t BUFFER_SIZE = 1024;
+
+  // answers Time messages until the connection closes
+  auto serve(brilliant::snapcast::SnapServerSession<Socket>& session)
+      -> boost::asio::awaitable<void> {
+    std::vector<std::byte> buffer(BUFFER_SIZE);
+    std::vector<std::byte> replyBuffer(BUFFER_SIZE);
+    while (auto message = co_await session.read(std::span(buffer))) {
+      if (std::get<0>(*message).type ==
+          brilliant::snapcast::MessageType::TIME) {
+        co_await session.replyTime(std::get<0>(*message),
+                                   std::span(replyBuffer));
+      }
+    }
+  }
+
+  // sends a ClientInfo and a Time message and waits for the Time reply
+  auto probe(brilliant::snapcast::SnapClient<Socket>& client,
+             std::span<std::byte> buffer,
+             std::optional<std::chrono::nanoseconds>& rtt)
+      -> boost::asio::awaitable<void> {
+    std::array<std::byte, brilliant::snapcast::FRAME_SIZE<
+                              brilliant::snapcast::Time>>
+        timeBuffer{};
+    const auto start = std::chrono::steady_clock::now();
+    if (!co_await client.send(
+            0,
+            brilliant::snapcast::ClientInfo(
+                R"({"volume":{"muted":false,"percent":100},"latency":0})"),
+            buffer) ||
+        !co_await client.send(0, brilliant::snapcast::Time{},
+                              std::span(timeBuffer))) {
+      co_return;
+    }
+    while (auto message = co_await client.read(buffer)) {
+      if (std::get<0>(*message).type ==
+          brilliant::snapcast::MessageType::TIME) {
+        rtt = std::chrono::steady_clock::now() - start;
+        co_return;
+      }
+    }
+  }
+
+  void benchTimeRtt(benchmark::State& state,
+                    brilliant::snapcast::SocketTuning tuning) {
+    auto* mr = std::pmr::get_default_resource();
+    boost::asio::io_context context;
+    boost::asio::ip::tcp::acceptor acceptor(
+        context, {boost::asio::ip::address_v4::loopback(), 0});
+
+    brilliant::snapcast::TcpClient<Socket> tcpClient(Socket(context), mr);
+    tcpClient.setTuning(tuning);
+    brilliant::snapcast::SnapClient<Socket> client(tcpClient);
+    std::optional<brilliant::snapcast::TcpClient<Socket>> peer;
+    boost::asio::co_spawn(
+        context,
+        // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+        [&] -> boost::asio::awaitable<void> {
+          auto accepted = acceptor.async_accept(boost::asio::use_awaitable);
+          co_await tcpClient.connect(acceptor.local_endpoint());
+          peer.emplace(co_await std::move(accepted), mr);
+        },
+        boost::asio::detached);
+    context.run();
+    context.restart();
+    if (tcpClient.tuningError()) {
+      state.SkipWithError(tcpClient.tuningError().message().c_str());
+      return;
+    }
+    brilliant::snapcast::SnapServerSession<Socket> session(*peer);
+    boost::asio::co_spawn(context, serve(session), boost::asio::detached);
+
+    std::vector<std::byte> buffer(BUFFER_SIZE);
+    brilliant::snapcast::Histogram histogram;
+    for (auto _ : state) {
+      std::optional<std::chrono::nanoseconds> rtt;
+      boost::asio::co_spawn(context, probe(client, std::span(buffer), rtt),
+                            boost::asio::detached);
+      while (!rtt && context.run_one() > 0) {
+      }
+      if (!rtt) {
+        state.SkipWithError("connection closed");
+        break;
+      }
+      state.SetIterationTime(std::chrono::duration<double>(*rtt).count());
+      histogram.record(static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(*rtt)
+              .count()));
+    }
+
+    brilliant::snapcast::Histogram::Snapshot snapshot;
+    histogram.snapshot(snapshot);
+    state.counters["p50_us"] =
+        static_cast<double>(snapshot.percentile(0.5));  // NOLINT
+    state.counters["p99_us"] =
+        static_cast<double>(snapshot.percentile(0.99));  // NOLINT
+    state.counters["max_us"] = static_cast<double>(snapshot.max);
+
+    tcpClient.disconnect();
+    peer->disconnect();
+    context.run();
+  }
+}  // namespace
+
+// NOLINTBEGIN
+BENCHMARK_CAPTURE(benchTimeRtt, system,
+                  brilliant::snapcast::SocketTuning::system())
+    ->Iterations(200)
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(benchTimeRtt, interactive,
+                  brilliant::snapcast::SocketTuning::interactive())
+    ->Iterations(200)
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(benchTimeRtt, lowLatency,
+                  brilliant::snapcast::SocketTuning::lowLatency(
+                      std::chrono::milliseconds(1000), 192000))
+    ->Iterations(200)
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+// NOLINTEND
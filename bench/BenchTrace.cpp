@@ -0,0 +1,49 @@
+// Measures the cost of a trace point. The ring is drained whenever it fills so
+// every iteration takes the recording path, the drain is amortised over the
+// records it copies.
+
+#include <benchmark/benchmark.h>
+
+#include <memory_resource>
+#include <vector>
+
+#include "BrilliantSnapcast/Trace.hpp"
+
+namespace {
+  void benchTraceScope(benchmark::State& state) {
+    std::pmr::vector<brilliant::snapcast::trace::Record> records;
+    std::pmr::vector<std::uint32_t> tids;
+    records.reserve(brilliant::snapcast::trace::RING_CAPACITY);
+    tids.reserve(brilliant::snapcast::trace::RING_CAPACITY);
+    auto& registry = brilliant::snapcast::trace::Registry::instance();
+    registry.drain(records, tids);
+    records.clear();
+    tids.clear();
+    std::size_t recorded = 0;
+    const int flow = 0;
+    for (auto _ : state) {
+      {
+        const brilliant::snapcast::trace::Scope scope("bench", &flow);
+      }
+      if (++recorded == brilliant::snapcast::trace::RING_CAPACITY) {
+        registry.drain(records, tids);
+        records.clear();
+        tids.clear();
+        recorded = 0;
+      }
+    }
+    state.counters["dropped"] = static_cast<double>(registry.dropped());
+  }
+
+  void benchTraceMacro(benchmark::State& state) {
+    for (auto _ : state) {
+      // free unless BRILLIANT_SNAPCAST_TRACE is defined, then it records until
+      // the ring is full and drops after that
+      BRILLIANT_TRACE_SCOPE("bench", nullptr);
+      benchmark::ClobberMemory();
+    }
+  }
+}  // namespace
+
+BENCHMARK(benchTraceScope);
+BENCHMARK(benchTraceMacro);
@@ -0,0 +1,97 @@
+// Round trip latency of a Time message over TCP loopback and over a Unix domain
+// socket. Both connections are made with TcpClient::connect() on an endpoint
+// of the protocol, the peer echoes each frame.
+
+#include <benchmark/benchmark.h>
+
+#include <boost/asio.hpp>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+
+#include "BrilliantSnapcast/ProtocolSession.hpp"
+#include "BrilliantSnapcast/SnapClient.hpp"
+
+namespace {
+  constexpr std::size_t FRAME_SIZE =
+      brilliant::snapcast::HEADER_SIZE + sizeof(brilliant::snapcast::Time);
+
+  auto makeEndpoint(std::type_identity<boost::asio::ip::tcp> /*protocol*/)
+      -> boost::asio::ip::tcp::endpoint {
+    return {boost::asio::ip::address_v4::loopback(), 0};
+  }
+
+  auto makeEndpoint(
+      std::type_identity<boost::asio::local::stream_protocol> /*protocol*/)
+      -> boost::asio::local::stream_protocol::endpoint {
+    const auto path = std::string("/tmp/BenchTransport.sock");
+    std::remove(path.c_str());
+    return {path};
+  }
+
+  template <class Protocol>
+  void benchRoundTrip(benchmark::State& state) {
+    using Socket = typename Protocol::socket;
+    auto* mr = std::pmr::get_default_resource();
+    boost::asio::io_context context;
+    typename Protocol::acceptor acceptor(
+        context, makeEndpoint(std::type_identity<Protocol>{}));
+    Socket socket(context, acceptor.local_endpoint().protocol());
+    if constexpr (std::is_same_v<Protocol, boost::asio::ip::tcp>) {
+      socket.set_option(boost::asio::ip::tcp::no_delay(true));
+    }
+    brilliant::snapcast::TcpClient<Socket> tcpClient(std::move(socket), mr);
+    brilliant::snapcast::SnapClient<Socket> snapClient(tcpClient);
+
+    boost::asio::co_spawn(
+        context,
+        // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+        [&acceptor] -> boost::asio::awaitable<void> {
+          auto peer =
+              co_await acceptor.async_accept(boost::asio::use_awaitable);
+          if constexpr (std::is_same_v<Protocol, boost::asio::ip::tcp>) {
+            peer.set_option(boost::asio::ip::tcp::no_delay(true));
+          }
+          std::array<std::byte, FRAME_SIZE> frame{};
+          boost::system::error_code ec{};
+          while (!ec) {
+            std::tie(ec, std::ignore) = co_await boost::asio::async_read(
+                peer, boost::asio::buffer(frame),
+                boost::asio::as_tuple(boost::asio::use_awaitable));
+            if (!ec) {
+              std::tie(ec, std::ignore) = co_await boost::asio::async_write(
+                  peer, boost::asio::buffer(frame),
+                  boost::asio::as_tuple(boost::asio::use_awaitable));
+            }
+          }
+        },
+        boost::asio::detached);
+
+    boost::asio::co_spawn(
+        context,
+        // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+        [&] -> boost::asio::awaitable<void> {
+          if (auto ec = co_await tcpClient.connect(acceptor.local_endpoint());
+              ec) {
+            state.SkipWithError(ec.message().c_str());
+            co_return;
+          }
+          std::array<std::byte, FRAME_SIZE> out{};
+          std::array<std::byte, FRAME_SIZE> in{};
+          for (auto _ : state) {
+            co_await snapClient.send(0, brilliant::snapcast::Time{},
+                                     std::span<std::byte>(out));
+            co_await snapClient.read(std::span<std::byte>(in));
+          }
+          tcpClient.disconnect();
+        },
+        boost::asio::detached);
+    context.run();
+    state.SetItemsProcessed(state.iterations());
+  }
+}  // namespace
+
+// NOLINTBEGIN
+BENCHMARK(benchRoundTrip<boost::asio::ip::tcp>);
+BENCHMARK(benchRoundTrip<boost::asio::local::stream_protocol>);
+// NOLINTEND
@@ -0,0 +1,79 @@
+// Compares the field descriptor codec for the message header with copying a
+// packed struct, the representation it replaced. Base is padded in memory
+// after refersTo, so on little endian hosts the codec copies it in two runs,
+// the 6 bytes before the padding and the 20 after it: 8 moves at -O2 on
+// x86-64 against 6 for the packed copy and 12 for the former field by field
+// copy. The difference to the packed copy is within the noise of a few
+// tenths of a nanosecond per header. A wire identical mirror struct copied
+// in one piece and then assigned field by field measured no faster than the
+// field by field copy.
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstring>
+
+#include "BrilliantSnapcast/MessageConv.hpp"
+
+namespace {
+#pragma pack(1)
+  // the former packed header layout, kept as the baseline
+  struct PackedBase {
+    std::uint16_t type;
+    std::uint16_t id;
+    std::uint16_t refersTo;
+    std::uint32_t sentSec;
+    std::uint32_t sentUsec;
+    std::uint32_t receivedSec;
+    std::uint32_t receivedUsec;
+    std::uint32_t size;
+  };
+#pragma pack()
+
+  static_assert(sizeof(PackedBase) == brilliant::snapcast::HEADER_SIZE);
+
+  void benchDecodeHeader(benchmark::State& state) {
+    std::array<std::byte, brilliant::snapcast::HEADER_SIZE> bytes{};
+    brilliant::snapcast::Base base{};
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(bytes);
+      brilliant::snapcast::read(std::span(bytes), base);
+      benchmark::DoNotOptimize(base);
+    }
+  }
+
+  void benchDecodeHeaderPacked(benchmark::State& state) {
+    std::array<std::byte, brilliant::snapcast::HEADER_SIZE> bytes{};
+    PackedBase base{};
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(bytes);
+      std::memcpy(&base, bytes.data(), sizeof(base));
+      benchmark::DoNotOptimize(base);
+    }
+  }
+
+  void benchEncodeHeader(benchmark::State& state) {
+    std::array<std::byte, brilliant::snapcast::HEADER_SIZE> bytes{};
+    brilliant::snapcast::Base base{};
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(base);
+      brilliant::snapcast::write(std::span(bytes), base);
+      benchmark::DoNotOptimize(bytes);
+    }
+  }
+
+  void benchEncodeHeaderPacked(benchmark::State& state) {
+    std::array<std::byte, brilliant::snapcast::HEADER_SIZE> bytes{};
+    PackedBase base{};
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(base);
+      std::memcpy(bytes.data(), &base, sizeof(base));
+      benchmark::DoNotOptimize(bytes);
+    }
+  }
+}  // namespace
+
+BENCHMARK(benchDecodeHeader);
+BENCHMARK(benchDecodeHeaderPacked);
+BENCHMARK(benchEncodeHeader);
+BENCHMARK(benchEncodeHeaderPacked);
@@ -6,6 +6,13 @@ option(BRILLIANT_CMAKE_BUILD_HEADER_ONLY
        "Build project as a header only library" OFF
 )
 option(BRILLIANT_CMAKE_CODE_COVERAGE "Build project with code coverage" OFF)
+option(BRILLIANT_CMAKE_BUILD_BENCHMARKS "Build the benchmarks" OFF)
+option(BRILLIANT_CMAKE_ENABLE_TRACING
+       "Compile in hot path trace points (see Trace.hpp)" OFF
+)
+option(BRILLIANT_CMAKE_USE_IO_URING
+       "Use the Boost.Asio io_uring backend for sockets (Linux only)" OFF
+)
 
 set(BRILLIANT_CMAKE_SANITIZER
     ""
@@ -0,0 +1,24 @@
+# Cross compile for big endian s390x and run the tests under qemu-user, e.g.
+#   cmake -S . -B build-s390x \
+#     -DCMAKE_TOOLCHAIN_FILE=cmake/toolchains/s390x-linux-gnu.cmake
+#   cmake --build build-s390x && ctest --test-dir build-s390x
+# GTest and Boost must be available for the target in CMAKE_FIND_ROOT_PATH.
+# No CI job runs this build, the big endian paths of the wire codec are only
+# covered by the simulated host tests in TestWireCodec on little endian hosts
+# and are unverified on real big endian hardware.
+
+set(CMAKE_SYSTEM_NAME Linux)
+set(CMAKE_SYSTEM_PROCESSOR s390x)
+
+set(BRILLIANT_CROSS_TRIPLE s390x-linux-gnu)
+set(CMAKE_CXX_COMPILER ${BRILLIANT_CROSS_TRIPLE}-g++)
+set(CMAKE_FIND_ROOT_PATH /usr/${BRILLIANT_CROSS_TRIPLE})
+set(CMAKE_FIND_ROOT_PATH_MODE_PROGRAM NEVER)
+set(CMAKE_FIND_ROOT_PATH_MODE_LIBRARY ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_INCLUDE ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_PACKAGE ONLY)
+
+# ctest and gtest_discover_tests run target binaries through the emulator
+set(CMAKE_CROSSCOMPILING_EMULATOR qemu-s390x -L
+                                  /usr/${BRILLIANT_CROSS_TRIPLE}
+)
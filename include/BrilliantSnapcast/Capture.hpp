@@ -0,0 +1,544 @@
+#pragma once
+
+// capture files are written and mapped with POSIX file APIs
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <boost/system/error_code.hpp>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <optional>
+#include <span>
+#include <utility>
+
+#include "BrilliantSnapcast/CaptureSink.hpp"
+#include "BrilliantSnapcast/Message.hpp"
+#include "BrilliantSnapcast/WireCodec.hpp"
+
+namespace brilliant::snapcast {
+
+  /// Magic bytes at the start of a capture file
+  inline constexpr std::array<char, 8> CAPTURE_MAGIC{'B', 'S', 'C', 'A',
+                                                     'P', '0', '0', '1'};
+
+  /**
+   * @brief Header preceding every frame in a capture file, stored little
+   * endian. The frame bytes follow and are padded to a multiple of 8 bytes.
+   *
+   */
+  struct CaptureRecord {
+    /// Receive time in microseconds
+    std::uint64_t timestamp;
+
+    /// Number of frame bytes, header and body, without padding
+    std::uint32_t size;
+
+    /// Reserved, always 0
+    std::uint32_t reserved;
+  };
+
+  /**
+   * @brief Wire layout of CaptureRecord
+   *
+   */
+  template <>
+  struct WireLayout<CaptureRecord> {
+    /// The fields in file order
+    using fields = Fields<&CaptureRecord::timestamp, &CaptureRecord::size,
+                          &CaptureRecord::reserved>;
+  };
+
+  /**
+   * @brief Entry of a capture index file, stored little endian. One entry
+   * is written per record.
+   *
+   */
+  struct CaptureIndexEntry {
+    /// Receive time in microseconds
+    std::uint64_t timestamp;
+
+    /// Offset of the record in the capture file
+    std::uint64_t offset;
+  };
+
+  /**
+   * @brief Wire layout of CaptureIndexEntry
+   *
+   */
+  template <>
+  struct WireLayout<CaptureIndexEntry> {
+    /// The fields in file order
+    using fields =
+        Fields<&CaptureIndexEntry::timestamp, &CaptureIndexEntry::offset>;
+  };
+
+  /**
+   * @brief Convert a Time to microseconds
+   *
+   * @param time The time
+   * @return The time in microseconds
+   */
+  inline auto toMicroseconds(Time time) -> std::uint64_t {
+    constexpr std::uint64_t USEC_PER_SEC = 1'000'000;
+    return (static_cast<std::uint64_t>(time.sec) * USEC_PER_SEC) + time.usec;
+  }
+
+  /**
+   * @brief Appends frames to a capture file and a timestamp index file. Every
+   * record is written with a single writev call unless the kernel writes it
+   * in parts, no memory is allocated. After a failed write no more records
+   * are written, so the index never points past the data.
+   *
+   */
+  class CaptureWriter : public CaptureSink {
+  public:
+    /**
+     * @brief Open a capture. Existing files are appended to.
+     *
+     * @param path Path of the capture file
+     * @param indexPath Path of the index file
+     * @return The writer if successful. An error_code otherwise.
+     */
+    static auto open(const char* path, const char* indexPath)
+        -> std::expected<CaptureWriter, boost::system::error_code> {
+      constexpr mode_t MODE = 0644;
+      CaptureWriter writer(
+          ::open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, MODE),
+          ::open(indexPath, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, MODE));
+      if (writer._fd < 0 || writer._indexFd < 0) {
+        return std::unexpected(lastError());
+      }
+
+      struct stat st {};
+      if (::fstat(writer._fd, &st) != 0) {
+        return std::unexpected(lastError());
+      }
+      writer._offset = static_cast<std::uint64_t>(st.st_size);
+      if (writer._offset == 0) {
+        if (::write(writer._fd, CAPTURE_MAGIC.data(), CAPTURE_MAGIC.size()) !=
+            static_cast<ssize_t>(CAPTURE_MAGIC.size())) {
+          return std::unexpected(lastError());
+        }
+        writer._offset = CAPTURE_MAGIC.size();
+      }
+      return writer;
+    }
+
+    /**
+     * @brief Destroy the Capture Writer object. Closes the files.
+     *
+     */
+    ~CaptureWriter() override {
+      if (_fd >= 0) {
+        ::close(_fd);
+      }
+      if (_indexFd >= 0) {
+        ::close(_indexFd);
+      }
+    }
+
+    /**
+     * @brief Deleted copy constructor
+     *
+     */
+    CaptureWriter(const CaptureWriter&) = delete;
+
+    /**
+     * @brief Deleted copy assignment operator
+     *
+     * @return CaptureWriter&
+     */
+    auto operator=(const CaptureWriter&) -> CaptureWriter& = delete;
+
+    /**
+     * @brief Move constructor
+     *
+     * @param other The object to move from
+     */
+    CaptureWriter(CaptureWriter&& other) noexcept
+        : _fd(std::exchange(other._fd, -1)),
+          _indexFd(std::exchange(other._indexFd, -1)),
+          _offset(other._offset),
+          _error(other._error) {}
+
+    /**
+     * @brief Move assignment operator
+     *
+     * @param other The object to move from
+     * @return A reference to this object
+     */
+    auto operator=(CaptureWriter&& other) noexcept -> CaptureWriter& {
+      std::swap(_fd, other._fd);
+      std::swap(_indexFd, other._indexFd);
+      std::swap(_offset, other._offset);
+      std::swap(_error, other._error);
+      return *this;
+    }
+
+    /**
+     * @brief Append a frame to the capture
+     *
+     * @param received The time the frame header was received
+     * @param header The raw header bytes
+     * @param body The raw message bytes
+     */
+    void record(Time received, std::span<const std::byte> header,
+                std::span<const std::byte> body) override {
+      constexpr std::size_t ALIGNMENT = 8;
+      static constexpr std::array<std::byte, ALIGNMENT> padding{};
+
+      const auto size = std::size(header) + std::size(body);
+      const CaptureRecord rec{.timestamp = toMicroseconds(received),
+                              .size = static_cast<std::uint32_t>(size),
+                              .reserved = 0};
+      const auto padded = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+      std::array<std::byte, WIRE_SIZE<CaptureRecord>> recBytes{};
+      encodeWire(recBytes.data(), rec);
+
+      // NOLINTBEGIN(cppcoreguidelines-pro-type-const-cast)
+      std::array<iovec, 4> iov{
+          iovec{recBytes.data(), recBytes.size()},
+          iovec{const_cast<std::byte*>(header.data()), header.size()},
+          iovec{const_cast<std::byte*>(body.data()), body.size()},
+          iovec{const_cast<std::byte*>(padding.data()), padded - size}};
+      // NOLINTEND(cppcoreguidelines-pro-type-const-cast)
+      if (_error) {
+        return;
+      }
+      if (auto ec = writeAll(_fd, iov); ec) {
+        _error = ec;
+        return;
+      }
+
+      const CaptureIndexEntry entry{.timestamp = rec.timestamp,
+                                    .offset = _offset};
+      _offset += recBytes.size() + padded;
+      std::array<std::byte, WIRE_SIZE<CaptureIndexEntry>> entryBytes{};
+      encodeWire(entryBytes.data(), entry);
+      std::array<iovec, 1> indexIov{
+          iovec{entryBytes.data(), entryBytes.size()}};
+      _error = writeAll(_indexFd, indexIov);
+    }
+
+    /**
+     * @brief Get the first error encountered while recording. No records
+     * are written after it.
+     *
+     * @return An error_code, empty if all records were written
+     */
+    [[nodiscard]] auto error() const -> boost::system::error_code {
+      return _error;
+    }
+
+  private:
+    /**
+     * @brief Construct a new Capture Writer object
+     *
+     * @param fd The capture file descriptor
+     * @param indexFd The index file descriptor
+     */
+    CaptureWriter(int fd, int indexFd) : _fd(fd), _indexFd(indexFd) {}
+
+    /**
+     * @brief Get the error_code for errno
+     *
+     * @return The error_code
+     */
+    static auto lastError() -> boost::system::error_code {
+      return {errno, boost::system::system_category()};
+    }
+
+    /**
+     * @brief Write buffers completely, continuing after partial writes and
+     * interrupts
+     *
+     * @param fd The file descriptor
+     * @param iov The buffers. Advanced past the bytes written.
+     * @return An error_code, empty if all bytes were written
+     */
+    static auto writeAll(int fd, std::span<iovec> iov)
+        -> boost::system::error_code {
+      while (!iov.empty()) {
+        const auto written =
+            ::writev(fd, iov.data(), static_cast<int>(iov.size()));
+        if (written < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          return lastError();
+        }
+        auto remaining = static_cast<std::size_t>(written);
+        while (!iov.empty() && remaining >= iov.front().iov_len) {
+          remaining -= iov.front().iov_len;
+          iov = iov.subspan(1);
+        }
+        if (!iov.empty()) {
+          // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+          iov.front().iov_base = static_cast<std::byte*>(iov.front().iov_base) +
+                                 remaining;
+          iov.front().iov_len -= remaining;
+        }
+      }
+      return {};
+    }
+
+    /// Capture file descriptor
+    int _fd{-1};
+
+    /// Index file descriptor
+    int _indexFd{-1};
+
+    /// Offset of the next record
+    std::uint64_t _offset{};
+
+    /// First write error, stops recording
+    boost::system::error_code _error{};
+  };
+
+  /**
+   * @brief A read only, memory mapped capture and its optional index
+   *
+   */
+  class CaptureFile {
+  public:
+    /**
+     * @brief A record of the capture
+     *
+     */
+    struct Record {
+      /// Receive time in microseconds
+      std::uint64_t timestamp;
+
+      /// The raw frame bytes, a view into the mapping
+      std::span<const std::byte> bytes;
+
+      /// Offset of the next record
+      std::size_t next;
+    };
+
+    /**
+     * @brief Map a capture
+     *
+     * @param path Path of the capture file
+     * @param indexPath Path of the index file, may be null
+     * @return The mapped capture if successful. An error_code otherwise.
+     */
+    static auto open(const char* path, const char* indexPath = nullptr)
+        -> std::expected<CaptureFile, boost::system::error_code> {
+      CaptureFile file;
+      if (auto ec = map(path, file._data)) {
+        return std::unexpected(ec);
+      }
+      if (std::size(file._data) < CAPTURE_MAGIC.size() ||
+          std::memcmp(file._data.data(), CAPTURE_MAGIC.data(),
+                      CAPTURE_MAGIC.size()) != 0) {
+        return std::unexpected(boost::system::errc::make_error_code(
+            boost::system::errc::illegal_byte_sequence));
+      }
+      if (indexPath) {
+        if (auto ec = map(indexPath, file._index)) {
+          return std::unexpected(ec);
+        }
+      }
+      return file;
+    }
+
+    /**
+     * @brief Destroy the Capture File object. Unmaps the files.
+     *
+     */
+    ~CaptureFile() {
+      unmap(_data);
+      unmap(_index);
+    }
+
+    /**
+     * @brief Deleted copy constructor
+     *
+     */
+    CaptureFile(const CaptureFile&) = delete;
+
+    /**
+     * @brief Deleted copy assignment operator
+     *
+     * @return CaptureFile&
+     */
+    auto operator=(const CaptureFile&) -> CaptureFile& = delete;
+
+    /**
+     * @brief Move constructor
+     *
+     * @param other The object to move from
+     */
+    CaptureFile(CaptureFile&& other) noexcept
+        : _data(std::exchange(other._data, {})),
+          _index(std::exchange(other._index, {})) {}
+
+    /**
+     * @brief Move assignment operator
+     *
+     * @param other The object to move from
+     * @return A reference to this object
+     */
+    auto operator=(CaptureFile&& other) noexcept -> CaptureFile& {
+      std::swap(_data, other._data);
+      std::swap(_index, other._index);
+      return *this;
+    }
+
+    /**
+     * @brief Get the offset of the first record
+     *
+     * @return The offset
+     */
+    [[nodiscard]] static constexpr auto begin() -> std::size_t {
+      return CAPTURE_MAGIC.size();
+    }
+
+    /**
+     * @brief Read the record at an offset
+     *
+     * @param offset The record offset
+     * @return The record, or an empty optional at the end of the capture or if
+     * the record is truncated
+     */
+    [[nodiscard]] auto at(std::size_t offset) const -> std::optional<Record> {
+      constexpr std::size_t ALIGNMENT = 8;
+      if (offset + WIRE_SIZE<CaptureRecord> > std::size(_data)) {
+        return std::nullopt;
+      }
+      CaptureRecord rec{};
+      decodeWire(_data.data() + offset, rec);
+      const auto start = offset + WIRE_SIZE<CaptureRecord>;
+      if (start + rec.size > std::size(_data)) {
+        return std::nullopt;
+      }
+      const auto padded = (rec.size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+      return Record{.timestamp = rec.timestamp,
+                    .bytes = _data.subspan(start, rec.size),
+                    .next = start + padded};
+    }
+
+    /**
+     * @brief Find the first record received at or after a time. Uses the
+     * index if one was opened, scans the capture otherwise.
+     *
+     * @param timestamp The time in microseconds
+     * @return The offset of the record. The end of the capture if no record
+     * matches.
+     */
+    [[nodiscard]] auto seek(std::uint64_t timestamp) const -> std::size_t {
+      if (!_index.empty()) {
+        const auto count =
+            std::size(_index) / WIRE_SIZE<CaptureIndexEntry>;
+        std::size_t lo = 0;
+        std::size_t hi = count;
+        while (lo < hi) {
+          const auto mid = lo + ((hi - lo) / 2);
+          if (entry(mid).timestamp < timestamp) {
+            lo = mid + 1;
+          } else {
+            hi = mid;
+          }
+        }
+        return lo == count ? std::size(_data)
+                           : static_cast<std::size_t>(entry(lo).offset);
+      }
+
+      auto offset = begin();
+      for (auto rec = at(offset); rec && rec->timestamp < timestamp;
+           rec = at(offset)) {
+        offset = rec->next;
+      }
+      return std::min(offset, std::size(_data));
+    }
+
+    /**
+     * @brief Get the size of the capture
+     *
+     * @return The size in bytes
+     */
+    [[nodiscard]] auto size() const -> std::size_t { return _data.size(); }
+
+  private:
+    /**
+     * @brief Construct an empty Capture File object
+     *
+     */
+    CaptureFile() = default;
+
+    /**
+     * @brief Read an index entry
+     *
+     * @param i The entry index
+     * @return The entry
+     */
+    [[nodiscard]] auto entry(std::size_t i) const -> CaptureIndexEntry {
+      CaptureIndexEntry e{};
+      decodeWire(_index.data() + (i * WIRE_SIZE<CaptureIndexEntry>), e);
+      return e;
+    }
+
+    /**
+     * @brief Map a file read only
+     *
+     * @param path The file path
+     * @param out Set to the mapping
+     * @return An error_code, empty if successful
+     */
+    static auto map(const char* path, std::span<const std::byte>& out)
+        -> boost::system::error_code {
+      const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        return {errno, boost::system::system_category()};
+      }
+      struct stat st {};
+      boost::system::error_code ec{};
+      if (::fstat(fd, &st) != 0) {
+        ec = {errno, boost::system::system_category()};
+      } else if (st.st_size > 0) {
+        const auto size = static_cast<std::size_t>(st.st_size);
+        void* p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+          ec = {errno, boost::system::system_category()};
+        } else {
+          ::madvise(p, size, MADV_SEQUENTIAL);
+          out = {static_cast<const std::byte*>(p), size};
+        }
+      }
+      ::close(fd);
+      return ec;
+    }
+
+    /**
+     * @brief Unmap a mapping created by map()
+     *
+     * @param mapping The mapping, may be empty
+     */
+    static void unmap(std::span<const std::byte> mapping) {
+      if (!mapping.empty()) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+        ::munmap(const_cast<std::byte*>(mapping.data()), mapping.size());
+      }
+    }
+
+    /// The mapped capture
+    std::span<const std::byte> _data;
+
+    /// The mapped index, empty if no index was opened
+    std::span<const std::byte> _index;
+  };
+
+}  // namespace brilliant::snapcast
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+#include "BrilliantSnapcast/Message.hpp"
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief Receives every raw frame read by a SnapClient
+   *
+   */
+  class CaptureSink {
+  public:
+    /**
+     * @brief Destroy the Capture Sink object
+     *
+     */
+    virtual ~CaptureSink() = default;
+
+    /**
+     * @brief Record a frame
+     *
+     * @param received The time the frame header was received
+     * @param header The raw header bytes
+     * @param body The raw message bytes following the header
+     */
+    virtual void record(Time received, std::span<const std::byte> header,
+                        std::span<const std::byte> body) = 0;
+  };
+
+}  // namespace brilliant::snapcast
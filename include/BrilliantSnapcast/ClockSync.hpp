@@ -0,0 +1,554 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <boost/system/error_code.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <expected>
+#include <optional>
+#include <string_view>
+
+// the state file is written with POSIX file APIs
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "BrilliantSnapcast/WireCodec.hpp"
+
+namespace brilliant::snapcast {
+
+  /// Magic bytes at the start of a clock state file
+  inline constexpr std::array<char, 8> CLOCK_STATE_MAGIC{'B', 'S', 'C', 'L',
+                                                         'K', '0', '0', '1'};
+
+  /**
+   * @brief A snapshot of a ClockSync estimate, small enough to be written
+   * to a file on every save
+   *
+   */
+  struct ClockSyncState {
+    /// Server clock minus the local steady clock in microseconds at the
+    /// time at
+    std::int64_t offset{};
+
+    /// Local steady clock in microseconds when the offset was estimated
+    std::int64_t at{};
+
+    /// Drift of the server clock against the local clock in parts per
+    /// billion
+    std::int64_t driftPpb{};
+
+    /// Number of Time replies behind the estimate
+    std::uint32_t confidence{};
+
+    /// Identity of the server, see ClockSync::serverId()
+    std::uint64_t server{};
+
+    /// First half of the local boot id, the steady clock restarts with
+    /// every boot
+    std::uint64_t bootHigh{};
+
+    /// Second half of the local boot id
+    std::uint64_t bootLow{};
+
+    /**
+     * @brief Compare two states
+     *
+     * @return True if all members are equal
+     */
+    auto operator==(const ClockSyncState&) const -> bool = default;
+  };
+
+  /**
+   * @brief Wire layout of ClockSyncState
+   *
+   */
+  template <>
+  struct WireLayout<ClockSyncState> {
+    /// The fields in wire order
+    using fields = Fields<&ClockSyncState::offset, &ClockSyncState::at,
+                          &ClockSyncState::driftPpb,
+                          &ClockSyncState::confidence, &ClockSyncState::server,
+                          &ClockSyncState::bootHigh, &ClockSyncState::bootLow>;
+  };
+
+  /// Size of a clock state file
+  inline constexpr std::size_t CLOCK_STATE_SIZE =
+      CLOCK_STATE_MAGIC.size() + WIRE_SIZE<ClockSyncState>;
+
+  /**
+   * @brief Options of a ClockSync
+   *
+   */
+  struct ClockSyncOptions {
+    /// Replies an estimate needs before it is worth restoring
+    std::uint32_t minConfidence{8};
+
+    /// Replies a restored estimate is checked against
+    std::uint32_t validationReplies{3};
+
+    /// Largest difference between a reply and a restored estimate, larger
+    /// differences discard the estimate
+    std::chrono::microseconds tolerance{std::chrono::milliseconds(2)};
+
+    /// Oldest state which is restored
+    std::chrono::seconds maxAge{std::chrono::hours(24)};
+  };
+
+  /**
+   * @brief Estimates the offset of the server clock to the local steady
+   * clock and its drift from Time replies
+   *
+   * The first replies are averaged, later ones move the offset by an
+   * eighth of the prediction error to smooth out jitter while the drift
+   * follows the remaining error slowly, an alpha-beta filter. The estimate
+   * can be saved with state() and save() and restored on the next start
+   * with load() and restore(). A restored estimate is used at once and
+   * checked against the first Time replies; one which does not predict
+   * them within the tolerance, e.g. because the server restarted, is
+   * discarded and the estimate starts from the reply.
+   *
+   */
+  class ClockSync {
+  public:
+    /**
+     * @brief Construct a new Clock Sync object without an estimate
+     *
+     * @param options The options
+     */
+    explicit ClockSync(ClockSyncOptions options = {}) : _options(options) {}
+
+    /**
+     * @brief Add the offset measured by a Time reply
+     *
+     * @param sample The server clock minus the local clock in microseconds,
+     * see clockOffset(const Base&, const Time&)
+     * @param now The local time the reply was received
+     * @return False if the reply contradicted a restored estimate, which was
+     * discarded
+     */
+    auto update(std::int64_t sample, std::chrono::steady_clock::time_point now)
+        -> bool {
+      bool kept = true;
+      const auto measured = static_cast<double>(sample);
+      if (_validating > 0) {
+        const auto error = measured - predict(now);
+        if (std::abs(error) >
+            static_cast<double>(_options.tolerance.count())) {
+          reset();
+          kept = false;
+        } else {
+          --_validating;
+        }
+      }
+      if (_confidence == 0) {
+        _offset = measured;
+        _at = now;
+        _confidence = 1;
+        return kept;
+      }
+
+      const auto elapsed =
+          std::chrono::duration<double, std::micro>(now - _at).count();
+      const auto predicted = predict(now);
+      const auto residual = measured - predicted;
+      _offset = predicted +
+                (residual / std::min(_confidence + 1.0, SMOOTHING));
+      if (_confidence >= SMOOTHING && elapsed > 0) {
+        _drift += residual * MICROS_PER_SECOND / (DRIFT_SMOOTHING * elapsed);
+      }
+      _at = now;
+      _confidence = std::min(_confidence + 1, MAX_CONFIDENCE);
+      return kept;
+    }
+
+    /**
+     * @brief Get the estimated offset at a point in time
+     *
+     * @param now The local time
+     * @return The server clock minus the local clock in microseconds, empty
+     * without an estimate
+     */
+    [[nodiscard]] auto offset(std::chrono::steady_clock::time_point now) const
+        -> std::optional<std::int64_t> {
+      if (_confidence == 0) {
+        return std::nullopt;
+      }
+      return std::llround(predict(now));
+    }
+
+    /**
+     * @brief Get the estimated drift
+     *
+     * @return The drift of the server clock against the local clock in parts
+     * per million, positive if the server clock runs faster
+     */
+    [[nodiscard]] auto driftPpm() const -> double { return _drift; }
+
+    /**
+     * @brief Get the number of Time replies behind the estimate
+     *
+     * @return The confidence, 0 without an estimate
+     */
+    [[nodiscard]] auto confidence() const -> std::uint32_t {
+      return _confidence;
+    }
+
+    /**
+     * @brief Check if a restored estimate is still being validated
+     *
+     * @return True until validationReplies replies confirmed it
+     */
+    [[nodiscard]] auto validating() const -> bool { return _validating > 0; }
+
+    /**
+     * @brief Discard the estimate
+     *
+     */
+    void reset() {
+      _offset = 0;
+      _drift = 0;
+      _confidence = 0;
+      _validating = 0;
+    }
+
+    /**
+     * @brief Get a snapshot of the estimate
+     *
+     * @param server The identity of the server, see serverId()
+     * @return The state
+     */
+    [[nodiscard]] auto state(std::uint64_t server) const -> ClockSyncState {
+      constexpr double PPB_PER_PPM = 1000;
+      const auto boot = bootId();
+      return {
+          .offset = std::llround(_offset),
+          .at = toMicros(_at),
+          .driftPpb = std::llround(_drift * PPB_PER_PPM),
+          .confidence = _confidence,
+          .server = server,
+          .bootHigh = boot[0],
+          .bootLow = boot[1],
+      };
+    }
+
+    /**
+     * @brief Use a saved estimate until Time replies validate or discard it.
+     * A state of another server or boot, an older state than maxAge or one
+     * with less than minConfidence replies is ignored.
+     *
+     * @param state The saved state
+     * @param server The identity of the server, see serverId()
+     * @param now The local time
+     * @return True if the state was restored
+     */
+    auto restore(const ClockSyncState& state, std::uint64_t server,
+                 std::chrono::steady_clock::time_point now) -> bool {
+      const auto age = toMicros(now) - state.at;
+      if (state.server != server ||
+          state.confidence < _options.minConfidence || age < 0 ||
+          age > std::chrono::microseconds(_options.maxAge).count() ||
+          std::array{state.bootHigh, state.bootLow} != bootId()) {
+        return false;
+      }
+      constexpr double PPB_PER_PPM = 1000;
+      _offset = static_cast<double>(state.offset);
+      _at = std::chrono::steady_clock::time_point(
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              std::chrono::microseconds(state.at)));
+      _drift = static_cast<double>(state.driftPpb) / PPB_PER_PPM;
+      _confidence = std::min(state.confidence, MAX_CONFIDENCE);
+      _validating = _options.validationReplies;
+      return true;
+    }
+
+    /**
+     * @brief Write a state to a file, replacing it atomically. The state is
+     * written and synced to a temporary file next to it, which is then
+     * renamed over the file, so a crash leaves either the old or the new
+     * state.
+     *
+     * @param path The file path
+     * @param state The state
+     * @return An error_code, empty if successful, operation_not_supported on
+     * platforms without POSIX files
+     */
+    static auto save(const char* path, const ClockSyncState& state)
+        -> boost::system::error_code {
+#if defined(__unix__) || defined(__APPLE__)
+      constexpr mode_t MODE = 0644;
+      std::array<char, MAX_PATH_SIZE> temporary{};
+      // one temporary file per process, saves of two processes do not mix
+      const int length =
+          std::snprintf(temporary.data(), temporary.size(), "%s.%ld.tmp",
+                        path, static_cast<long>(::getpid()));  // NOLINT
+      if (length < 0 || static_cast<std::size_t>(length) >= temporary.size()) {
+        return boost::system::errc::make_error_code(
+            boost::system::errc::filename_too_long);
+      }
+      std::array<std::byte, CLOCK_STATE_SIZE> data{};
+      encode(state, data);
+      const int fd =
+          ::open(temporary.data(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                 MODE);  // NOLINT
+      if (fd < 0) {
+        return {errno, boost::system::system_category()};
+      }
+      boost::system::error_code ec{};
+      std::size_t written = 0;
+      while (written < data.size()) {
+        const auto n =
+            ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n < 0) {
+          ec = {errno, boost::system::system_category()};
+          break;
+        }
+        written += static_cast<std::size_t>(n);
+      }
+      if (!ec && ::fsync(fd) != 0) {
+        ec = {errno, boost::system::system_category()};
+      }
+      if (::close(fd) != 0 && !ec) {
+        ec = {errno, boost::system::system_category()};
+      }
+      if (!ec && std::rename(temporary.data(), path) != 0) {
+        ec = {errno, boost::system::system_category()};
+      }
+      if (ec) {
+        ::unlink(temporary.data());
+      }
+      return ec;
+#else
+      static_cast<void>(path);
+      static_cast<void>(state);
+      return boost::system::errc::make_error_code(
+          boost::system::errc::operation_not_supported);
+#endif
+    }
+
+    /**
+     * @brief Read a state written by save()
+     *
+     * @param path The file path
+     * @return The state or an error_code, illegal_byte_sequence if the file
+     * holds no state, operation_not_supported on platforms without POSIX
+     * files
+     */
+    static auto load(const char* path)
+        -> std::expected<ClockSyncState, boost::system::error_code> {
+#if defined(__unix__) || defined(__APPLE__)
+      const int fd = ::open(path, O_RDONLY | O_CLOEXEC);  // NOLINT
+      if (fd < 0) {
+        return std::unexpected(boost::system::error_code(
+            errno, boost::system::system_category()));
+      }
+      // one byte more to detect a longer file
+      std::array<std::byte, CLOCK_STATE_SIZE + 1> data{};
+      std::size_t size = 0;
+      while (size < data.size()) {
+        const auto n = ::read(fd, data.data() + size, data.size() - size);
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n <= 0) {
+          break;
+        }
+        size += static_cast<std::size_t>(n);
+      }
+      ::close(fd);
+      if (size != CLOCK_STATE_SIZE ||
+          std::memcmp(data.data(), CLOCK_STATE_MAGIC.data(),
+                      CLOCK_STATE_MAGIC.size()) != 0) {
+        return std::unexpected(boost::system::errc::make_error_code(
+            boost::system::errc::illegal_byte_sequence));
+      }
+      ClockSyncState state;
+      decodeWire(data.data() + CLOCK_STATE_MAGIC.size(), state);
+      return state;
+#else
+      static_cast<void>(path);
+      return std::unexpected(boost::system::errc::make_error_code(
+          boost::system::errc::operation_not_supported));
+#endif
+    }
+
+    /**
+     * @brief Get an identity of a server from its endpoint, FNV-1a of the
+     * endpoint's address bytes. The identity changes with the address,
+     * prefer serverId(std::string_view, std::uint16_t) for a server which
+     * is looked up by name.
+     *
+     * @tparam Endpoint The endpoint type, e.g. an ip::tcp::endpoint
+     * @param endpoint The endpoint
+     * @return The identity
+     */
+    template <class Endpoint>
+    static auto serverId(const Endpoint& endpoint) -> std::uint64_t {
+      return hash(FNV_BASIS, endpoint.data(), endpoint.size());
+    }
+
+    /**
+     * @brief Get an identity of a server from its configured host and port,
+     * FNV-1a of both. The identity is kept when the host resolves to another
+     * address.
+     *
+     * @param host The configured host name or address
+     * @param port The configured port
+     * @return The identity
+     */
+    static auto serverId(std::string_view host, std::uint16_t port)
+        -> std::uint64_t {
+      const std::array<unsigned char, 2> portBytes{
+          static_cast<unsigned char>(port >> 8U),  // NOLINT
+          static_cast<unsigned char>(port & 0xFFU)};  // NOLINT
+      return hash(hash(FNV_BASIS, host.data(), host.size()), portBytes.data(),
+                  portBytes.size());
+    }
+
+    /**
+     * @brief Get the boot id of the local host from
+     * /proc/sys/kernel/random/boot_id
+     *
+     * @return The boot id, zero where the system provides none
+     */
+    static auto bootId() -> std::array<std::uint64_t, 2> {
+      std::array<std::uint64_t, 2> result{};
+#if defined(__unix__) || defined(__APPLE__)
+      const int fd =
+          ::open("/proc/sys/kernel/random/boot_id", O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        return result;
+      }
+      std::array<char, 64> text{};  // NOLINT
+      const auto n = ::read(fd, text.data(), text.size());
+      ::close(fd);
+      constexpr unsigned NIBBLE = 4;
+      constexpr std::size_t DIGITS = 16;
+      std::size_t digits = 0;
+      for (std::size_t i = 0; n > 0 && i < static_cast<std::size_t>(n) &&
+                              digits < 2 * DIGITS;
+           ++i) {
+        const auto c = text.at(i);
+        std::uint64_t value = 0;
+        if (c >= '0' && c <= '9') {
+          value = static_cast<std::uint64_t>(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+          value = static_cast<std::uint64_t>(c - 'a' + 10);  // NOLINT
+        } else {
+          continue;
+        }
+        auto& half = result.at(digits / DIGITS);
+        half = (half << NIBBLE) | value;
+        ++digits;
+      }
+#endif
+      return result;
+    }
+
+  private:
+    /**
+     * @brief Continue an FNV-1a hash over some bytes
+     *
+     * @param basis The hash so far, FNV_BASIS to start a new one
+     * @param data The bytes
+     * @param size The number of bytes
+     * @return The hash
+     */
+    static auto hash(std::uint64_t basis, const void* data, std::size_t size)
+        -> std::uint64_t {
+      constexpr std::uint64_t PRIME = 1099511628211ULL;
+      const auto* bytes = static_cast<const unsigned char*>(data);
+      for (std::size_t i = 0; i < size; ++i) {
+        basis = (basis ^ bytes[i]) * PRIME;  // NOLINT
+      }
+      return basis;
+    }
+
+    /**
+     * @brief Encode a state with the magic bytes in front
+     *
+     * @param state The state
+     * @param out The file content
+     */
+    static void encode(const ClockSyncState& state,
+                       std::array<std::byte, CLOCK_STATE_SIZE>& out) {
+      std::memcpy(out.data(), CLOCK_STATE_MAGIC.data(),
+                  CLOCK_STATE_MAGIC.size());
+      encodeWire(out.data() + CLOCK_STATE_MAGIC.size(), state);
+    }
+
+    /**
+     * @brief Extrapolate the offset with the drift
+     *
+     * @param now The local time
+     * @return The offset in microseconds
+     */
+    [[nodiscard]] auto predict(std::chrono::steady_clock::time_point now) const
+        -> double {
+      const auto elapsed =
+          std::chrono::duration<double, std::micro>(now - _at).count();
+      return _offset + (_drift * elapsed / MICROS_PER_SECOND);
+    }
+
+    /**
+     * @brief Convert a local time to microseconds
+     *
+     * @param time The local time
+     * @return Microseconds since the clock's epoch
+     */
+    static auto toMicros(std::chrono::steady_clock::time_point time)
+        -> std::int64_t {
+      return std::chrono::duration_cast<std::chrono::microseconds>(
+                 time.time_since_epoch())
+          .count();
+    }
+
+    /// Offset basis of the FNV-1a hash
+    static constexpr std::uint64_t FNV_BASIS = 14695981039346656037ULL;
+
+    /// Size of the buffer holding the temporary file path of save()
+    static constexpr std::size_t MAX_PATH_SIZE = 4096;
+
+    /// Replies averaged before the offset moves by a fixed fraction
+    static constexpr double SMOOTHING = 8;
+
+    /// The drift follows 1/DRIFT_SMOOTHING of the prediction error per second
+    static constexpr double DRIFT_SMOOTHING = 64;
+
+    /// Microseconds per second, the drift is kept in parts per million
+    static constexpr double MICROS_PER_SECOND = 1e6;
+
+    /// Saturation of the confidence
+    static constexpr std::uint32_t MAX_CONFIDENCE = 1U << 20U;
+
+    /// The options
+    ClockSyncOptions _options;
+
+    /// The offset at _at in microseconds, kept fractional so the drift is
+    /// not lost to rounding
+    double _offset{};
+
+    /// Local time of the last reply
+    std::chrono::steady_clock::time_point _at;
+
+    /// Drift in parts per million
+    double _drift{};
+
+    /// Number of replies behind the estimate
+    std::uint32_t _confidence{};
+
+    /// Replies left to validate a restored estimate
+    std::uint32_t _validating{};
+  };
+
+}  // namespace brilliant::snapcast
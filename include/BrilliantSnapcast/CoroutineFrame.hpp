@@ -0,0 +1,152 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/version.hpp>
+#include <coroutine>
+#include <cstddef>
+#include <memory_resource>
+
+// PmrAwaitableFrame relies on Asio internals: the awaitable_frame promise,
+// its coro_ handle and a frame layout which does not depend on the promise's
+// allocation functions. Other Boost versions keep Asio's frame allocation.
+#if BOOST_VERSION >= 107400 && BOOST_VERSION < 108800
+/// Set if coroutine frames are allocated from the owner's memory resource
+#define BRILLIANT_SNAPCAST_PMR_FRAMES 1
+#else
+/// Set if coroutine frames are allocated from the owner's memory resource
+#define BRILLIANT_SNAPCAST_PMR_FRAMES 0
+#endif
+
+#if BRILLIANT_SNAPCAST_PMR_FRAMES
+namespace brilliant::snapcast {
+
+  /**
+   * @brief Promise type for boost::asio::awaitable coroutines whose frame is
+   * allocated from the memory resource of the object the coroutine is a
+   * member of. Selected through std::coroutine_traits specializations for
+   * TcpClient and SnapClient.
+   *
+   * The object must provide getAllocator() returning a
+   * std::pmr::polymorphic_allocator. The resource is stored in front of the
+   * frame so the frame can be released without the object. The owner and
+   * parameter types are class parameters, an allocation function template
+   * would not pair with the usual deallocation function the frame is
+   * released with.
+   *
+   * @tparam T The awaitable result type
+   * @tparam Executor The awaitable executor type
+   * @tparam Owner The type of the object the coroutine is a member of
+   * @tparam Args The coroutine parameter types
+   */
+  template <class T, class Executor, class Owner, class... Args>
+  class PmrAwaitableFrame
+      : public boost::asio::detail::awaitable_frame<T, Executor> {
+    /// Type alias for the Asio promise type
+    using Base = boost::asio::detail::awaitable_frame<T, Executor>;
+
+  public:
+    /**
+     * @brief Allocate a coroutine frame
+     *
+     * @param size The frame size
+     * @param owner The object the coroutine is a member of
+     * @return A pointer to the frame
+     */
+    static auto operator new(std::size_t size, Owner& owner,
+                             const Args&... /*args*/) -> void* {
+      auto* mr = owner.getAllocator().resource();
+      auto* block = static_cast<std::byte*>(
+          mr->allocate(size + HEADER_SIZE, HEADER_SIZE));
+      *reinterpret_cast<std::pmr::memory_resource**>(block) = mr;  // NOLINT
+      return block + HEADER_SIZE;
+    }
+
+    /**
+     * @brief Release a coroutine frame to the resource it was allocated from
+     *
+     * @param frame A pointer to the frame
+     * @param size The frame size
+     */
+    static void operator delete(void* frame, std::size_t size) noexcept {
+      auto* block = static_cast<std::byte*>(frame) - HEADER_SIZE;
+      auto* mr = *reinterpret_cast<std::pmr::memory_resource**>(  // NOLINT
+          block);
+      mr->deallocate(block, size + HEADER_SIZE, HEADER_SIZE);
+    }
+
+    /**
+     * @brief Create the awaitable. Points the stored coroutine handle at this
+     * promise type, the base class uses its own type.
+     *
+     * @return The awaitable
+     */
+    auto get_return_object() noexcept {
+      auto awaitable = Base::get_return_object();
+      this->coro_ =
+          std::coroutine_handle<PmrAwaitableFrame>::from_promise(*this);
+      return awaitable;
+    }
+
+    using Base::await_transform;
+
+    /**
+     * @brief Transform an awaited awaitable. Awaitables only accept the handle
+     * of an Asio promise, the returned awaiter passes the frame on as one.
+     *
+     * @tparam U The result type of the awaited awaitable
+     * @param awaitable The awaited awaitable
+     * @return An awaiter for the awaitable
+     */
+    template <class U>
+    auto await_transform(boost::asio::awaitable<U, Executor> awaitable) {
+      return Awaiter<U>{Base::await_transform(std::move(awaitable))};
+    }
+
+  private:
+    /**
+     * @brief Awaits an awaitable on behalf of this promise type
+     *
+     * @tparam U The result type of the awaitable
+     */
+    template <class U>
+    struct Awaiter {
+      /// The awaited awaitable
+      boost::asio::awaitable<U, Executor> awaitable;
+
+      /**
+       * @brief Check if the result is available without suspending
+       *
+       * @return The result of the awaitable
+       */
+      auto await_ready() const noexcept -> bool {
+        return awaitable.await_ready();
+      }
+
+      /**
+       * @brief Suspend the awaiting coroutine
+       *
+       * @param handle The handle of the awaiting coroutine
+       */
+      void await_suspend(std::coroutine_handle<PmrAwaitableFrame> handle) {
+        // the promise is the Asio promise with a different allocation
+        // function, the frame layout is the same
+        awaitable.await_suspend(
+            std::coroutine_handle<Base>::from_address(handle.address()));
+      }
+
+      /**
+       * @brief Get the result of the awaitable
+       *
+       * @return The result
+       */
+      auto await_resume() -> U { return awaitable.await_resume(); }
+    };
+
+    /// Space in front of the frame holding the memory resource, keeps the
+    /// frame aligned like operator new would
+    static constexpr std::size_t HEADER_SIZE =
+        __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+  };
+
+}  // namespace brilliant::snapcast
+#endif
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <boost/system/error_code.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+#include "BrilliantSnapcast/Message.hpp"
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief A decoded frame handed to the output stage
+   *
+   */
+  struct PcmFrame {
+    /// Time the first sample is due at the output, on the steady clock
+    std::chrono::steady_clock::time_point playout;
+
+    /// Interleaved samples in the stream's sample format
+    std::pmr::vector<std::byte> samples;
+  };
+
+  /**
+   * @brief Sample format of decoded audio
+   *
+   */
+  struct AudioFormat {
+    /// Sample rate in Hz
+    std::uint32_t rate{};
+
+    /// Bits per sample
+    std::uint16_t bits{};
+
+    /// Number of interleaved channels
+    std::uint16_t channels{};
+
+    /**
+     * @brief Get the size of one frame, a sample for every channel
+     *
+     * @return The frame size in bytes
+     */
+    [[nodiscard]] constexpr auto frameSize() const -> std::size_t {
+      return std::size_t{channels} * ((std::size_t{bits} + 7) / 8);
+    }
+  };
+
+  /**
+   * @brief Decodes the chunks of one stream into interleaved PCM
+   *
+   */
+  class Decoder {
+  public:
+    /**
+     * @brief Destroy the Decoder object
+     *
+     */
+    virtual ~Decoder() = default;
+
+    /**
+     * @brief Get the format of the decoded samples
+     *
+     * @return The sample format
+     */
+    [[nodiscard]] virtual auto format() const -> AudioFormat = 0;
+
+    /**
+     * @brief Get the number of frames the decoder outputs before the first
+     * sample of the stream, e.g. the pre-skip of Opus. They are discarded.
+     *
+     * @return The number of priming frames
+     */
+    [[nodiscard]] virtual auto delay() const -> std::size_t { return 0; }
+
+    /**
+     * @brief Prepare the decoder for the first chunk, e.g. fault in tables or
+     * decode a silent packet. Called off the decode path.
+     *
+     * @return An error_code if the decoder is unusable
+     */
+    virtual auto prime() -> boost::system::error_code { return {}; }
+
+    /**
+     * @brief Decode a chunk
+     *
+     * @param payload The encoded chunk
+     * @param out The vector decoded samples are appended to
+     * @return An error_code if the chunk could not be decoded
+     */
+    virtual auto decode(std::span<const std::byte> payload,
+                        std::pmr::vector<std::byte>& out)
+        -> boost::system::error_code = 0;
+
+    /**
+     * @brief Output the samples still buffered at the end of the stream
+     *
+     * @param out The vector the samples are appended to
+     */
+    virtual void flush(std::pmr::vector<std::byte>& /*out*/) {}
+  };
+
+  /**
+   * @brief Creates decoders from codec headers
+   *
+   */
+  class DecoderFactory {
+  public:
+    /**
+     * @brief Destroy the Decoder Factory object
+     *
+     */
+    virtual ~DecoderFactory() = default;
+
+    /**
+     * @brief Create a decoder for a stream
+     *
+     * @param header The codec header of the stream. The views stay valid for
+     * the lifetime of the decoder.
+     * @param mr A pointer to the memory resource the decoder and all of its
+     * allocations must use
+     * @return The decoder, constructed from mr, if successful. An error_code
+     * otherwise.
+     */
+    virtual auto create(const CodecHeader& header,
+                        std::pmr::memory_resource* mr)
+        -> std::expected<Decoder*, boost::system::error_code> = 0;
+  };
+
+}  // namespace brilliant::snapcast
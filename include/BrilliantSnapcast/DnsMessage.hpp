@@ -0,0 +1,281 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <boost/asio/error.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief Record types of a DNS question
+   *
+   */
+  enum class DnsType : std::uint16_t {
+    A = 1,  ///< IPv4 address
+    AAAA = 28  ///< IPv6 address
+  };
+
+  /// Largest DNS message sent over UDP without EDNS, RFC 1035
+  inline constexpr std::size_t DNS_UDP_SIZE = 512;
+
+  namespace detail {
+    /// Size of the DNS message header
+    inline constexpr std::size_t DNS_HEADER_SIZE = 12;
+
+    /// Longest encoded domain name, RFC 1035
+    inline constexpr std::size_t DNS_MAX_NAME = 255;
+
+    /// Longest label of a domain name, RFC 1035
+    inline constexpr std::size_t DNS_MAX_LABEL = 63;
+
+    /// Header flag of a response
+    inline constexpr std::uint16_t DNS_FLAG_QR = 0x8000;
+
+    /// Header flag of a response truncated to fit a UDP datagram
+    inline constexpr std::uint16_t DNS_FLAG_TC = 0x0200;
+
+    /// Header flag asking the server to recurse
+    inline constexpr std::uint16_t DNS_FLAG_RD = 0x0100;
+
+    /// Mask of the response code in the header flags
+    inline constexpr std::uint16_t DNS_RCODE_MASK = 0x000F;
+
+    /// Response code of a name which does not exist
+    inline constexpr std::uint16_t DNS_RCODE_NXDOMAIN = 3;
+
+    /// Marks a compression pointer in place of a label length
+    inline constexpr std::uint8_t DNS_POINTER = 0xC0;
+
+    /// Class of internet records
+    inline constexpr std::uint16_t DNS_CLASS_IN = 1;
+
+    /**
+     * @brief Store a 16 bit integer in network byte order
+     *
+     * @param data The destination, at least 2 bytes
+     * @param value The integer
+     */
+    inline void storeBig16(std::byte* data, std::uint16_t value) {
+      constexpr unsigned BITS = 8;
+      data[0] = static_cast<std::byte>(value >> BITS);  // NOLINT
+      data[1] = static_cast<std::byte>(value);  // NOLINT
+    }
+
+    /**
+     * @brief Load a 16 bit integer in network byte order
+     *
+     * @param data The source, at least 2 bytes
+     * @return The integer
+     */
+    inline auto loadBig16(const std::byte* data) -> std::uint16_t {
+      constexpr unsigned BITS = 8;
+      return static_cast<std::uint16_t>(
+          (std::to_integer<unsigned>(data[0]) << BITS) |  // NOLINT
+          std::to_integer<unsigned>(data[1]));  // NOLINT
+    }
+
+    /**
+     * @brief Skip an encoded domain name, following no compression pointer
+     *
+     * @param message The message
+     * @param offset The offset of the name, set to the offset after it
+     * @return True if the name lies within the message
+     */
+    inline auto skipName(std::span<const std::byte> message,
+                         std::size_t& offset) -> bool {
+      while (offset < message.size()) {
+        const auto length = std::to_integer<std::uint8_t>(message[offset]);
+        if ((length & DNS_POINTER) == DNS_POINTER) {
+          offset += 2;
+          return offset <= message.size();
+        }
+        ++offset;
+        if (length == 0) {
+          return true;
+        }
+        offset += length;
+      }
+      return false;
+    }
+  }  // namespace detail
+
+  /**
+   * @brief Encode a recursive query for one record type of a name
+   *
+   * @param id The message id, echoed by the response
+   * @param name The domain name, a trailing dot is accepted
+   * @param type The record type
+   * @param out The buffer to encode into, DNS_UDP_SIZE bytes always suffice
+   * @return The size of the query or invalid_argument if the name is not a
+   * valid domain name, no_buffer_space if the buffer is too short.
+   */
+  inline auto encodeDnsQuery(std::uint16_t id, std::string_view name,
+                             DnsType type, std::span<std::byte> out)
+      -> std::expected<std::size_t, boost::system::error_code> {
+    if (name.ends_with('.')) {
+      name.remove_suffix(1);
+    }
+    // labels with their length bytes and the root label
+    if (name.empty() || name.size() + 2 > detail::DNS_MAX_NAME) {
+      return std::unexpected(boost::asio::error::invalid_argument);
+    }
+    const auto size = detail::DNS_HEADER_SIZE + name.size() + 2 + 4;
+    if (out.size() < size) {
+      return std::unexpected(boost::system::errc::make_error_code(
+          boost::system::errc::no_buffer_space));
+    }
+
+    auto* data = out.data();
+    detail::storeBig16(data, id);
+    detail::storeBig16(data + 2, detail::DNS_FLAG_RD);  // NOLINT
+    detail::storeBig16(data + 4, 1);  // NOLINT qdcount
+    detail::storeBig16(data + 6, 0);  // NOLINT ancount
+    detail::storeBig16(data + 8, 0);  // NOLINT nscount
+    detail::storeBig16(data + 10, 0);  // NOLINT arcount
+
+    auto* p = data + detail::DNS_HEADER_SIZE;  // NOLINT
+    while (!name.empty()) {
+      const auto dot = name.find('.');
+      const auto label = name.substr(0, dot);
+      if (label.empty() || label.size() > detail::DNS_MAX_LABEL) {
+        return std::unexpected(boost::asio::error::invalid_argument);
+      }
+      *p++ = static_cast<std::byte>(label.size());  // NOLINT
+      for (const char c : label) {
+        *p++ = static_cast<std::byte>(c);  // NOLINT
+      }
+      name.remove_prefix(dot == std::string_view::npos ? name.size()
+                                                       : dot + 1);
+    }
+    *p++ = std::byte{0};  // NOLINT
+    detail::storeBig16(p, static_cast<std::uint16_t>(type));
+    detail::storeBig16(p + 2, detail::DNS_CLASS_IN);  // NOLINT
+    return size;
+  }
+
+  /**
+   * @brief Get the id of a DNS message
+   *
+   * @param message The message
+   * @return The id, empty if the message is shorter than a header
+   */
+  inline auto dnsMessageId(std::span<const std::byte> message)
+      -> std::optional<std::uint16_t> {
+    if (message.size() < detail::DNS_HEADER_SIZE) {
+      return std::nullopt;
+    }
+    return detail::loadBig16(message.data());
+  }
+
+  /**
+   * @brief Check if a response answers a query, i.e. it carries the query's
+   * id and echoes its question byte for byte
+   *
+   * @param response The response
+   * @param query The query, as encoded by encodeDnsQuery()
+   * @return True if the response belongs to the query
+   */
+  inline auto dnsAnswers(std::span<const std::byte> response,
+                         std::span<const std::byte> query) -> bool {
+    if (query.size() < detail::DNS_HEADER_SIZE ||
+        response.size() < query.size() ||
+        detail::loadBig16(response.data()) != detail::loadBig16(query.data()) ||
+        detail::loadBig16(response.data() + 4) != 1) {  // NOLINT qdcount
+      return false;
+    }
+    return std::ranges::equal(response.subspan(detail::DNS_HEADER_SIZE,
+                                               query.size() -
+                                                   detail::DNS_HEADER_SIZE),
+                              query.subspan(detail::DNS_HEADER_SIZE));
+  }
+
+  /**
+   * @brief Decode the A and AAAA records of a DNS response. Other records,
+   * e.g. the CNAME records of an alias, are skipped. Answers of a message
+   * cut short are decoded up to the last complete record.
+   *
+   * @param message The response
+   * @param out The addresses are appended to this vector
+   * @return An error_code, empty if the server answered. host_not_found if
+   * the name does not exist, host_not_found_try_again if the server failed
+   * or truncated the response, illegal_byte_sequence if the message is
+   * malformed.
+   */
+  inline auto decodeDnsResponse(std::span<const std::byte> message,
+                                std::pmr::vector<boost::asio::ip::address>& out)
+      -> boost::system::error_code {
+    const auto malformed = boost::system::errc::make_error_code(
+        boost::system::errc::illegal_byte_sequence);
+    if (message.size() < detail::DNS_HEADER_SIZE) {
+      return malformed;
+    }
+    const auto* data = message.data();
+    const auto flags = detail::loadBig16(data + 2);  // NOLINT
+    if ((flags & detail::DNS_FLAG_QR) == 0) {
+      return malformed;
+    }
+    const auto rcode = flags & detail::DNS_RCODE_MASK;
+    if (rcode == detail::DNS_RCODE_NXDOMAIN) {
+      return boost::asio::error::host_not_found;
+    }
+    // the full answer needs TCP, which is not implemented
+    if (rcode != 0 || (flags & detail::DNS_FLAG_TC) != 0) {
+      return boost::asio::error::host_not_found_try_again;
+    }
+    const auto questions = detail::loadBig16(data + 4);  // NOLINT
+    const auto answers = detail::loadBig16(data + 6);  // NOLINT
+
+    std::size_t offset = detail::DNS_HEADER_SIZE;
+    for (std::uint16_t i = 0; i < questions; ++i) {
+      if (!detail::skipName(message, offset) ||
+          (offset += 4) > message.size()) {
+        return malformed;
+      }
+    }
+
+    // type, class, ttl and rdata length
+    constexpr std::size_t RECORD_HEADER = 10;
+    constexpr std::size_t V4_SIZE = 4;
+    constexpr std::size_t V6_SIZE = 16;
+    for (std::uint16_t i = 0; i < answers; ++i) {
+      if (!detail::skipName(message, offset) ||
+          offset + RECORD_HEADER > message.size()) {
+        break;
+      }
+      const auto type = detail::loadBig16(data + offset);  // NOLINT
+      const auto length = detail::loadBig16(data + offset + 8);  // NOLINT
+      offset += RECORD_HEADER;
+      if (offset + length > message.size()) {
+        break;
+      }
+      const auto* rdata = data + offset;  // NOLINT
+      if (type == static_cast<std::uint16_t>(DnsType::A) &&
+          length == V4_SIZE) {
+        boost::asio::ip::address_v4::bytes_type bytes{};
+        for (std::size_t b = 0; b < V4_SIZE; ++b) {
+          bytes[b] = std::to_integer<unsigned char>(rdata[b]);  // NOLINT
+        }
+        out.emplace_back(boost::asio::ip::address_v4(bytes));
+      } else if (type == static_cast<std::uint16_t>(DnsType::AAAA) &&
+                 length == V6_SIZE) {
+        boost::asio::ip::address_v6::bytes_type bytes{};
+        for (std::size_t b = 0; b < V6_SIZE; ++b) {
+          bytes[b] = std::to_integer<unsigned char>(rdata[b]);  // NOLINT
+        }
+        out.emplace_back(boost::asio::ip::address_v6(bytes));
+      }
+      offset += length;
+    }
+    return {};
+  }
+
+}  // namespace brilliant::snapcast
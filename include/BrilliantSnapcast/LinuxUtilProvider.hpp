@@ -0,0 +1,475 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <fcntl.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "BrilliantSnapcast/UtilProvider.hpp"
+
+namespace brilliant::snapcast {
+
+  namespace detail {
+
+    /**
+     * @brief Text kept in fixed storage inside its owner. Longer text is
+     * truncated to the capacity.
+     *
+     * @tparam Capacity The most characters stored
+     */
+    template <std::size_t Capacity>
+    class InlineString {
+    public:
+      /**
+       * @brief Replace the text
+       *
+       * @param text The new text
+       */
+      void assign(std::string_view text) {
+        _size = std::min(text.size(), Capacity);
+        std::copy_n(text.data(), _size, _data.data());
+      }
+
+      /**
+       * @brief View the text
+       *
+       * @return The stored text
+       */
+      [[nodiscard]] auto view() const -> std::string_view {
+        return {_data.data(), _size};
+      }
+
+      /**
+       * @brief Check if no text is stored
+       *
+       * @return True if the text is empty
+       */
+      [[nodiscard]] auto empty() const -> bool { return _size == 0; }
+
+    private:
+      /// The characters
+      std::array<char, Capacity> _data{};
+
+      /// The number of characters stored
+      std::size_t _size{};
+    };
+
+  }  // namespace detail
+
+  /**
+   * @brief A UtilProvider for Linux. The OS and architecture are read once
+   * on construction and the MAC address on first use, then kept in fixed
+   * storage inside the provider. The getters only copy them into a string
+   * of the given memory resource and the views allocate nothing, so
+   * rebuilding a Hello message on reconnect costs a few copies.
+   *
+   * The MAC address is the one of the interface the connected socket's
+   * local address belongs to. Without a socket, or for a socket which is
+   * not bound to an interface with a hardware address, e.g. a loopback or
+   * local socket, it is the one of the first interface which is up and has
+   * one.
+   */
+  class LinuxUtilProvider : public UtilProvider {
+  public:
+    /// The length of a formatted MAC address, e.g. 01:23:45:67:89:ab
+    static constexpr std::size_t MAC_LENGTH = 17;
+
+    /// The longest OS name kept
+    static constexpr std::size_t OS_CAPACITY = 128;
+
+    /// The longest architecture name kept
+    static constexpr std::size_t ARCH_CAPACITY = sizeof(utsname::machine);
+
+    /// The MAC address reported when no interface has one
+    static constexpr std::string_view NO_MAC = "00:00:00:00:00:00";
+
+    /**
+     * @brief Construct a new Linux Util Provider object. Reads the OS name
+     * from os-release, falling back to the kernel's name, and the
+     * architecture from uname.
+     *
+     */
+    LinuxUtilProvider() {
+      utsname names{};
+      if (::uname(&names) == 0) {
+        _arch.assign(names.machine);
+        _os.assign(names.sysname);
+      }
+      std::array<char, FILE_SIZE> buffer{};
+      for (const char* path : {"/etc/os-release", "/usr/lib/os-release"}) {
+        const auto name = prettyName(readFile(path, buffer));
+        if (!name.empty()) {
+          _os.assign(name);
+          break;
+        }
+      }
+    }
+
+    /**
+     * @brief Get the MAC Address as a string
+     *
+     * @param sock The socket handle, negative if there is none
+     * @param mr A pointer to the memory resource used to allocate the string
+     * @return The MAC address as a string
+     */
+    auto getMacAddress(int sock, std::pmr::memory_resource* mr)
+        -> std::pmr::string override {
+      return std::pmr::string(macAddress(sock), mr);
+    }
+
+    /**
+     * @brief Get the OS name
+     *
+     * @param mr The memory resource used to allocate the string
+     * @return The OS string
+     */
+    auto getOS(std::pmr::memory_resource* mr) -> std::pmr::string override {
+      return std::pmr::string(os(), mr);
+    }
+
+    /**
+     * @brief Get the platform architecture string, eg: x86_64
+     *
+     * @param mr The memory resource used to allocate the string
+     * @return The platform architecture string
+     */
+    auto getArch(std::pmr::memory_resource* mr) -> std::pmr::string override {
+      return std::pmr::string(arch(), mr);
+    }
+
+    /**
+     * @brief View the MAC address. It is looked up on the first call and
+     * again while it did not come from a connected socket yet.
+     *
+     * @param sock The socket handle, negative if there is none
+     * @return The MAC address, e.g. 01:23:45:67:89:ab
+     */
+    auto macAddress(int sock) -> std::string_view {
+      if (!_macBound && (_mac.empty() || sock >= 0)) {
+        lookupMac(sock);
+      }
+      return _mac.view();
+    }
+
+    /**
+     * @brief View the OS name, e.g. the PRETTY_NAME of os-release
+     *
+     * @return The OS name
+     */
+    [[nodiscard]] auto os() const -> std::string_view { return _os.view(); }
+
+    /**
+     * @brief View the architecture, e.g. x86_64
+     *
+     * @return The architecture
+     */
+    [[nodiscard]] auto arch() const -> std::string_view {
+      return _arch.view();
+    }
+
+    /**
+     * @brief Forget the MAC address, e.g. after the route to the server
+     * changed. The next call looks it up again.
+     *
+     */
+    void forgetMacAddress() {
+      _mac.assign({});
+      _macBound = false;
+    }
+
+  private:
+    /// The largest os-release file read
+    static constexpr std::size_t FILE_SIZE = 4096;
+
+    /// The most interfaces listed by SIOCGIFCONF
+    static constexpr std::size_t MAX_INTERFACES = 32;
+
+    /// The number of bytes of a MAC address
+    static constexpr std::size_t MAC_BYTES = 6;
+
+    /**
+     * @brief Read the start of a file
+     *
+     * @param path The file path
+     * @param buffer The storage the file is read into
+     * @return The bytes read, empty if the file could not be read
+     */
+    static auto readFile(const char* path, std::span<char> buffer)
+        -> std::string_view {
+      const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        return {};
+      }
+      std::size_t size = 0;
+      while (size < buffer.size()) {
+        const auto count =
+            ::read(fd, buffer.data() + size, buffer.size() - size);
+        if (count <= 0) {
+          break;
+        }
+        size += static_cast<std::size_t>(count);
+      }
+      ::close(fd);
+      return {buffer.data(), size};
+    }
+
+    /**
+     * @brief Find the PRETTY_NAME value of an os-release file
+     *
+     * @param text The file content
+     * @return The unquoted value, empty if there is none
+     */
+    static auto prettyName(std::string_view text) -> std::string_view {
+      constexpr std::string_view KEY = "PRETTY_NAME=";
+      while (!text.empty()) {
+        const auto end = std::min(text.find('\n'), text.size());
+        auto line = text.substr(0, end);
+        text.remove_prefix(std::min(end + 1, text.size()));
+        if (!line.starts_with(KEY)) {
+          continue;
+        }
+        line.remove_prefix(KEY.size());
+        if (line.size() >= 2 && (line.front() == '"' || line.front() == '\'') &&
+            line.back() == line.front()) {
+          line = line.substr(1, line.size() - 2);
+        }
+        return line;
+      }
+      return {};
+    }
+
+    /**
+     * @brief Find the interface of an IPv4 address
+     *
+     * @param fd A socket for interface requests
+     * @param address The address
+     * @param request Receives the interface name
+     * @return True if an interface has the address
+     */
+    static auto interfaceOf(int fd, in_addr address, ifreq& request)
+        -> bool {
+      std::array<ifreq, MAX_INTERFACES> interfaces{};
+      ifconf list{};
+      list.ifc_len = static_cast<int>(sizeof(interfaces));
+      list.ifc_req = interfaces.data();
+      if (::ioctl(fd, SIOCGIFCONF, &list) < 0) {
+        return false;
+      }
+      const auto count = static_cast<std::size_t>(list.ifc_len) / sizeof(ifreq);
+      for (const auto& entry : std::span(interfaces).first(count)) {
+        sockaddr_in local{};
+        std::memcpy(&local, &entry.ifr_addr, sizeof(local));
+        if (local.sin_addr.s_addr == address.s_addr) {
+          request = entry;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /**
+     * @brief Find the interface of an IPv6 address in /proc/net/if_inet6,
+     * which lists one address per line as 32 hex digits followed by the
+     * interface index, prefix length, scope, flags and interface name
+     *
+     * @param address The address
+     * @param request Receives the interface name
+     * @return True if an interface has the address
+     */
+    static auto interfaceOf(const in6_addr& address, ifreq& request) -> bool {
+      constexpr std::string_view HEX = "0123456789abcdef";
+      constexpr unsigned NIBBLE = 4;
+      std::array<char, sizeof(address.s6_addr) * 2> digits{};
+      for (std::size_t i = 0; i < sizeof(address.s6_addr); ++i) {
+        const auto byte = address.s6_addr[i];  // NOLINT
+        digits.at(2 * i) = HEX[byte >> NIBBLE];
+        digits.at((2 * i) + 1) = HEX[byte & 0xfU];  // NOLINT
+      }
+      std::array<char, FILE_SIZE> buffer{};
+      auto text = readFile("/proc/net/if_inet6", buffer);
+      while (!text.empty()) {
+        const auto end = std::min(text.find('\n'), text.size());
+        auto line = text.substr(0, end);
+        text.remove_prefix(std::min(end + 1, text.size()));
+        if (!line.starts_with(std::string_view(digits.data(), digits.size()))) {
+          continue;
+        }
+        while (!line.empty() && line.back() == ' ') {
+          line.remove_suffix(1);
+        }
+        const auto name = line.substr(line.find_last_of(' ') + 1);
+        if (name.empty() || name.size() >= sizeof(request.ifr_name)) {
+          return false;
+        }
+        std::copy_n(name.data(), name.size(), request.ifr_name);
+        request.ifr_name[name.size()] = '\0';  // NOLINT
+        return true;
+      }
+      return false;
+    }
+
+    /**
+     * @brief Find the interface the local address of a socket belongs to
+     *
+     * @param fd A socket for interface requests
+     * @param sock The socket
+     * @param request Receives the interface name
+     * @return True if the interface was found
+     */
+    static auto interfaceOf(int fd, int sock, ifreq& request) -> bool {
+      sockaddr_storage local{};
+      socklen_t size = sizeof(local);
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      if (::getsockname(sock, reinterpret_cast<sockaddr*>(&local), &size) <
+          0) {
+        return false;
+      }
+      if (local.ss_family == AF_INET) {
+        sockaddr_in address{};
+        std::memcpy(&address, &local, sizeof(address));
+        return interfaceOf(fd, address.sin_addr, request);
+      }
+      if (local.ss_family == AF_INET6) {
+        sockaddr_in6 address{};
+        std::memcpy(&address, &local, sizeof(address));
+        if (IN6_IS_ADDR_V4MAPPED(&address.sin6_addr)) {  // NOLINT
+          in_addr mapped{};
+          std::memcpy(&mapped, &address.sin6_addr.s6_addr[12],  // NOLINT
+                      sizeof(mapped));
+          return interfaceOf(fd, mapped, request);
+        }
+        return interfaceOf(address.sin6_addr, request);
+      }
+      return false;
+    }
+
+    /**
+     * @brief Read the hardware address of an interface
+     *
+     * @param fd A socket for interface requests
+     * @param request The interface name, receives the hardware address
+     * @return True if the interface has a hardware address other than zero
+     */
+    static auto hardwareAddress(int fd, ifreq& request) -> bool {
+      if (::ioctl(fd, SIOCGIFHWADDR, &request) < 0) {
+        return false;
+      }
+      const auto bytes =
+          std::span(request.ifr_hwaddr.sa_data).first(MAC_BYTES);
+      return std::ranges::any_of(bytes, [](char byte) { return byte != 0; });
+    }
+
+    /**
+     * @brief Find the first interface which is up, is not a loopback and
+     * has a hardware address
+     *
+     * @param fd A socket for interface requests
+     * @param request Receives the hardware address
+     * @return True if an interface was found
+     */
+    static auto firstHardwareAddress(int fd, ifreq& request) -> bool {
+      std::array<ifreq, MAX_INTERFACES> interfaces{};
+      ifconf list{};
+      list.ifc_len = static_cast<int>(sizeof(interfaces));
+      list.ifc_req = interfaces.data();
+      if (::ioctl(fd, SIOCGIFCONF, &list) < 0) {
+        return false;
+      }
+      const auto count = static_cast<std::size_t>(list.ifc_len) / sizeof(ifreq);
+      for (auto& entry : std::span(interfaces).first(count)) {
+        if (::ioctl(fd, SIOCGIFFLAGS, &entry) < 0 ||
+            (entry.ifr_flags & IFF_UP) == 0 ||
+            (entry.ifr_flags & IFF_LOOPBACK) != 0) {
+          continue;
+        }
+        if (hardwareAddress(fd, entry)) {
+          request = entry;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /**
+     * @brief Format and keep the hardware address of a request
+     *
+     * @param request The request holding the hardware address
+     */
+    void storeMac(const ifreq& request) {
+      constexpr std::string_view HEX = "0123456789abcdef";
+      constexpr unsigned NIBBLE = 4;
+      std::array<char, MAC_LENGTH> text{};
+      const auto bytes = std::span(request.ifr_hwaddr.sa_data);
+      for (std::size_t i = 0; i < MAC_BYTES; ++i) {
+        const auto byte = static_cast<unsigned char>(bytes[i]);
+        text.at(3 * i) = HEX[byte >> NIBBLE];
+        text.at((3 * i) + 1) = HEX[byte & 0xfU];  // NOLINT
+        if (i + 1 < MAC_BYTES) {
+          text.at((3 * i) + 2) = ':';
+        }
+      }
+      _mac.assign({text.data(), text.size()});
+    }
+
+    /**
+     * @brief Look the MAC address up. An address from the socket's
+     * interface replaces the one of the first interface for good.
+     *
+     * @param sock The socket handle, negative if there is none
+     */
+    void lookupMac(int sock) {
+      const int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+      if (fd < 0) {
+        if (_mac.empty()) {
+          _mac.assign(NO_MAC);
+        }
+        return;
+      }
+      ifreq request{};
+      if (sock >= 0 && interfaceOf(fd, sock, request)) {
+        // an interface without a hardware address keeps the first one's
+        if (hardwareAddress(fd, request)) {
+          storeMac(request);
+        }
+        _macBound = true;
+      }
+      if (_mac.empty()) {
+        if (firstHardwareAddress(fd, request)) {
+          storeMac(request);
+        } else {
+          _mac.assign(NO_MAC);
+        }
+      }
+      ::close(fd);
+    }
+
+    /// The MAC address
+    detail::InlineString<MAC_LENGTH> _mac;
+
+    /// The OS name
+    detail::InlineString<OS_CAPACITY> _os;
+
+    /// The architecture
+    detail::InlineString<ARCH_CAPACITY> _arch;
+
+    /// True once the MAC address was looked up for a connected socket
+    bool _macBound{};
+  };
+
+}  // namespace brilliant::snapcast
+
+#endif
@@ -9,10 +9,10 @@
 
 namespace brilliant::snapcast {
 
-#pragma pack(1)
-
   /**
-   * @brief Time message. Stores a time point as seconds and microseconds
+   * @brief Time message. Stores a time point as seconds and microseconds.
+   * Structs hold decoded values in natural alignment, the wire layout is
+   * described in WireCodec.hpp.
    *
    */
   struct Time {
@@ -47,8 +47,6 @@ namespace brilliant::snapcast {
     std::uint32_t size;
   };
 
-#pragma pack()
-
   /**
    * @brief Base class for messages containing only json data. Stores a view of
    * the data so a string this refers to must outlive this object.
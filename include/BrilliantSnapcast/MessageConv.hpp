@@ -1,118 +1,362 @@
 #pragma once
 
+#include <boost/system/error_code.hpp>
 #include <concepts>
 #include <cstring>
+#include <expected>
 #include <span>
 #include <type_traits>
 #include <utility>
 
 #include "BrilliantSnapcast/Message.hpp"
+#include "BrilliantSnapcast/WireCodec.hpp"
 
 namespace brilliant::snapcast {
 
   template <std::size_t Extent>
   void read(std::span<std::byte, Extent> buffer, Time& time) {
-    static_assert(Extent == std::dynamic_extent || Extent >= sizeof(Time));
-
-    auto data = buffer.data();
-    std::memcpy(&time, data, sizeof(Time));
+    static_assert(Extent == std::dynamic_extent ||
+                  Extent >= WIRE_SIZE<Time>);
+    decodeWire(buffer.data(), time);
   }
 
   template <std::size_t Extent>
   void read(std::span<std::byte, Extent> buffer, Base& base) {
-    static_assert(Extent == std::dynamic_extent || Extent >= sizeof(Base));
-
-    auto data = buffer.data();
-    std::memcpy(&base, data, sizeof(Base));
+    static_assert(Extent == std::dynamic_extent ||
+                  Extent >= HEADER_SIZE);
+    decodeWire(buffer.data(), base);
   }
 
   template <class T, std::size_t Extent>
   void read(std::span<std::byte, Extent> buffer, T& t)
     requires std::derived_from<T, JsonMessage>
   {
-    std::memcpy(&t.size, buffer.data(), sizeof(t.size));
+    t.size = loadLittle<std::uint32_t>(buffer.data());
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
     t.payload = reinterpret_cast<char*>(buffer.data() + sizeof(t.size));
   }
 
+  /**
+   * @brief Compile time wire properties of a message type. Specialized for
+   * every alternative of Message.
+   *
+   * @tparam T The message type
+   */
+  template <class T>
+  struct WireTraits;
+
+  /**
+   * @brief Wire properties shared by json messages
+   *
+   */
+  struct JsonWireTraits {
+    /// Size of the fixed fields, the json string follows them
+    static constexpr std::size_t MIN_SIZE = sizeof(JsonMessage::size);
+
+    /// True if every message of the type has the same size
+    static constexpr bool FIXED_SIZE = false;
+  };
+
+  /**
+   * @brief Wire properties of Hello messages
+   *
+   */
+  template <>
+  struct WireTraits<Hello> : JsonWireTraits {
+    /// The type stored in the header
+    static constexpr MessageType TYPE = MessageType::HELLO;
+  };
+
+  /**
+   * @brief Wire properties of ServerSettings messages
+   *
+   */
+  template <>
+  struct WireTraits<ServerSettings> : JsonWireTraits {
+    /// The type stored in the header
+    static constexpr MessageType TYPE = MessageType::SERVER_SETTINGS;
+  };
+
+  /**
+   * @brief Wire properties of ClientInfo messages
+   *
+   */
+  template <>
+  struct WireTraits<ClientInfo> : JsonWireTraits {
+    /// The type stored in the header
+    static constexpr MessageType TYPE = MessageType::CLIENT_INFO;
+  };
+
+  /**
+   * @brief Wire properties of Time messages
+   *
+   */
+  template <>
+  struct WireTraits<Time> {
+    /// The type stored in the header
+    static constexpr MessageType TYPE = MessageType::TIME;
+
+    /// Size of the message
+    static constexpr std::size_t MIN_SIZE = WIRE_SIZE<Time>;
+
+    /// True if every message of the type has the same size
+    static constexpr bool FIXED_SIZE = true;
+  };
+
+  /**
+   * @brief Wire properties of WireChunk messages
+   *
+   */
+  template <>
+  struct WireTraits<WireChunk> {
+    /// The type stored in the header
+    static constexpr MessageType TYPE = MessageType::WIRE_CHUNK;
+
+    /// Size of the timestamp and payload size, the payload follows them
+    static constexpr std::size_t MIN_SIZE =
+        WIRE_SIZE<Time> + sizeof(WireChunk::size);
+
+    /// True if every message of the type has the same size
+    static constexpr bool FIXED_SIZE = false;
+  };
+
+  /**
+   * @brief Wire properties of CodecHeader messages
+   *
+   */
+  template <>
+  struct WireTraits<CodecHeader> {
+    /// The type stored in the header
+    static constexpr MessageType TYPE = MessageType::CODEC_HEADER;
+
+    /// Size of the two size fields, the strings follow each of them
+    static constexpr std::size_t MIN_SIZE =
+        sizeof(CodecHeader::codecSize) + sizeof(CodecHeader::size);
+
+    /// True if every message of the type has the same size
+    static constexpr bool FIXED_SIZE = false;
+  };
+
+  /**
+   * @brief Wire properties of Error messages
+   *
+   */
+  template <>
+  struct WireTraits<Error> {
+    /// The type stored in the header
+    static constexpr MessageType TYPE = MessageType::ERROR;
+
+    /// Size of the error code and the two size fields
+    static constexpr std::size_t MIN_SIZE = sizeof(Error::errorCode) +
+                                            sizeof(Error::errorSize) +
+                                            sizeof(Error::errorMessageSize);
+
+    /// True if every message of the type has the same size
+    static constexpr bool FIXED_SIZE = false;
+  };
+
+  namespace detail {
+
+    /**
+     * @brief Decode the body of a json message received from a peer
+     *
+     * @tparam T The json message type
+     * @tparam Extent The extent of the buffer
+     * @param buffer The message body
+     * @return The message or bad_message if the json size overruns the body
+     */
+    template <class T, std::size_t Extent>
+    auto readJson(std::span<std::byte, Extent> buffer)
+        -> std::expected<Message, boost::system::error_code> {
+      T message{};
+      if (buffer.size() < WireTraits<T>::MIN_SIZE) {
+        return std::unexpected(boost::system::errc::make_error_code(
+            boost::system::errc::bad_message));
+      }
+      read(buffer, message);
+      if (message.size > buffer.size() - WireTraits<T>::MIN_SIZE) {
+        return std::unexpected(boost::system::errc::make_error_code(
+            boost::system::errc::bad_message));
+      }
+      return message;
+    }
+
+  }  // namespace detail
+
+  /**
+   * @brief Decode the body of a message received from a peer. The sizes
+   * inside the body are checked against the body size, the returned message
+   * only views bytes of the buffer.
+   *
+   * @tparam Extent The extent of the buffer
+   * @param buffer The message body, Base::size bytes
+   * @param type The type from the header
+   * @return The message or bad_message if the type is unknown, the body is
+   * shorter than the fixed fields of the type or a size inside the body
+   * overruns it
+   */
   template <std::size_t Extent>
-  auto read(std::span<std::byte, Extent> buffer, MessageType type) -> Message {
+  auto read(std::span<std::byte, Extent> buffer, MessageType type)
+      -> std::expected<Message, boost::system::error_code> {
+    const auto malformed = [] {
+      return std::unexpected(boost::system::errc::make_error_code(
+          boost::system::errc::bad_message));
+    };
+    // the bytes after data, a size field naming more is malformed
+    const auto remaining = [buffer](const std::byte* data) {
+      return static_cast<std::size_t>(buffer.data() + buffer.size() - data);
+    };
+
     switch (type) {
-    case MessageType::HELLO: {
-      Hello hello{};
-      read(buffer, hello);
-      return hello;
-    }
-    case MessageType::SERVER_SETTINGS: {
-      ServerSettings settings{};
-      read(buffer, settings);
-      return settings;
-    }
-    case MessageType::CLIENT_INFO: {
-      ClientInfo info{};
-      read(buffer, info);
-      return info;
-    }
+    case MessageType::HELLO:
+      return detail::readJson<Hello>(buffer);
+    case MessageType::SERVER_SETTINGS:
+      return detail::readJson<ServerSettings>(buffer);
+    case MessageType::CLIENT_INFO:
+      return detail::readJson<ClientInfo>(buffer);
     case MessageType::TIME: {
+      if (buffer.size() < WireTraits<Time>::MIN_SIZE) {
+        return malformed();
+      }
       Time time{};
       read(buffer, time);
       return time;
     }
     case MessageType::WIRE_CHUNK: {
+      if (buffer.size() < WireTraits<WireChunk>::MIN_SIZE) {
+        return malformed();
+      }
       WireChunk chunk{};
       read(buffer, chunk.timestamp);
-      auto data = buffer.data() + sizeof(chunk.timestamp);
-      std::memcpy(&chunk.size, data, sizeof(chunk.size));
+      auto data = buffer.data() + WIRE_SIZE<Time>;
+      chunk.size = loadLittle<std::uint32_t>(data);
       chunk.payload = data + sizeof(chunk.size);
+      if (chunk.size > remaining(chunk.payload)) {
+        return malformed();
+      }
       return chunk;
     }
     case MessageType::CODEC_HEADER: {
+      if (buffer.size() < WireTraits<CodecHeader>::MIN_SIZE) {
+        return malformed();
+      }
       CodecHeader header{};
       auto data = buffer.data();
-      std::memcpy(&header.codecSize, data, sizeof(header.codecSize));
+      header.codecSize = loadLittle<std::uint32_t>(data);
       data += sizeof(header.codecSize);
+      // the payload size follows the codec string
+      if (header.codecSize > remaining(data) - sizeof(header.size)) {
+        return malformed();
+      }
       // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
       header.codec = reinterpret_cast<char*>(data);
       data += header.codecSize;
-      std::memcpy(&header.size, data, sizeof(header.size));
+      header.size = loadLittle<std::uint32_t>(data);
       data += sizeof(header.size);
       header.payload = data;
+      if (header.size > remaining(data)) {
+        return malformed();
+      }
       return header;
     }
     case MessageType::ERROR: {
+      if (buffer.size() < WireTraits<Error>::MIN_SIZE) {
+        return malformed();
+      }
       Error error{};
       auto data = buffer.data();
-      std::memcpy(&error.errorCode, data, sizeof(error.errorCode));
+      error.errorCode = loadLittle<std::uint32_t>(data);
       data += sizeof(error.errorCode);
-      std::memcpy(&error.errorSize, data, sizeof(error.errorSize));
+      error.errorSize = loadLittle<std::uint32_t>(data);
       data += sizeof(error.errorSize);
+      // the message size follows the error string
+      if (error.errorSize > remaining(data) - sizeof(error.errorMessageSize)) {
+        return malformed();
+      }
       // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
       error.error = reinterpret_cast<char*>(data);
       data += error.errorSize;
-      std::memcpy(&error.errorMessageSize, data,
-                  sizeof(error.errorMessageSize));
+      error.errorMessageSize = loadLittle<std::uint32_t>(data);
       data += sizeof(error.errorMessageSize);
       // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
       error.errorMessage = reinterpret_cast<char*>(data);
+      if (error.errorMessageSize > remaining(data)) {
+        return malformed();
+      }
       return error;
     }
     case MessageType::BASE:
     default:
-      std::unreachable();
+      return malformed();
     }
-    std::unreachable();
+  }
+
+  /**
+   * @brief Number of bytes a fixed size message occupies on the wire,
+   * including the header. Use it to size buffers for static extent sends.
+   *
+   * @tparam T The message type
+   */
+  template <class T>
+    requires WireTraits<T>::FIXED_SIZE
+  inline constexpr std::size_t FRAME_SIZE =
+      HEADER_SIZE + WireTraits<T>::MIN_SIZE;
+
+  /**
+   * @brief Get the MessageType stored in the header of a message
+   *
+   * @param message The message
+   * @return The message type
+   */
+  inline auto messageType(const Message& message) -> MessageType {
+    return std::visit(
+        [](const auto& msg) {
+          return WireTraits<std::decay_t<decltype(msg)>>::TYPE;
+        },
+        message);
+  }
+
+  /**
+   * @brief Get the number of bytes a message occupies on the wire, not
+   * including the header
+   *
+   * @param message The message
+   * @return The serialized size of the message
+   */
+  inline auto wireSize(const Message& message) -> std::uint32_t {
+    return std::visit(
+        [](const auto& msg) -> std::uint32_t {
+          using type = std::decay_t<decltype(msg)>;
+          constexpr auto minSize =
+              static_cast<std::uint32_t>(WireTraits<type>::MIN_SIZE);
+          if constexpr (WireTraits<type>::FIXED_SIZE) {
+            return minSize;
+          } else if constexpr (std::derived_from<type, JsonMessage> ||
+                               std::is_same_v<type, WireChunk>) {
+            return minSize + msg.size;
+          } else if constexpr (std::is_same_v<type, CodecHeader>) {
+            return minSize + msg.codecSize + msg.size;
+          } else if constexpr (std::is_same_v<type, Error>) {
+            return minSize + msg.errorSize + msg.errorMessageSize;
+          } else {
+            std::unreachable();
+          }
+        },
+        message);
   }
 
   template <std::size_t Extent>
   void write(std::span<std::byte, Extent> buffer, const Time& time) {
-    static_assert(Extent == std::dynamic_extent || Extent >= sizeof(Time));
-    std::memcpy(buffer.data(), &time, sizeof(Time));
+    static_assert(Extent == std::dynamic_extent ||
+                  Extent >= WIRE_SIZE<Time>);
+    encodeWire(buffer.data(), time);
   }
 
   template <std::size_t Extent>
   void write(std::span<std::byte, Extent> buffer, const Base& base) {
-    static_assert(Extent == std::dynamic_extent || Extent >= sizeof(Time));
-    std::memcpy(buffer.data(), &base, sizeof(Base));
+    static_assert(Extent == std::dynamic_extent ||
+                  Extent >= HEADER_SIZE);
+    encodeWire(buffer.data(), base);
   }
 
   template <std::size_t Extent>
@@ -122,7 +366,7 @@ namespace brilliant::snapcast {
           using type = std::decay_t<decltype(msg)>;
           if constexpr (std::derived_from<type, JsonMessage>) {
             auto data = buffer.data();
-            std::memcpy(data, &msg.size, sizeof(msg.size));
+            storeLittle(data, msg.size);
             data += sizeof(msg.size);
             std::memcpy(data, msg.payload, msg.size);
           } else if constexpr (std::is_same_v<type, Time>) {
@@ -130,29 +374,28 @@ namespace brilliant::snapcast {
           } else if constexpr (std::is_same_v<type, WireChunk>) {
             auto data = buffer.data();
             write(std::span(buffer), msg.timestamp);
-            data += sizeof(msg.timestamp);
-            std::memcpy(data, &msg.size, sizeof(msg.size));
+            data += WIRE_SIZE<Time>;
+            storeLittle(data, msg.size);
             data += sizeof(msg.size);
             std::memcpy(data, msg.payload, msg.size);
           } else if constexpr (std::is_same_v<type, CodecHeader>) {
             auto data = buffer.data();
-            std::memcpy(data, &msg.codecSize, sizeof(msg.codecSize));
+            storeLittle(data, msg.codecSize);
             data += sizeof(msg.codecSize);
             std::memcpy(data, msg.codec, msg.codecSize);
             data += msg.codecSize;
-            std::memcpy(data, &msg.size, sizeof(msg.size));
+            storeLittle(data, msg.size);
             data += sizeof(msg.size);
             std::memcpy(data, msg.payload, msg.size);
           } else if constexpr (std::is_same_v<type, Error>) {
             auto data = buffer.data();
-            std::memcpy(data, &msg.errorCode, sizeof(msg.errorCode));
+            storeLittle(data, msg.errorCode);
             data += sizeof(msg.errorCode);
-            std::memcpy(data, &msg.errorSize, sizeof(msg.errorSize));
+            storeLittle(data, msg.errorSize);
             data += sizeof(msg.errorSize);
             std::memcpy(data, msg.error, msg.errorSize);
             data += msg.errorSize;
-            std::memcpy(data, &msg.errorMessageSize,
-                        sizeof(msg.errorMessageSize));
+            storeLittle(data, msg.errorMessageSize);
             data += sizeof(msg.errorMessageSize);
             std::memcpy(data, msg.errorMessage, msg.errorMessageSize);
           } else {
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <array>
+#include <boost/asio.hpp>
+#include <cstddef>
+#include <expected>
+#include <optional>
+#include <span>
+
+#include "BrilliantSnapcast/CoroutineFrame.hpp"
+#include "BrilliantSnapcast/Message.hpp"
+#include "BrilliantSnapcast/SnapClient.hpp"
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief Reads messages ahead of the consumer. run() keeps reading into a
+   * ring of buffers while the consumer processes earlier messages returned by
+   * next(), so network wait and message processing overlap. At most Depth
+   * messages are buffered, run() waits for the consumer when all buffers are
+   * full.
+   *
+   * All member functions must be called from the executor of the socket.
+   *
+   * run() and next() wake each other by cancelling a steady_timer wait, as
+   * SnapServerSession does, rather than through an experimental::channel.
+   * Messages are views into the buffers, so the reader has to learn when the
+   * consumer gives a buffer back, which a channel of results does not model.
+   * A channel also queues buffered values in a std::deque from the global
+   * heap unless custom traits are supplied, while the timer waits are
+   * allocated from the client's memory resource.
+   *
+   * @tparam Socket The socket type
+   * @tparam Depth The number of buffers
+   */
+  template <class Socket, std::size_t Depth = 4>
+  class MessageStream {
+  public:
+    static_assert(Depth > 0, "MessageStream needs at least one buffer");
+
+    /// Type alias for the result of a read
+    using result_type =
+        std::expected<std::tuple<Base, Message>, boost::system::error_code>;
+
+    /**
+     * @brief Construct a new Message Stream object
+     *
+     * @param client The client messages are read with
+     * @param storage Storage for the buffers. Split into Depth buffers of
+     * equal size, each must be large enough for the largest expected message.
+     */
+    MessageStream(SnapClient<Socket>& client, std::span<std::byte> storage)
+        : _client(&client),
+          _storage(storage),
+          _slotSize(storage.size() / Depth),
+          _readable(client.getExecutor()),
+          _writable(client.getExecutor()) {
+      _readable.expires_at(boost::asio::steady_timer::time_point::max());
+      _writable.expires_at(boost::asio::steady_timer::time_point::max());
+    }
+
+    /**
+     * @brief Read messages until a read fails or close() is called
+     *
+     * @return The error_code which ended the loop. operation_aborted if
+     * close() was called.
+     */
+    auto run() -> boost::asio::awaitable<boost::system::error_code> {
+      auto handler = boost::asio::bind_allocator(_client->getAllocator(),
+                                                 boost::asio::use_awaitable);
+      while (!_closed) {
+        if (_count == Depth) {
+          co_await _writable.async_wait(boost::asio::as_tuple(handler));
+          continue;
+        }
+
+        const auto index = (_head + _count) % Depth;
+        auto result = co_await _client->read(slot(index));
+        if (!result) {
+          _error = result.error();
+          _readable.cancel();
+          co_return _error;
+        }
+        _results[index] = std::move(result);
+        ++_count;
+        _readable.cancel();
+      }
+      co_return boost::asio::error::operation_aborted;
+    }
+
+    /**
+     * @brief Get the next message. Views in the returned message refer to the
+     * buffer it was read into and stay valid until the next call.
+     *
+     * @return The next message. The error which ended run() once all buffered
+     * messages were returned, operation_aborted after close().
+     */
+    auto next() -> boost::asio::awaitable<result_type> {
+      release();
+      auto handler = boost::asio::bind_allocator(_client->getAllocator(),
+                                                 boost::asio::use_awaitable);
+      while (_count == 0) {
+        if (_error) {
+          co_return std::unexpected(_error);
+        }
+        if (_closed) {
+          co_return std::unexpected(boost::asio::error::operation_aborted);
+        }
+        co_await _readable.async_wait(boost::asio::as_tuple(handler));
+      }
+      _holding = true;
+      co_return *_results[_head];
+    }
+
+    /**
+     * @brief Stop run() after the read in progress. Disconnect the TcpClient to
+     * abort the read itself.
+     *
+     */
+    void close() {
+      _closed = true;
+      _readable.cancel();
+      _writable.cancel();
+    }
+
+    /**
+     * @brief Get the number of buffered messages
+     *
+     * @return The number of messages read and not yet released by the
+     * consumer
+     */
+    [[nodiscard]] auto buffered() const -> std::size_t { return _count; }
+
+    /**
+     * @brief Get the Allocator object
+     *
+     * @return The allocator of the client
+     */
+    [[nodiscard]] auto getAllocator() const
+        -> std::pmr::polymorphic_allocator<void> {
+      return _client->getAllocator();
+    }
+
+  private:
+    /**
+     * @brief Get a buffer
+     *
+     * @param index The buffer index
+     * @return View of the buffer
+     */
+    auto slot(std::size_t index) -> std::span<std::byte> {
+      return _storage.subspan(index * _slotSize, _slotSize);
+    }
+
+    /**
+     * @brief Return the buffer of the message last returned by next() to
+     * run()
+     *
+     */
+    void release() {
+      if (!_holding) {
+        return;
+      }
+      _holding = false;
+      _results[_head].reset();
+      _head = (_head + 1) % Depth;
+      --_count;
+      _writable.cancel();
+    }
+
+    /// Pointer to the client
+    SnapClient<Socket>* _client;
+
+    /// Storage for all buffers
+    std::span<std::byte> _storage;
+
+    /// Size of a single buffer
+    std::size_t _slotSize;
+
+    /// Wakes next() when a message was read
+    boost::asio::steady_timer _readable;
+
+    /// Wakes run() when a buffer was released
+    boost::asio::steady_timer _writable;
+
+    /// Read results, one per buffer
+    std::array<std::optional<result_type>, Depth> _results{};
+
+    /// Index of the oldest buffered message
+    std::size_t _head{};
+
+    /// Number of buffered messages
+    std::size_t _count{};
+
+    /// The error which ended run()
+    boost::system::error_code _error;
+
+    /// Set while the consumer holds the oldest buffered message
+    bool _holding{};
+
+    /// Set by close()
+    bool _closed{};
+  };
+
+}  // namespace brilliant::snapcast
+
+#if BRILLIANT_SNAPCAST_PMR_FRAMES
+/**
+ * @brief Allocate the frames of MessageStream coroutines from the memory
+ * resource of its client
+ *
+ */
+// NOLINTBEGIN(cert-dcl58-cpp)
+template <class T, class Executor, class Socket, std::size_t Depth,
+          class... Args>
+struct std::coroutine_traits<
+    boost::asio::awaitable<T, Executor>,
+    brilliant::snapcast::MessageStream<Socket, Depth>&, Args...> {
+  /// Type alias for the promise type
+  using promise_type = brilliant::snapcast::PmrAwaitableFrame<
+      T, Executor, brilliant::snapcast::MessageStream<Socket, Depth>, Args...>;
+};
+// NOLINTEND(cert-dcl58-cpp)
+#endif
@@ -0,0 +1,516 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <boost/system/error_code.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "BrilliantSnapcast/SessionMetrics.hpp"
+#include "BrilliantSnapcast/Trace.hpp"
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief Get the pipeline timestamp
+   *
+   * @return Microseconds on the steady clock
+   */
+  inline auto pipelineNow() -> std::uint64_t {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+  }
+
+  /**
+   * @brief Bounded single producer single consumer queue connecting two
+   * pipeline stages. Holds handles such as SharedFrame, payloads are never
+   * copied. Blocking operations wait on an atomic and are woken by the other
+   * side or by a stop request on their stop_token.
+   *
+   * @tparam T The handle type
+   */
+  template <class T>
+  class StageQueue {
+  public:
+    /**
+     * @brief A copy of the queue statistics at one point in time
+     *
+     */
+    struct Snapshot {
+      /// Number of queued handles
+      std::size_t size{};
+
+      /// Capacity of the queue
+      std::size_t capacity{};
+
+      /// Largest number of queued handles seen by the consumer
+      std::size_t maxSize{};
+
+      /// Number of pushes which waited for space
+      std::uint64_t stalls{};
+
+      /// Number of handles rejected by tryPush() because the queue was full
+      std::uint64_t rejected{};
+
+      /// Time handles spent queued in microseconds
+      Histogram::Snapshot wait;
+    };
+
+    /**
+     * @brief Construct a new Stage Queue object
+     *
+     * @param capacity The maximum number of queued handles, rounded up to a
+     * power of two
+     * @param mr A pointer to the memory resource used for the ring
+     */
+    StageQueue(std::size_t capacity, std::pmr::memory_resource* mr)
+        : _entries(std::bit_ceil(std::max<std::size_t>(capacity, 1)), mr),
+          _mask(_entries.size() - 1) {}
+
+    /**
+     * @brief Queue a handle if there is space. Called by the producer only.
+     *
+     * @param value The handle. Moved from if queued.
+     * @return True if the handle was queued
+     */
+    auto tryPush(T& value) -> bool {
+      const auto head = _head.load(std::memory_order_relaxed);
+      if (head - _tail.load(std::memory_order_acquire) == _entries.size()) {
+        _rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      publish(head, value);
+      return true;
+    }
+
+    /**
+     * @brief Queue a handle, waiting while the queue is full. Called by the
+     * producer only.
+     *
+     * @param value The handle
+     * @param stop Stops waiting when requested
+     * @return True if the handle was queued, false if stop was requested
+     */
+    auto push(T value, std::stop_token stop) -> bool {
+      const auto head = _head.load(std::memory_order_relaxed);
+      if (head - _tail.load(std::memory_order_acquire) == _entries.size()) {
+        _stalls.fetch_add(1, std::memory_order_relaxed);
+        const std::stop_callback wake(stop, [this] { signal(); });
+        while (true) {
+          const auto epoch = _epoch.load(std::memory_order_acquire);
+          if (head - _tail.load(std::memory_order_acquire) <
+              _entries.size()) {
+            break;
+          }
+          if (stop.stop_requested()) {
+            return false;
+          }
+          _epoch.wait(epoch, std::memory_order_acquire);
+        }
+      }
+      publish(head, value);
+      return true;
+    }
+
+    /**
+     * @brief Take up to max handles, waiting while the queue is empty. Called
+     * by the consumer only.
+     *
+     * @param out The vector handles are appended to
+     * @param max The maximum number of handles to take
+     * @param stop Stops waiting when requested
+     * @return The number of handles taken, 0 if stop was requested
+     */
+    auto popBatch(std::pmr::vector<T>& out, std::size_t max,
+                  std::stop_token stop) -> std::size_t {
+      const auto tail = _tail.load(std::memory_order_relaxed);
+      auto head = _head.load(std::memory_order_acquire);
+      if (head == tail) {
+        const std::stop_callback wake(stop, [this] { signal(); });
+        while (true) {
+          const auto epoch = _epoch.load(std::memory_order_acquire);
+          head = _head.load(std::memory_order_acquire);
+          if (head != tail) {
+            break;
+          }
+          if (stop.stop_requested()) {
+            return 0;
+          }
+          _epoch.wait(epoch, std::memory_order_acquire);
+        }
+      }
+
+      const auto available = static_cast<std::size_t>(head - tail);
+      const auto count = std::min(available, max);
+      _maxSize.store(std::max(available,
+                              _maxSize.load(std::memory_order_relaxed)),
+                     std::memory_order_relaxed);
+      const auto now = pipelineNow();
+      for (std::size_t i = 0; i < count; ++i) {
+        auto& entry = _entries[(tail + i) & _mask];
+        _wait.record(now - entry.enqueued);
+        out.push_back(std::move(*entry.value));
+        entry.value.reset();
+      }
+      _tail.store(tail + count, std::memory_order_release);
+      signal();
+      return count;
+    }
+
+    /**
+     * @brief Get the number of queued handles
+     *
+     * @return The number of handles
+     */
+    [[nodiscard]] auto size() const -> std::size_t {
+      return static_cast<std::size_t>(_head.load(std::memory_order_acquire) -
+                                      _tail.load(std::memory_order_acquire));
+    }
+
+    /**
+     * @brief Get the capacity
+     *
+     * @return The maximum number of queued handles
+     */
+    [[nodiscard]] auto capacity() const -> std::size_t {
+      return _entries.size();
+    }
+
+    /**
+     * @brief Copy the queue statistics. Safe to call from any thread.
+     *
+     * @param out The snapshot to write to
+     */
+    void snapshot(Snapshot& out) const {
+      out.size = size();
+      out.capacity = capacity();
+      out.maxSize = _maxSize.load(std::memory_order_relaxed);
+      out.stalls = _stalls.load(std::memory_order_relaxed);
+      out.rejected = _rejected.load(std::memory_order_relaxed);
+      _wait.snapshot(out.wait);
+    }
+
+  private:
+    /**
+     * @brief A queued handle
+     *
+     */
+    struct Entry {
+      /// The handle
+      std::optional<T> value;
+
+      /// Time the handle was queued
+      std::uint64_t enqueued{};
+    };
+
+    /**
+     * @brief Store a handle and make it visible to the consumer
+     *
+     * @param head The producer index
+     * @param value The handle
+     */
+    void publish(std::size_t head, T& value) {
+      auto& entry = _entries[head & _mask];
+      entry.value.emplace(std::move(value));
+      entry.enqueued = pipelineNow();
+      _head.store(head + 1, std::memory_order_release);
+      signal();
+    }
+
+    /**
+     * @brief Notify the other side of a change
+     *
+     */
+    void signal() {
+      _epoch.fetch_add(1, std::memory_order_release);
+      _epoch.notify_all();
+    }
+
+    /// Ring of entries
+    std::pmr::vector<Entry> _entries;
+
+    /// Index mask
+    std::size_t _mask;
+
+    /// Index of the next entry to write
+    alignas(64) std::atomic<std::size_t> _head{};
+
+    /// Index of the next entry to read
+    alignas(64) std::atomic<std::size_t> _tail{};
+
+    /// Changed on every push, pop and stop request, waited on by blocked
+    /// calls
+    alignas(64) std::atomic<std::uint32_t> _epoch{};
+
+    /// Largest observed queue size
+    std::atomic<std::size_t> _maxSize{};
+
+    /// Number of pushes which waited
+    std::atomic<std::uint64_t> _stalls{};
+
+    /// Number of rejected handles
+    std::atomic<std::uint64_t> _rejected{};
+
+    /// Time handles spent queued
+    Histogram _wait;
+  };
+
+  /**
+   * @brief Thread options of a pipeline stage
+   *
+   */
+  struct StageOptions {
+    /// Maximum number of handles processed per batch
+    std::size_t batchSize{8};
+
+    /// Core the stage thread is pinned to, no pinning if empty
+    std::optional<std::size_t> core;
+
+    /// SCHED_FIFO priority of the stage thread, 0 keeps the default policy.
+    /// The thread runs with the default policy if the process lacks the
+    /// privilege.
+    int realtimePriority{};
+  };
+
+  /**
+   * @brief A pipeline stage running on its own thread. Takes batches of
+   * handles from an input queue and passes them to a function. Stages which
+   * produce output push into the next queue from the function, push() blocks
+   * while that queue is full which propagates backpressure upstream.
+   *
+   * The network stage stays on the io_context and feeds the first queue with
+   * tryPush() so a slow stage never blocks socket reads.
+   *
+   * @tparam In The input handle type
+   * @tparam Fn The function type, invoked as fn(std::span<In>, std::stop_token)
+   */
+  template <class In, class Fn>
+  class PipelineStage {
+  public:
+    /**
+     * @brief A copy of the stage statistics at one point in time
+     *
+     */
+    struct Snapshot {
+      /// Number of processed handles
+      std::uint64_t items{};
+
+      /// Number of processed batches
+      std::uint64_t batches{};
+
+      /// Processing time per handle in microseconds
+      Histogram::Snapshot service;
+    };
+
+    /**
+     * @brief Construct a new Pipeline Stage object. The thread is started by
+     * start().
+     *
+     * @param input The queue the stage consumes
+     * @param fn The function processing batches
+     * @param options Thread options
+     * @param mr A pointer to the memory resource used for the batch
+     */
+    PipelineStage(StageQueue<In>& input, Fn fn, StageOptions options,
+                  std::pmr::memory_resource* mr)
+        : _input(&input),
+          _fn(std::move(fn)),
+          _options(options),
+          _batch(mr) {
+      _batch.reserve(std::max<std::size_t>(options.batchSize, 1));
+    }
+
+    /**
+     * @brief Destroy the Pipeline Stage object. Stops the thread.
+     *
+     */
+    ~PipelineStage() { stop(); }
+
+    /**
+     * @brief Deleted copy constructor
+     *
+     */
+    PipelineStage(const PipelineStage&) = delete;
+
+    /**
+     * @brief Deleted move constructor
+     *
+     */
+    PipelineStage(PipelineStage&&) = delete;
+
+    /**
+     * @brief Deleted copy assignment operator
+     *
+     * @return PipelineStage&
+     */
+    auto operator=(const PipelineStage&) -> PipelineStage& = delete;
+
+    /**
+     * @brief Deleted move assignment operator
+     *
+     * @return PipelineStage&
+     */
+    auto operator=(PipelineStage&&) -> PipelineStage& = delete;
+
+    /**
+     * @brief Start the stage thread and wait until it applied its options.
+     * The thread runs even if an option could not be applied.
+     *
+     * @return The first error applying the core or priority option, e.g.
+     * invalid_argument for a core the system does not have or
+     * operation_not_permitted for a priority without the privilege. Empty
+     * if the options were applied.
+     */
+    auto start() -> boost::system::error_code {
+      _configured.store(false, std::memory_order_relaxed);
+      _thread = std::jthread([this](std::stop_token stop) {
+        _threadError = configureThread();
+        _configured.store(true, std::memory_order_release);
+        _configured.notify_one();
+        run(stop);
+      });
+      _configured.wait(false, std::memory_order_acquire);
+      return _threadError;
+    }
+
+    /**
+     * @brief Stop the stage thread. Handles still queued are not processed.
+     * The function must observe its stop_token when pushing downstream.
+     *
+     */
+    void stop() {
+      if (_thread.joinable()) {
+        _thread.request_stop();
+        _thread.join();
+      }
+    }
+
+    /**
+     * @brief Get the stop token of the stage thread
+     *
+     * @return The stop token
+     */
+    [[nodiscard]] auto stopToken() const -> std::stop_token {
+      return _thread.get_stop_token();
+    }
+
+    /**
+     * @brief Copy the stage statistics. Safe to call from any thread.
+     *
+     * @param out The snapshot to write to
+     */
+    void snapshot(Snapshot& out) const {
+      out.items = _items.load(std::memory_order_relaxed);
+      out.batches = _batches.load(std::memory_order_relaxed);
+      _service.snapshot(out.service);
+    }
+
+  private:
+    /**
+     * @brief Process batches until stop is requested
+     *
+     * @param stop The stop token of the thread
+     */
+    void run(const std::stop_token& stop) {
+      const auto batchSize = std::max<std::size_t>(_options.batchSize, 1);
+      while (!stop.stop_requested()) {
+        _batch.clear();
+        const auto count = _input->popBatch(_batch, batchSize, stop);
+        if (count == 0) {
+          continue;
+        }
+        const auto start = pipelineNow();
+        {
+          BRILLIANT_TRACE_SCOPE("PipelineStage::batch", this);
+          _fn(std::span<In>(_batch), stop);
+        }
+        _service.record((pipelineNow() - start) / count);
+        _items.fetch_add(count, std::memory_order_relaxed);
+        _batches.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * @brief Apply core pinning and scheduling policy to the calling thread.
+     * Has no effect on platforms without support.
+     *
+     * @return The first error, empty if both options were applied
+     */
+    [[nodiscard]] auto configureThread() const -> boost::system::error_code {
+      boost::system::error_code ec;
+#if defined(__linux__)
+      if (_options.core) {
+        if (*_options.core >= CPU_SETSIZE) {
+          ec = boost::system::errc::make_error_code(
+              boost::system::errc::invalid_argument);
+        } else {
+          cpu_set_t set;
+          CPU_ZERO(&set);
+          CPU_SET(*_options.core, &set);
+          if (const auto result =
+                  pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+            ec = {result, boost::system::system_category()};
+          }
+        }
+      }
+      if (_options.realtimePriority > 0) {
+        sched_param param{};
+        param.sched_priority = _options.realtimePriority;
+        if (const auto result =
+                pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            result && !ec) {
+          ec = {result, boost::system::system_category()};
+        }
+      }
+#endif
+      return ec;
+    }
+
+    /// The input queue
+    StageQueue<In>* _input;
+
+    /// The batch function
+    Fn _fn;
+
+    /// Thread options
+    StageOptions _options;
+
+    /// The current batch
+    std::pmr::vector<In> _batch;
+
+    /// Number of processed handles
+    std::atomic<std::uint64_t> _items{};
+
+    /// Number of processed batches
+    std::atomic<std::uint64_t> _batches{};
+
+    /// Processing time per handle
+    Histogram _service;
+
+    /// Result of applying the thread options, written before _configured
+    /// is set
+    boost::system::error_code _threadError;
+
+    /// Set once the stage thread applied its options
+    std::atomic<bool> _configured{};
+
+    /// The stage thread
+    std::jthread _thread;
+  };
+
+}  // namespace brilliant::snapcast
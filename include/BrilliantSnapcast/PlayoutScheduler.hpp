@@ -0,0 +1,229 @@
+#pragma once
+
+// waits on the shared PCM ring, which is Linux only
+#if defined(__linux__)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+
+#include "BrilliantSnapcast/SessionMetrics.hpp"
+#include "BrilliantSnapcast/SharedPcmRing.hpp"
+#include "BrilliantSnapcast/Trace.hpp"
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief Options of a playout scheduler
+   *
+   */
+  struct PlayoutOptions {
+    /// Period of the sink, e.g. the ALSA period. Wakeups are aligned to
+    /// multiples of it and a frame is written at least one period ahead of
+    /// its playout time.
+    std::chrono::nanoseconds period{std::chrono::milliseconds(20)};
+
+    /// How far ahead of the playout time frames are written to the sink. The
+    /// sink must buffer this much audio. Larger values mean fewer wakeups.
+    std::chrono::nanoseconds slack{std::chrono::milliseconds(200)};
+  };
+
+  /**
+   * @brief Player side consumer of a shared PCM ring which batches wakeups.
+   * Each wakeup writes every frame due within the slack to the sink, then
+   * sleeps until the next frame is one period from being due, rounded down
+   * to a period boundary so the wakeup coalesces with the sink's own period
+   * interrupt. While the ring is empty it waits on the ring's futex without
+   * a timeout until a frame is published or stop is requested, there are no
+   * periodic wakeups during network idle periods.
+   *
+   * consumePcm() wakes once per frame, this wakes about once per slack minus
+   * one period.
+   *
+   */
+  class PlayoutScheduler {
+  public:
+    /**
+     * @brief A copy of the scheduler statistics at one point in time
+     *
+     */
+    struct Snapshot {
+      /// Number of times the scheduler woke up
+      std::uint64_t wakeups{};
+
+      /// Number of frames written to the sink
+      std::uint64_t frames{};
+
+      /// Number of frames written after their playout time
+      std::uint64_t late{};
+    };
+
+    /**
+     * @brief Construct a new Playout Scheduler object
+     *
+     * @param ring The ring opened with SharedPcmRing::open(). Must outlive
+     * this object.
+     * @param options Scheduling options, slack should be at least two
+     * periods
+     */
+    PlayoutScheduler(SharedPcmRing& ring, PlayoutOptions options)
+        : _ring(&ring), _options(options) {}
+
+    /**
+     * @brief Set the metrics which count late frames as late chunks. Call
+     * before run().
+     *
+     * @param metrics A pointer to the metrics, null to stop collecting. Must
+     * outlive this object or be reset.
+     */
+    void setMetrics(SessionMetrics* metrics) { _metrics = metrics; }
+
+    /**
+     * @brief Pass frames to the sink ahead of their playout time until stop
+     * is requested
+     *
+     * @tparam Sink Callable as sink(PcmSlot), e.g. a non-blocking write to
+     * the audio device
+     * @param sink Receives each frame up to slack before its playout time
+     * @param stop Stops the scheduler
+     * @return The number of frames written
+     */
+    template <class Sink>
+    auto run(Sink&& sink, std::stop_token stop) -> std::uint64_t {
+      std::uint64_t written = 0;
+      // playout time of the last written frame, the epoch once the sink
+      // was checked after it
+      std::chrono::steady_clock::time_point last{};
+      while (!stop.stop_requested()) {
+        const auto now = std::chrono::steady_clock::now();
+        const auto horizon = now + _options.slack;
+        std::optional<PcmSlot> frame;
+        while ((frame = _ring->peek()) && frame->playout < horizon) {
+          if (!_origin) {
+            _origin = frame->playout;
+          }
+          if (frame->playout < now) {
+            _late.fetch_add(1, std::memory_order_relaxed);
+            if (_metrics) {
+              _metrics->lateChunk();
+            }
+          }
+          {
+            BRILLIANT_TRACE_SCOPE("PlayoutScheduler::sink", this);
+            sink(*frame);
+          }
+          last = frame->playout;
+          _ring->release();
+          ++written;
+          _frames.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (stop.stop_requested()) {
+          break;
+        }
+        if (frame) {
+          // never earlier than the frame enters the slack, a slack shorter
+          // than two periods would otherwise spin
+          sleepUntil(std::max(alignDown(frame->playout - _options.period),
+                              frame->playout - _options.slack),
+                     stop);
+        } else if (alignDown(last - _options.period) > now) {
+          // the sink is still busy, check for new frames when it runs low
+          sleepUntil(alignDown(last - _options.period), stop);
+          last = {};
+        } else {
+          _ring->waitForFrame(stop);
+          _wakeups.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+      return written;
+    }
+
+    /**
+     * @brief Copy the scheduler statistics. Safe to call from any thread.
+     *
+     * @param out The snapshot to write to
+     */
+    void snapshot(Snapshot& out) const {
+      out.wakeups = _wakeups.load(std::memory_order_relaxed);
+      out.frames = _frames.load(std::memory_order_relaxed);
+      out.late = _late.load(std::memory_order_relaxed);
+    }
+
+  private:
+    /**
+     * @brief Round a time down to a period boundary. Boundaries are counted
+     * from the playout time of the first frame, where the sink started.
+     *
+     * @param time The time
+     * @return The boundary at or before time
+     */
+    [[nodiscard]] auto alignDown(std::chrono::steady_clock::time_point time)
+        const -> std::chrono::steady_clock::time_point {
+      const auto period = std::chrono::duration_cast<
+          std::chrono::steady_clock::duration>(_options.period);
+      if (!_origin || period <= std::chrono::steady_clock::duration::zero()) {
+        return time;
+      }
+      const auto offset = time - *_origin;
+      auto periods = offset / period;
+      if (offset % period < std::chrono::steady_clock::duration::zero()) {
+        --periods;
+      }
+      return *_origin + periods * period;
+    }
+
+    /**
+     * @brief Sleep until a time or until stop is requested. Returns at once
+     * if the time has passed.
+     *
+     * @param time The time to wake up at
+     * @param stop Ends the sleep early
+     */
+    void sleepUntil(std::chrono::steady_clock::time_point time,
+                    const std::stop_token& stop) {
+      if (time <= std::chrono::steady_clock::now()) {
+        return;
+      }
+      BRILLIANT_TRACE_SCOPE("PlayoutScheduler::sleep", this);
+      std::unique_lock lock(_mutex);
+      _wake.wait_until(lock, stop, time, [] { return false; });
+      _wakeups.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// The ring
+    SharedPcmRing* _ring;
+
+    /// Scheduling options
+    PlayoutOptions _options;
+
+    /// Playout time of the first frame, the first period boundary
+    std::optional<std::chrono::steady_clock::time_point> _origin;
+
+    /// Mutex of the sleep condition
+    std::mutex _mutex;
+
+    /// Interrupts sleeps on stop requests
+    std::condition_variable_any _wake;
+
+    /// Number of wakeups
+    std::atomic<std::uint64_t> _wakeups{};
+
+    /// Number of written frames
+    std::atomic<std::uint64_t> _frames{};
+
+    /// Number of late frames
+    std::atomic<std::uint64_t> _late{};
+
+    /// Pointer to the metrics, may be null
+    SessionMetrics* _metrics{};
+  };
+
+}  // namespace brilliant::snapcast
+
+#endif
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <boost/system/error_code.hpp>
+#include <cstddef>
+#include <cstring>
+#include <expected>
+#include <optional>
+#include <span>
+
+#include "BrilliantSnapcast/Message.hpp"
+#include "BrilliantSnapcast/MessageConv.hpp"
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief A message header and the message decoded from the bytes following
+   * it.
+   *
+   */
+  struct Frame {
+    /// The message header
+    Base base;
+
+    /// The message. May contain views into the session storage
+    Message message;
+  };
+
+  /**
+   * @brief Sans-IO implementation of the snapcast protocol. Bytes received
+   * from any transport are fed to the session which yields decoded frames.
+   * Outgoing messages are encoded into caller provided buffers. No network
+   * calls are made so a session can be driven from Boost.Asio, a hand written
+   * event loop or a bare-metal receive interrupt.
+   *
+   * Received bytes are stored in a caller provided span. A decoded frame
+   * contains views into this storage and is valid until more bytes are
+   * committed to the session.
+   */
+  class ProtocolSession {
+  public:
+    /**
+     * @brief Decoder state
+     *
+     */
+    enum class State : std::uint8_t {
+      /// Waiting for the bytes of a message header
+      HEADER,
+
+      /// Waiting for the bytes of a message body
+      BODY,
+
+      /// A complete frame is ready to be retrieved with next()
+      FRAME,
+
+      /// Skipping the body of a message which did not fit the storage
+      DISCARD
+    };
+
+    /**
+     * @brief Construct a new Protocol Session object
+     *
+     * @param storage The storage received bytes are written to. Must be at
+     * least HEADER_SIZE bytes and large enough to hold the largest message
+     * body expected.
+     */
+    explicit ProtocolSession(std::span<std::byte> storage)
+        : _storage(storage) {}
+
+    /**
+     * @brief Get the region the next received bytes should be written to. The
+     * region is sized to the exact number of bytes needed to complete the
+     * current header or body so a transport can read directly into it.
+     *
+     * @return A view into the session storage. Empty if a frame is waiting to
+     * be retrieved or the storage cannot hold a header.
+     */
+    [[nodiscard]] auto prepare() const -> std::span<std::byte> {
+      switch (_state) {
+      case State::HEADER:
+        if (std::size(_storage) < HEADER_SIZE) {
+          return {};
+        }
+        return _storage.subspan(_filled, HEADER_SIZE - _filled);
+      case State::BODY:
+        return _storage.subspan(_filled, _base.size - _filled);
+      case State::DISCARD:
+        return _storage.first(
+            std::min<std::size_t>(std::size(_storage), _base.size - _filled));
+      case State::FRAME:
+      default:
+        return {};
+      }
+    }
+
+    /**
+     * @brief Mark bytes written to the region returned by prepare() as
+     * received
+     *
+     * @param n The number of bytes written. Must not exceed the size of the
+     * region returned by prepare()
+     * @param now The time the bytes were received. Stored in Base::received
+     * when a header is completed.
+     */
+    void commit(std::size_t n, Time now = {}) {
+      _filled += n;
+      switch (_state) {
+      case State::HEADER:
+        if (_filled == HEADER_SIZE) {
+          std::memcpy(_header.data(), _storage.data(), HEADER_SIZE);
+          brilliant::snapcast::read(std::span(_header), _base);
+          _base.received = now;
+          _filled = 0;
+          if (std::size(_storage) < _base.size) {
+            _state = State::DISCARD;
+            ++_discarded;
+          } else {
+            _state = _base.size == 0 ? State::FRAME : State::BODY;
+          }
+        }
+        break;
+      case State::BODY:
+        if (_filled == _base.size) {
+          _state = State::FRAME;
+        }
+        break;
+      case State::DISCARD:
+        if (_filled == _base.size) {
+          _filled = 0;
+          _state = State::HEADER;
+        }
+        break;
+      case State::FRAME:
+      default:
+        break;
+      }
+    }
+
+    /**
+     * @brief Copy received bytes into the session. Stops consuming after a
+     * complete frame so the frame can be retrieved before its storage is
+     * reused.
+     *
+     * @param data The received bytes
+     * @param now The time the bytes were received
+     * @return The number of bytes consumed from data
+     */
+    auto feed(std::span<const std::byte> data, Time now = {}) -> std::size_t {
+      std::size_t consumed = 0;
+      while (consumed < std::size(data)) {
+        auto region = prepare();
+        if (region.empty()) {
+          break;
+        }
+        const auto n =
+            std::min(std::size(region), std::size(data) - consumed);
+        std::memcpy(region.data(), data.data() + consumed, n);
+        commit(n, now);
+        consumed += n;
+      }
+      return consumed;
+    }
+
+    /**
+     * @brief Retrieve the next decoded frame
+     *
+     * @return The frame if one is complete, an empty optional if more bytes
+     * are needed. Returns no_buffer_space once for every message too large for
+     * the storage, the body of such a message is skipped. Returns
+     * no_buffer_space while the storage cannot hold a header. Returns
+     * bad_message for a frame of an unknown type or with sizes inside the
+     * body which overrun it, decoding continues with the next frame.
+     */
+    auto next()
+        -> std::expected<std::optional<Frame>, boost::system::error_code> {
+      if (std::size(_storage) < HEADER_SIZE) {
+        return std::unexpected(boost::system::errc::make_error_code(
+            boost::system::errc::no_buffer_space));
+      }
+      if (_discarded > 0) {
+        --_discarded;
+        return std::unexpected(boost::system::errc::make_error_code(
+            boost::system::errc::no_buffer_space));
+      }
+
+      if (_state != State::FRAME) {
+        return std::nullopt;
+      }
+
+      _state = State::HEADER;
+      _filled = 0;
+      auto message =
+          brilliant::snapcast::read(_storage.first(_base.size), _base.type);
+      if (!message) {
+        return std::unexpected(message.error());
+      }
+      return Frame{_base, *message};
+    }
+
+    /**
+     * @brief Drop any partially received message and start waiting for a new
+     * header
+     *
+     */
+    void reset() {
+      _state = State::HEADER;
+      _filled = 0;
+      _discarded = 0;
+    }
+
+    /**
+     * @brief Get the raw bytes of the most recently received header. The
+     * Base::received field is as sent by the peer.
+     *
+     * @return A view of the header bytes
+     */
+    [[nodiscard]] auto header() const -> std::span<const std::byte> {
+      return _header;
+    }
+
+    /**
+     * @brief Get the decoder state
+     *
+     * @return The current state
+     */
+    [[nodiscard]] auto state() const -> State { return _state; }
+
+    /**
+     * @brief Encode a message and its header
+     *
+     * @param id The message id
+     * @param message The message to encode. If it is a Time message it is set
+     * to the sent time.
+     * @param sent The time stored in the header as the sent time
+     * @param buffer The buffer to encode into
+     * @param refersTo The id of the message this message replies to
+     * @return A view of the encoded bytes within buffer if successful,
+     * no_buffer_space if the buffer is too small.
+     */
+    static auto encode(std::uint16_t id, Message& message, Time sent,
+                       std::span<std::byte> buffer, std::uint16_t refersTo = 0)
+        -> std::expected<std::span<std::byte>, boost::system::error_code> {
+      Base base{};
+      base.type = messageType(message);
+      base.id = id;
+      base.refersTo = refersTo;
+      base.sent = sent;
+      base.size = wireSize(message);
+
+      if (auto* time = std::get_if<Time>(&message)) {
+        *time = sent;
+      }
+
+      if (std::size(buffer) < (HEADER_SIZE + base.size)) {
+        return std::unexpected(boost::system::errc::make_error_code(
+            boost::system::errc::no_buffer_space));
+      }
+
+      brilliant::snapcast::write(buffer.first(HEADER_SIZE), base);
+      brilliant::snapcast::write(buffer.subspan(HEADER_SIZE, base.size),
+                                 message);
+      return buffer.first(HEADER_SIZE + base.size);
+    }
+
+    /**
+     * @brief Encode a fixed size message and its header into a buffer of
+     * static extent. The size is known at compile time so there is no size
+     * check and no dispatch on the message type, an undersized buffer fails
+     * to compile.
+     *
+     * @tparam T The message type
+     * @tparam Extent The buffer extent, at least FRAME_SIZE<T>
+     * @param id The message id
+     * @param message The message to encode. A Time message is set to the sent
+     * time.
+     * @param sent The time stored in the header as the sent time
+     * @param buffer The buffer to encode into
+     * @param refersTo The id of the message this message replies to
+     * @return A view of the encoded bytes within buffer
+     */
+    template <class T, std::size_t Extent>
+      requires(WireTraits<T>::FIXED_SIZE && Extent != std::dynamic_extent)
+    static auto encode(std::uint16_t id, T& message, Time sent,
+                       std::span<std::byte, Extent> buffer,
+                       std::uint16_t refersTo = 0)
+        -> std::span<std::byte, FRAME_SIZE<T>> {
+      static_assert(Extent >= FRAME_SIZE<T>,
+                    "buffer is too small for the message");
+      Base base{};
+      base.type = WireTraits<T>::TYPE;
+      base.id = id;
+      base.refersTo = refersTo;
+      base.sent = sent;
+      base.size = static_cast<std::uint32_t>(WireTraits<T>::MIN_SIZE);
+
+      if constexpr (std::is_same_v<T, Time>) {
+        message = sent;
+      }
+
+      auto frame = buffer.template first<FRAME_SIZE<T>>();
+      brilliant::snapcast::write(frame.template first<HEADER_SIZE>(), base);
+      brilliant::snapcast::write(frame.template subspan<HEADER_SIZE>(),
+                                 message);
+      return frame;
+    }
+
+  private:
+    /// Storage for received bytes
+    std::span<std::byte> _storage;
+
+    /// The header of the message being received
+    Base _base{};
+
+    /// Raw bytes of the header of the message being received
+    std::array<std::byte, HEADER_SIZE> _header{};
+
+    /// Number of bytes received for the current header or body
+    std::size_t _filled{};
+
+    /// The decoder state
+    State _state{State::HEADER};
+
+    /// Number of messages too large for the storage which have not been
+    /// reported by next()
+    std::size_t _discarded{};
+  };
+
+}  // namespace brilliant::snapcast
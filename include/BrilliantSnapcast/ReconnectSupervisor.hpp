@@ -0,0 +1,816 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BrilliantSnapcast/BoostPmrWrapper.hpp"
+#include "BrilliantSnapcast/ClockSync.hpp"
+#include "BrilliantSnapcast/CoroutineFrame.hpp"
+#include "BrilliantSnapcast/Message.hpp"
+#include "BrilliantSnapcast/Pipeline.hpp"
+#include "BrilliantSnapcast/SessionMetrics.hpp"
+#include "BrilliantSnapcast/SnapClient.hpp"
+#include "BrilliantSnapcast/StreamDecoder.hpp"
+#include "BrilliantSnapcast/TcpClient.hpp"
+#include "BrilliantSnapcast/UtilProvider.hpp"
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief Options of a reconnect supervisor
+   *
+   */
+  struct ReconnectOptions {
+    /// Wait after the first failed attempt, doubled after every further
+    /// failed attempt
+    std::chrono::nanoseconds initialBackoff{std::chrono::milliseconds(100)};
+
+    /// Longest wait between two attempts
+    std::chrono::nanoseconds maxBackoff{std::chrono::seconds(5)};
+
+    /// Interval of the Time messages which keep the clock offset current
+    std::chrono::nanoseconds timeInterval{std::chrono::seconds(1)};
+
+    /// Longest time a connection attempt or a write may take
+    std::chrono::nanoseconds ioTimeout{std::chrono::seconds(2)};
+
+    /// Part of the server's buffer a connection may stay silent. A silent
+    /// connection is probed with a Time message and dropped if nothing
+    /// arrives for the same time again, well before the buffered audio runs
+    /// out.
+    double idleFraction{0.25};
+
+    /// Longest silence before the server settings arrive
+    std::chrono::nanoseconds idleTimeout{std::chrono::seconds(1)};
+
+    /// Options of the clock offset and drift estimate
+    ClockSyncOptions clockSync{};
+
+    /// File the clock estimate is saved to and restored from by run(), no
+    /// file if null
+    const char* clockStatePath{};
+
+    /// Identity of the server in the clock state file, e.g.
+    /// ClockSync::serverId() of the configured host and port, so the
+    /// estimate survives the host resolving to another address. Zero keys
+    /// the state on the endpoint passed to run().
+    std::uint64_t clockServer{};
+
+    /// Interval the clock estimate is saved in while connected, it is saved
+    /// when a connection ends as well
+    std::chrono::nanoseconds clockSaveInterval{std::chrono::seconds(60)};
+
+    /// Size of the slabs messages are read into, including the header. The
+    /// default fits a 20 ms chunk of 96 kHz 32 bit stereo PCM, larger
+    /// messages are skipped.
+    std::size_t slabSize{16384};
+
+    /// Number of slabs, at least the chunk queue capacity plus the chunks
+    /// the decode stage holds plus one. Zero for twice the queue capacity
+    /// plus two.
+    std::size_t slabCount{};
+  };
+
+  /**
+   * @brief Keeps a client connected and its audio flowing across connection
+   * drops. run() connects, replays the cached Hello, sends Time messages and
+   * queues received chunks for a StreamDecoder until stop() is called. A
+   * dropped connection is retried at once if it delivered audio, failed
+   * attempts back off exponentially.
+   *
+   * Messages are read into the slabs of a SlabPool allocated once from the
+   * tcp client's memory resource. A chunk is queued with its slab, so the
+   * decode stage reads the payload in place and the slab returns to the
+   * pool lock free on the decode thread; no memory of the session resource
+   * is freed there. While the decode stage holds every slab, messages are
+   * read into the run() buffer and chunks among them are dropped.
+   *
+   * The clock offset, the server settings and the decoder stream outlive
+   * the connection. After a reconnect the first chunk is queued as soon as
+   * it is read, without waiting for a Time reply, and a codec header equal
+   * to the previous one keeps the running decoder. The time from losing the
+   * connection to queuing the first chunk again is recorded as the time to
+   * first audio.
+   *
+   * With ReconnectOptions::clockStatePath set, the clock estimate is saved
+   * to a file and restored by the next run() of any process on the same
+   * boot, so chunks are scheduled with a drift corrected offset before the
+   * first Time reply; the first replies validate the restored estimate.
+   *
+   * Connects and writes time out after ReconnectOptions::ioTimeout. A
+   * connection which stays silent for idleFraction of the server's buffer
+   * is probed with a Time message and dropped if the probe is not answered
+   * within the same time, so a stalled server is replaced while the jitter
+   * buffer still holds audio.
+   *
+   * All member functions except snapshot() must be called from the executor
+   * of the socket.
+   *
+   * @tparam Socket The socket type
+   */
+  template <class Socket>
+  class ReconnectSupervisor {
+  public:
+    /// Type alias for the endpoint type
+    using endpoint_type = typename TcpClient<Socket>::protocol::endpoint;
+
+    /**
+     * @brief A copy of the supervisor statistics at one point in time
+     *
+     */
+    struct Snapshot {
+      /// Number of established connections
+      std::uint64_t connects{};
+
+      /// Number of failed connection attempts
+      std::uint64_t failures{};
+
+      /// Number of chunks which could not be scheduled, because the clock
+      /// offset, the server settings or the codec header were not known yet
+      /// or the chunk queue was full
+      std::uint64_t dropped{};
+
+      /// Number of codec headers which required a new decoder
+      std::uint64_t rebuilds{};
+
+      /// Number of connections dropped because the server fell silent
+      std::uint64_t idleDrops{};
+
+      /// Number of clock estimates restored from the state file
+      std::uint64_t clockRestores{};
+
+      /// Number of restored clock estimates discarded by a Time reply
+      std::uint64_t clockRejects{};
+
+      /// Number of clock estimates which could not be saved
+      std::uint64_t clockSaveFailures{};
+
+      /// Time from starting run() or losing a connection to queuing the
+      /// first chunk in microseconds
+      Histogram::Snapshot timeToFirstAudio;
+
+      /// The most recent time to first audio in microseconds
+      std::uint64_t lastTimeToFirstAudio{};
+    };
+
+    /**
+     * @brief Construct a new Reconnect Supervisor object
+     *
+     * @param tcpClient The tcp client used for network operations. Its
+     * memory resource is used for dynamic allocations.
+     * @param decoder The decoder chunks are prepared for. Must outlive this
+     * object.
+     * @param chunks The input queue of the decode stage. Must outlive this
+     * object, the chunks queued hold slabs of this object and must be
+     * destroyed before it.
+     * @param options Reconnect options
+     */
+    ReconnectSupervisor(TcpClient<Socket>& tcpClient, StreamDecoder& decoder,
+                        StageQueue<StreamChunk>& chunks,
+                        ReconnectOptions options)
+        : _tcpClient(&tcpClient),
+          _client(tcpClient),
+          _decoder(&decoder),
+          _chunks(&chunks),
+          _options(options),
+          _slabs(options.slabSize,
+                 options.slabCount != 0 ? options.slabCount
+                                        : (2 * chunks.capacity()) + 2,
+                 tcpClient.getAllocator().resource()),
+          _sync(options.clockSync),
+          _timer(tcpClient.getExecutor()),
+          _keepAliveDone(tcpClient.getExecutor()),
+          _hello(resource()),
+          _codec(resource()),
+          _codecPayload(resource()) {}
+
+    /**
+     * @brief Build the Hello message. It is replayed on every connect
+     * without querying the util provider or serializing json again. A Hello
+     * built without a connection carries the fallback MAC address of the
+     * util provider, it is built once more on the first connect to carry
+     * the address of the connection's interface.
+     *
+     * @param utilProvider A reference to the util provider. Must outlive
+     * this object or the first connection.
+     * @param serializer A reference to the json serializer. Must outlive
+     * this object or the first connection.
+     */
+    void cacheHello(UtilProvider& utilProvider,
+                    boost::json::serializer& serializer) {
+      _utilProvider = &utilProvider;
+      _serializer = &serializer;
+      buildHello();
+    }
+
+    /**
+     * @brief Connect and keep reconnecting until stop() is called
+     *
+     * @param endpoint The endpoint of the server
+     * @param buffer The buffer messages are read into and sent from. Must
+     * remain valid until the operation completes.
+     * @return operation_aborted once stop() was called
+     */
+    auto run(endpoint_type endpoint, std::span<std::byte> buffer)
+        -> boost::asio::awaitable<boost::system::error_code> {
+      auto handler = boost::asio::bind_allocator(_tcpClient->getAllocator(),
+                                                 boost::asio::use_awaitable);
+      _stopped = false;
+      _lost = std::chrono::steady_clock::now();
+      _awaitingAudio = true;
+      _server = _options.clockServer != 0 ? _options.clockServer
+                                          : ClockSync::serverId(endpoint);
+      restoreClock();
+      auto backoff = _options.initialBackoff;
+      while (!_stopped) {
+        if (const auto ec =
+                co_await _tcpClient->connect(endpoint, _options.ioTimeout);
+            !ec) {
+          _connects.fetch_add(1, std::memory_order_relaxed);
+          _sessionAudio = false;
+          co_await session(buffer);
+          _tcpClient->disconnect();
+          saveClock();
+          if (_sessionAudio) {
+            // the connection worked, retry at once
+            _lost = std::chrono::steady_clock::now();
+            _awaitingAudio = true;
+            backoff = _options.initialBackoff;
+            continue;
+          }
+        } else {
+          _tcpClient->disconnect();
+          _failures.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (_stopped) {
+          break;
+        }
+        _timer.expires_after(backoff);
+        co_await _timer.async_wait(boost::asio::as_tuple(handler));
+        backoff = std::min(backoff * 2, _options.maxBackoff);
+      }
+      co_return boost::asio::error::operation_aborted;
+    }
+
+    /**
+     * @brief Stop run(). Closes the connection and ends a backoff wait.
+     *
+     */
+    void stop() {
+      _stopped = true;
+      _timer.cancel();
+      _tcpClient->disconnect();
+    }
+
+    /**
+     * @brief Get the clock offset to the server
+     *
+     * @return The server clock minus the local steady clock. Empty until the
+     * first Time reply or a restored estimate.
+     */
+    [[nodiscard]] auto clockOffset() const
+        -> std::optional<std::chrono::microseconds> {
+      const auto offset = _sync.offset(std::chrono::steady_clock::now());
+      if (!offset) {
+        return std::nullopt;
+      }
+      return std::chrono::microseconds(*offset);
+    }
+
+    /**
+     * @brief Get the clock offset and drift estimate
+     *
+     * @return A reference to the estimate
+     */
+    [[nodiscard]] auto clockSync() const -> const ClockSync& { return _sync; }
+
+    /**
+     * @brief Get the snap client used for the connection, e.g. to set
+     * metrics or a capture sink
+     *
+     * @return A reference to the snap client
+     */
+    [[nodiscard]] auto client() -> SnapClient<Socket>& { return _client; }
+
+    /**
+     * @brief Set the metrics updated by the snap client and by chunks which
+     * could not be scheduled
+     *
+     * @param metrics A pointer to the metrics, null to stop collecting. Must
+     * outlive this object or be reset.
+     */
+    void setMetrics(SessionMetrics* metrics) {
+      _metrics = metrics;
+      _client.setMetrics(metrics);
+    }
+
+    /**
+     * @brief Copy the supervisor statistics. Safe to call from any thread.
+     *
+     * @param out The snapshot to write to
+     */
+    void snapshot(Snapshot& out) const {
+      out.connects = _connects.load(std::memory_order_relaxed);
+      out.failures = _failures.load(std::memory_order_relaxed);
+      out.dropped = _dropped.load(std::memory_order_relaxed);
+      out.rebuilds = _rebuilds.load(std::memory_order_relaxed);
+      out.idleDrops = _idleDrops.load(std::memory_order_relaxed);
+      out.clockRestores = _clockRestores.load(std::memory_order_relaxed);
+      out.clockRejects = _clockRejects.load(std::memory_order_relaxed);
+      out.clockSaveFailures =
+          _clockSaveFailures.load(std::memory_order_relaxed);
+      _timeToFirstAudio.snapshot(out.timeToFirstAudio);
+      out.lastTimeToFirstAudio =
+          _lastTimeToFirstAudio.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get the Allocator object
+     *
+     * @return An allocator using the memory resource of the tcp client.
+     * Frames of coroutines started by this object are allocated with it.
+     */
+    [[nodiscard]] auto getAllocator() const
+        -> std::pmr::polymorphic_allocator<void> {
+      return _tcpClient->getAllocator();
+    }
+
+  private:
+    /**
+     * @brief Serialize the Hello message with the util provider
+     *
+     */
+    void buildHello() {
+      constexpr std::size_t TMP_BUF_SIZE = 512;
+
+      BoostPmrWrapper wrapper(resource());
+      auto object = _client.helloObject(*_utilProvider,
+                                        boost::json::storage_ptr(&wrapper));
+      _serializer->reset(&object);
+      _hello.clear();
+      std::array<char, TMP_BUF_SIZE> tmpBuf{};
+      while (!_serializer->done()) {
+        _hello.append(_serializer->read(tmpBuf.data(), tmpBuf.size()));
+      }
+    }
+
+    /**
+     * @brief Serve one connection until it fails or stop() is called. Reads
+     * here while keepAlive() sends, there is one read and one write in
+     * flight at a time.
+     *
+     * @param buffer The buffer messages are read into and the Hello is sent
+     * from
+     */
+    auto session(std::span<std::byte> buffer) -> boost::asio::awaitable<void> {
+      auto handler = boost::asio::bind_allocator(_tcpClient->getAllocator(),
+                                                 boost::asio::use_awaitable);
+      if (_utilProvider != nullptr) {
+        // the first connection tells the util provider which interface's
+        // MAC address to report
+        buildHello();
+        _utilProvider = nullptr;
+        _serializer = nullptr;
+      }
+      if (!co_await _client.send(0, Hello(_hello), buffer,
+                                 _options.ioTimeout)) {
+        co_return;
+      }
+      _lastRead = std::chrono::steady_clock::now();
+      _nextTime = _lastRead;
+      _probe.reset();
+      _keepAliveRunning = true;
+      _keepAliveDone.expires_at(std::chrono::steady_clock::time_point::max());
+      boost::asio::co_spawn(_tcpClient->getExecutor(), keepAlive(),
+                            [this](const std::exception_ptr&) {
+                              _keepAliveRunning = false;
+                              _keepAliveDone.cancel();
+                            });
+
+      while (!_stopped) {
+        Slab slab;
+        if (auto acquired = _slabs.acquire()) {
+          slab = std::move(*acquired);
+        }
+        auto result = co_await _client.read(slab ? slab.data() : buffer);
+        if (!result &&
+            (result.error() == boost::system::errc::no_buffer_space ||
+             result.error() == boost::system::errc::bad_message)) {
+          // the message was skipped, the next read starts at a header
+          _lastRead = std::chrono::steady_clock::now();
+          _probe.reset();
+          continue;
+        }
+        if (!result) {
+          break;
+        }
+        _lastRead = std::chrono::steady_clock::now();
+        _probe.reset();
+        const auto& [base, message] = *result;
+        if (const auto* time = std::get_if<Time>(&message)) {
+          updateOffset(brilliant::snapcast::clockOffset(base, *time));
+        } else if (const auto* settings =
+                       std::get_if<ServerSettings>(&message)) {
+          updateSettings(*settings);
+          // the idle threshold follows the buffer, keepAlive() rearms
+          _timer.cancel();
+        } else if (const auto* header = std::get_if<CodecHeader>(&message)) {
+          updateCodec(*header);
+        } else if (const auto* chunk = std::get_if<WireChunk>(&message)) {
+          schedule(*chunk, std::move(slab));
+        }
+      }
+
+      // ends a pending write or wait of keepAlive()
+      _tcpClient->disconnect();
+      _timer.cancel();
+      if (_keepAliveRunning) {
+        co_await _keepAliveDone.async_wait(boost::asio::as_tuple(handler));
+      }
+    }
+
+    /**
+     * @brief Send Time messages while the connection is open and drop it
+     * once it is idle. A connection is idle if nothing was read for the idle
+     * threshold after a probe, which is sent once nothing was read for the
+     * threshold.
+     *
+     */
+    auto keepAlive() -> boost::asio::awaitable<void> {
+      auto handler = boost::asio::bind_allocator(_tcpClient->getAllocator(),
+                                                 boost::asio::use_awaitable);
+      while (!_stopped && _tcpClient->isConnected()) {
+        const auto now = std::chrono::steady_clock::now();
+        const auto threshold = idleThreshold();
+        if (_probe && now >= *_probe + threshold) {
+          _idleDrops.fetch_add(1, std::memory_order_relaxed);
+          _tcpClient->disconnect();
+          co_return;
+        }
+        const bool silent = !_probe && now >= _lastRead + threshold;
+        if (silent || now >= _nextTime) {
+          if (silent) {
+            _probe = now;
+          }
+          if (!co_await sendTime()) {
+            _tcpClient->disconnect();
+            co_return;
+          }
+        }
+
+        const auto idleAt = (_probe ? *_probe : _lastRead) + threshold;
+        _timer.expires_at(std::min(idleAt, _nextTime));
+        co_await _timer.async_wait(boost::asio::as_tuple(handler));
+      }
+    }
+
+    /**
+     * @brief Get the longest time the connection may stay silent
+     *
+     * @return idleFraction of the server's buffer, idleTimeout until the
+     * server settings arrive
+     */
+    [[nodiscard]] auto idleThreshold() const
+        -> std::chrono::steady_clock::duration {
+      if (!_buffer) {
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            _options.idleTimeout);
+      }
+      return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          *_buffer * _options.idleFraction);
+    }
+
+    /**
+     * @brief Send a Time message and schedule the next one
+     *
+     * @return True if successful
+     */
+    auto sendTime() -> boost::asio::awaitable<bool> {
+      _nextTime = std::chrono::steady_clock::now() + _options.timeInterval;
+      const auto sent = co_await _client.send(0, Time{}, std::span(_timeBuffer),
+                                              _options.ioTimeout);
+      co_return sent.has_value();
+    }
+
+    /**
+     * @brief Update the clock estimate with a Time reply and save it once
+     * the save interval passed
+     *
+     * @param sample The offset measured by the reply in microseconds
+     */
+    void updateOffset(std::int64_t sample) {
+      const auto now = std::chrono::steady_clock::now();
+      if (!_sync.update(sample, now)) {
+        _clockRejects.fetch_add(1, std::memory_order_relaxed);
+      }
+      if (now >= _lastSave + _options.clockSaveInterval) {
+        saveClock();
+      }
+    }
+
+    /**
+     * @brief Restore the clock estimate from the state file unless there is
+     * an estimate already
+     *
+     */
+    void restoreClock() {
+      if (_options.clockStatePath == nullptr || _sync.confidence() > 0) {
+        return;
+      }
+      const auto state = ClockSync::load(_options.clockStatePath);
+      if (state &&
+          _sync.restore(*state, _server, std::chrono::steady_clock::now())) {
+        _clockRestores.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * @brief Save the clock estimate to the state file if it is confirmed by
+     * enough Time replies. A failed save is counted and retried after the
+     * save interval.
+     *
+     */
+    void saveClock() {
+      if (_options.clockStatePath == nullptr || _sync.validating() ||
+          _sync.confidence() < _options.clockSync.minConfidence) {
+        return;
+      }
+      _lastSave = std::chrono::steady_clock::now();
+      if (ClockSync::save(_options.clockStatePath, _sync.state(_server))) {
+        _clockSaveFailures.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * @brief Read the buffer and latency settings of the server
+     *
+     * @param settings The server settings message
+     */
+    void updateSettings(const ServerSettings& settings) {
+      BoostPmrWrapper wrapper(resource());
+      boost::system::error_code ec;
+      const auto json =
+          boost::json::parse(std::string_view(settings.payload, settings.size),
+                             ec, boost::json::storage_ptr(&wrapper));
+      const auto* object = json.if_object();
+      if (ec || !object) {
+        return;
+      }
+      const auto number = [object](std::string_view key) -> std::int64_t {
+        const auto* value = object->if_contains(key);
+        boost::system::error_code error;
+        const auto result = value ? value->to_number<std::int64_t>(error) : 0;
+        return error ? 0 : result;
+      };
+      // chunks play bufferMs after their timestamp, earlier by the latency
+      // of the client's output
+      _buffer = std::chrono::milliseconds(number("bufferMs"));
+      _delay = *_buffer - std::chrono::milliseconds(number("latency"));
+    }
+
+    /**
+     * @brief Cache a codec header. A header equal to the cached one keeps the
+     * current decoder stream, a new one is prepared with the first chunk
+     * which can be queued.
+     *
+     * @param header The codec header
+     */
+    void updateCodec(const CodecHeader& header) {
+      const std::string_view codec(header.codec, header.codecSize);
+      const std::span<const std::byte> payload(header.payload, header.size);
+      if (_stream && codec == _codec &&
+          std::ranges::equal(payload, _codecPayload)) {
+        return;
+      }
+      _codec.assign(codec);
+      _codecPayload.assign(payload.begin(), payload.end());
+      _hasCodec = true;
+      _stream.reset();
+    }
+
+    /**
+     * @brief Queue a chunk for the decode stage
+     *
+     * @param chunk The chunk
+     * @param slab The slab holding the chunk, empty if it was read into the
+     * run() buffer
+     */
+    void schedule(const WireChunk& chunk, Slab slab) {
+      // a full queue is checked before preparing, a prepared stream always
+      // receives a chunk and the decoder never reports busy
+      const auto offset = _sync.offset(std::chrono::steady_clock::now());
+      if (!slab || !offset || !_delay || !_hasCodec ||
+          _chunks->size() == _chunks->capacity()) {
+        drop();
+        return;
+      }
+      if (!_stream) {
+        const auto stream = _decoder->prepare(
+            CodecHeader(_codec, std::span(_codecPayload)));
+        if (!stream) {
+          drop();
+          return;
+        }
+        _stream = *stream;
+        _rebuilds.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      const auto local = toSignedMicroseconds(chunk.timestamp) - *offset;
+      StreamChunk queued{
+          *_stream,
+          std::chrono::steady_clock::time_point(
+              std::chrono::microseconds(local)) +
+              *_delay,
+          std::span<const std::byte>(chunk.payload, chunk.size),
+          std::move(slab)};
+      if (!_chunks->tryPush(queued)) {
+        drop();
+        return;
+      }
+      _sessionAudio = true;
+      if (_awaitingAudio) {
+        _awaitingAudio = false;
+        const auto elapsed =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - _lost);
+        const auto micros = static_cast<std::uint64_t>(elapsed.count());
+        _timeToFirstAudio.record(micros);
+        _lastTimeToFirstAudio.store(micros, std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * @brief Count a chunk which could not be scheduled
+     *
+     */
+    void drop() {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      if (_metrics) {
+        _metrics->droppedChunk();
+      }
+    }
+
+    /**
+     * @brief Get the memory resource of the tcp client
+     *
+     * @return A pointer to the memory resource
+     */
+    [[nodiscard]] auto resource() const -> std::pmr::memory_resource* {
+      return _tcpClient->getAllocator().resource();
+    }
+
+    /// Pointer to the tcp client
+    TcpClient<Socket>* _tcpClient;
+
+    /// Used to send and read messages
+    SnapClient<Socket> _client;
+
+    /// Pointer to the decoder
+    StreamDecoder* _decoder;
+
+    /// Pointer to the input queue of the decode stage
+    StageQueue<StreamChunk>* _chunks;
+
+    /// Reconnect options
+    ReconnectOptions _options;
+
+    /// Slabs messages are read into, chunks keep theirs until decoded
+    SlabPool _slabs;
+
+    /// Clock offset and drift estimate, outlives connections
+    ClockSync _sync;
+
+    /// Identity of the server for the clock state file
+    std::uint64_t _server{};
+
+    /// Time the clock estimate was last saved
+    std::chrono::steady_clock::time_point _lastSave;
+
+    /// Backoff timer, times Time messages while connected
+    boost::asio::steady_timer _timer;
+
+    /// Cancelled when keepAlive() returns
+    boost::asio::steady_timer _keepAliveDone;
+
+    /// Set while keepAlive() runs
+    bool _keepAliveRunning{};
+
+    /// The serialized Hello json
+    std::pmr::string _hello;
+
+    /// Pointer to the util provider until the first connection
+    UtilProvider* _utilProvider{};
+
+    /// Pointer to the json serializer until the first connection
+    boost::json::serializer* _serializer{};
+
+    /// Buffer of outgoing Time messages
+    std::array<std::byte, FRAME_SIZE<Time>> _timeBuffer{};
+
+    /// Time the next Time message is due
+    std::chrono::steady_clock::time_point _nextTime;
+
+    /// Time the last message was read
+    std::chrono::steady_clock::time_point _lastRead;
+
+    /// Time the probe of a silent connection was sent, empty if none is
+    /// outstanding
+    std::optional<std::chrono::steady_clock::time_point> _probe;
+
+    /// Buffer of the server
+    std::optional<std::chrono::milliseconds> _buffer;
+
+    /// Time from a chunk's timestamp to its playout
+    std::optional<std::chrono::milliseconds> _delay;
+
+    /// Codec string of the cached header
+    std::pmr::string _codec;
+
+    /// Codec payload of the cached header
+    std::pmr::vector<std::byte> _codecPayload;
+
+    /// Set once a codec header was received
+    bool _hasCodec{};
+
+    /// Decoder stream of the cached header, empty until it is prepared
+    std::optional<std::uint32_t> _stream;
+
+    /// Time the connection was lost or run() started
+    std::chrono::steady_clock::time_point _lost;
+
+    /// Set until the first chunk after _lost is queued
+    bool _awaitingAudio{};
+
+    /// Set once the current connection queued a chunk
+    bool _sessionAudio{};
+
+    /// Set by stop()
+    bool _stopped{};
+
+    /// Number of established connections
+    std::atomic<std::uint64_t> _connects{};
+
+    /// Number of failed connection attempts
+    std::atomic<std::uint64_t> _failures{};
+
+    /// Number of chunks which could not be scheduled
+    std::atomic<std::uint64_t> _dropped{};
+
+    /// Pointer to the metrics, may be null
+    SessionMetrics* _metrics{};
+
+    /// Number of prepared decoder streams
+    std::atomic<std::uint64_t> _rebuilds{};
+
+    /// Number of connections dropped because they were idle
+    std::atomic<std::uint64_t> _idleDrops{};
+
+    /// Number of clock estimates restored from the state file
+    std::atomic<std::uint64_t> _clockRestores{};
+
+    /// Number of restored clock estimates discarded by a Time reply
+    std::atomic<std::uint64_t> _clockRejects{};
+
+    /// Number of failed saves of the clock estimate
+    std::atomic<std::uint64_t> _clockSaveFailures{};
+
+    /// Time to first audio in microseconds
+    Histogram _timeToFirstAudio;
+
+    /// The most recent time to first audio in microseconds
+    std::atomic<std::uint64_t> _lastTimeToFirstAudio{};
+  };
+
+}  // namespace brilliant::snapcast
+
+#if BRILLIANT_SNAPCAST_PMR_FRAMES
+/**
+ * @brief Allocate the frames of ReconnectSupervisor coroutines from the memory
+ * resource of its tcp client
+ *
+ */
+// NOLINTBEGIN(cert-dcl58-cpp)
+template <class T, class Executor, class Socket, class... Args>
+struct std::coroutine_traits<
+    boost::asio::awaitable<T, Executor>,
+    brilliant::snapcast::ReconnectSupervisor<Socket>&, Args...> {
+  /// Type alias for the promise type
+  using promise_type = brilliant::snapcast::PmrAwaitableFrame<
+      T, Executor, brilliant::snapcast::ReconnectSupervisor<Socket>, Args...>;
+};
+// NOLINTEND(cert-dcl58-cpp)
+#endif
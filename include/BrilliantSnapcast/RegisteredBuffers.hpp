@@ -0,0 +1,126 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <cstddef>
+#include <iterator>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief Splits user provided storage into equally sized receive buffers
+   * and registers them with an io_context. When Boost.Asio is built with the
+   * io_uring backend (BOOST_ASIO_HAS_IO_URING) reads into a registered buffer
+   * are submitted as fixed buffer operations, avoiding the per read page
+   * mapping done by the kernel. With other backends the registration has no
+   * effect and reads behave like reads into a regular buffer.
+   *
+   */
+  class RegisteredBuffers {
+  public:
+    /// Type alias for the allocator used for the registration
+    using allocator_type =
+        std::pmr::polymorphic_allocator<boost::asio::mutable_buffer>;
+
+    /// Type alias for the buffer sequence which is registered
+    using sequence_type = std::pmr::vector<boost::asio::mutable_buffer>;
+
+    /// Type alias for the registration
+    using registration_type =
+        boost::asio::buffer_registration<sequence_type, allocator_type>;
+
+    /**
+     * @brief Construct a new Registered Buffers object
+     *
+     * @param context The io_context the buffers are registered with
+     * @param storage The storage to split into buffers. Must outlive this
+     * object.
+     * @param count The number of buffers. 0 registers no buffers
+     * @param mr A pointer to the memory resource used for the registration
+     */
+    RegisteredBuffers(boost::asio::io_context& context,
+                      std::span<std::byte> storage, std::size_t count,
+                      std::pmr::memory_resource* mr)
+        : _storage(storage),
+          _bufferSize(bufferSize(storage, count)),
+          _registration(boost::asio::register_buffers(
+              context, makeSequence(storage, count, mr), allocator_type(mr))) {
+    }
+
+    /**
+     * @brief Get the number of registered buffers
+     *
+     * @return The number of buffers
+     */
+    [[nodiscard]] auto size() const -> std::size_t {
+      return _registration.size();
+    }
+
+    /**
+     * @brief Get a registered buffer
+     *
+     * @param i The index of the buffer
+     * @return The registered buffer. Can be passed to TcpClient::read and
+     * SnapClient::read.
+     */
+    [[nodiscard]] auto operator[](std::size_t i) const
+        -> boost::asio::mutable_registered_buffer {
+      return *std::next(_registration.begin(),
+                        static_cast<std::ptrdiff_t>(i));
+    }
+
+    /**
+     * @brief Get a view of a registered buffer's storage
+     *
+     * @param i The index of the buffer
+     * @return A view of the buffer's bytes
+     */
+    [[nodiscard]] auto span(std::size_t i) const -> std::span<std::byte> {
+      return _storage.subspan(i * _bufferSize, _bufferSize);
+    }
+
+  private:
+    /**
+     * @brief Get the size of each buffer
+     *
+     * @param storage The storage to split
+     * @param count The number of buffers
+     * @return The buffer size, 0 if there are no buffers
+     */
+    static auto bufferSize(std::span<std::byte> storage, std::size_t count)
+        -> std::size_t {
+      return count == 0 ? 0 : std::size(storage) / count;
+    }
+
+    /**
+     * @brief Create the buffer sequence to register
+     *
+     * @param storage The storage to split
+     * @param count The number of buffers
+     * @param mr A pointer to the memory resource for the sequence
+     * @return The buffer sequence
+     */
+    static auto makeSequence(std::span<std::byte> storage, std::size_t count,
+                             std::pmr::memory_resource* mr) -> sequence_type {
+      const auto size = bufferSize(storage, count);
+      sequence_type sequence(mr);
+      sequence.reserve(count);
+      for (std::size_t i = 0; i < count; ++i) {
+        sequence.emplace_back(storage.data() + (i * size), size);
+      }
+      return sequence;
+    }
+
+    /// The registered storage
+    std::span<std::byte> _storage;
+
+    /// The size of a single buffer
+    std::size_t _bufferSize;
+
+    /// The registration
+    registration_type _registration;
+  };
+
+}  // namespace brilliant::snapcast
@@ -0,0 +1,292 @@
+#pragma once
+
+// replays capture files, which need POSIX file APIs
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <utility>
+
+#include "BrilliantSnapcast/Capture.hpp"
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief Replay pacing
+   *
+   */
+  enum class ReplayMode : std::uint8_t {
+    /// Deliver every record as soon as it is read
+    FAST,
+
+    /// Deliver records with the time between them as originally received
+    REALTIME
+  };
+
+  /**
+   * @brief A socket which replays a memory mapped capture. Usable as the
+   * Socket parameter of TcpClient. Reads copy directly from the mapping into
+   * the read buffer, there is no intermediate buffering and no system call per
+   * read. Writes are discarded.
+   *
+   * @tparam Protocol The protocol type reported by the socket
+   * @tparam Executor The executor type
+   */
+  template <class Protocol = boost::asio::ip::tcp,
+            class Executor = boost::asio::any_io_executor>
+  class ReplaySocket {
+  public:
+    /// Type alias for the protocol
+    using protocol_type = Protocol;
+
+    /// Type alias for the executor
+    using executor_type = Executor;
+
+    /**
+     * @brief Construct a new Replay Socket object
+     *
+     * @param exec The executor used for completions
+     * @param capture The capture to replay. Must outlive this object.
+     * @param mode Replay pacing
+     * @param offset The offset of the first record to replay, see
+     * CaptureFile::seek()
+     */
+    ReplaySocket(Executor exec, const CaptureFile& capture, ReplayMode mode,
+                 std::size_t offset = CaptureFile::begin())
+        : _timer(exec), _capture(&capture), _mode(mode), _offset(offset) {}
+
+    /**
+     * @brief Get the executor
+     *
+     * @return The executor
+     */
+    [[nodiscard]] auto get_executor() -> executor_type {
+      return _timer.get_executor();
+    }
+
+    /**
+     * @brief Check if the socket is open. The socket is open until close() is
+     * called.
+     *
+     * @return True if open
+     */
+    [[nodiscard]] auto is_open() const -> bool { return _open; }
+
+    /**
+     * @brief Close the socket. Pending reads complete with operation_aborted.
+     *
+     */
+    void close() {
+      _open = false;
+      _timer.cancel();
+    }
+
+    /**
+     * @brief Cancel a read waiting for its record's due time, it completes
+     * with operation_aborted
+     *
+     * @param ec Set to indicate what error occurred, if any
+     */
+    void cancel(boost::system::error_code& ec) {
+      _timer.cancel();
+      ec = {};
+    }
+
+    /**
+     * @brief Connect. Always succeeds immediately.
+     *
+     * @tparam Endpoint The endpoint type
+     * @tparam Handler The completion token type
+     * @param handler The completion token
+     * @return Depends on the completion token
+     */
+    template <class Endpoint, class Handler>
+    auto async_connect(const Endpoint& /*endpoint*/, Handler&& handler) {
+      return boost::asio::async_initiate<Handler,
+                                         void(boost::system::error_code)>(
+          [this](auto h) {
+            _open = true;
+            boost::asio::post(get_executor(),
+                              std::bind(std::move(h),
+                                        boost::system::error_code{}));
+          },
+          handler);
+    }
+
+    /**
+     * @brief Read replayed bytes. Completes with at most the bytes remaining in
+     * the current record.
+     *
+     * @tparam Buffers The buffer sequence type
+     * @tparam Handler The completion token type
+     * @param buffers The buffers to read into
+     * @param handler The completion token
+     * @return Depends on the completion token
+     */
+    template <class Buffers, class Handler>
+    auto async_read_some(const Buffers& buffers, Handler&& handler) {
+      return boost::asio::async_initiate<
+          Handler, void(boost::system::error_code, std::size_t)>(
+          [this](auto h, const Buffers& bufs) {
+            startRead(std::move(h), bufs);
+          },
+          handler, buffers);
+    }
+
+    /**
+     * @brief Write bytes. The bytes are discarded.
+     *
+     * @tparam Buffers The buffer sequence type
+     * @tparam Handler The completion token type
+     * @param buffers The buffers to write
+     * @param handler The completion token
+     * @return Depends on the completion token
+     */
+    template <class Buffers, class Handler>
+    auto async_write_some(const Buffers& buffers, Handler&& handler) {
+      return boost::asio::async_initiate<
+          Handler, void(boost::system::error_code, std::size_t)>(
+          [this](auto h, const Buffers& bufs) {
+            boost::asio::post(get_executor(),
+                              std::bind(std::move(h),
+                                        boost::system::error_code{},
+                                        boost::asio::buffer_size(bufs)));
+          },
+          handler, buffers);
+    }
+
+  private:
+    /**
+     * @brief Start a read, waiting for the record's due time in REALTIME mode.
+     * Emitting the cancellation slot associated with the handler ends the
+     * wait with operation_aborted.
+     *
+     * @tparam Handler The handler type
+     * @tparam Buffers The buffer sequence type
+     * @param handler The completion handler
+     * @param buffers The buffers to read into
+     */
+    template <class Handler, class Buffers>
+    void startRead(Handler handler, const Buffers& buffers) {
+      auto rec = _capture->at(_offset);
+      if (!rec) {
+        boost::asio::post(get_executor(),
+                          std::bind(std::move(handler),
+                                    boost::asio::error::make_error_code(
+                                        boost::asio::error::eof),
+                                    std::size_t{0}));
+        return;
+      }
+
+      if (_mode == ReplayMode::REALTIME && _position == 0) {
+        const auto now = std::chrono::steady_clock::now();
+        if (!_started) {
+          _started = true;
+          _start = now;
+          _firstTimestamp = rec->timestamp;
+        }
+        const auto due = _start + std::chrono::microseconds(
+                                      rec->timestamp - _firstTimestamp);
+        if (due > now) {
+          if (auto slot =
+                  boost::asio::get_associated_cancellation_slot(handler);
+              slot.is_connected()) {
+            // a late emit finds another wait or none and has no effect
+            slot.assign([this, wait = _waits + 1](
+                            boost::asio::cancellation_type /*type*/) {
+              if (_waits == wait) {
+                boost::system::error_code ignored;
+                cancel(ignored);
+              }
+            });
+          }
+          ++_waits;
+          _timer.expires_at(due);
+          _timer.async_wait(
+              [this, handler = std::move(handler),
+               buffers](boost::system::error_code ec) mutable {
+                if (ec || !_open) {
+                  std::move(handler)(boost::asio::error::make_error_code(
+                                         boost::asio::error::operation_aborted),
+                                     std::size_t{0});
+                  return;
+                }
+                complete(std::move(handler), buffers);
+              });
+          return;
+        }
+      }
+
+      boost::asio::post(get_executor(),
+                        [this, handler = std::move(handler), buffers] mutable {
+                          complete(std::move(handler), buffers);
+                        });
+    }
+
+    /**
+     * @brief Copy bytes of the current record into the buffers and invoke the
+     * handler
+     *
+     * @tparam Handler The handler type
+     * @tparam Buffers The buffer sequence type
+     * @param handler The completion handler
+     * @param buffers The buffers to read into
+     */
+    template <class Handler, class Buffers>
+    void complete(Handler handler, const Buffers& buffers) {
+      if (!_open) {
+        std::move(handler)(boost::asio::error::make_error_code(
+                               boost::asio::error::operation_aborted),
+                           std::size_t{0});
+        return;
+      }
+
+      auto rec = _capture->at(_offset);
+      const auto remaining = rec->bytes.subspan(_position);
+      const auto n = boost::asio::buffer_copy(
+          buffers, boost::asio::buffer(remaining.data(), remaining.size()));
+      _position += n;
+      if (_position == rec->bytes.size()) {
+        _offset = rec->next;
+        _position = 0;
+      }
+      std::move(handler)(boost::system::error_code{}, n);
+    }
+
+    /// Timer used for pacing, also provides the executor
+    boost::asio::steady_timer _timer;
+
+    /// The capture
+    const CaptureFile* _capture;
+
+    /// Replay pacing
+    ReplayMode _mode;
+
+    /// Offset of the current record
+    std::size_t _offset;
+
+    /// Bytes of the current record already delivered
+    std::size_t _position{};
+
+    /// Set by connect, cleared by close
+    bool _open{true};
+
+    /// Set once the first record was delivered in REALTIME mode
+    bool _started{};
+
+    /// Time the first record was delivered
+    std::chrono::steady_clock::time_point _start{};
+
+    /// Timestamp of the first record
+    std::uint64_t _firstTimestamp{};
+
+    /// Number of started waits for a due time, identifies the pending wait
+    std::size_t _waits{};
+  };
+
+}  // namespace brilliant::snapcast
+
+#endif
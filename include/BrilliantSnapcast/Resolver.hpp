@@ -0,0 +1,626 @@
+#pragma once
+
+// the configuration is read and the query ids are drawn with POSIX calls
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <fcntl.h>
+#if defined(__linux__)
+#include <sys/random.h>
+#endif
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <boost/asio.hpp>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <expected>
+#include <memory_resource>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BrilliantSnapcast/CoroutineFrame.hpp"
+#include "BrilliantSnapcast/DnsMessage.hpp"
+
+namespace brilliant::snapcast {
+  class Resolver;
+}  // namespace brilliant::snapcast
+
+#if BRILLIANT_SNAPCAST_PMR_FRAMES
+/**
+ * @brief Allocate the frames of Resolver coroutines from its memory resource.
+ * Declared before the class, whose member coroutines use it.
+ *
+ */
+// NOLINTBEGIN(cert-dcl58-cpp)
+template <class T, class Executor, class... Args>
+struct std::coroutine_traits<boost::asio::awaitable<T, Executor>,
+                             brilliant::snapcast::Resolver&, Args...> {
+  /// Type alias for the promise type
+  using promise_type = brilliant::snapcast::PmrAwaitableFrame<
+      T, Executor, brilliant::snapcast::Resolver, Args...>;
+};
+// NOLINTEND(cert-dcl58-cpp)
+#endif
+
+namespace brilliant::snapcast {
+
+  namespace detail {
+    /// Longest accepted address string, an IPv6 address with a scope id
+    inline constexpr std::size_t MAX_ADDRESS_LENGTH = 63;
+
+    /**
+     * @brief Parse an IP address without allocating
+     *
+     * @param text The address string
+     * @return The address, empty if the text is no address
+     */
+    inline auto parseAddress(std::string_view text)
+        -> std::optional<boost::asio::ip::address> {
+      // copy to a stack buffer to guarantee a trailing 0 without allocating
+      std::array<char, MAX_ADDRESS_LENGTH + 1> str{};
+      if (text.empty() || text.size() > MAX_ADDRESS_LENGTH) {
+        return std::nullopt;
+      }
+      std::ranges::copy(text, str.begin());
+      boost::system::error_code ec{};
+      auto address = boost::asio::ip::make_address(str.data(), ec);
+      if (ec) {
+        return std::nullopt;
+      }
+      return address;
+    }
+
+    /**
+     * @brief Split the next whitespace separated token off a line
+     *
+     * @param line The line, the token and the whitespace before it are
+     * removed
+     * @return The token, empty at the end of the line
+     */
+    inline auto nextToken(std::string_view& line) -> std::string_view {
+      constexpr std::string_view SPACE = " \t\r";
+      const auto begin = line.find_first_not_of(SPACE);
+      if (begin == std::string_view::npos) {
+        line = {};
+        return {};
+      }
+      line.remove_prefix(begin);
+      const auto end = std::min(line.find_first_of(SPACE), line.size());
+      const auto token = line.substr(0, end);
+      line.remove_prefix(end);
+      return token;
+    }
+
+    /**
+     * @brief Call a function with every line of a text, without the comment
+     * starting at a '#' or ';'
+     *
+     * @param text The text
+     * @param f Called with each line
+     */
+    inline void forEachLine(std::string_view text, auto&& f) {
+      while (!text.empty()) {
+        const auto end = std::min(text.find('\n'), text.size());
+        auto line = text.substr(0, end);
+        line = line.substr(0, line.find_first_of("#;"));
+        f(line);
+        text.remove_prefix(std::min(end + 1, text.size()));
+      }
+    }
+
+    /**
+     * @brief Compare two host names, ignoring ASCII case
+     *
+     * @return True if the names are equal
+     */
+    inline auto equalNames(std::string_view a, std::string_view b) -> bool {
+      const auto lower = [](char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+      };
+      return std::ranges::equal(a, b, [&lower](char x, char y) {
+        return lower(x) == lower(y);
+      });
+    }
+
+    /**
+     * @brief Read a whole file with POSIX calls
+     *
+     * @param path The file path
+     * @param out The content is appended to this string
+     * @return An error_code, empty if successful
+     */
+    inline auto readFile(const char* path, std::pmr::string& out)
+        -> boost::system::error_code {
+      const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        return {errno, boost::system::system_category()};
+      }
+      constexpr std::size_t CHUNK = 512;
+      std::array<char, CHUNK> chunk{};
+      boost::system::error_code ec{};
+      while (true) {
+        const auto n = ::read(fd, chunk.data(), chunk.size());
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n < 0) {
+          ec = {errno, boost::system::system_category()};
+        }
+        if (n <= 0) {
+          break;
+        }
+        out.append(chunk.data(), static_cast<std::size_t>(n));
+      }
+      ::close(fd);
+      return ec;
+    }
+
+    /**
+     * @brief Draw a DNS query id from the system's CSPRNG, so an off-path
+     * attacker cannot predict it
+     *
+     * @return The id
+     */
+    inline auto randomDnsId() -> std::uint16_t {
+      std::uint16_t id{};
+#if defined(__linux__)
+      ssize_t n = 0;
+      do {
+        n = ::getrandom(&id, sizeof(id), 0);
+      } while (n < 0 && errno == EINTR);
+      if (n != static_cast<ssize_t>(sizeof(id))) {
+        // kernels without getrandom, the library reads /dev/urandom
+        std::random_device device;
+        id = static_cast<std::uint16_t>(device());
+      }
+#else
+      ::arc4random_buf(&id, sizeof(id));
+#endif
+      return id;
+    }
+  }  // namespace detail
+
+  /**
+   * @brief Where and how a Resolver looks up names, usually loaded from
+   * /etc/resolv.conf and /etc/hosts with load()
+   *
+   */
+  struct ResolverConfig {
+    /// Servers resolv.conf lists at most, further servers are ignored
+    static constexpr std::size_t MAX_NAMESERVERS = 3;
+
+    /// Port of DNS servers
+    static constexpr boost::asio::ip::port_type DNS_PORT = 53;
+
+    /**
+     * @brief Construct a new Resolver Config object without servers or hosts
+     *
+     * @param mr A pointer to the memory resource
+     */
+    explicit ResolverConfig(std::pmr::memory_resource* mr)
+        : nameservers(mr), hosts(mr) {}
+
+    /// Servers queried in order, may use any port, e.g. a local stub
+    std::pmr::vector<boost::asio::ip::udp::endpoint> nameservers;
+
+    /// Text of a hosts file, searched before any server is queried
+    std::pmr::string hosts;
+
+    /// Time to wait for the answers of one server, "options timeout:n"
+    std::chrono::steady_clock::duration timeout{std::chrono::seconds(5)};
+
+    /// Rounds over all servers before giving up, "options attempts:n"
+    unsigned attempts{2};
+
+    /**
+     * @brief Apply the nameserver and options lines of a resolv.conf file.
+     * Search domains, sortlist and other options are ignored.
+     *
+     * @param text The file content
+     */
+    void parseResolvConf(std::string_view text) {
+      detail::forEachLine(text, [this](std::string_view line) {
+        const auto keyword = detail::nextToken(line);
+        if (keyword == "nameserver") {
+          const auto address = detail::parseAddress(detail::nextToken(line));
+          if (address && nameservers.size() < MAX_NAMESERVERS) {
+            nameservers.emplace_back(*address, DNS_PORT);
+          }
+        } else if (keyword == "options") {
+          for (auto option = detail::nextToken(line); !option.empty();
+               option = detail::nextToken(line)) {
+            parseOption(option);
+          }
+        }
+      });
+    }
+
+    /**
+     * @brief Load the system configuration. Like the C library, a missing
+     * resolv.conf queries a server on the local host and a missing hosts file
+     * is treated as empty.
+     *
+     * @param mr A pointer to the memory resource
+     * @param resolvConfPath The resolv.conf file
+     * @param hostsPath The hosts file
+     * @return The configuration
+     */
+    static auto load(std::pmr::memory_resource* mr,
+                     const char* resolvConfPath = "/etc/resolv.conf",
+                     const char* hostsPath = "/etc/hosts") -> ResolverConfig {
+      ResolverConfig config(mr);
+      std::pmr::string resolvConf(mr);
+      if (!detail::readFile(resolvConfPath, resolvConf)) {
+        config.parseResolvConf(resolvConf);
+      }
+      if (config.nameservers.empty()) {
+        config.nameservers.emplace_back(
+            boost::asio::ip::address_v4::loopback(), DNS_PORT);
+      }
+      if (detail::readFile(hostsPath, config.hosts)) {
+        config.hosts.clear();
+      }
+      return config;
+    }
+
+  private:
+    /**
+     * @brief Apply a timeout:n or attempts:n option
+     *
+     * @param option The option
+     */
+    void parseOption(std::string_view option) {
+      const auto colon = option.find(':');
+      if (colon == std::string_view::npos) {
+        return;
+      }
+      const auto name = option.substr(0, colon);
+      const auto value = option.substr(colon + 1);
+      unsigned n = 0;
+      const auto [end, ec] =
+          std::from_chars(value.data(), value.data() + value.size(), n);
+      if (ec != std::errc{} || n == 0) {
+        return;
+      }
+      // the C library's limits
+      constexpr unsigned MAX_TIMEOUT = 30;
+      constexpr unsigned MAX_ATTEMPTS = 5;
+      if (name == "timeout") {
+        timeout = std::chrono::seconds(std::min(n, MAX_TIMEOUT));
+      } else if (name == "attempts") {
+        attempts = std::min(n, MAX_ATTEMPTS);
+      }
+    }
+  };
+
+  /**
+   * @brief Find the addresses of a name in a hosts file
+   *
+   * @param hosts The text of the hosts file
+   * @param name The host name, compared ignoring case
+   * @param out The addresses of every matching line are appended to this
+   * vector
+   */
+  inline void findHosts(std::string_view hosts, std::string_view name,
+                        std::pmr::vector<boost::asio::ip::address>& out) {
+    detail::forEachLine(hosts, [name, &out](std::string_view line) {
+      const auto address = detail::parseAddress(detail::nextToken(line));
+      if (!address) {
+        return;
+      }
+      for (auto alias = detail::nextToken(line); !alias.empty();
+           alias = detail::nextToken(line)) {
+        if (detail::equalNames(alias, name)) {
+          out.push_back(*address);
+          return;
+        }
+      }
+    });
+  }
+
+  /**
+   * @brief Resolves host names to TCP endpoints. Every allocation, the
+   * coroutine frames, the handlers of the UDP socket and the results, is
+   * made from the provided memory resource.
+   *
+   * Names are looked up as IP literals, in the hosts file and finally by
+   * sending A and AAAA queries to the configured servers over UDP. Both
+   * queries are in flight at once; a server which does not answer both
+   * within the timeout is skipped, as is a server which truncates its
+   * answer. The results are ordered for happy eyeballs, alternating IPv6 and
+   * IPv4 addresses starting with IPv6, see TcpClient::connect(std::span,
+   * duration).
+   *
+   * Against off-path spoofing every server is asked from a new socket, with
+   * a new source port, the query ids are random and only responses from the
+   * server which echo the id and the question of a query are accepted.
+   *
+   * One resolve may be in flight at a time.
+   *
+   */
+  class Resolver {
+  public:
+    /// Type alias for the resolved endpoints
+    using endpoints_type = std::pmr::vector<boost::asio::ip::tcp::endpoint>;
+
+    /**
+     * @brief Construct a new Resolver object
+     *
+     * @param executor The executor of the UDP socket
+     * @param config The servers and hosts, see ResolverConfig::load()
+     * @param mr A pointer to the memory resource
+     */
+    Resolver(const boost::asio::any_io_executor& executor,
+             ResolverConfig config, std::pmr::memory_resource* mr)
+        : _config(std::move(config)),
+          _alloc(mr),
+          _socket(executor),
+          _timer(executor) {}
+
+    /**
+     * @brief Resolve a host name
+     *
+     * @param host The host name or an IP address
+     * @param port The port of the endpoints
+     * @return The endpoints in the order they should be tried or an
+     * error_code. host_not_found if the name does not exist, no_data if it
+     * has no addresses, timed_out if no server answered.
+     */
+    auto resolve(std::string_view host, boost::asio::ip::port_type port)
+        -> boost::asio::awaitable<
+            std::expected<endpoints_type, boost::system::error_code>> {
+      std::pmr::vector<boost::asio::ip::address> addresses(_alloc.resource());
+      if (auto literal = detail::parseAddress(host)) {
+        addresses.push_back(*literal);
+      } else {
+        findHosts(_config.hosts, host, addresses);
+      }
+      if (addresses.empty()) {
+        const auto ec = co_await query(host, addresses);
+        if (ec) {
+          co_return std::unexpected(ec);
+        }
+      }
+      co_return order(addresses, port);
+    }
+
+    /**
+     * @brief Get the configuration
+     *
+     * @return The servers and hosts
+     */
+    [[nodiscard]] auto config() const -> const ResolverConfig& {
+      return _config;
+    }
+
+    /**
+     * @brief Get the Allocator object
+     *
+     * @return A reference to the allocator used for async operations
+     */
+    [[nodiscard]] auto getAllocator()
+        -> std::pmr::polymorphic_allocator<void>& {
+      return _alloc;
+    }
+
+  private:
+    /**
+     * @brief Ask the servers in turn until one answers
+     *
+     * @param host The host name
+     * @param out The addresses are appended to this vector, only those of
+     * the server which answered
+     * @return An error_code, empty if a server answered with addresses
+     */
+    auto query(std::string_view host,
+               std::pmr::vector<boost::asio::ip::address>& out)
+        -> boost::asio::awaitable<boost::system::error_code> {
+      boost::system::error_code last = boost::asio::error::host_not_found;
+      const auto start = out.size();
+      for (unsigned attempt = 0; attempt < _config.attempts; ++attempt) {
+        for (const auto& server : _config.nameservers) {
+          // a server which failed may have answered one of the queries
+          out.resize(start);
+          last = co_await ask(server, host, out);
+          // another server gives the same answer
+          if (!last || last == boost::asio::error::host_not_found ||
+              last == boost::asio::error::no_data ||
+              last == boost::asio::error::invalid_argument) {
+            co_return last;
+          }
+        }
+      }
+      co_return last;
+    }
+
+    /**
+     * @brief Send the A and AAAA queries to a server and wait for both
+     * answers
+     *
+     * @param server The server
+     * @param host The host name
+     * @param out The addresses are appended to this vector
+     * @return An error_code, empty if the server answered with addresses.
+     * Empty as well if the server answered one query with addresses and the
+     * other timed out.
+     */
+    auto ask(const boost::asio::ip::udp::endpoint& server,
+             std::string_view host,
+             std::pmr::vector<boost::asio::ip::address>& out)
+        -> boost::asio::awaitable<boost::system::error_code> {
+      const auto found = out.size();
+      boost::system::error_code ec{};
+      _socket.close(ec);
+      _socket.open(server.protocol(), ec);
+      if (ec) {
+        co_return ec;
+      }
+
+      constexpr std::array<DnsType, 2> TYPES{DnsType::AAAA, DnsType::A};
+      std::array<std::size_t, 2> sizes{};
+      for (std::size_t i = 0; i < TYPES.size(); ++i) {
+        auto size = encodeDnsQuery(detail::randomDnsId(), host, TYPES.at(i),
+                                   std::span(_queries.at(i)));
+        if (!size) {
+          co_return size.error();
+        }
+        sizes.at(i) = *size;
+      }
+
+      auto handler =
+          boost::asio::bind_allocator(_alloc, boost::asio::use_awaitable);
+      arm(_config.timeout);
+      for (std::size_t i = 0; i < TYPES.size() && !ec; ++i) {
+        std::tie(ec, std::ignore) = co_await _socket.async_send_to(
+            boost::asio::buffer(_queries.at(i).data(), sizes.at(i)), server,
+            boost::asio::as_tuple(handler));
+      }
+
+      std::array<bool, 2> answered{};
+      while (!ec && !(answered[0] && answered[1])) {
+        std::size_t size = 0;
+        std::tie(ec, size) = co_await _socket.async_receive_from(
+            boost::asio::buffer(_response), _sender,
+            boost::asio::as_tuple(handler));
+        if (ec || _sender != server) {
+          continue;
+        }
+        const auto response = std::span(_response).first(size);
+        // anything but the answer to one of the queries is dropped
+        const auto answers = [&](std::size_t i) {
+          return dnsAnswers(response,
+                            std::span(_queries.at(i)).first(sizes.at(i)));
+        };
+        std::size_t index = 0;
+        while (index < TYPES.size() && !answers(index)) {
+          ++index;
+        }
+        if (index == TYPES.size() || answered.at(index)) {
+          continue;
+        }
+        answered.at(index) = true;
+        ec = decodeDnsResponse(response, out);
+      }
+      disarm(ec);
+      boost::system::error_code ignored;
+      _socket.close(ignored);
+      if (ec == boost::asio::error::timed_out && out.size() != found) {
+        ec = {};
+      }
+      if (!ec && out.size() == found) {
+        ec = boost::asio::error::no_data;
+      }
+      co_return ec;
+    }
+
+    /**
+     * @brief Order addresses for happy eyeballs, alternating the families
+     * starting with IPv6 and keeping the order within each family
+     *
+     * @param addresses The addresses
+     * @param port The port of the endpoints
+     * @return The endpoints
+     */
+    auto order(const std::pmr::vector<boost::asio::ip::address>& addresses,
+               boost::asio::ip::port_type port) -> endpoints_type {
+      endpoints_type result(_alloc.resource());
+      result.reserve(addresses.size());
+      auto v6 = addresses.begin();
+      auto v4 = addresses.begin();
+      const auto next = [&addresses](auto it, bool isV6) {
+        return std::find_if(it, addresses.end(), [isV6](const auto& a) {
+          return a.is_v6() == isV6;
+        });
+      };
+      v6 = next(v6, true);
+      v4 = next(v4, false);
+      while (v6 != addresses.end() || v4 != addresses.end()) {
+        if (v6 != addresses.end()) {
+          result.emplace_back(*v6, port);
+          v6 = next(v6 + 1, true);
+        }
+        if (v4 != addresses.end()) {
+          result.emplace_back(*v4, port);
+          v4 = next(v4 + 1, false);
+        }
+      }
+      return result;
+    }
+
+    /**
+     * @brief Start the timer of a query. Its handler is allocated with the
+     * allocator of this object and cancels the socket once the timer
+     * expires.
+     *
+     * @param timeout The longest time the query may take
+     */
+    void arm(std::chrono::steady_clock::duration timeout) {
+      _expired = false;
+      _timer.expires_after(timeout);
+      _timer.async_wait(boost::asio::bind_allocator(
+          _alloc, [this, generation = _generation](
+                      const boost::system::error_code& ec) {
+            if (!ec && generation == _generation) {
+              _expired = true;
+              boost::system::error_code ignored;
+              _socket.cancel(ignored);
+            }
+          }));
+    }
+
+    /**
+     * @brief Stop the timer of a completed query
+     *
+     * @param ec The result of the query, operation_aborted becomes
+     * timed_out if the timer expired
+     */
+    void disarm(boost::system::error_code& ec) {
+      ++_generation;
+      _timer.cancel();
+      if (_expired && ec == boost::asio::error::operation_aborted) {
+        ec = boost::asio::error::timed_out;
+      }
+    }
+
+    /// The servers and hosts
+    ResolverConfig _config;
+
+    /// The allocator used for async operations and results
+    std::pmr::polymorphic_allocator<void> _alloc;
+
+    /// The socket queries are sent from, opened for each server asked
+    boost::asio::ip::udp::socket _socket;
+
+    /// Cancels the socket when a server does not answer in time
+    boost::asio::steady_timer _timer;
+
+    /// Incremented when a query completes, a wait completing after its
+    /// query is ignored
+    std::uint64_t _generation{};
+
+    /// Set if the timer of the current query expired
+    bool _expired{};
+
+    /// The AAAA and A queries
+    std::array<std::array<std::byte, DNS_UDP_SIZE>, 2> _queries{};
+
+    /// The last received response
+    std::array<std::byte, DNS_UDP_SIZE> _response{};
+
+    /// Sender of the last received response
+    boost::asio::ip::udp::endpoint _sender;
+  };
+
+}  // namespace brilliant::snapcast
+
+#endif
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/system/error_code.hpp>
+#include <cstddef>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief Runs sessions on several io_contexts, one thread per io_context.
+   * Each io_context thread is pinned to a core and owns an unsynchronized
+   * memory resource which must only be used by sessions running on that
+   * thread. Sessions stay on the shard they are placed on for their lifetime.
+   *
+   */
+  class SessionHost {
+  public:
+    /**
+     * @brief A single io_context, its thread and memory resource
+     *
+     */
+    class Shard {
+    public:
+      /**
+       * @brief Construct a new Shard object
+       *
+       * @param c The core the shard's thread is pinned to
+       * @param upstream The memory resource the shard's pool allocates from.
+       * Must be thread safe.
+       */
+      Shard(std::size_t c, std::pmr::memory_resource* upstream)
+          : _resource(upstream), _context(1), _core(c) {}
+
+      /**
+       * @brief Get the executor of the shard's io_context
+       *
+       * @return The executor
+       */
+      [[nodiscard]] auto getExecutor()
+          -> boost::asio::io_context::executor_type {
+        return _context.get_executor();
+      }
+
+      /**
+       * @brief Get the shard's memory resource. Must only be used from the
+       * shard's thread.
+       *
+       * @return A pointer to the memory resource
+       */
+      [[nodiscard]] auto resource() -> std::pmr::memory_resource* {
+        return &_resource;
+      }
+
+      /**
+       * @brief Get the number of sessions placed on the shard which have not
+       * finished
+       *
+       * @return The number of sessions
+       */
+      [[nodiscard]] auto sessions() const -> std::size_t {
+        return _sessions.load(std::memory_order_relaxed);
+      }
+
+      /**
+       * @brief Get the core the shard's thread is pinned to
+       *
+       * @return The core index
+       */
+      [[nodiscard]] auto core() const -> std::size_t { return _core; }
+
+      /**
+       * @brief Get the result of pinning the shard's thread to its core. Set
+       * by the thread before it runs a handler, so a session on the shard
+       * sees the result.
+       *
+       * @return An empty error_code if the thread is pinned or has not
+       * started. The pthread_setaffinity_np error if pinning failed, e.g.
+       * invalid_argument for a core outside the process's cpuset.
+       * operation_not_supported on platforms without thread affinity
+       * support.
+       */
+      [[nodiscard]] auto pinError() const -> boost::system::error_code {
+        return {_pinError.load(std::memory_order_acquire),
+                boost::system::generic_category()};
+      }
+
+      /**
+       * @brief Check if the caller runs on the shard's thread
+       *
+       * @return True if called from the shard's thread
+       */
+      [[nodiscard]] auto runningInThisThread() -> bool {
+        return _context.get_executor().running_in_this_thread();
+      }
+
+    private:
+      friend class SessionHost;
+
+      /// Memory resource for sessions on this shard. Declared before the
+      /// io_context, which frees the frames of abandoned sessions into it
+      /// when destroyed
+      std::pmr::unsynchronized_pool_resource _resource;
+
+      /// The io_context, created with a concurrency hint of 1
+      boost::asio::io_context _context;
+
+      /// Number of active sessions
+      std::atomic<std::size_t> _sessions{};
+
+      /// The error number of pinning the thread, zero if pinned
+      std::atomic<int> _pinError{};
+
+      /// The core the thread is pinned to
+      std::size_t _core;
+    };
+
+    /**
+     * @brief Construct a new Session Host object
+     *
+     * @param shardCount The number of io_contexts and threads. At least one
+     * shard is created.
+     * @param upstream The memory resource shard pools allocate from. Must be
+     * thread safe.
+     * @param mr A pointer to the memory resource used for the host's own
+     * bookkeeping
+     */
+    SessionHost(std::size_t shardCount, std::pmr::memory_resource* upstream,
+                std::pmr::memory_resource* mr)
+        : _alloc(mr), _shards(mr), _threads(mr) {
+      const auto cores = std::max(1U, std::thread::hardware_concurrency());
+      // place() needs a shard to choose from
+      shardCount = std::max<std::size_t>(shardCount, 1);
+      _shards.reserve(shardCount);
+      for (std::size_t i = 0; i < shardCount; ++i) {
+        _shards.push_back(_alloc.new_object<Shard>(i % cores, upstream));
+      }
+    }
+
+    /**
+     * @brief Destroy the Session Host object. Stops all shards.
+     *
+     */
+    ~SessionHost() {
+      stop();
+      for (auto* shard : _shards) {
+        _alloc.delete_object(shard);
+      }
+    }
+
+    /**
+     * @brief Deleted copy constructor
+     *
+     */
+    SessionHost(const SessionHost&) = delete;
+
+    /**
+     * @brief Deleted copy assignment operator
+     *
+     * @return SessionHost&
+     */
+    auto operator=(const SessionHost&) -> SessionHost& = delete;
+
+    /**
+     * @brief Deleted move constructor
+     *
+     */
+    SessionHost(SessionHost&&) = delete;
+
+    /**
+     * @brief Deleted move assignment operator
+     *
+     * @return SessionHost&
+     */
+    auto operator=(SessionHost&&) -> SessionHost& = delete;
+
+    /**
+     * @brief Start one thread per shard. Each thread is pinned to its shard's
+     * core and runs the shard's io_context until stop() is called. A host
+     * may be started again after stop(), sessions spawned in between run
+     * then. Must not be called while the host is running.
+     *
+     */
+    void start() {
+      _threads.reserve(_shards.size());
+      for (auto* shard : _shards) {
+        // a stopped io_context returns from run() at once
+        shard->_context.restart();
+      }
+      for (auto* shard : _shards) {
+        _threads.emplace_back([shard] {
+          shard->_pinError.store(pinToCore(shard->_core),
+                                 std::memory_order_release);
+          auto guard = boost::asio::make_work_guard(shard->_context);
+          shard->_context.run();
+        });
+      }
+    }
+
+    /**
+     * @brief Stop all io_contexts and wait for the threads to exit. Sessions
+     * which have not finished are abandoned.
+     *
+     */
+    void stop() {
+      for (auto* shard : _shards) {
+        shard->_context.stop();
+      }
+      _threads.clear();
+    }
+
+    /**
+     * @brief Select the shard a new session should be placed on. The shard
+     * with the fewest active sessions is chosen so new connections go to
+     * cores with spare capacity.
+     *
+     * @return A reference to the selected shard
+     */
+    [[nodiscard]] auto place() -> Shard& {
+      return **std::ranges::min_element(
+          _shards, {}, [](const Shard* shard) { return shard->sessions(); });
+    }
+
+    /**
+     * @brief Start a session on the least loaded shard
+     *
+     * @tparam Session Callable type
+     * @tparam CompletionToken The completion token type
+     * @param session Called on the shard's thread with a reference to the
+     * shard. Must return a boost::asio::awaitable<void> running the session.
+     * Objects using the shard's memory resource must be created in the
+     * session.
+     * @param token Completion token invoked when the session finishes
+     * @return Depends on the completion token
+     */
+    template <class Session, class CompletionToken>
+    auto spawn(Session session, CompletionToken&& token) {
+      auto& shard = place();
+      shard._sessions.fetch_add(1, std::memory_order_relaxed);
+      return boost::asio::co_spawn(
+          shard._context,
+          // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+          [&shard, session = std::move(session)] mutable
+              -> boost::asio::awaitable<void> {
+            struct Guard {
+              explicit Guard(Shard* s) : shard(s) {}
+              Guard(const Guard&) = delete;
+              Guard(Guard&&) = delete;
+              auto operator=(const Guard&) -> Guard& = delete;
+              auto operator=(Guard&&) -> Guard& = delete;
+              ~Guard() {
+                shard->_sessions.fetch_sub(1, std::memory_order_relaxed);
+              }
+              Shard* shard;
+            } guard(&shard);
+            co_await session(shard);
+          },
+          std::forward<CompletionToken>(token));
+    }
+
+    /**
+     * @brief Get the number of shards
+     *
+     * @return The number of shards
+     */
+    [[nodiscard]] auto size() const -> std::size_t { return _shards.size(); }
+
+    /**
+     * @brief Get a shard
+     *
+     * @param i The shard index
+     * @return A reference to the shard
+     */
+    [[nodiscard]] auto operator[](std::size_t i) -> Shard& {
+      return *_shards[i];
+    }
+
+  private:
+    /**
+     * @brief Pin the calling thread to a core. Has no effect on platforms
+     * without thread affinity support.
+     *
+     * @param core The core index
+     * @return Zero if successful, an error number otherwise
+     */
+    static auto pinToCore([[maybe_unused]] std::size_t core) -> int {
+#if defined(__linux__)
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(core, &set);
+      return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+      return static_cast<int>(boost::system::errc::operation_not_supported);
+#endif
+    }
+
+    /// Allocator for shards
+    std::pmr::polymorphic_allocator<Shard> _alloc;
+
+    /// The shards
+    std::pmr::vector<Shard*> _shards;
+
+    /// One thread per shard
+    std::pmr::vector<std::jthread> _threads;
+  };
+
+}  // namespace brilliant::snapcast
@@ -0,0 +1,464 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#include "BrilliantSnapcast/Message.hpp"
+#include "BrilliantSnapcast/MessageType.hpp"
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief Convert a Time to signed microseconds. The wire carries snapcast's
+   * signed timeval, a latency measured across the two clocks is negative
+   * when the server clock is behind. Both fields are read as signed 32 bit
+   * values, so a usec outside [0, 1e6) is normalized as well.
+   *
+   * @param time The time
+   * @return The time in microseconds
+   */
+  constexpr auto toSignedMicroseconds(const Time& time) -> std::int64_t {
+    constexpr std::int64_t USEC_PER_SEC = 1'000'000;
+    return (static_cast<std::int64_t>(static_cast<std::int32_t>(time.sec)) *
+            USEC_PER_SEC) +
+           static_cast<std::int64_t>(static_cast<std::int32_t>(time.usec));
+  }
+
+  /**
+   * @brief Convert signed microseconds to a Time, the inverse of
+   * toSignedMicroseconds. Normalized like snapcast's timeval: sec is rounded
+   * towards negative infinity and usec is in [0, 1e6), so -1.5 s is sec -2
+   * and usec 500000.
+   *
+   * @param usec The time in microseconds
+   * @return The time, sec stored as a signed 32 bit value
+   */
+  constexpr auto fromSignedMicroseconds(std::int64_t usec) -> Time {
+    constexpr std::int64_t USEC_PER_SEC = 1'000'000;
+    auto sec = usec / USEC_PER_SEC;
+    auto rest = usec % USEC_PER_SEC;
+    if (rest < 0) {
+      --sec;
+      rest += USEC_PER_SEC;
+    }
+    return {.sec = static_cast<std::uint32_t>(static_cast<std::int32_t>(sec)),
+            .usec = static_cast<std::uint32_t>(rest)};
+  }
+
+  /**
+   * @brief Get the clock offset to the server from a Time reply. The server
+   * stores the client to server latency in the message, the header carries
+   * the server to client latency.
+   *
+   * @param base The header of the reply
+   * @param time The reply
+   * @return The server clock minus the client clock in microseconds
+   */
+  constexpr auto clockOffset(const Base& base, const Time& time)
+      -> std::int64_t {
+    const auto c2s = toSignedMicroseconds(time);
+    const auto s2c =
+        toSignedMicroseconds(base.received) - toSignedMicroseconds(base.sent);
+    return (c2s - s2c) / 2;
+  }
+
+  /**
+   * @brief Fixed bucket log-linear histogram. Values below 8 get a bucket
+   * each, every power of two above is split into 8 linear buckets, so the
+   * relative error of a bucket is at most 12.5%. Recording is a few relaxed
+   * atomic increments and never allocates.
+   *
+   */
+  class Histogram {
+  public:
+    /// Number of linear buckets per power of two, as a power of two
+    static constexpr unsigned SUB_BUCKET_BITS = 3;
+
+    /// Number of linear buckets per power of two
+    static constexpr std::size_t SUB_BUCKETS = 1U << SUB_BUCKET_BITS;
+
+    /// Values are clamped below 2^MAX_EXPONENT
+    static constexpr unsigned MAX_EXPONENT = 40;
+
+    /// Number of buckets
+    static constexpr std::size_t BUCKETS =
+        (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    /// Largest recordable value
+    static constexpr std::uint64_t MAX_VALUE =
+        (std::uint64_t{1} << MAX_EXPONENT) - 1;
+
+    /**
+     * @brief A copy of the histogram at one point in time
+     *
+     */
+    struct Snapshot {
+      /// Number of values in each bucket
+      std::array<std::uint64_t, BUCKETS> buckets{};
+
+      /// Number of recorded values
+      std::uint64_t count{};
+
+      /// Sum of recorded values
+      std::uint64_t sum{};
+
+      /// Largest recorded value
+      std::uint64_t max{};
+
+      /**
+       * @brief Get an approximate percentile
+       *
+       * @param p The percentile in [0, 1]
+       * @return The upper bound of the bucket containing the percentile, 0
+       * if nothing was recorded
+       */
+      [[nodiscard]] auto percentile(double p) const -> std::uint64_t {
+        if (count == 0) {
+          return 0;
+        }
+        const auto rank = static_cast<std::uint64_t>(
+            std::clamp(p, 0.0, 1.0) * static_cast<double>(count - 1));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < BUCKETS; ++i) {
+          seen += buckets[i];
+          if (seen > rank) {
+            return std::min(upperBound(i), max);
+          }
+        }
+        return max;
+      }
+
+      /**
+       * @brief Get the mean of recorded values
+       *
+       * @return The mean, 0 if nothing was recorded
+       */
+      [[nodiscard]] auto mean() const -> double {
+        return count == 0
+                   ? 0.0
+                   : static_cast<double>(sum) / static_cast<double>(count);
+      }
+    };
+
+    /**
+     * @brief Get the bucket a value is counted in
+     *
+     * @param value The value
+     * @return The bucket index
+     */
+    static constexpr auto bucket(std::uint64_t value) -> std::size_t {
+      value = std::min(value, MAX_VALUE);
+      if (value < SUB_BUCKETS) {
+        return static_cast<std::size_t>(value);
+      }
+      const auto exponent =
+          static_cast<unsigned>(std::bit_width(value)) - 1;
+      const auto sub = (value >> (exponent - SUB_BUCKET_BITS)) &
+                       (SUB_BUCKETS - 1);
+      return ((exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS) +
+             static_cast<std::size_t>(sub);
+    }
+
+    /**
+     * @brief Get the largest value counted in a bucket
+     *
+     * @param index The bucket index
+     * @return The upper bound of the bucket
+     */
+    static constexpr auto upperBound(std::size_t index) -> std::uint64_t {
+      if (index < SUB_BUCKETS) {
+        return index;
+      }
+      const auto exponent =
+          static_cast<unsigned>(index / SUB_BUCKETS) + SUB_BUCKET_BITS - 1;
+      const auto sub = static_cast<std::uint64_t>(index % SUB_BUCKETS);
+      const auto width = std::uint64_t{1} << (exponent - SUB_BUCKET_BITS);
+      return (std::uint64_t{1} << exponent) + ((sub + 1) * width) - 1;
+    }
+
+    /**
+     * @brief Record a value. Values above MAX_VALUE are counted in the last
+     * bucket.
+     *
+     * @param value The value
+     */
+    void record(std::uint64_t value) {
+      _buckets[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+      _count.fetch_add(1, std::memory_order_relaxed);
+      _sum.fetch_add(value, std::memory_order_relaxed);
+      auto max = _max.load(std::memory_order_relaxed);
+      while (value > max && !_max.compare_exchange_weak(
+                                max, value, std::memory_order_relaxed)) {
+      }
+    }
+
+    /**
+     * @brief Copy the histogram. Concurrent records may be partially visible.
+     *
+     * @param out The snapshot to write to
+     */
+    void snapshot(Snapshot& out) const {
+      for (std::size_t i = 0; i < BUCKETS; ++i) {
+        out.buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+      }
+      out.count = _count.load(std::memory_order_relaxed);
+      out.sum = _sum.load(std::memory_order_relaxed);
+      out.max = _max.load(std::memory_order_relaxed);
+    }
+
+  private:
+    /// Bucket counts
+    std::array<std::atomic<std::uint64_t>, BUCKETS> _buckets{};
+
+    /// Number of recorded values
+    std::atomic<std::uint64_t> _count{};
+
+    /// Sum of recorded values
+    std::atomic<std::uint64_t> _sum{};
+
+    /// Largest recorded value
+    std::atomic<std::uint64_t> _max{};
+  };
+
+  /**
+   * @brief Counters and latency histograms of a single session. Updated by the
+   * session thread with relaxed atomics and read from any thread with
+   * snapshot().
+   *
+   */
+  class SessionMetrics {
+  public:
+    /// Number of message types
+    static constexpr std::size_t MESSAGE_TYPES =
+        static_cast<std::size_t>(MessageType::ERROR) + 1;
+
+    /**
+     * @brief A copy of the metrics at one point in time
+     *
+     */
+    struct Snapshot {
+      /// Bytes received per message type, including headers
+      std::array<std::uint64_t, MESSAGE_TYPES> bytesReceived{};
+
+      /// Messages received per message type
+      std::array<std::uint64_t, MESSAGE_TYPES> messagesReceived{};
+
+      /// Bytes sent per message type, including headers
+      std::array<std::uint64_t, MESSAGE_TYPES> bytesSent{};
+
+      /// Messages sent per message type
+      std::array<std::uint64_t, MESSAGE_TYPES> messagesSent{};
+
+      /// Failed reads
+      std::uint64_t readErrors{};
+
+      /// Failed writes
+      std::uint64_t writeErrors{};
+
+      /// Messages which did not fit the supplied buffer
+      std::uint64_t bufferSpaceErrors{};
+
+      /// Chunks played late
+      std::uint64_t lateChunks{};
+
+      /// Chunks dropped
+      std::uint64_t droppedChunks{};
+
+      /// Round trip time of Time messages in microseconds
+      Histogram::Snapshot roundTrip;
+
+      /// Positive clock offsets to the server in microseconds
+      Histogram::Snapshot clockOffsetPositive;
+
+      /// Magnitude of negative clock offsets to the server in microseconds
+      Histogram::Snapshot clockOffsetNegative;
+
+      /// Sum of signed clock offsets in microseconds, the counts of
+      /// clockOffsetPositive and clockOffsetNegative values were summed
+      std::int64_t clockOffsetSum{};
+
+      /// Time from receiving a header to handing the message to the caller in
+      /// microseconds
+      Histogram::Snapshot readToDispatch;
+    };
+
+    /**
+     * @brief Count a received message
+     *
+     * @param type The message type
+     * @param bytes The number of bytes including the header
+     */
+    void received(MessageType type, std::size_t bytes) {
+      const auto index = typeIndex(type);
+      _bytesReceived[index].fetch_add(bytes, std::memory_order_relaxed);
+      _messagesReceived[index].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Count a sent message
+     *
+     * @param type The message type
+     * @param bytes The number of bytes including the header
+     */
+    void sent(MessageType type, std::size_t bytes) {
+      const auto index = typeIndex(type);
+      _bytesSent[index].fetch_add(bytes, std::memory_order_relaxed);
+      _messagesSent[index].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Count a failed read
+     *
+     */
+    void readError() { _readErrors.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * @brief Count a failed write
+     *
+     */
+    void writeError() { _writeErrors.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * @brief Count a message which did not fit the supplied buffer
+     *
+     */
+    void bufferSpaceError() {
+      _bufferSpaceErrors.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Count a chunk played after its scheduled time
+     *
+     */
+    void lateChunk() { _lateChunks.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * @brief Count a chunk which was not played
+     *
+     */
+    void droppedChunk() {
+      _droppedChunks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Record a Time reply. The server stores the client to server
+     * latency in the message, the header carries the server to client
+     * latency.
+     *
+     * @param base The header of the reply
+     * @param time The reply
+     */
+    void timeReply(const Base& base, const Time& time) {
+      const auto c2s = toSignedMicroseconds(time);
+      const auto s2c =
+          toSignedMicroseconds(base.received) - toSignedMicroseconds(base.sent);
+      const auto offset = clockOffset(base, time);
+      _roundTrip.record(static_cast<std::uint64_t>(std::max<std::int64_t>(
+          c2s + s2c, 0)));
+      if (offset < 0) {
+        _clockOffsetNegative.record(static_cast<std::uint64_t>(-offset));
+      } else {
+        _clockOffsetPositive.record(static_cast<std::uint64_t>(offset));
+      }
+      _clockOffsetSum.fetch_add(offset, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Record the time between receiving a header and handing the
+     * message to the caller
+     *
+     * @param micros The latency in microseconds
+     */
+    void readToDispatch(std::int64_t micros) {
+      _readToDispatch.record(
+          static_cast<std::uint64_t>(std::max<std::int64_t>(micros, 0)));
+    }
+
+    /**
+     * @brief Copy all metrics. Does not allocate and takes no locks, values
+     * updated concurrently may be partially visible.
+     *
+     * @param out The snapshot to write to
+     */
+    void snapshot(Snapshot& out) const {
+      for (std::size_t i = 0; i < MESSAGE_TYPES; ++i) {
+        out.bytesReceived[i] =
+            _bytesReceived[i].load(std::memory_order_relaxed);
+        out.messagesReceived[i] =
+            _messagesReceived[i].load(std::memory_order_relaxed);
+        out.bytesSent[i] = _bytesSent[i].load(std::memory_order_relaxed);
+        out.messagesSent[i] = _messagesSent[i].load(std::memory_order_relaxed);
+      }
+      out.readErrors = _readErrors.load(std::memory_order_relaxed);
+      out.writeErrors = _writeErrors.load(std::memory_order_relaxed);
+      out.bufferSpaceErrors =
+          _bufferSpaceErrors.load(std::memory_order_relaxed);
+      out.lateChunks = _lateChunks.load(std::memory_order_relaxed);
+      out.droppedChunks = _droppedChunks.load(std::memory_order_relaxed);
+      _roundTrip.snapshot(out.roundTrip);
+      _clockOffsetPositive.snapshot(out.clockOffsetPositive);
+      _clockOffsetNegative.snapshot(out.clockOffsetNegative);
+      out.clockOffsetSum = _clockOffsetSum.load(std::memory_order_relaxed);
+      _readToDispatch.snapshot(out.readToDispatch);
+    }
+
+  private:
+    /**
+     * @brief Get the counter index of a message type
+     *
+     * @param type The message type
+     * @return The index, unknown types are counted as BASE
+     */
+    static auto typeIndex(MessageType type) -> std::size_t {
+      const auto index = static_cast<std::size_t>(type);
+      return index < MESSAGE_TYPES ? index : 0;
+    }
+
+    /// Bytes received per message type
+    std::array<std::atomic<std::uint64_t>, MESSAGE_TYPES> _bytesReceived{};
+
+    /// Messages received per message type
+    std::array<std::atomic<std::uint64_t>, MESSAGE_TYPES> _messagesReceived{};
+
+    /// Bytes sent per message type
+    std::array<std::atomic<std::uint64_t>, MESSAGE_TYPES> _bytesSent{};
+
+    /// Messages sent per message type
+    std::array<std::atomic<std::uint64_t>, MESSAGE_TYPES> _messagesSent{};
+
+    /// Failed reads
+    std::atomic<std::uint64_t> _readErrors{};
+
+    /// Failed writes
+    std::atomic<std::uint64_t> _writeErrors{};
+
+    /// Messages which did not fit the supplied buffer
+    std::atomic<std::uint64_t> _bufferSpaceErrors{};
+
+    /// Chunks played late
+    std::atomic<std::uint64_t> _lateChunks{};
+
+    /// Chunks dropped
+    std::atomic<std::uint64_t> _droppedChunks{};
+
+    /// Round trip time of Time messages
+    Histogram _roundTrip;
+
+    /// Positive clock offsets
+    Histogram _clockOffsetPositive;
+
+    /// Magnitude of negative clock offsets
+    Histogram _clockOffsetNegative;
+
+    /// Sum of signed clock offsets
+    std::atomic<std::int64_t> _clockOffsetSum{};
+
+    /// Read to dispatch latency
+    Histogram _readToDispatch;
+  };
+
+}  // namespace brilliant::snapcast
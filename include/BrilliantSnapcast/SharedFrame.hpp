@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic>
+#include <boost/system/error_code.hpp>
+#include <cstddef>
+#include <expected>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <utility>
+
+#include "BrilliantSnapcast/Message.hpp"
+#include "BrilliantSnapcast/ProtocolSession.hpp"
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief A reference counted, immutable, encoded message. The message is
+   * serialized once and the bytes are shared by every copy of the handle so a
+   * frame can be queued for many peers without copying. The storage is
+   * returned to the memory resource when the last handle is destroyed.
+   *
+   */
+  class SharedFrame {
+  public:
+    /**
+     * @brief Construct an empty Shared Frame object
+     *
+     */
+    SharedFrame() = default;
+
+    /**
+     * @brief Encode a message into a new shared frame
+     *
+     * @param id The message id
+     * @param message The message to encode
+     * @param sent The time stored in the header as the sent time
+     * @param mr A pointer to the memory resource the frame is allocated from.
+     * Must be thread safe if handles are released on several threads.
+     * @return The frame if successful. An error_code otherwise.
+     */
+    static auto make(std::uint16_t id, Message message, Time sent,
+                     std::pmr::memory_resource* mr)
+        -> std::expected<SharedFrame, boost::system::error_code> {
+      const auto size = HEADER_SIZE + wireSize(message);
+      void* mem = mr->allocate(sizeof(Block) + size, alignof(Block));
+      auto* block = ::new (mem) Block{{1}, mr, size};
+
+      auto encoded = ProtocolSession::encode(id, message, sent, block->data());
+      if (!encoded) {
+        release(block);
+        return std::unexpected(encoded.error());
+      }
+      return SharedFrame(block);
+    }
+
+    /**
+     * @brief Destroy the Shared Frame object. Releases the storage if this is
+     * the last handle.
+     *
+     */
+    ~SharedFrame() { release(_block); }
+
+    /**
+     * @brief Copy constructor. Shares the frame.
+     *
+     * @param other The frame to share
+     */
+    SharedFrame(const SharedFrame& other) : _block(other._block) {
+      if (_block) {
+        _block->refs.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * @brief Copy assignment operator. Shares the frame.
+     *
+     * @param other The frame to share
+     * @return A reference to this object
+     */
+    auto operator=(const SharedFrame& other) -> SharedFrame& {
+      SharedFrame copy(other);
+      std::swap(_block, copy._block);
+      return *this;
+    }
+
+    /**
+     * @brief Move constructor
+     *
+     * @param other The object to move from
+     */
+    SharedFrame(SharedFrame&& other) noexcept
+        : _block(std::exchange(other._block, nullptr)) {}
+
+    /**
+     * @brief Move assignment operator
+     *
+     * @param other The object to move from
+     * @return A reference to this object
+     */
+    auto operator=(SharedFrame&& other) noexcept -> SharedFrame& {
+      std::swap(_block, other._block);
+      return *this;
+    }
+
+    /**
+     * @brief Get the encoded bytes, including the header
+     *
+     * @return A view of the encoded frame. Empty if this handle is empty.
+     */
+    [[nodiscard]] auto bytes() const -> std::span<const std::byte> {
+      if (!_block) {
+        return {};
+      }
+      return _block->data();
+    }
+
+    /**
+     * @brief Get the number of handles sharing the frame
+     *
+     * @return The number of handles
+     */
+    [[nodiscard]] auto useCount() const -> std::size_t {
+      return _block ? _block->refs.load(std::memory_order_relaxed) : 0;
+    }
+
+    /**
+     * @brief Check if the handle refers to a frame
+     *
+     * @return True if the handle is not empty
+     */
+    explicit operator bool() const { return _block != nullptr; }
+
+  private:
+    /**
+     * @brief Control block. The encoded bytes follow it in the same
+     * allocation.
+     *
+     */
+    struct Block {
+      /// Number of handles
+      std::atomic<std::size_t> refs;
+
+      /// The memory resource the block was allocated from
+      std::pmr::memory_resource* mr;
+
+      /// Size of the encoded bytes
+      std::size_t size;
+
+      /**
+       * @brief Get the encoded bytes
+       *
+       * @return A view of the bytes following the block
+       */
+      auto data() -> std::span<std::byte> {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+        return {reinterpret_cast<std::byte*>(this + 1), size};
+      }
+    };
+
+    /**
+     * @brief Construct a new Shared Frame object
+     *
+     * @param block The control block, the handle takes ownership
+     */
+    explicit SharedFrame(Block* block) : _block(block) {}
+
+    /**
+     * @brief Drop a reference and free the block if it was the last one
+     *
+     * @param block The control block, may be null
+     */
+    static void release(Block* block) {
+      if (block && block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        auto* mr = block->mr;
+        const auto bytes = sizeof(Block) + block->size;
+        block->~Block();
+        mr->deallocate(block, bytes, alignof(Block));
+      }
+    }
+
+    /// The shared control block
+    Block* _block{};
+  };
+
+}  // namespace brilliant::snapcast
@@ -0,0 +1,682 @@
+#pragma once
+
+// the ring lives in a memfd and is synchronized with futexes
+#if defined(__linux__)
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <bit>
+#include <boost/system/error_code.hpp>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <expected>
+#include <memory_resource>
+#include <new>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BrilliantSnapcast/Decoder.hpp"
+#include "BrilliantSnapcast/Trace.hpp"
+
+namespace brilliant::snapcast {
+
+  /// Identifies a shared PCM ring mapping, "SPCM"
+  inline constexpr std::uint32_t PCM_RING_MAGIC = 0x5350434DU;
+
+  /// Layout version of the shared PCM ring, bumped on incompatible changes
+  inline constexpr std::uint32_t PCM_RING_VERSION = 1;
+
+  /**
+   * @brief A view of a frame in the shared ring
+   *
+   */
+  struct PcmSlot {
+    /// Time the first sample is due at the output, on the steady clock
+    std::chrono::steady_clock::time_point playout;
+
+    /// The samples, a view into the mapping
+    std::span<const std::byte> samples;
+  };
+
+  /**
+   * @brief Single producer single consumer ring of PCM frames in a memfd
+   * mapping shared between two processes. The header holds the indices and
+   * the slots follow it, so the consumer reads samples in place. Blocking
+   * waits use shared futexes and only issue a wake when the other side is
+   * waiting. Playout times use the steady clock, which is CLOCK_MONOTONIC on
+   * Linux and therefore comparable across processes.
+   *
+   * The producer uses tryAcquire(), commit(), tryPublish() and waitForSpace().
+   * The consumer uses peek(), release() and waitForFrame(). Each side must be
+   * used by one thread at a time.
+   *
+   */
+  class SharedPcmRing {
+  public:
+    /**
+     * @brief Create a new ring in an anonymous memfd
+     *
+     * @param slotCount The number of slots, rounded up to a power of two
+     * @param slotSize The maximum number of sample bytes per slot
+     * @return The ring if successful. An error_code otherwise.
+     */
+    static auto create(std::size_t slotCount, std::size_t slotSize)
+        -> std::expected<SharedPcmRing, boost::system::error_code> {
+      slotCount = std::bit_ceil(std::max<std::size_t>(slotCount, 1));
+      if (slotCount > MAX_SLOTS || slotSize > UINT32_MAX) {
+        return std::unexpected(boost::system::errc::make_error_code(
+            boost::system::errc::invalid_argument));
+      }
+      const int fd = ::memfd_create("brilliant-snapcast-pcm", MFD_CLOEXEC);
+      if (fd < 0) {
+        return std::unexpected(lastError());
+      }
+      SharedPcmRing ring;
+      ring._fd = fd;
+      const auto size = mappingSize(slotCount, slotStride(slotSize));
+      if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        return std::unexpected(lastError());
+      }
+      if (auto ec = ring.map(size)) {
+        return std::unexpected(ec);
+      }
+      auto* header = ::new (ring._mapping.data()) Header{};
+      header->slotCount = static_cast<std::uint32_t>(slotCount);
+      header->slotSize = static_cast<std::uint32_t>(slotSize);
+      header->version = PCM_RING_VERSION;
+      header->magic.store(PCM_RING_MAGIC, std::memory_order_release);
+      ring.attach();
+      return ring;
+    }
+
+    /**
+     * @brief Map a ring created by another process
+     *
+     * @param fd The memfd of the ring, e.g. inherited or received over a Unix
+     * domain socket. Ownership is taken.
+     * @return The ring if successful. An error_code otherwise.
+     */
+    static auto open(int fd)
+        -> std::expected<SharedPcmRing, boost::system::error_code> {
+      SharedPcmRing ring;
+      ring._fd = fd;
+      struct stat st {};
+      if (::fstat(fd, &st) != 0) {
+        return std::unexpected(lastError());
+      }
+      const auto size = static_cast<std::size_t>(st.st_size);
+      if (size < HEADER_SIZE) {
+        return std::unexpected(invalidRing());
+      }
+      if (auto ec = ring.map(size)) {
+        return std::unexpected(ec);
+      }
+      const auto* header = ring.header();
+      if (header->magic.load(std::memory_order_acquire) != PCM_RING_MAGIC ||
+          header->version != PCM_RING_VERSION ||
+          !std::has_single_bit(header->slotCount) ||
+          header->slotCount > MAX_SLOTS ||
+          mappingSize(header->slotCount, slotStride(header->slotSize)) !=
+              size) {
+        return std::unexpected(invalidRing());
+      }
+      ring.attach();
+      return ring;
+    }
+
+    /**
+     * @brief Destroy the Shared Pcm Ring object. Unmaps the ring and closes
+     * the memfd, the other process keeps its mapping.
+     *
+     */
+    ~SharedPcmRing() {
+      if (!_mapping.empty()) {
+        ::munmap(_mapping.data(), _mapping.size());
+      }
+      if (_fd >= 0) {
+        ::close(_fd);
+      }
+    }
+
+    /**
+     * @brief Deleted copy constructor
+     *
+     */
+    SharedPcmRing(const SharedPcmRing&) = delete;
+
+    /**
+     * @brief Deleted copy assignment operator
+     *
+     * @return SharedPcmRing&
+     */
+    auto operator=(const SharedPcmRing&) -> SharedPcmRing& = delete;
+
+    /**
+     * @brief Move constructor
+     *
+     * @param other The object to move from
+     */
+    SharedPcmRing(SharedPcmRing&& other) noexcept
+        : _fd(std::exchange(other._fd, -1)),
+          _mapping(std::exchange(other._mapping, {})),
+          _mask(other._mask),
+          _stride(other._stride) {}
+
+    /**
+     * @brief Move assignment operator
+     *
+     * @param other The object to move from
+     * @return A reference to this object
+     */
+    auto operator=(SharedPcmRing&& other) noexcept -> SharedPcmRing& {
+      std::swap(_fd, other._fd);
+      std::swap(_mapping, other._mapping);
+      std::swap(_mask, other._mask);
+      std::swap(_stride, other._stride);
+      return *this;
+    }
+
+    /**
+     * @brief Get the memfd to hand to the consumer process
+     *
+     * @return The file descriptor
+     */
+    [[nodiscard]] auto fd() const -> int { return _fd; }
+
+    /**
+     * @brief Get the number of slots
+     *
+     * @return The slot count
+     */
+    [[nodiscard]] auto slotCount() const -> std::size_t { return _mask + 1; }
+
+    /**
+     * @brief Get the maximum number of sample bytes per slot
+     *
+     * @return The slot size
+     */
+    [[nodiscard]] auto slotSize() const -> std::size_t {
+      return header()->slotSize;
+    }
+
+    /**
+     * @brief Get the number of published frames not yet released
+     *
+     * @return The number of frames
+     */
+    [[nodiscard]] auto size() const -> std::size_t {
+      return header()->head.load(std::memory_order_acquire) -
+             header()->tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Get the number of times the producer found the ring full
+     *
+     * @return The number of stalls
+     */
+    [[nodiscard]] auto stalls() const -> std::uint64_t {
+      return header()->stalls.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get the sample storage of the next slot. The producer writes the
+     * samples in place and then calls commit().
+     *
+     * @return A view of the slot's sample storage. Empty if the ring is full.
+     */
+    auto tryAcquire() -> std::span<std::byte> {
+      auto* h = header();
+      const auto head = h->head.load(std::memory_order_relaxed);
+      if (head - h->tail.load(std::memory_order_acquire) > _mask) {
+        h->stalls.fetch_add(1, std::memory_order_relaxed);
+        return {};
+      }
+      return {slot(head) + sizeof(SlotHeader), h->slotSize};
+    }
+
+    /**
+     * @brief Publish the slot returned by tryAcquire()
+     *
+     * @param size The number of sample bytes written
+     * @param playout The time the first sample is due at the output
+     */
+    void commit(std::size_t size,
+                std::chrono::steady_clock::time_point playout) {
+      auto* h = header();
+      const auto head = h->head.load(std::memory_order_relaxed);
+      auto* slotHeader = reinterpret_cast<SlotHeader*>(slot(head));  // NOLINT
+      slotHeader->playout = playout.time_since_epoch().count();
+      slotHeader->size = static_cast<std::uint32_t>(size);
+      // seq_cst orders the store before the waiter check, pairs with
+      // waitForFrame()
+      h->head.store(head + 1, std::memory_order_seq_cst);
+      if (h->consumerWaiting.load(std::memory_order_seq_cst) != 0) {
+        futexWake(h->head);
+      }
+    }
+
+    /**
+     * @brief Copy samples into the next slot and publish it
+     *
+     * @param samples The samples, at most slotSize() bytes
+     * @param playout The time the first sample is due at the output
+     * @return true if published. false if the ring is full.
+     */
+    auto tryPublish(std::span<const std::byte> samples,
+                    std::chrono::steady_clock::time_point playout) -> bool {
+      auto storage = tryAcquire();
+      if (storage.empty()) {
+        return false;
+      }
+      const auto size = std::min(samples.size(), storage.size());
+      std::memcpy(storage.data(), samples.data(), size);
+      commit(size, playout);
+      return true;
+    }
+
+    /**
+     * @brief Wait until the consumer released a slot
+     *
+     * @param timeout The maximum time to wait
+     * @return true if a slot is free
+     */
+    auto waitForSpace(std::chrono::nanoseconds timeout) -> bool {
+      auto* h = header();
+      const auto head = h->head.load(std::memory_order_relaxed);
+      return wait(h->tail, h->producerWaiting, timeout, [&](auto tail) {
+        return head - tail <= _mask;
+      });
+    }
+
+    /**
+     * @brief Get the oldest published frame without releasing it
+     *
+     * @return A view of the frame. Empty if no frame is published.
+     */
+    [[nodiscard]] auto peek() const -> std::optional<PcmSlot> {
+      const auto* h = header();
+      const auto tail = h->tail.load(std::memory_order_relaxed);
+      if (h->head.load(std::memory_order_acquire) == tail) {
+        return std::nullopt;
+      }
+      const auto* data = slot(tail);
+      SlotHeader slotHeader{};
+      std::memcpy(&slotHeader, data, sizeof(slotHeader));
+      const auto size = std::min<std::size_t>(slotHeader.size, h->slotSize);
+      return PcmSlot{
+          std::chrono::steady_clock::time_point(
+              std::chrono::steady_clock::duration(slotHeader.playout)),
+          {data + sizeof(SlotHeader), size}};
+    }
+
+    /**
+     * @brief Release the frame returned by peek() to the producer
+     *
+     */
+    void release() {
+      auto* h = header();
+      const auto tail = h->tail.load(std::memory_order_relaxed);
+      // seq_cst orders the store before the waiter check, pairs with
+      // waitForSpace()
+      h->tail.store(tail + 1, std::memory_order_seq_cst);
+      if (h->producerWaiting.load(std::memory_order_seq_cst) != 0) {
+        futexWake(h->tail);
+      }
+    }
+
+    /**
+     * @brief Wait until the producer published a frame
+     *
+     * @param timeout The maximum time to wait
+     * @return true if a frame is available
+     */
+    auto waitForFrame(std::chrono::nanoseconds timeout) -> bool {
+      auto* h = header();
+      const auto tail = h->tail.load(std::memory_order_relaxed);
+      return wait(h->head, h->consumerWaiting, timeout,
+                  [&](auto head) { return head != tail; });
+    }
+
+    /**
+     * @brief Wait without a timeout until the producer published a frame or
+     * stop is requested
+     *
+     * @param stop Ends the wait
+     * @return true if a frame is available
+     */
+    auto waitForFrame(const std::stop_token& stop) -> bool {
+      auto* h = header();
+      const auto tail = h->tail.load(std::memory_order_relaxed);
+      // the stop request does not change the futex word, a wake between the
+      // waiter's check and its futex wait would be lost, so keep waking
+      // until the waiter left
+      const std::stop_callback wake(stop, [h] {
+        while (h->consumerWaiting.load(std::memory_order_seq_cst) != 0) {
+          futexWake(h->head);
+          std::this_thread::yield();
+        }
+      });
+      return wait(h->head, h->consumerWaiting, std::nullopt,
+                  [&](auto head) {
+                    return head != tail || stop.stop_requested();
+                  }) &&
+             h->head.load(std::memory_order_acquire) != tail;
+    }
+
+  private:
+    /**
+     * @brief The shared header at the start of the mapping. Indices are 32
+     * bits so they can be futex words, they wrap and are compared by
+     * difference.
+     *
+     */
+    struct Header {
+      /// PCM_RING_MAGIC once the header is initialized
+      std::atomic<std::uint32_t> magic;
+
+      /// PCM_RING_VERSION
+      std::uint32_t version;
+
+      /// Number of slots, a power of two
+      std::uint32_t slotCount;
+
+      /// Maximum number of sample bytes per slot
+      std::uint32_t slotSize;
+
+      /// Number of times the producer found the ring full
+      std::atomic<std::uint64_t> stalls;
+
+      /// Index of the next slot to publish, written by the producer
+      alignas(64) std::atomic<std::uint32_t> head;
+
+      /// Set while the consumer waits on head
+      std::atomic<std::uint32_t> consumerWaiting;
+
+      /// Index of the next slot to release, written by the consumer
+      alignas(64) std::atomic<std::uint32_t> tail;
+
+      /// Set while the producer waits on tail
+      std::atomic<std::uint32_t> producerWaiting;
+    };
+
+    static_assert(std::atomic<std::uint32_t>::is_always_lock_free &&
+                      std::atomic<std::uint64_t>::is_always_lock_free,
+                  "shared atomics must be lock free");
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t),
+                  "futex words must be plain 32 bit integers");
+
+    /**
+     * @brief Per slot header in front of the samples
+     *
+     */
+    struct SlotHeader {
+      /// Playout time in steady clock ticks
+      std::int64_t playout;
+
+      /// Number of sample bytes
+      std::uint32_t size;
+
+      /// Padding, keeps the samples 8 byte aligned
+      std::uint32_t reserved;
+    };
+
+    /// Size of the shared header, slots start at this offset
+    static constexpr std::size_t HEADER_SIZE = 192;
+
+    /// Slot alignment, slots never share a cache line
+    static constexpr std::size_t SLOT_ALIGNMENT = 64;
+
+    /// Largest slot count, keeps index differences unambiguous
+    static constexpr std::size_t MAX_SLOTS = 1U << 30U;
+
+    static_assert(sizeof(Header) <= HEADER_SIZE, "header does not fit");
+
+    /**
+     * @brief Construct an empty Shared Pcm Ring object
+     *
+     */
+    SharedPcmRing() = default;
+
+    /**
+     * @brief Get the distance between slots
+     *
+     * @param slotSize The maximum number of sample bytes per slot
+     * @return The slot stride in bytes
+     */
+    static constexpr auto slotStride(std::size_t slotSize) -> std::size_t {
+      return (sizeof(SlotHeader) + slotSize + SLOT_ALIGNMENT - 1) &
+             ~(SLOT_ALIGNMENT - 1);
+    }
+
+    /**
+     * @brief Get the size of the mapping
+     *
+     * @param slotCount The number of slots
+     * @param stride The slot stride
+     * @return The mapping size in bytes
+     */
+    static constexpr auto mappingSize(std::size_t slotCount,
+                                      std::size_t stride) -> std::size_t {
+      return HEADER_SIZE + (slotCount * stride);
+    }
+
+    /**
+     * @brief Get the error_code for errno
+     *
+     * @return The error_code
+     */
+    static auto lastError() -> boost::system::error_code {
+      return {errno, boost::system::system_category()};
+    }
+
+    /**
+     * @brief Get the error_code for a mapping which is not a valid ring
+     *
+     * @return The error_code
+     */
+    static auto invalidRing() -> boost::system::error_code {
+      return boost::system::errc::make_error_code(
+          boost::system::errc::illegal_byte_sequence);
+    }
+
+    /**
+     * @brief Wake all waiters on a futex word
+     *
+     * @param word The futex word
+     */
+    static void futexWake(std::atomic<std::uint32_t>& word) {
+      ::syscall(SYS_futex, &word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    /**
+     * @brief Wait on an index of the other side until a condition holds
+     *
+     * @param word The index, used as futex word
+     * @param waiting The waiter flag checked by the other side
+     * @param timeout The maximum time to wait, none to wait until ready
+     * @param ready Called with the index, returns true to stop waiting
+     * @return The last result of ready
+     */
+    template <class Ready>
+    static auto wait(std::atomic<std::uint32_t>& word,
+                     std::atomic<std::uint32_t>& waiting,
+                     std::optional<std::chrono::nanoseconds> timeout,
+                     Ready ready) -> bool {
+      auto value = word.load(std::memory_order_acquire);
+      if (ready(value)) {
+        return true;
+      }
+      const auto start = std::chrono::steady_clock::now();
+      waiting.store(1, std::memory_order_seq_cst);
+      while (!ready(value = word.load(std::memory_order_seq_cst))) {
+        timespec ts{};
+        const timespec* limit = nullptr;
+        if (timeout) {
+          const auto left = start + *timeout - std::chrono::steady_clock::now();
+          if (left <= std::chrono::nanoseconds::zero()) {
+            break;
+          }
+          const auto seconds =
+              std::chrono::duration_cast<std::chrono::seconds>(left);
+          ts = {seconds.count(),
+                std::chrono::duration_cast<std::chrono::nanoseconds>(left -
+                                                                     seconds)
+                    .count()};
+          limit = &ts;
+        }
+        ::syscall(SYS_futex, &word, FUTEX_WAIT, value, limit, nullptr, 0);
+      }
+      waiting.store(0, std::memory_order_relaxed);
+      return ready(value);
+    }
+
+    /**
+     * @brief Map the memfd shared
+     *
+     * @param size The mapping size
+     * @return An error_code, empty if successful
+     */
+    auto map(std::size_t size) -> boost::system::error_code {
+      void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd,
+                       0);
+      if (p == MAP_FAILED) {
+        return lastError();
+      }
+      _mapping = {static_cast<std::byte*>(p), size};
+      return {};
+    }
+
+    /**
+     * @brief Cache the layout of a validated header
+     *
+     */
+    void attach() {
+      _mask = header()->slotCount - 1;
+      _stride = slotStride(header()->slotSize);
+    }
+
+    /**
+     * @brief Get the shared header
+     *
+     * @return A pointer to the header
+     */
+    [[nodiscard]] auto header() const -> Header* {
+      return std::launder(
+          reinterpret_cast<Header*>(_mapping.data()));  // NOLINT
+    }
+
+    /**
+     * @brief Get the start of a slot
+     *
+     * @param index The index of the slot, wrapped to the ring
+     * @return A pointer to the slot header
+     */
+    [[nodiscard]] auto slot(std::uint32_t index) const -> std::byte* {
+      return _mapping.data() + HEADER_SIZE + ((index & _mask) * _stride);
+    }
+
+    /// The memfd
+    int _fd{-1};
+
+    /// The shared mapping
+    std::span<std::byte> _mapping;
+
+    /// slotCount - 1
+    std::size_t _mask{};
+
+    /// Distance between slots
+    std::size_t _stride{};
+  };
+
+  /**
+   * @brief Output pipeline stage publishing decoded frames into a shared PCM
+   * ring. Use as the function of a PipelineStage<PcmFrame, ...>. Waits for
+   * the consumer while the ring is full, which holds the stage's input queue
+   * and propagates backpressure upstream.
+   *
+   */
+  class SharedPcmOutput {
+  public:
+    /**
+     * @brief Construct a new Shared Pcm Output object
+     *
+     * @param ring The ring to publish to. Must outlive this object.
+     */
+    explicit SharedPcmOutput(SharedPcmRing& ring) : _ring(&ring) {}
+
+    /**
+     * @brief Publish a batch of frames. Frames larger than a slot are
+     * truncated.
+     *
+     * @param frames The frames
+     * @param stop Stops waiting for the consumer, remaining frames are
+     * dropped
+     */
+    void operator()(std::span<PcmFrame> frames, std::stop_token stop) {
+      BRILLIANT_TRACE_SCOPE("SharedPcmOutput::publish", _ring);
+      for (auto& frame : frames) {
+        while (!_ring->tryPublish(frame.samples, frame.playout)) {
+          if (stop.stop_requested()) {
+            return;
+          }
+          BRILLIANT_TRACE_SCOPE("SharedPcmRing::waitForSpace", _ring);
+          _ring->waitForSpace(WAIT_SLICE);
+        }
+      }
+    }
+
+  private:
+    /// Longest wait for the consumer before the stop token is checked again
+    static constexpr std::chrono::milliseconds WAIT_SLICE{10};
+
+    /// The ring
+    SharedPcmRing* _ring;
+  };
+
+  /**
+   * @brief Reference consumer for the player process. Waits for each frame,
+   * sleeps until its playout time and passes the samples to the sink while
+   * they are still in the shared mapping.
+   *
+   * @tparam Sink Callable as sink(PcmSlot), e.g. a write to the audio device
+   * @param ring The ring opened with SharedPcmRing::open()
+   * @param sink Receives each frame at its playout time
+   * @param stop Stops the consumer
+   * @return The number of frames consumed
+   */
+  template <class Sink>
+  auto consumePcm(SharedPcmRing& ring, Sink&& sink, std::stop_token stop)
+      -> std::uint64_t {
+    constexpr std::chrono::milliseconds waitSlice{10};
+    std::uint64_t consumed = 0;
+    while (!stop.stop_requested()) {
+      if (!ring.waitForFrame(waitSlice)) {
+        continue;
+      }
+      const auto frame = ring.peek();
+      std::this_thread::sleep_until(frame->playout);
+      sink(*frame);
+      ring.release();
+      ++consumed;
+    }
+    return consumed;
+  }
+
+}  // namespace brilliant::snapcast
+
+#endif
@@ -0,0 +1,615 @@
+#pragma once
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory_resource>
+#include <random>
+#include <span>
+
+#include "BrilliantSnapcast/VirtualClock.hpp"
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief Latency distribution of a simulated link
+   *
+   */
+  enum class LatencyDistribution : std::uint8_t {
+    /// Every segment is delayed by the base latency
+    CONSTANT,
+
+    /// Base latency plus a uniform sample in [-jitter, jitter]
+    UNIFORM,
+
+    /// Normal distribution with the base latency as mean and jitter as
+    /// standard deviation
+    NORMAL,
+
+    /// Base latency plus a heavy tailed Pareto sample scaled by jitter
+    PARETO
+  };
+
+  /**
+   * @brief Impairments applied to one direction of a simulated connection
+   *
+   */
+  struct ImpairmentProfile {
+    /// Base one way latency
+    std::chrono::microseconds latency{};
+
+    /// Jitter, interpretation depends on the distribution
+    std::chrono::microseconds jitter{};
+
+    /// Latency distribution
+    LatencyDistribution distribution{LatencyDistribution::CONSTANT};
+
+    /// Link bandwidth in bytes per second, 0 for unlimited
+    std::uint64_t bandwidth{};
+
+    /// Maximum number of bytes returned by a single read, 0 for unlimited
+    std::size_t maxReadSize{};
+
+    /// Probability that a read returns a random number of the available bytes
+    double shortReadProbability{};
+
+    /// Probability that a segment is held back by a stall
+    double stallProbability{};
+
+    /// Duration of a stall
+    std::chrono::microseconds stallDuration{};
+
+    /// Seed for the random number generator
+    std::uint64_t seed{1};
+  };
+
+  /**
+   * @brief One direction of a simulated connection. Bytes sent are delivered
+   * in order to the reader once their virtual arrival time is reached.
+   *
+   */
+  class SimulatedLink {
+  public:
+    /**
+     * @brief Construct a new Simulated Link object
+     *
+     * @param clock The virtual clock. Must outlive this object.
+     * @param profile The impairments applied to the link
+     * @param mr A pointer to the memory resource used for buffered bytes
+     */
+    SimulatedLink(VirtualClock& clock, const ImpairmentProfile& profile,
+                  std::pmr::memory_resource* mr)
+        : _clock(&clock),
+          _profile(profile),
+          _random(profile.seed),
+          _bytes(mr),
+          _segments(mr) {}
+
+    /**
+     * @brief Send bytes over the link at the current virtual time
+     *
+     * @param data The bytes to send
+     */
+    void send(std::span<const std::byte> data) {
+      if (data.empty()) {
+        return;
+      }
+      const auto now = _clock->now();
+      const auto txStart = std::max(now, _linkFreeAt);
+      std::chrono::microseconds txTime{};
+      if (_profile.bandwidth > 0) {
+        constexpr std::uint64_t USEC_PER_SEC = 1'000'000;
+        txTime = std::chrono::microseconds(
+            static_cast<std::int64_t>((data.size() * USEC_PER_SEC) /
+                                      _profile.bandwidth));
+      }
+      _linkFreeAt = txStart + txTime;
+
+      auto arrival = _linkFreeAt + sampleLatency();
+      if (_profile.stallProbability > 0.0 &&
+          std::bernoulli_distribution(_profile.stallProbability)(_random)) {
+        arrival += _profile.stallDuration;
+      }
+      // a stream delivers in order
+      arrival = std::max(arrival, _lastArrival);
+      _lastArrival = arrival;
+
+      _bytes.insert(_bytes.end(), data.begin(), data.end());
+      _sent += data.size();
+      _segments.push_back({arrival, _sent});
+      pump();
+    }
+
+    /**
+     * @brief Close the sending end. The reader receives eof once all sent
+     * bytes were delivered.
+     *
+     */
+    void shutdown() {
+      _shutdown = true;
+      pump();
+    }
+
+    /**
+     * @brief Abort a pending read with operation_aborted. Later reads fail
+     * too.
+     *
+     */
+    void abort() {
+      _aborted = true;
+      pump();
+    }
+
+    /**
+     * @brief Complete a pending read with operation_aborted. Later reads are
+     * not affected.
+     *
+     */
+    void cancel() {
+      if (_reader) {
+        complete(boost::asio::error::operation_aborted);
+      }
+    }
+
+    /**
+     * @brief Read bytes which have arrived. Completes once at least one byte
+     * arrived, the link was shut down or aborted, or with operation_aborted
+     * once the cancellation slot associated with the handler is emitted.
+     *
+     * @tparam Executor The executor type
+     * @tparam Buffers The buffer sequence type
+     * @tparam Handler The handler type
+     * @param exec The executor the completion is posted to
+     * @param buffers The buffers to read into
+     * @param handler The completion handler
+     */
+    template <class Executor, class Buffers, class Handler>
+    void asyncRead(Executor exec, const Buffers& buffers, Handler handler) {
+      if (auto slot = boost::asio::get_associated_cancellation_slot(handler);
+          slot.is_connected()) {
+        // a late emit finds another read or none and has no effect
+        slot.assign([this, read = _readStarts + 1](
+                        boost::asio::cancellation_type /*type*/) {
+          if (_readStarts == read) {
+            cancel();
+          }
+        });
+      }
+      ++_readStarts;
+      _reader = [this, exec, buffers, h = std::move(handler)](
+                    boost::system::error_code ec) mutable {
+        std::size_t n = 0;
+        if (!ec) {
+          n = take(buffers);
+        }
+        ++_reads;
+        boost::asio::post(exec, std::bind(std::move(h), ec, n));
+      };
+      pump();
+    }
+
+    /**
+     * @brief Get the number of completed reads
+     *
+     * @return The number of reads
+     */
+    [[nodiscard]] auto reads() const -> std::size_t { return _reads; }
+
+    /**
+     * @brief Get the number of sent bytes not yet read
+     *
+     * @return The number of bytes in flight or waiting to be read
+     */
+    [[nodiscard]] auto pending() const -> std::size_t { return _bytes.size(); }
+
+  private:
+    /**
+     * @brief A group of bytes sent together
+     *
+     */
+    struct Segment {
+      /// Virtual arrival time
+      VirtualClock::time_point arrival;
+
+      /// Total number of bytes sent up to and including this segment
+      std::uint64_t end;
+    };
+
+    /**
+     * @brief Complete the pending read if possible, otherwise schedule it for
+     * the next arrival
+     *
+     */
+    void pump() {
+      if (!_reader) {
+        return;
+      }
+      // an abort does not wait for a scheduled arrival, the scheduled event
+      // finds no reader
+      if (_aborted) {
+        complete(boost::asio::error::operation_aborted);
+        return;
+      }
+      if (_scheduled) {
+        return;
+      }
+      if (_segments.empty()) {
+        if (_shutdown) {
+          complete(boost::asio::error::eof);
+        }
+        return;
+      }
+
+      const auto arrival = _segments.front().arrival;
+      if (arrival <= _clock->now()) {
+        complete({});
+        return;
+      }
+      _scheduled = true;
+      _clock->schedule(arrival, [this] {
+        _scheduled = false;
+        pump();
+      });
+    }
+
+    /**
+     * @brief Invoke the pending read
+     *
+     * @param ec The result of the read
+     */
+    void complete(boost::system::error_code ec) {
+      auto reader = std::move(_reader);
+      _reader = nullptr;
+      reader(ec);
+    }
+
+    /**
+     * @brief Copy arrived bytes into buffers, applying short reads
+     *
+     * @tparam Buffers The buffer sequence type
+     * @param buffers The buffers to copy into
+     * @return The number of bytes copied
+     */
+    template <class Buffers>
+    auto take(const Buffers& buffers) -> std::size_t {
+      const auto now = _clock->now();
+      std::uint64_t arrivedEnd = _received;
+      for (const auto& segment : _segments) {
+        if (segment.arrival > now) {
+          break;
+        }
+        arrivedEnd = segment.end;
+      }
+
+      auto n = std::min(static_cast<std::size_t>(arrivedEnd - _received),
+                        boost::asio::buffer_size(buffers));
+      if (_profile.maxReadSize > 0) {
+        n = std::min(n, _profile.maxReadSize);
+      }
+      if (n > 1 && _profile.shortReadProbability > 0.0 &&
+          std::bernoulli_distribution(_profile.shortReadProbability)(
+              _random)) {
+        n = std::uniform_int_distribution<std::size_t>(1, n)(_random);
+      }
+
+      auto src = _bytes.begin();
+      auto remaining = n;
+      for (auto it = boost::asio::buffer_sequence_begin(buffers);
+           remaining > 0 && it != boost::asio::buffer_sequence_end(buffers);
+           ++it) {
+        const boost::asio::mutable_buffer buffer(*it);
+        const auto count = std::min(remaining, buffer.size());
+        std::copy_n(src, count, static_cast<std::byte*>(buffer.data()));
+        src += static_cast<std::ptrdiff_t>(count);
+        remaining -= count;
+      }
+
+      _bytes.erase(_bytes.begin(), src);
+      _received += n;
+      while (!_segments.empty() && _segments.front().end <= _received) {
+        _segments.pop_front();
+      }
+      return n;
+    }
+
+    /**
+     * @brief Sample the latency of a segment
+     *
+     * @return The latency, never negative
+     */
+    auto sampleLatency() -> std::chrono::microseconds {
+      const auto base = static_cast<double>(_profile.latency.count());
+      const auto jitter = static_cast<double>(_profile.jitter.count());
+      double latency = base;
+      switch (_profile.distribution) {
+      case LatencyDistribution::UNIFORM:
+        latency += std::uniform_real_distribution<double>(-jitter,
+                                                          jitter)(_random);
+        break;
+      case LatencyDistribution::NORMAL:
+        if (jitter > 0.0) {
+          latency = std::normal_distribution<double>(base, jitter)(_random);
+        }
+        break;
+      case LatencyDistribution::PARETO: {
+        // inverse transform sampling with shape 2, minimum 1
+        constexpr double SHAPE = 2.0;
+        const auto u =
+            std::uniform_real_distribution<double>(0.0, 1.0)(_random);
+        latency += jitter * (1.0 / std::pow(1.0 - u, 1.0 / SHAPE) - 1.0);
+        break;
+      }
+      case LatencyDistribution::CONSTANT:
+      default:
+        break;
+      }
+      return std::chrono::microseconds(
+          static_cast<std::int64_t>(std::max(latency, 0.0)));
+    }
+
+    /// The virtual clock
+    VirtualClock* _clock;
+
+    /// Impairments
+    ImpairmentProfile _profile;
+
+    /// Random number generator
+    std::mt19937_64 _random;
+
+    /// Bytes sent and not yet read
+    std::pmr::deque<std::byte> _bytes;
+
+    /// Arrival times of the buffered bytes
+    std::pmr::deque<Segment> _segments;
+
+    /// The pending read
+    std::move_only_function<void(boost::system::error_code)> _reader;
+
+    /// Time the link finishes transmitting the last sent segment
+    VirtualClock::time_point _linkFreeAt{};
+
+    /// Arrival time of the last sent segment
+    VirtualClock::time_point _lastArrival{};
+
+    /// Total bytes sent
+    std::uint64_t _sent{};
+
+    /// Total bytes read
+    std::uint64_t _received{};
+
+    /// Number of completed reads
+    std::size_t _reads{};
+
+    /// Number of started reads, identifies the pending read
+    std::size_t _readStarts{};
+
+    /// Set while the pending read waits for a scheduled arrival
+    bool _scheduled{};
+
+    /// Set by shutdown()
+    bool _shutdown{};
+
+    /// Set by abort()
+    bool _aborted{};
+  };
+
+  /**
+   * @brief A socket whose reads and writes go over simulated links running on
+   * a VirtualClock. Usable as the Socket parameter of TcpClient.
+   *
+   * @tparam Protocol The protocol type reported by the socket
+   * @tparam Executor The executor type
+   */
+  template <class Protocol = boost::asio::ip::tcp,
+            class Executor = boost::asio::any_io_executor>
+  class SimulatedSocket {
+  public:
+    /// Type alias for the protocol
+    using protocol_type = Protocol;
+
+    /// Type alias for the executor
+    using executor_type = Executor;
+
+    /**
+     * @brief Construct a new Simulated Socket object
+     *
+     * @param exec The executor used for completions
+     * @param in The link the socket reads from. Must outlive this object.
+     * @param out The link the socket writes to. Must outlive this object.
+     */
+    SimulatedSocket(Executor exec, SimulatedLink& in, SimulatedLink& out)
+        : _exec(std::move(exec)), _in(&in), _out(&out) {}
+
+    /**
+     * @brief Get the executor
+     *
+     * @return The executor
+     */
+    [[nodiscard]] auto get_executor() const -> executor_type { return _exec; }
+
+    /**
+     * @brief Check if the socket is open
+     *
+     * @return True if open
+     */
+    [[nodiscard]] auto is_open() const -> bool { return _open; }
+
+    /**
+     * @brief Close the socket. Pending reads complete with operation_aborted
+     * and the peer reads eof.
+     *
+     */
+    void close() {
+      if (_open) {
+        _open = false;
+        _in->abort();
+        _out->shutdown();
+      }
+    }
+
+    /**
+     * @brief Cancel a pending read, it completes with operation_aborted.
+     * Writes complete immediately and are never pending.
+     *
+     * @param ec Set to indicate what error occurred, if any
+     */
+    void cancel(boost::system::error_code& ec) {
+      _in->cancel();
+      ec = {};
+    }
+
+    /**
+     * @brief Connect. Always succeeds immediately.
+     *
+     * @tparam Endpoint The endpoint type
+     * @tparam Handler The completion token type
+     * @param handler The completion token
+     * @return Depends on the completion token
+     */
+    template <class Endpoint, class Handler>
+    auto async_connect(const Endpoint& /*endpoint*/, Handler&& handler) {
+      return boost::asio::async_initiate<Handler,
+                                         void(boost::system::error_code)>(
+          [this](auto h) {
+            _open = true;
+            boost::asio::post(_exec, std::bind(std::move(h),
+                                               boost::system::error_code{}));
+          },
+          handler);
+    }
+
+    /**
+     * @brief Read bytes which arrived over the inbound link
+     *
+     * @tparam Buffers The buffer sequence type
+     * @tparam Handler The completion token type
+     * @param buffers The buffers to read into
+     * @param handler The completion token
+     * @return Depends on the completion token
+     */
+    template <class Buffers, class Handler>
+    auto async_read_some(const Buffers& buffers, Handler&& handler) {
+      return boost::asio::async_initiate<
+          Handler, void(boost::system::error_code, std::size_t)>(
+          [this](auto h, const Buffers& bufs) {
+            _in->asyncRead(_exec, bufs, std::move(h));
+          },
+          handler, buffers);
+    }
+
+    /**
+     * @brief Send bytes over the outbound link. Completes immediately, the
+     * link models transmission and propagation time.
+     *
+     * @tparam Buffers The buffer sequence type
+     * @tparam Handler The completion token type
+     * @param buffers The buffers to write
+     * @param handler The completion token
+     * @return Depends on the completion token
+     */
+    template <class Buffers, class Handler>
+    auto async_write_some(const Buffers& buffers, Handler&& handler) {
+      return boost::asio::async_initiate<
+          Handler, void(boost::system::error_code, std::size_t)>(
+          [this](auto h, const Buffers& bufs) {
+            std::size_t n = 0;
+            for (auto it = boost::asio::buffer_sequence_begin(bufs);
+                 it != boost::asio::buffer_sequence_end(bufs); ++it) {
+              const boost::asio::const_buffer buffer(*it);
+              _out->send({static_cast<const std::byte*>(buffer.data()),
+                          buffer.size()});
+              n += buffer.size();
+            }
+            boost::asio::post(_exec, std::bind(std::move(h),
+                                               boost::system::error_code{}, n));
+          },
+          handler, buffers);
+    }
+
+  private:
+    /// The executor
+    Executor _exec;
+
+    /// Inbound link
+    SimulatedLink* _in;
+
+    /// Outbound link
+    SimulatedLink* _out;
+
+    /// Open state
+    bool _open{true};
+  };
+
+  /**
+   * @brief A simulated bidirectional connection made of two links
+   *
+   */
+  class SimulatedConnection {
+  public:
+    /**
+     * @brief Construct a new Simulated Connection object
+     *
+     * @param clock The virtual clock. Must outlive this object.
+     * @param toClient Impairments from the server to the client
+     * @param toServer Impairments from the client to the server
+     * @param mr A pointer to the memory resource used for buffered bytes
+     */
+    SimulatedConnection(VirtualClock& clock, const ImpairmentProfile& toClient,
+                        const ImpairmentProfile& toServer,
+                        std::pmr::memory_resource* mr)
+        : _toClient(clock, toClient, mr), _toServer(clock, toServer, mr) {}
+
+    /**
+     * @brief Create the client end of the connection
+     *
+     * @tparam Protocol The protocol type reported by the socket
+     * @tparam Executor The executor type
+     * @param exec The executor used for completions
+     * @return The client socket
+     */
+    template <class Protocol = boost::asio::ip::tcp, class Executor>
+    auto client(Executor exec) -> SimulatedSocket<Protocol, Executor> {
+      return {std::move(exec), _toClient, _toServer};
+    }
+
+    /**
+     * @brief Create the server end of the connection
+     *
+     * @tparam Protocol The protocol type reported by the socket
+     * @tparam Executor The executor type
+     * @param exec The executor used for completions
+     * @return The server socket
+     */
+    template <class Protocol = boost::asio::ip::tcp, class Executor>
+    auto server(Executor exec) -> SimulatedSocket<Protocol, Executor> {
+      return {std::move(exec), _toServer, _toClient};
+    }
+
+    /**
+     * @brief Get the link from the server to the client
+     *
+     * @return The link
+     */
+    auto toClient() -> SimulatedLink& { return _toClient; }
+
+    /**
+     * @brief Get the link from the client to the server
+     *
+     * @return The link
+     */
+    auto toServer() -> SimulatedLink& { return _toServer; }
+
+  private:
+    /// Server to client link
+    SimulatedLink _toClient;
+
+    /// Client to server link
+    SimulatedLink _toServer;
+  };
+
+}  // namespace brilliant::snapcast
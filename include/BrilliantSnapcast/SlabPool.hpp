@@ -0,0 +1,331 @@
+#pragma once
+
+#include <atomic>
+#include <boost/system/error_code.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <utility>
+
+#include "BrilliantSnapcast/Message.hpp"
+
+namespace brilliant::snapcast {
+
+  class SlabPool;
+
+  /**
+   * @brief A reference counted handle to a slab of a SlabPool. Copies share
+   * the slab, the slab returns to the pool when the last handle is destroyed.
+   * Handles may be copied and destroyed on any thread.
+   *
+   */
+  class Slab {
+  public:
+    /**
+     * @brief Construct an empty Slab object
+     *
+     */
+    Slab() = default;
+
+    /**
+     * @brief Destroy the Slab object. Returns the slab to its pool if this is
+     * the last handle.
+     *
+     */
+    ~Slab() { release(); }
+
+    /**
+     * @brief Copy constructor. Shares the slab.
+     *
+     * @param other The slab to share
+     */
+    Slab(const Slab& other) : _header(other._header) {
+      if (_header) {
+        _header->refs.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * @brief Copy assignment operator. Shares the slab.
+     *
+     * @param other The slab to share
+     * @return A reference to this object
+     */
+    auto operator=(const Slab& other) -> Slab& {
+      Slab copy(other);
+      std::swap(_header, copy._header);
+      return *this;
+    }
+
+    /**
+     * @brief Move constructor
+     *
+     * @param other The object to move from
+     */
+    Slab(Slab&& other) noexcept
+        : _header(std::exchange(other._header, nullptr)) {}
+
+    /**
+     * @brief Move assignment operator
+     *
+     * @param other The object to move from
+     * @return A reference to this object
+     */
+    auto operator=(Slab&& other) noexcept -> Slab& {
+      std::swap(_header, other._header);
+      return *this;
+    }
+
+    /**
+     * @brief Get the slab's storage
+     *
+     * @return A view of the storage. Empty if this handle is empty.
+     */
+    [[nodiscard]] auto data() const -> std::span<std::byte>;
+
+    /**
+     * @brief Get the number of handles sharing the slab
+     *
+     * @return The number of handles
+     */
+    [[nodiscard]] auto useCount() const -> std::size_t {
+      return _header ? _header->refs.load(std::memory_order_relaxed) : 0;
+    }
+
+    /**
+     * @brief Check if the handle refers to a slab
+     *
+     * @return True if the handle is not empty
+     */
+    explicit operator bool() const { return _header != nullptr; }
+
+  private:
+    friend class SlabPool;
+
+    /**
+     * @brief Control block in front of every slab's storage
+     *
+     */
+    struct alignas(64) Header {
+      /// Number of handles
+      std::atomic<std::uint32_t> refs;
+
+      /// The pool the slab belongs to
+      SlabPool* pool;
+
+      /// Next free slab while the slab is in the pool
+      Header* next;
+    };
+
+    /**
+     * @brief Construct a new Slab object
+     *
+     * @param header The control block, the handle takes ownership
+     */
+    explicit Slab(Header* header) : _header(header) {}
+
+    /**
+     * @brief Drop the reference and return the slab if it was the last one
+     *
+     */
+    void release();
+
+    /// The shared control block
+    Header* _header{};
+  };
+
+  /**
+   * @brief A fixed number of fixed size slabs allocated once from a memory
+   * resource. Messages are read into slabs so they can outlive the read
+   * buffer, e.g. sit in a jitter buffer or cross to another thread, without
+   * a copy.
+   *
+   * acquire() must be called from one thread at a time, slabs are returned
+   * lock free from any thread. The pool must outlive all handles.
+   *
+   */
+  class SlabPool {
+  public:
+    /**
+     * @brief Construct a new Slab Pool object
+     *
+     * @param slabSize The storage size of each slab, should fit the largest
+     * expected message including its header
+     * @param count The number of slabs
+     * @param mr A pointer to the memory resource the slabs are allocated from
+     */
+    SlabPool(std::size_t slabSize, std::size_t count,
+             std::pmr::memory_resource* mr)
+        : _slabSize(slabSize),
+          _stride(sizeof(Slab::Header) +
+                  (slabSize + alignof(Slab::Header) - 1) /
+                      alignof(Slab::Header) * alignof(Slab::Header)),
+          _count(count),
+          _mr(mr),
+          _memory(static_cast<std::byte*>(
+              mr->allocate(_stride * count, alignof(Slab::Header)))) {
+      for (std::size_t i = count; i > 0; --i) {
+        auto* header = ::new (_memory + (i - 1) * _stride) Slab::Header{
+            {0}, this, _free.load(std::memory_order_relaxed)};
+        _free.store(header, std::memory_order_relaxed);
+      }
+      _available.store(count, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Destroy the Slab Pool object. All handles must be destroyed.
+     *
+     */
+    ~SlabPool() {
+      _mr->deallocate(_memory, _stride * _count, alignof(Slab::Header));
+    }
+
+    /**
+     * @brief Deleted copy constructor
+     *
+     */
+    SlabPool(const SlabPool&) = delete;
+
+    /**
+     * @brief Deleted move constructor
+     *
+     */
+    SlabPool(SlabPool&&) = delete;
+
+    /**
+     * @brief Deleted copy assignment operator
+     *
+     * @return SlabPool&
+     */
+    auto operator=(const SlabPool&) -> SlabPool& = delete;
+
+    /**
+     * @brief Deleted move assignment operator
+     *
+     * @return SlabPool&
+     */
+    auto operator=(SlabPool&&) -> SlabPool& = delete;
+
+    /**
+     * @brief Take a free slab
+     *
+     * @return A handle to the slab if successful. no_buffer_space if every
+     * slab is in use.
+     */
+    auto acquire() -> std::expected<Slab, boost::system::error_code> {
+      auto* header = _free.load(std::memory_order_acquire);
+      // the only popping thread, a header cannot be popped and pushed again
+      // between the load and the exchange
+      while (header && !_free.compare_exchange_weak(
+                           header, header->next, std::memory_order_acquire,
+                           std::memory_order_acquire)) {
+      }
+      if (!header) {
+        return std::unexpected(boost::system::errc::make_error_code(
+            boost::system::errc::no_buffer_space));
+      }
+      _available.fetch_sub(1, std::memory_order_relaxed);
+      header->refs.store(1, std::memory_order_relaxed);
+      return Slab(header);
+    }
+
+    /**
+     * @brief Get the storage size of each slab
+     *
+     * @return The slab size in bytes
+     */
+    [[nodiscard]] auto slabSize() const -> std::size_t { return _slabSize; }
+
+    /**
+     * @brief Get the number of slabs
+     *
+     * @return The number of slabs
+     */
+    [[nodiscard]] auto capacity() const -> std::size_t { return _count; }
+
+    /**
+     * @brief Get the number of free slabs
+     *
+     * @return The number of free slabs
+     */
+    [[nodiscard]] auto available() const -> std::size_t {
+      return _available.load(std::memory_order_relaxed);
+    }
+
+  private:
+    friend class Slab;
+
+    /**
+     * @brief Return a slab whose last handle was destroyed
+     *
+     * @param header The control block of the slab
+     */
+    void recycle(Slab::Header* header) {
+      auto* head = _free.load(std::memory_order_relaxed);
+      do {
+        header->next = head;
+      } while (!_free.compare_exchange_weak(head, header,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+      _available.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Storage size of each slab
+    std::size_t _slabSize;
+
+    /// Distance between two control blocks
+    std::size_t _stride;
+
+    /// Number of slabs
+    std::size_t _count;
+
+    /// Memory resource of the slabs
+    std::pmr::memory_resource* _mr;
+
+    /// Memory of all slabs
+    std::byte* _memory;
+
+    /// Stack of free slabs
+    std::atomic<Slab::Header*> _free{};
+
+    /// Number of free slabs
+    std::atomic<std::size_t> _available{};
+  };
+
+  inline auto Slab::data() const -> std::span<std::byte> {
+    if (!_header) {
+      return {};
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return {reinterpret_cast<std::byte*>(_header + 1),
+            _header->pool->slabSize()};
+  }
+
+  inline void Slab::release() {
+    if (_header &&
+        _header->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      _header->pool->recycle(_header);
+    }
+    _header = nullptr;
+  }
+
+  /**
+   * @brief A message read into a slab. The views in message refer to the
+   * slab, copies share it and keep the message valid.
+   *
+   */
+  struct PooledMessage {
+    /// The message header
+    Base base;
+
+    /// The message
+    Message message;
+
+    /// The slab holding the raw frame
+    Slab slab;
+  };
+
+}  // namespace brilliant::snapcast
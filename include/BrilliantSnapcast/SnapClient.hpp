@@ -1,26 +1,40 @@
-
 #pragma once
 
+#include <algorithm>
 #include <boost/json.hpp>
+#ifndef BRILLIANT_SNAPCAST_SEPARATE_COMPILATION
 #include <boost/json/src.hpp>
+#endif
 #include <chrono>
+#include <concepts>
 #include <cstddef>
 #include <expected>
+#include <optional>
 
 #include "BrilliantSnapcast/BoostPmrWrapper.hpp"
+#include "BrilliantSnapcast/CaptureSink.hpp"
+#include "BrilliantSnapcast/CoroutineFrame.hpp"
 #include "BrilliantSnapcast/Message.hpp"
 #include "BrilliantSnapcast/MessageConv.hpp"
+#include "BrilliantSnapcast/ProtocolSession.hpp"
+#include "BrilliantSnapcast/SessionMetrics.hpp"
+#include "BrilliantSnapcast/SlabPool.hpp"
 #include "BrilliantSnapcast/TcpClient.hpp"
+#include "BrilliantSnapcast/Trace.hpp"
 #include "BrilliantSnapcast/UtilProvider.hpp"
 
 namespace brilliant::snapcast {
 
   /**
-   * @brief Implements snapcast client functionality
+   * @brief Implements snapcast client functionality. Adapts a
+   * ProtocolSession to a TcpClient, encoding and decoding is done by the
+   * session.
    *
    * @tparam Socket The socket type
+   * @tparam Clock The clock header times and read deadlines are taken from,
+   * a type with a static now() like std::chrono::steady_clock
    */
-  template <class Socket>
+  template <class Socket, class Clock = std::chrono::steady_clock>
   class SnapClient {
   public:
     /**
@@ -43,13 +57,15 @@ namespace brilliant::snapcast {
 
     /**
      * @brief Send a message to the server. Creates the message header and
-     * populates sent time using std::chrono::steady_clock.
+     * populates sent time using Clock.
      *
      * @tparam Extent The extent of the buffer
      * @param id The message id
      * @param message The message to send
      * @param buffer The buffer to copy serialized data to. Passed to network
      * calls once populated.
+     * @param timeout The longest time the write may take, empty to wait until
+     * it completes. An expired timeout fails with timed_out.
      * @return If the operation was successful, returns a Time struct containing
      * the time that was populated in the outgoing header. This should be used
      * when sending Time messagese to calculate network latency. If the
@@ -57,62 +73,84 @@ namespace brilliant::snapcast {
      */
     template <std::size_t Extent>
     auto send(std::uint16_t id, Message message,
-              std::span<std::byte, Extent> buffer)
+              std::span<std::byte, Extent> buffer,
+              std::optional<std::chrono::steady_clock::duration> timeout =
+                  std::nullopt)
         -> boost::asio::awaitable<
             std::expected<Time, boost::system::error_code>> {
-      auto base = std::visit(
-          [this, &buffer, id](auto& msg) {
-            using type = std::decay_t<decltype(msg)>;
-
-            const auto now =
-                std::chrono::duration_cast<std::chrono::microseconds>(
-                    std::chrono::steady_clock::now().time_since_epoch());
-            const auto nowSecs =
-                std::chrono::duration_cast<std::chrono::seconds>(now);
-
-            Base b{};
-            b.id = id;
-            b.refersTo = 0;  // TODO(david):
-            b.sent.sec = static_cast<std::uint32_t>(nowSecs.count());
-            b.sent.usec = static_cast<std::uint32_t>((now - nowSecs).count());
-            if constexpr (std::is_same_v<type, Hello>) {
-              b.type = MessageType::HELLO;
-              b.size = static_cast<std::uint32_t>(sizeof(msg.size) + msg.size);
-            } else if constexpr (std::is_same_v<type, ClientInfo>) {
-              b.type = MessageType::CLIENT_INFO;
-              b.size = static_cast<std::uint32_t>(sizeof(msg.size) + msg.size);
-            } else if constexpr (std::is_same_v<type, ServerSettings>) {
-              b.type = MessageType::SERVER_SETTINGS;
-              b.size = static_cast<std::uint32_t>(sizeof(msg.size) + msg.size);
-            } else if constexpr (std::is_same_v<type, Time>) {
-              b.type = MessageType::TIME;
-              b.size = static_cast<std::uint32_t>(sizeof(Time));
-              msg = b.sent;
-            } else if constexpr (std::is_same_v<type, WireChunk>) {
-              b.type = MessageType::WIRE_CHUNK;
-              b.size = static_cast<std::uint32_t>(sizeof(Time) +
-                                                  sizeof(msg.size) + msg.size);
-            } else {
-              std::unreachable();
-            }
-            return b;
-          },
-          message);
+      BRILLIANT_TRACE_SCOPE("SnapClient::send", _tcpClient);
+      const auto sent = currentTime();
+      auto encoded = ProtocolSession::encode(id, message, sent, buffer);
+      if (!encoded) {
+        co_return std::unexpected(encoded.error());
+      }
 
-      if (std::size(buffer) < (sizeof(Base) + base.size)) {
-        co_return std::unexpected(boost::system::errc::make_error_code(
-            boost::system::errc::no_buffer_space));
+      boost::system::error_code ec;
+      {
+        BRILLIANT_TRACE_SCOPE("TcpClient::write", _tcpClient);
+        std::tie(ec, std::ignore) = co_await write(encoded.value(), timeout);
+      }
+      if (ec) {
+        if (_metrics) {
+          _metrics->writeError();
+        }
+        co_return std::unexpected(ec);
+      }
+      if (std::holds_alternative<Time>(message)) {
+        _tcpClient->quickAck();
       }
+      if (_metrics) {
+        _metrics->sent(messageType(message), encoded->size());
+      }
+      co_return sent;
+    }
 
-      brilliant::snapcast::write(buffer.first(sizeof(Base)), base);
-      brilliant::snapcast::write(buffer.subspan(sizeof(Base), base.size),
-                                 message);
-      auto [ec, size] =
-          co_await _tcpClient->write(buffer.first(sizeof(Base) + base.size));
+    /**
+     * @brief Send a fixed size message from a buffer of static extent. The
+     * frame is encoded without a size check or a std::visit, a buffer smaller
+     * than FRAME_SIZE<T> fails to compile.
+     *
+     * @tparam T The message type, e.g. Time
+     * @tparam Extent The extent of the buffer
+     * @param id The message id
+     * @param message The message to send
+     * @param buffer The buffer to copy serialized data to, e.g. a
+     * std::array<std::byte, FRAME_SIZE<Time>>
+     * @param timeout The longest time the write may take, empty to wait until
+     * it completes. An expired timeout fails with timed_out.
+     * @return The time populated in the outgoing header if successful. An
+     * error_code otherwise.
+     */
+    template <class T, std::size_t Extent>
+      requires(WireTraits<T>::FIXED_SIZE && Extent != std::dynamic_extent)
+    auto send(std::uint16_t id, T message, std::span<std::byte, Extent> buffer,
+              std::optional<std::chrono::steady_clock::duration> timeout =
+                  std::nullopt)
+        -> boost::asio::awaitable<
+            std::expected<Time, boost::system::error_code>> {
+      BRILLIANT_TRACE_SCOPE("SnapClient::send", _tcpClient);
+      const auto sent = currentTime();
+      const std::span<std::byte> frame =
+          ProtocolSession::encode(id, message, sent, buffer);
+
+      boost::system::error_code ec;
+      {
+        BRILLIANT_TRACE_SCOPE("TcpClient::write", _tcpClient);
+        std::tie(ec, std::ignore) = co_await write(frame, timeout);
+      }
       if (ec) {
+        if (_metrics) {
+          _metrics->writeError();
+        }
         co_return std::unexpected(ec);
       }
-      co_return base.sent;
+      if constexpr (std::same_as<T, Time>) {
+        _tcpClient->quickAck();
+      }
+      if (_metrics) {
+        _metrics->sent(WireTraits<T>::TYPE, frame.size());
+      }
+      co_return sent;
     }
 
     /**
@@ -187,73 +225,375 @@ namespace brilliant::snapcast {
                    std::span<std::byte, Extent> buffer)
         -> boost::asio::awaitable<
             std::expected<Time, boost::system::error_code>> {
-      const auto macAddress = utilProvider.getMacAddress(0, _mr);
       BoostPmrWrapper wrapper(_mr);
-      boost::json::storage_ptr jsonAlloc(&wrapper);
-      boost::json::object helloJson({{"MAC", macAddress},
-                                     {"HostName", ""},
-                                     {"Version", "0.34"},
-                                     {"ClientName", "Snapclient"},
-                                     {"OS", utilProvider.getOS(_mr)},
-                                     {"Arch", utilProvider.getArch(_mr)},
-                                     {"Instance", ""},
-                                     {"ID", macAddress},
-                                     {"SnapStreamProtocolVersion", 2}},
-                                    jsonAlloc);
+      auto helloJson =
+          helloObject(utilProvider, boost::json::storage_ptr(&wrapper));
       return sendJson(0, MessageType::HELLO, helloJson, serializer, buffer);
     }
 
+    /**
+     * @brief Build the json object of a Hello message. Populates platform
+     * dependent information from the UtilProvider instance.
+     *
+     * @param utilProvider A reference to the util provider
+     * @param storage The storage the object is allocated from
+     * @return The json object
+     */
+    auto helloObject(UtilProvider& utilProvider,
+                     boost::json::storage_ptr storage) -> boost::json::object {
+      const auto macAddress =
+          utilProvider.getMacAddress(_tcpClient->nativeHandle(), _mr);
+      return boost::json::object({{"MAC", macAddress},
+                                  {"HostName", ""},
+                                  {"Version", "0.34"},
+                                  {"ClientName", "Snapclient"},
+                                  {"OS", utilProvider.getOS(_mr)},
+                                  {"Arch", utilProvider.getArch(_mr)},
+                                  {"Instance", ""},
+                                  {"ID", macAddress},
+                                  {"SnapStreamProtocolVersion", 2}},
+                                 std::move(storage));
+    }
+
     /**
      * @brief Read a message from the server
      *
      * @tparam Extent The buffer extent
      * @param buffer View of storage to read raw data into
+     * @param timeout The longest time reading the whole message may take,
+     * empty to wait until a message arrives. An expired timeout fails with
+     * timed_out and may leave part of a message unread, the connection
+     * should be closed.
      * @return The message header and message read from the data stream if
-     * successful. An error code otherwise.
+     * successful. no_buffer_space if the message does not fit the buffer,
+     * its body is read and discarded so the next read starts at the
+     * following message. bad_message if the message is malformed, the next
+     * read starts at the following message as well. An error code
+     * otherwise.
      */
     template <std::size_t Extent>
-    auto read(std::span<std::byte, Extent> buffer)
+    auto read(std::span<std::byte, Extent> buffer,
+              std::optional<std::chrono::steady_clock::duration> timeout =
+                  std::nullopt)
         -> boost::asio::awaitable<std::expected<std::tuple<Base, Message>,
                                                 boost::system::error_code>> {
-      if (std::size(buffer) < sizeof(Base)) {
-        co_return std::unexpected(boost::system::errc::make_error_code(
-            boost::system::errc::no_buffer_space));
-      }
+      static_assert(Extent == std::dynamic_extent || Extent >= HEADER_SIZE,
+                    "buffer is too small for a message header");
+      return readFrame(
+          buffer, [](std::span<std::byte> region) { return region; },
+          deadline(timeout));
+    }
 
-      auto [ec, size] = co_await _tcpClient->read(buffer.first(sizeof(Base)));
-      if (ec) {
-        co_return std::unexpected(ec);
+    /**
+     * @brief Read a message from the server into a registered buffer. With
+     * the io_uring backend every socket read is a fixed buffer operation.
+     *
+     * @param buffer The registered buffer to read raw data into
+     * @param timeout The longest time reading the whole message may take,
+     * empty to wait until a message arrives. An expired timeout fails with
+     * timed_out, the connection should be closed.
+     * @return The message header and message read from the data stream if
+     * successful. no_buffer_space if the message does not fit the buffer,
+     * its body is read and discarded so the next read starts at the
+     * following message. bad_message if the message is malformed, the next
+     * read starts at the following message as well. An error code
+     * otherwise.
+     */
+    auto read(const boost::asio::mutable_registered_buffer& buffer,
+              std::optional<std::chrono::steady_clock::duration> timeout =
+                  std::nullopt)
+        -> boost::asio::awaitable<std::expected<std::tuple<Base, Message>,
+                                                boost::system::error_code>> {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      auto* data = reinterpret_cast<std::byte*>(buffer.data());
+      std::span<std::byte> storage(data, buffer.size());
+      return readFrame(
+          storage,
+          [buffer, data](std::span<std::byte> region) {
+            return boost::asio::buffer(
+                buffer + static_cast<std::size_t>(region.data() - data),
+                region.size());
+          },
+          deadline(timeout));
+    }
+
+    /**
+     * @brief Read a message from the server into a slab of a pool. The
+     * returned message holds the slab, so it stays valid after further reads
+     * and can be queued or passed to another thread without a copy.
+     *
+     * @param pool The pool the slab is taken from
+     * @param timeout The longest time reading the whole message may take,
+     * empty to wait until a message arrives. An expired timeout fails with
+     * timed_out, the connection should be closed.
+     * @return The message and the slab holding it if successful.
+     * no_buffer_space if the pool is empty, nothing is read then, or if the
+     * message does not fit a slab, its body is read and discarded so the
+     * next read starts at the following message and the slab is returned to
+     * the pool. bad_message if the message is malformed, its slab is
+     * returned as well. An error code otherwise.
+     */
+    auto read(SlabPool& pool,
+              std::optional<std::chrono::steady_clock::duration> timeout =
+                  std::nullopt)
+        -> boost::asio::awaitable<
+            std::expected<PooledMessage, boost::system::error_code>> {
+      auto slab = pool.acquire();
+      if (!slab) {
+        co_return std::unexpected(slab.error());
       }
+      auto result = co_await read(slab->data(), timeout);
+      if (!result) {
+        co_return std::unexpected(result.error());
+      }
+      auto& [base, message] = *result;
+      co_return PooledMessage{base, message, std::move(*slab)};
+    }
+
+    /**
+     * @brief Set the sink which records every frame read
+     *
+     * @param capture A pointer to the sink, null to stop capturing. Must
+     * outlive this object or be reset.
+     */
+    void setCapture(CaptureSink* capture) { _capture = capture; }
+
+    /**
+     * @brief Get the Allocator object
+     *
+     * @return An allocator using the memory resource of this object. Frames
+     * of coroutines started by this object are allocated with it.
+     */
+    [[nodiscard]] auto getAllocator() const
+        -> std::pmr::polymorphic_allocator<void> {
+      return _mr;
+    }
+
+    /**
+     * @brief Get the executor of the underlying socket
+     *
+     * @return The executor
+     */
+    [[nodiscard]] auto getExecutor() { return _tcpClient->getExecutor(); }
 
+    /**
+     * @brief Set the metrics updated by reads and sends. Time messages read
+     * are treated as replies from the server.
+     *
+     * @param metrics A pointer to the metrics, null to stop collecting. Must
+     * outlive this object or be reset.
+     */
+    void setMetrics(SessionMetrics* metrics) { _metrics = metrics; }
+
+    /**
+     * @brief Get the current time of Clock as a Time
+     *
+     * @return The current time
+     */
+    static auto currentTime() -> Time {
       const auto now = std::chrono::duration_cast<std::chrono::microseconds>(
-          std::chrono::steady_clock::now().time_since_epoch());
+          Clock::now().time_since_epoch());
       const auto nowSecs =
           std::chrono::duration_cast<std::chrono::seconds>(now);
+      return {.sec = static_cast<std::uint32_t>(nowSecs.count()),
+              .usec = static_cast<std::uint32_t>((now - nowSecs).count())};
+    }
+
+  private:
+    /**
+     * @brief Read a single frame
+     *
+     * @tparam ToBuffer Callable type
+     * @param storage The storage the frame is read into
+     * @param toBuffer Converts a region of storage into a buffer accepted by
+     * TcpClient::read
+     * @param deadline The time the whole frame must be read by, empty to
+     * wait indefinitely
+     * @return The message header and message read from the data stream if
+     * successful. An error code otherwise.
+     */
+    template <class ToBuffer>
+    auto readFrame(
+        std::span<std::byte> storage, ToBuffer toBuffer,
+        std::optional<typename Clock::time_point> deadline)
+        -> boost::asio::awaitable<std::expected<std::tuple<Base, Message>,
+                                                boost::system::error_code>> {
+      BRILLIANT_TRACE_SCOPE("SnapClient::read", _tcpClient);
+      ProtocolSession session(storage);
+      // set while the body of a message too large for the storage is
+      // skipped, so the next read starts at a header
+      std::optional<boost::system::error_code> skipped;
+      while (true) {
+        auto frame = [&session, &skipped]
+            -> std::expected<std::optional<Frame>, boost::system::error_code> {
+          if (skipped) {
+            return std::nullopt;
+          }
+          BRILLIANT_TRACE_SCOPE("ProtocolSession::next", nullptr);
+          return session.next();
+        }();
+        if (!frame) {
+          if (_metrics &&
+              frame.error() == boost::system::errc::no_buffer_space) {
+            _metrics->bufferSpaceError();
+          }
+          if (session.state() != ProtocolSession::State::DISCARD) {
+            co_return std::unexpected(frame.error());
+          }
+          skipped = frame.error();
+        } else if (frame->has_value()) {
+          const auto& base = frame->value().base;
+          if (_capture) {
+            _capture->record(base.received, session.header(),
+                             storage.first(base.size));
+          }
+          if (_metrics) {
+            collect(base, frame->value().message);
+          }
+          co_return std::make_tuple(base, frame->value().message);
+        }
 
-      Base base{};
-      brilliant::snapcast::read(buffer, base);
-      if (std::size(buffer) < base.size) {
-        co_return std::unexpected(boost::system::errc::make_error_code(
-            boost::system::errc::no_buffer_space));
+        boost::system::error_code ec;
+        std::size_t size = 0;
+        {
+          BRILLIANT_TRACE_SCOPE("TcpClient::read", _tcpClient);
+          if (deadline) {
+            // a deadline passed between reads times out the next one at once
+            const auto remaining = std::max(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    *deadline - Clock::now()),
+                std::chrono::steady_clock::duration::zero());
+            std::tie(ec, size) = co_await _tcpClient->read(
+                toBuffer(session.prepare()), remaining);
+          } else {
+            std::tie(ec, size) =
+                co_await _tcpClient->read(toBuffer(session.prepare()));
+          }
+        }
+        if (ec) {
+          if (_metrics) {
+            _metrics->readError();
+          }
+          co_return std::unexpected(ec);
+        }
+        session.commit(size, currentTime());
+        if (skipped && session.state() != ProtocolSession::State::DISCARD) {
+          co_return std::unexpected(*skipped);
+        }
       }
+    }
 
-      std::tie(ec, size) = co_await _tcpClient->read(buffer.first(base.size));
-      if (ec) {
-        co_return std::unexpected(ec);
+    /**
+     * @brief Write a frame, with a timeout if one is given
+     *
+     * @param frame The encoded frame
+     * @param timeout The longest time the write may take, empty to wait
+     * until it completes
+     * @return An error_code and the number of bytes written
+     */
+    auto write(std::span<std::byte> frame,
+               std::optional<std::chrono::steady_clock::duration> timeout)
+        -> boost::asio::awaitable<
+            std::tuple<boost::system::error_code, std::size_t>> {
+      if (timeout) {
+        return _tcpClient->write(frame, *timeout);
       }
+      return _tcpClient->write(frame);
+    }
 
-      base.received.sec = static_cast<std::uint32_t>(nowSecs.count());
-      base.received.usec = static_cast<std::uint32_t>((now - nowSecs).count());
-      co_return std::make_tuple(base,
-                                brilliant::snapcast::read(buffer, base.type));
+    /**
+     * @brief Turn a timeout into the time it expires at
+     *
+     * @param timeout The timeout, may be empty
+     * @return The time the timeout expires at, empty if timeout is empty
+     */
+    static auto deadline(
+        std::optional<std::chrono::steady_clock::duration> timeout)
+        -> std::optional<typename Clock::time_point> {
+      if (!timeout) {
+        return std::nullopt;
+      }
+      return Clock::now() +
+             std::chrono::duration_cast<typename Clock::duration>(*timeout);
+    }
+
+    /**
+     * @brief Update metrics with a frame which was read
+     *
+     * @param base The message header
+     * @param message The message
+     */
+    void collect(const Base& base, const Message& message) {
+      _metrics->received(base.type, HEADER_SIZE + base.size);
+      if (const auto* time = std::get_if<Time>(&message)) {
+        _metrics->timeReply(base, *time);
+      }
+      _metrics->readToDispatch(toSignedMicroseconds(currentTime()) -
+                               toSignedMicroseconds(base.received));
     }
 
-  private:
     /// Pointer to the tcp client
     TcpClient<Socket>* _tcpClient;
 
     /// Pointer to the memory resource
     std::pmr::memory_resource* _mr;
+
+    /// Pointer to the capture sink, may be null
+    CaptureSink* _capture{};
+
+    /// Pointer to the metrics, may be null
+    SessionMetrics* _metrics{};
   };
 
+#ifdef BRILLIANT_SNAPCAST_SEPARATE_COMPILATION
+  // instantiated once in the compiled library, see src/SnapClient.cpp
+  extern template class SnapClient<boost::asio::ip::tcp::socket>;
+
+  extern template auto SnapClient<boost::asio::ip::tcp::socket>::send(
+      std::uint16_t id, Message message, std::span<std::byte> buffer,
+      std::optional<std::chrono::steady_clock::duration> timeout)
+      -> boost::asio::awaitable<
+          std::expected<Time, boost::system::error_code>>;
+
+  extern template auto SnapClient<boost::asio::ip::tcp::socket>::sendJson(
+      uint16_t id, MessageType type, boost::json::object& object,
+      boost::json::serializer& serializer, std::span<std::byte> buffer)
+      -> boost::asio::awaitable<
+          std::expected<Time, boost::system::error_code>>;
+
+  extern template auto SnapClient<boost::asio::ip::tcp::socket>::sendHello(
+      UtilProvider& utilProvider, boost::json::serializer& serializer,
+      std::span<std::byte> buffer)
+      -> boost::asio::awaitable<
+          std::expected<Time, boost::system::error_code>>;
+
+  extern template auto SnapClient<boost::asio::ip::tcp::socket>::read(
+      std::span<std::byte> buffer,
+      std::optional<std::chrono::steady_clock::duration> timeout)
+      -> boost::asio::awaitable<std::expected<std::tuple<Base, Message>,
+                                              boost::system::error_code>>;
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+  extern template class SnapClient<
+      boost::asio::local::stream_protocol::socket>;
+#endif
+#endif
+
 }  // namespace brilliant::snapcast
+
+#if BRILLIANT_SNAPCAST_PMR_FRAMES
+/**
+ * @brief Allocate the frames of SnapClient coroutines from its memory resource
+ *
+ */
+// NOLINTBEGIN(cert-dcl58-cpp)
+template <class T, class Executor, class Socket, class Clock, class... Args>
+struct std::coroutine_traits<boost::asio::awaitable<T, Executor>,
+                             brilliant::snapcast::SnapClient<Socket, Clock>&,
+                             Args...> {
+  /// Type alias for the promise type
+  using promise_type = brilliant::snapcast::PmrAwaitableFrame<
+      T, Executor, brilliant::snapcast::SnapClient<Socket, Clock>, Args...>;
+};
+// NOLINTEND(cert-dcl58-cpp)
+#endif
@@ -0,0 +1,299 @@
+#pragma once
+
+#include <array>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <expected>
+#include <memory_resource>
+#include <vector>
+
+#include "BrilliantSnapcast/Message.hpp"
+#include "BrilliantSnapcast/ProtocolSession.hpp"
+#include "BrilliantSnapcast/SessionMetrics.hpp"
+#include "BrilliantSnapcast/SharedFrame.hpp"
+#include "BrilliantSnapcast/SnapClient.hpp"
+#include "BrilliantSnapcast/TcpClient.hpp"
+#include "BrilliantSnapcast/Trace.hpp"
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief Implements the server side of the snapcast protocol for a single
+   * connected client. Replies are sent directly, broadcast frames are queued
+   * and written by run() with gathered writes. The queue is bounded, frames
+   * enqueued while it is full are dropped so a slow client never causes
+   * unbounded buffering.
+   *
+   * All member functions must be called from the executor of the socket.
+   *
+   * @tparam Socket The socket type
+   * @tparam QueueDepth The maximum number of queued frames
+   */
+  template <class Socket, std::size_t QueueDepth = 8>
+  class SnapServerSession {
+  public:
+    /**
+     * @brief Construct a new Snap Server Session object
+     *
+     * @param tcpClient The tcp client wrapping the accepted socket
+     */
+    explicit SnapServerSession(TcpClient<Socket>& tcpClient)
+        : _tcpClient(&tcpClient),
+          _peer(tcpClient),
+          _wakeup(tcpClient.getExecutor()) {
+      _wakeup.expires_at(boost::asio::steady_timer::time_point::max());
+    }
+
+    /**
+     * @brief Read a message from the client
+     *
+     * @tparam Extent The buffer extent
+     * @param buffer View of storage to read raw data into
+     * @return The message header and message if successful. An error code
+     * otherwise.
+     */
+    template <std::size_t Extent>
+    auto read(std::span<std::byte, Extent> buffer)
+        -> boost::asio::awaitable<std::expected<std::tuple<Base, Message>,
+                                                boost::system::error_code>> {
+      return _peer.read(buffer);
+    }
+
+    /**
+     * @brief Send a message to the client immediately, bypassing the queue
+     *
+     * @param id The message id
+     * @param message The message to send
+     * @param buffer The buffer to serialize the message into
+     * @param refersTo The id of the message this message replies to
+     * @return The sent time stored in the header if successful. An error_code
+     * otherwise.
+     */
+    auto send(std::uint16_t id, Message message, std::span<std::byte> buffer,
+              std::uint16_t refersTo = 0)
+        -> boost::asio::awaitable<
+            std::expected<Time, boost::system::error_code>> {
+      const auto sent = SnapClient<Socket>::currentTime();
+      auto encoded =
+          ProtocolSession::encode(id, message, sent, buffer, refersTo);
+      if (!encoded) {
+        co_return std::unexpected(encoded.error());
+      }
+
+      auto [ec, size] = co_await _tcpClient->write(encoded.value());
+      if (ec) {
+        co_return std::unexpected(ec);
+      }
+      co_return sent;
+    }
+
+    /**
+     * @brief Reply to a Time message from the client. The reply carries the
+     * difference between the time the request was received and the time it
+     * was sent, as the snapcast server does. The difference is negative
+     * when the client clock is ahead and normalized like a timeval.
+     *
+     * @param request The header of the received Time message
+     * @param buffer The buffer to serialize the reply into
+     * @return The sent time stored in the header if successful. An error_code
+     * otherwise.
+     */
+    auto replyTime(const Base& request, std::span<std::byte> buffer)
+        -> boost::asio::awaitable<
+            std::expected<Time, boost::system::error_code>> {
+      const auto diff =
+          fromSignedMicroseconds(toSignedMicroseconds(request.received) -
+                                 toSignedMicroseconds(request.sent));
+
+      if (std::size(buffer) < HEADER_SIZE + WIRE_SIZE<Time>) {
+        co_return std::unexpected(boost::system::errc::make_error_code(
+            boost::system::errc::no_buffer_space));
+      }
+
+      const auto sent = SnapClient<Socket>::currentTime();
+      Base base{};
+      base.type = MessageType::TIME;
+      base.refersTo = request.id;
+      base.sent = sent;
+      base.size = WIRE_SIZE<Time>;
+      brilliant::snapcast::write(buffer.first(HEADER_SIZE), base);
+      brilliant::snapcast::write(buffer.subspan(HEADER_SIZE, WIRE_SIZE<Time>),
+                                 diff);
+
+      auto [ec, size] = co_await _tcpClient->write(
+          buffer.first(HEADER_SIZE + WIRE_SIZE<Time>));
+      if (ec) {
+        co_return std::unexpected(ec);
+      }
+      co_return sent;
+    }
+
+    /**
+     * @brief Queue a frame to be written by run(). The frame is shared, not
+     * copied.
+     *
+     * @param frame The frame to queue
+     * @return True if the frame was queued, false if the queue is full and the
+     * frame was dropped
+     */
+    auto enqueue(const SharedFrame& frame) -> bool {
+      if (_count == QueueDepth) {
+        ++_dropped;
+        return false;
+      }
+      _queue[(_head + _count) % QueueDepth] = frame;
+      ++_count;
+      _wakeup.cancel();
+      return true;
+    }
+
+    /**
+     * @brief Write queued frames until the connection fails or close() is
+     * called. All frames queued at the time of a write are sent with one
+     * gathered write.
+     *
+     * @return The error_code which ended the loop. operation_aborted if
+     * close() was called.
+     */
+    auto run() -> boost::asio::awaitable<boost::system::error_code> {
+      auto handler = boost::asio::bind_allocator(
+          _tcpClient->getAllocator(), boost::asio::use_awaitable);
+      while (!_closed) {
+        if (_count == 0) {
+          co_await _wakeup.async_wait(boost::asio::as_tuple(handler));
+          continue;
+        }
+
+        const auto inFlight = _count;
+        std::array<boost::asio::const_buffer, QueueDepth> buffers{};
+        for (std::size_t i = 0; i < inFlight; ++i) {
+          const auto bytes = _queue[(_head + i) % QueueDepth].bytes();
+          buffers[i] = boost::asio::buffer(bytes.data(), bytes.size());
+        }
+
+        boost::system::error_code ec;
+        {
+          BRILLIANT_TRACE_SCOPE("SnapServerSession::write", _tcpClient);
+          std::tie(ec, std::ignore) = co_await _tcpClient->write(
+              std::span(buffers).first(inFlight));
+        }
+        for (std::size_t i = 0; i < inFlight; ++i) {
+          _queue[_head] = SharedFrame{};
+          _head = (_head + 1) % QueueDepth;
+        }
+        _count -= inFlight;
+        if (ec) {
+          co_return ec;
+        }
+      }
+      co_return boost::asio::error::operation_aborted;
+    }
+
+    /**
+     * @brief Stop run() once the current write finishes
+     *
+     */
+    void close() {
+      _closed = true;
+      _wakeup.cancel();
+    }
+
+    /**
+     * @brief Get the number of frames dropped because the queue was full
+     *
+     * @return The number of dropped frames
+     */
+    [[nodiscard]] auto dropped() const -> std::size_t { return _dropped; }
+
+    /**
+     * @brief Get the number of queued frames
+     *
+     * @return The number of queued frames, including frames being written
+     */
+    [[nodiscard]] auto queued() const -> std::size_t { return _count; }
+
+  private:
+    /// Pointer to the tcp client
+    TcpClient<Socket>* _tcpClient;
+
+    /// Used to read messages from the client
+    SnapClient<Socket> _peer;
+
+    /// Wakes run() when a frame is queued
+    boost::asio::steady_timer _wakeup;
+
+    /// Queued frames
+    std::array<SharedFrame, QueueDepth> _queue{};
+
+    /// Index of the oldest queued frame
+    std::size_t _head{};
+
+    /// Number of queued frames
+    std::size_t _count{};
+
+    /// Number of dropped frames
+    std::size_t _dropped{};
+
+    /// Set by close()
+    bool _closed{};
+  };
+
+  /**
+   * @brief Distributes shared frames to a set of server sessions
+   *
+   * @tparam Session The server session type
+   */
+  template <class Session>
+  class FanOut {
+  public:
+    /**
+     * @brief Construct a new Fan Out object
+     *
+     * @param mr A pointer to the memory resource used for the session list
+     */
+    explicit FanOut(std::pmr::memory_resource* mr) : _sessions(mr) {}
+
+    /**
+     * @brief Add a session
+     *
+     * @param session The session. Must outlive this object or be removed.
+     */
+    void add(Session& session) { _sessions.push_back(&session); }
+
+    /**
+     * @brief Remove a session
+     *
+     * @param session The session to remove
+     */
+    void remove(Session& session) { std::erase(_sessions, &session); }
+
+    /**
+     * @brief Queue a frame on every session
+     *
+     * @param frame The frame to publish
+     * @return The number of sessions the frame was queued on
+     */
+    auto publish(const SharedFrame& frame) -> std::size_t {
+      std::size_t delivered = 0;
+      for (auto* session : _sessions) {
+        if (session->enqueue(frame)) {
+          ++delivered;
+        }
+      }
+      return delivered;
+    }
+
+    /**
+     * @brief Get the number of sessions
+     *
+     * @return The number of sessions
+     */
+    [[nodiscard]] auto size() const -> std::size_t { return _sessions.size(); }
+
+  private:
+    /// The sessions
+    std::pmr::vector<Session*> _sessions;
+  };
+
+}  // namespace brilliant::snapcast
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief An integer socket option Asio has no type for, e.g. TCP_QUICKACK.
+   * Satisfies Asio's SettableSocketOption and GettableSocketOption.
+   *
+   * @tparam Level The option level, e.g. IPPROTO_TCP
+   * @tparam Name The option name
+   */
+  template <int Level, int Name>
+  class IntegerOption {
+  public:
+    /**
+     * @brief Construct a new Integer Option object
+     *
+     * @param value The option value
+     */
+    explicit IntegerOption(int value) : _value(value) {}
+
+    /**
+     * @brief Get the option level
+     *
+     * @tparam Protocol The protocol type
+     * @return The level
+     */
+    template <class Protocol>
+    [[nodiscard]] auto level(const Protocol& /*protocol*/) const -> int {
+      return Level;
+    }
+
+    /**
+     * @brief Get the option name
+     *
+     * @tparam Protocol The protocol type
+     * @return The name
+     */
+    template <class Protocol>
+    [[nodiscard]] auto name(const Protocol& /*protocol*/) const -> int {
+      return Name;
+    }
+
+    /**
+     * @brief Get the option value passed to setsockopt
+     *
+     * @tparam Protocol The protocol type
+     * @return A pointer to the value
+     */
+    template <class Protocol>
+    [[nodiscard]] auto data(const Protocol& /*protocol*/) const -> const int* {
+      return &_value;
+    }
+
+    /**
+     * @brief Get the option value written by getsockopt
+     *
+     * @tparam Protocol The protocol type
+     * @return A pointer to the value
+     */
+    template <class Protocol>
+    [[nodiscard]] auto data(const Protocol& /*protocol*/) -> int* {
+      return &_value;
+    }
+
+    /**
+     * @brief Get the size of the option value
+     *
+     * @tparam Protocol The protocol type
+     * @return The size in bytes
+     */
+    template <class Protocol>
+    [[nodiscard]] auto size(const Protocol& /*protocol*/) const
+        -> std::size_t {
+      return sizeof(_value);
+    }
+
+    /**
+     * @brief Check the size written by getsockopt
+     *
+     * @tparam Protocol The protocol type
+     * @param size The size in bytes
+     */
+    template <class Protocol>
+    void resize(const Protocol& /*protocol*/, std::size_t size) {
+      if (size != sizeof(_value)) {
+        _value = 0;
+      }
+    }
+
+    /**
+     * @brief Get the option value
+     *
+     * @return The value
+     */
+    [[nodiscard]] auto value() const -> int { return _value; }
+
+  private:
+    /// The option value
+    int _value;
+  };
+
+  /**
+   * @brief Socket options of a TCP connection. Every member left at its
+   * default keeps the system's setting. Options the platform lacks are
+   * skipped.
+   *
+   */
+  struct SocketTuning {
+    /// Disable Nagle's algorithm, a Time probe written behind another small
+    /// message is sent at once instead of waiting for an ACK
+    bool noDelay{};
+
+    /// Acknowledge received data at once after every Time message, so the
+    /// server's reply is not held back by a delayed ACK. Linux only, the
+    /// kernel returns to delayed ACKs by itself, see TcpClient::quickAck().
+    bool quickAck{};
+
+    /// Receive buffer size in bytes, 0 keeps the system's size. See
+    /// receiveBufferFor().
+    int receiveBuffer{};
+
+    /// Busy polling time of blocking receives, 0 disables it. Linux only,
+    /// raising it above net.core.busy_read requires CAP_NET_ADMIN.
+    std::chrono::microseconds busyPoll{};
+
+    /// Longest time sent data may stay unacknowledged before the kernel
+    /// drops the connection, 0 keeps the system's timeout of many minutes.
+    /// Linux only.
+    std::chrono::milliseconds userTimeout{};
+
+    /**
+     * @brief Compare two tunings
+     *
+     * @return True if all options are equal
+     */
+    auto operator==(const SocketTuning&) const -> bool = default;
+
+    /**
+     * @brief The system's settings, no options are set
+     *
+     * @return The tuning
+     */
+    static constexpr auto system() -> SocketTuning { return {}; }
+
+    /**
+     * @brief Small messages are sent and acknowledged at once, buffers keep
+     * the system's size
+     *
+     * @return The tuning
+     */
+    static constexpr auto interactive() -> SocketTuning {
+      SocketTuning result;
+      result.noDelay = true;
+      result.quickAck = true;
+      return result;
+    }
+
+    /**
+     * @brief interactive() with a receive buffer sized to the jitter buffer,
+     * busy polling and a user timeout of the jitter buffer, so a dead
+     * connection is dropped before the buffered audio runs out
+     *
+     * @param jitterBuffer The buffer of the server, bufferMs of the server
+     * settings
+     * @param bytesPerSecond The stream's encoded data rate
+     * @return The tuning
+     */
+    static constexpr auto lowLatency(std::chrono::milliseconds jitterBuffer,
+                                     std::uint32_t bytesPerSecond)
+        -> SocketTuning {
+      constexpr std::chrono::microseconds BUSY_POLL{50};
+      auto result = interactive();
+      result.receiveBuffer = receiveBufferFor(jitterBuffer, bytesPerSecond);
+      result.busyPoll = BUSY_POLL;
+      result.userTimeout = jitterBuffer;
+      return result;
+    }
+
+    /**
+     * @brief Size a receive buffer to hold one jitter buffer of audio. A
+     * larger buffer only queues data the player cannot use yet and hides a
+     * stalled reader from the server's flow control.
+     *
+     * @param jitterBuffer The buffer of the server
+     * @param bytesPerSecond The stream's encoded data rate
+     * @return The buffer size in bytes, at least 16 KiB
+     */
+    static constexpr auto receiveBufferFor(
+        std::chrono::milliseconds jitterBuffer, std::uint32_t bytesPerSecond)
+        -> int {
+      constexpr std::int64_t MIN_SIZE = 16 * 1024;
+      constexpr std::int64_t MAX_SIZE = 64 * 1024 * 1024;
+      constexpr std::int64_t MS_PER_SECOND = 1000;
+      const auto bytes = jitterBuffer.count() * bytesPerSecond / MS_PER_SECOND;
+      return static_cast<int>(std::clamp(bytes, MIN_SIZE, MAX_SIZE));
+    }
+  };
+
+  /**
+   * @brief A TCP socket which accepts socket options
+   *
+   * @tparam Socket The socket type
+   */
+  template <class Socket>
+  concept TunableSocket =
+      std::same_as<typename Socket::protocol_type, boost::asio::ip::tcp> &&
+      requires(Socket& socket, boost::system::error_code& ec) {
+        socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+      };
+
+  /**
+   * @brief Set the options of a tuning on a socket. Every option is tried,
+   * a rejected one does not stop the others.
+   *
+   * @tparam Socket The socket type
+   * @param socket The open socket
+   * @param tuning The options
+   * @return The error of the first rejected option, empty if all were set
+   */
+  template <TunableSocket Socket>
+  auto applyTuning(Socket& socket, const SocketTuning& tuning)
+      -> boost::system::error_code {
+    boost::system::error_code first;
+    const auto set = [&socket, &first](const auto& option) {
+      boost::system::error_code ec;
+      socket.set_option(option, ec);
+      if (ec && !first) {
+        first = ec;
+      }
+    };
+
+    if (tuning.noDelay) {
+      set(boost::asio::ip::tcp::no_delay(true));
+    }
+    if (tuning.receiveBuffer > 0) {
+      set(boost::asio::socket_base::receive_buffer_size(tuning.receiveBuffer));
+    }
+#ifdef TCP_QUICKACK
+    if (tuning.quickAck) {
+      set(IntegerOption<IPPROTO_TCP, TCP_QUICKACK>(1));
+    }
+#endif
+#ifdef SO_BUSY_POLL
+    if (tuning.busyPoll.count() > 0) {
+      set(IntegerOption<SOL_SOCKET, SO_BUSY_POLL>(
+          static_cast<int>(tuning.busyPoll.count())));
+    }
+#endif
+#ifdef TCP_USER_TIMEOUT
+    if (tuning.userTimeout.count() > 0) {
+      set(IntegerOption<IPPROTO_TCP, TCP_USER_TIMEOUT>(
+          static_cast<int>(tuning.userTimeout.count())));
+    }
+#endif
+    return first;
+  }
+
+}  // namespace brilliant::snapcast
@@ -0,0 +1,552 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <boost/system/error_code.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <memory_resource>
+#include <new>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "BrilliantSnapcast/Decoder.hpp"
+#include "BrilliantSnapcast/Message.hpp"
+#include "BrilliantSnapcast/Pipeline.hpp"
+#include "BrilliantSnapcast/SlabPool.hpp"
+#include "BrilliantSnapcast/Trace.hpp"
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief An encoded chunk handed to the decode stage
+   *
+   */
+  struct StreamChunk {
+    /// The stream the chunk belongs to, as returned by
+    /// StreamDecoder::prepare()
+    std::uint32_t stream{};
+
+    /// Time the first sample is due at the output, on the steady clock
+    std::chrono::steady_clock::time_point playout;
+
+    /// The encoded payload, a view into slab
+    std::span<const std::byte> payload;
+
+    /// The slab the chunk was read into, keeps the payload valid. It
+    /// returns to its pool lock free on the thread which drops the chunk.
+    Slab slab;
+  };
+
+  /**
+   * @brief Decode pipeline stage which switches streams without a gap. A new
+   * codec header is passed to prepare() as soon as it is received, the next
+   * decoder is then created and primed on a builder thread while the stage
+   * keeps decoding the chunks of the current stream still queued in front of
+   * it. The switch happens at the first chunk of the new stream: the old
+   * decoder is flushed and its tail cut at that chunk's playout time, and the
+   * priming frames of the new decoder are discarded so its first sample plays
+   * at that time.
+   *
+   * Both decoders live in a pool of two fixed size slots allocated once. A
+   * slot is handed to the factory as a monotonic resource without upstream,
+   * the retired decoder is destroyed by the builder before the slot is
+   * reused, never on the decode path.
+   *
+   * prepare() is called by the network stage, the function call operator by
+   * the stage thread. Use as the function of a PipelineStage<StreamChunk,
+   * std::reference_wrapper<StreamDecoder>>.
+   *
+   */
+  class StreamDecoder {
+  public:
+    /**
+     * @brief A copy of the decoder statistics at one point in time
+     *
+     */
+    struct Snapshot {
+      /// Number of stream switches
+      std::uint64_t switches{};
+
+      /// Number of switches which waited for the builder
+      std::uint64_t waits{};
+
+      /// Number of chunks dropped because their stream was not prepared,
+      /// could not be created or the chunk failed to decode
+      std::uint64_t dropped{};
+    };
+
+    /**
+     * @brief Construct a new Stream Decoder object. Starts the builder
+     * thread.
+     *
+     * @param factory Creates the decoders. Must outlive this object.
+     * @param output The queue decoded frames are pushed to. Must outlive this
+     * object.
+     * @param slotSize The budget of each decoder in bytes. It holds the
+     * copied codec header, the decoder and everything the decoder allocates
+     * until it is retired. The arena is monotonic, memory the decoder frees
+     * is only reclaimed when the slot is reused, so decoders should allocate
+     * their state when created or primed. A stream whose header or decoder
+     * does not fit fails like an unknown codec and its chunks are dropped.
+     * @param mr A pointer to the memory resource used for the pool and the
+     * decoded frames
+     */
+    StreamDecoder(DecoderFactory& factory, StageQueue<PcmFrame>& output,
+                  std::size_t slotSize, std::pmr::memory_resource* mr)
+        : _factory(&factory),
+          _output(&output),
+          _slotSize((slotSize + SLOT_ALIGNMENT - 1) & ~(SLOT_ALIGNMENT - 1)),
+          _mr(mr),
+          _pool(static_cast<std::byte*>(
+              mr->allocate(SLOT_COUNT * _slotSize, SLOT_ALIGNMENT))),
+          _codec(mr),
+          _payload(mr) {
+      for (std::size_t i = 0; i < SLOT_COUNT; ++i) {
+        _slots[i].memory = _pool + i * _slotSize;
+      }
+      _builder = std::jthread([this](std::stop_token stop) { build(stop); });
+    }
+
+    /**
+     * @brief Destroy the Stream Decoder object. Stops the builder thread and
+     * destroys the decoders.
+     *
+     */
+    ~StreamDecoder() {
+      _builder.request_stop();
+      _builder.join();
+      for (auto& slot : _slots) {
+        retire(slot);
+      }
+      _mr->deallocate(_pool, SLOT_COUNT * _slotSize, SLOT_ALIGNMENT);
+    }
+
+    /**
+     * @brief Deleted copy constructor
+     *
+     */
+    StreamDecoder(const StreamDecoder&) = delete;
+
+    /**
+     * @brief Deleted move constructor
+     *
+     */
+    StreamDecoder(StreamDecoder&&) = delete;
+
+    /**
+     * @brief Deleted copy assignment operator
+     *
+     * @return StreamDecoder&
+     */
+    auto operator=(const StreamDecoder&) -> StreamDecoder& = delete;
+
+    /**
+     * @brief Deleted move assignment operator
+     *
+     * @return StreamDecoder&
+     */
+    auto operator=(StreamDecoder&&) -> StreamDecoder& = delete;
+
+    /**
+     * @brief Start building the decoder for a new stream. The header is
+     * copied, the call does not wait for the decoder.
+     *
+     * @param header The codec header of the new stream
+     * @return The stream id to tag the stream's chunks with if successful.
+     * device_or_resource_busy if the previously prepared stream has not
+     * started yet.
+     */
+    auto prepare(const CodecHeader& header)
+        -> std::expected<std::uint32_t, boost::system::error_code> {
+      const auto requested = _requested.load(std::memory_order_relaxed);
+      if (requested != _activated.load(std::memory_order_acquire) &&
+          requested != _failed.load(std::memory_order_acquire)) {
+        return std::unexpected(boost::system::errc::make_error_code(
+            boost::system::errc::device_or_resource_busy));
+      }
+      _codec.assign(header.codec, header.codecSize);
+      _payload.assign(header.payload, header.payload + header.size);
+      _requested.store(requested + 1, std::memory_order_release);
+      signal();
+      return requested + 1;
+    }
+
+    /**
+     * @brief Decode a batch of chunks and push the frames to the output
+     * queue. Switches to a prepared stream at its first chunk.
+     *
+     * @param chunks The chunks
+     * @param stop Stops waiting for the builder and the output queue
+     */
+    void operator()(std::span<StreamChunk> chunks, std::stop_token stop) {
+      for (auto& chunk : chunks) {
+        const auto& slot = _slots[_active];
+        if ((chunk.stream != slot.stream || !slot.decoder) &&
+            !activate(chunk, stop)) {
+          _dropped.fetch_add(1, std::memory_order_relaxed);
+          continue;
+        }
+        decode(chunk, stop);
+      }
+    }
+
+    /**
+     * @brief Copy the decoder statistics. Safe to call from any thread.
+     *
+     * @param out The snapshot to write to
+     */
+    void snapshot(Snapshot& out) const {
+      out.switches = _switches.load(std::memory_order_relaxed);
+      out.waits = _waits.load(std::memory_order_relaxed);
+      out.dropped = _dropped.load(std::memory_order_relaxed);
+    }
+
+  private:
+    /**
+     * @brief A pool slot holding one decoder
+     *
+     */
+    struct Slot {
+      /// The slot's memory in the pool
+      std::byte* memory{};
+
+      /// Resource over the slot's memory, recreated for every decoder
+      std::optional<std::pmr::monotonic_buffer_resource> arena;
+
+      /// The decoder, constructed from the arena
+      Decoder* decoder{};
+
+      /// The stream the decoder belongs to
+      std::uint32_t stream{};
+    };
+
+    /**
+     * @brief Create and prime decoders for prepared streams until stop is
+     * requested
+     *
+     * @param stop The stop token of the thread
+     */
+    void build(const std::stop_token& stop) {
+      const std::stop_callback wake(stop, [this] { signal(); });
+      std::uint32_t built = 0;
+      while (true) {
+        const auto epoch = _epoch.load(std::memory_order_acquire);
+        if (stop.stop_requested()) {
+          return;
+        }
+        const auto stream = _requested.load(std::memory_order_acquire);
+        if (stream == built) {
+          _epoch.wait(epoch, std::memory_order_acquire);
+          continue;
+        }
+        built = stream;
+        if (!create(_slots[1 - _active], stream)) {
+          _failed.store(stream, std::memory_order_release);
+        }
+        _built.store(stream, std::memory_order_release);
+        signal();
+      }
+    }
+
+    /**
+     * @brief Create a decoder in a slot from the prepared header. Destroys
+     * the decoder previously held by the slot. The slot is left empty if the
+     * decoder cannot be created or primed.
+     *
+     * @param slot The spare slot
+     * @param stream The id of the prepared stream
+     * @return True if the decoder was created and primed
+     */
+    auto create(Slot& slot, std::uint32_t stream) -> bool {
+      BRILLIANT_TRACE_SCOPE("StreamDecoder::create", this);
+      retire(slot);
+      if (_codec.size() + _payload.size() > _slotSize) {
+        return false;
+      }
+      // the arena has no upstream and throws once the slot is exhausted, on
+      // this thread the exception would terminate the process
+      bool created = false;
+      try {
+        created = construct(slot, stream);
+      } catch (const std::bad_alloc&) {
+        created = false;
+      }
+      if (!created) {
+        retire(slot);
+      }
+      return created;
+    }
+
+    /**
+     * @brief Copy the prepared header into a new arena in an empty slot and
+     * create and prime the decoder from it
+     *
+     * @param slot The empty slot
+     * @param stream The id of the prepared stream
+     * @return True if the decoder was created and primed
+     */
+    auto construct(Slot& slot, std::uint32_t stream) -> bool {
+      auto& arena = slot.arena.emplace(slot.memory, _slotSize,
+                                       std::pmr::null_memory_resource());
+      std::pmr::polymorphic_allocator<std::byte> alloc(&arena);
+      auto* codec = alloc.allocate_object<char>(_codec.size());
+      std::ranges::copy(_codec, codec);
+      auto* payload = alloc.allocate(_payload.size());
+      std::ranges::copy(_payload, payload);
+      const CodecHeader header(std::string_view(codec, _codec.size()),
+                               std::span<std::byte>(payload, _payload.size()));
+
+      auto decoder = _factory->create(header, &arena);
+      if (!decoder) {
+        return false;
+      }
+      slot.decoder = *decoder;
+      slot.stream = stream;
+      return !slot.decoder->prime();
+    }
+
+    /**
+     * @brief Destroy the decoder of a slot and release its memory
+     *
+     * @param slot The slot
+     */
+    static void retire(Slot& slot) {
+      if (slot.decoder) {
+        slot.decoder->~Decoder();
+        slot.decoder = nullptr;
+      }
+      slot.arena.reset();
+    }
+
+    /**
+     * @brief Switch to the stream of a chunk, waiting for its decoder if it
+     * is still being built
+     *
+     * @param chunk The first chunk of the stream
+     * @param stop Stops waiting
+     * @return True if the stream's decoder is now active
+     */
+    auto activate(const StreamChunk& chunk, const std::stop_token& stop)
+        -> bool {
+      const auto stream = chunk.stream;
+      if (stream <= _slots[_active].stream ||
+          stream > _requested.load(std::memory_order_acquire)) {
+        return false;
+      }
+      if (_built.load(std::memory_order_acquire) < stream) {
+        _waits.fetch_add(1, std::memory_order_relaxed);
+        const std::stop_callback wake(stop, [this] { signal(); });
+        while (true) {
+          const auto epoch = _epoch.load(std::memory_order_acquire);
+          if (_built.load(std::memory_order_acquire) >= stream) {
+            break;
+          }
+          if (stop.stop_requested()) {
+            return false;
+          }
+          _epoch.wait(epoch, std::memory_order_acquire);
+        }
+      }
+      // a later stream is only prepared once this one started or failed
+      if (_built.load(std::memory_order_acquire) != stream ||
+          _failed.load(std::memory_order_acquire) >= stream) {
+        return false;
+      }
+
+      finish(chunk.playout, stop);
+      _active = 1 - _active;
+      const auto& decoder = *_slots[_active].decoder;
+      const auto format = decoder.format();
+      _rate = format.rate;
+      _frameSize = std::max<std::size_t>(format.frameSize(), 1);
+      _skip = decoder.delay() * _frameSize;
+      _delay = duration(decoder.delay());
+      _next.reset();
+      _activated.store(stream, std::memory_order_release);
+      _switches.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    /**
+     * @brief Flush the active decoder and push its tail, cut at the start of
+     * the next stream
+     *
+     * @param until Playout time of the next stream's first sample
+     * @param stop Stops waiting for the output queue
+     */
+    void finish(std::chrono::steady_clock::time_point until,
+                const std::stop_token& stop) {
+      auto* decoder = _slots[_active].decoder;
+      if (!decoder || !_next) {
+        return;
+      }
+      PcmFrame frame{*_next, std::pmr::vector<std::byte>(_mr)};
+      decoder->flush(frame.samples);
+      const auto room =
+          until > *_next ? frames(until - *_next) * _frameSize : 0;
+      if (frame.samples.size() > room) {
+        frame.samples.resize(room);
+      }
+      if (!frame.samples.empty()) {
+        _output->push(std::move(frame), stop);
+      }
+    }
+
+    /**
+     * @brief Decode a chunk of the active stream and push the frame
+     *
+     * @param chunk The chunk
+     * @param stop Stops waiting for the output queue
+     */
+    void decode(const StreamChunk& chunk, const std::stop_token& stop) {
+      BRILLIANT_TRACE_SCOPE("StreamDecoder::decode", this);
+      PcmFrame frame{chunk.playout - _delay, std::pmr::vector<std::byte>(_mr)};
+      if (_slots[_active].decoder->decode(chunk.payload, frame.samples)) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      if (_skip > 0) {
+        const auto skipped = std::min(_skip, frame.samples.size());
+        frame.samples.erase(frame.samples.begin(),
+                            frame.samples.begin() +
+                                static_cast<std::ptrdiff_t>(skipped));
+        _skip -= skipped;
+        frame.playout += duration(skipped / _frameSize);
+      }
+      if (frame.samples.empty()) {
+        return;
+      }
+      _next = frame.playout + duration(frame.samples.size() / _frameSize);
+      _output->push(std::move(frame), stop);
+    }
+
+    /**
+     * @brief Get the playing time of a number of frames of the active stream
+     *
+     * @param count The number of frames
+     * @return The duration
+     */
+    [[nodiscard]] auto duration(std::size_t count) const
+        -> std::chrono::steady_clock::duration {
+      if (_rate == 0) {
+        return {};
+      }
+      return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::nanoseconds(
+              static_cast<std::int64_t>(count * NANOS_PER_SECOND / _rate)));
+    }
+
+    /**
+     * @brief Get the number of frames of the active stream played in a
+     * duration
+     *
+     * @param time The duration, not negative
+     * @return The number of frames
+     */
+    [[nodiscard]] auto frames(std::chrono::steady_clock::duration time) const
+        -> std::size_t {
+      const auto nanos = static_cast<std::size_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(time).count());
+      return nanos * _rate / NANOS_PER_SECOND;
+    }
+
+    /**
+     * @brief Wake the builder and a decode stage waiting for it
+     *
+     */
+    void signal() {
+      _epoch.fetch_add(1, std::memory_order_release);
+      _epoch.notify_all();
+    }
+
+    /// Number of pool slots, the active and the next decoder
+    static constexpr std::size_t SLOT_COUNT = 2;
+
+    /// Alignment of the pool slots
+    static constexpr std::size_t SLOT_ALIGNMENT = 64;
+
+    /// Nanoseconds per second
+    static constexpr std::size_t NANOS_PER_SECOND = 1'000'000'000;
+
+    /// Creates the decoders
+    DecoderFactory* _factory;
+
+    /// The output queue
+    StageQueue<PcmFrame>* _output;
+
+    /// Size of a pool slot
+    std::size_t _slotSize;
+
+    /// Memory resource of the pool and the decoded frames
+    std::pmr::memory_resource* _mr;
+
+    /// Memory of all pool slots
+    std::byte* _pool;
+
+    /// The pool slots
+    std::array<Slot, SLOT_COUNT> _slots{};
+
+    /// Index of the slot holding the active decoder, the other one is spare.
+    /// Changed by the decode stage only while the builder is idle.
+    std::size_t _active{};
+
+    /// Sample rate of the active stream
+    std::uint32_t _rate{};
+
+    /// Frame size of the active stream in bytes
+    std::size_t _frameSize{1};
+
+    /// Bytes of priming output still to discard
+    std::size_t _skip{};
+
+    /// Output delay of the active decoder
+    std::chrono::steady_clock::duration _delay{};
+
+    /// Playout time following the last pushed sample of the active stream
+    std::optional<std::chrono::steady_clock::time_point> _next;
+
+    /// Codec name of the prepared stream
+    std::pmr::string _codec;
+
+    /// Codec payload of the prepared stream
+    std::pmr::vector<std::byte> _payload;
+
+    /// Id of the last prepared stream
+    std::atomic<std::uint32_t> _requested{};
+
+    /// Id of the last stream the builder finished with
+    std::atomic<std::uint32_t> _built{};
+
+    /// Id of the last stream whose decoder could not be created
+    std::atomic<std::uint32_t> _failed{};
+
+    /// Id of the active stream
+    std::atomic<std::uint32_t> _activated{};
+
+    /// Changed on every prepare, build and stop request, waited on by the
+    /// builder and the decode stage
+    std::atomic<std::uint32_t> _epoch{};
+
+    /// Number of stream switches
+    std::atomic<std::uint64_t> _switches{};
+
+    /// Number of switches which waited
+    std::atomic<std::uint64_t> _waits{};
+
+    /// Number of dropped chunks
+    std::atomic<std::uint64_t> _dropped{};
+
+    /// The builder thread
+    std::jthread _builder;
+  };
+
+}  // namespace brilliant::snapcast
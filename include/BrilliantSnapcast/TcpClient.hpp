@@ -1,14 +1,34 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <boost/asio.hpp>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstdint>
 #include <memory_resource>
+#include <optional>
 #include <span>
 #include <string_view>
+#include <vector>
+
+#include "BrilliantSnapcast/CoroutineFrame.hpp"
+#include "BrilliantSnapcast/SocketTuning.hpp"
 
 namespace brilliant::snapcast {
 
   /**
-   * @brief Encapsulates network calls for a TCP connection
+   * @brief Encapsulates network calls for a stream connection, TCP or any
+   * other Asio stream protocol such as Unix domain sockets
+   *
+   * Operations without a timeout wait until they complete or the socket is
+   * closed. The overloads taking a timeout fail with timed_out when it
+   * expires. Expiry cancels only the timed out operation through its
+   * cancellation slot, an operation in flight in the other direction
+   * continues. One read and one write may be in flight at a time. A
+   * connection whose read timed out should be closed, the read may have
+   * consumed part of a message.
    *
    * @tparam Socket The socket type
    */
@@ -28,7 +48,10 @@ namespace brilliant::snapcast {
      * @param mr A pointer to the memory resource
      */
     TcpClient(Socket socket, std::pmr::memory_resource* mr)
-        : _socket(std::move(socket)), _alloc(mr) {}
+        : _socket(std::move(socket)),
+          _alloc(mr),
+          _readDeadline{boost::asio::steady_timer(_socket.get_executor())},
+          _writeDeadline{boost::asio::steady_timer(_socket.get_executor())} {}
 
     /**
      * @brief Destroy the Tcp Client object. If the socket is open
@@ -59,44 +82,220 @@ namespace brilliant::snapcast {
      * @param other The object to move from
      */
     TcpClient(TcpClient&& other) noexcept
-        : TcpClient(std::move(other._socket), other._alloc.resource()) {}
+        : TcpClient(std::move(other._socket), other._alloc.resource()) {
+      _tuning = other._tuning;
+      _tuningError = other._tuningError;
+    }
 
     /**
-     * @brief Move assignment operator
+     * @brief Move assignment operator. Closes the socket of this object and
+     * cancels the deadlines of both objects, neither may have an operation
+     * in progress. The memory resource of this object is kept.
      *
      * @param other The object to move from
      * @return A reference to this object
      */
     auto operator=(TcpClient&& other) noexcept -> TcpClient& {
+      if (this == &other) {
+        return *this;
+      }
       disconnect();
+      cancel(_readDeadline);
+      cancel(_writeDeadline);
+      cancel(other._readDeadline);
+      cancel(other._writeDeadline);
       _socket = std::move(other._socket);
+      _tuning = other._tuning;
+      _tuningError = other._tuningError;
+      // the timers use the executor of the socket
+      _readDeadline.timer = std::move(other._readDeadline.timer);
+      _writeDeadline.timer = std::move(other._writeDeadline.timer);
+      return *this;
+    }
+
+    /**
+     * @brief Connect to a listener. The tuning set with setTuning() is
+     * applied before the connection is made, options the system rejects are
+     * skipped and reported by tuningError().
+     *
+     * @param endpoint The remote endpoint, e.g. an ip::tcp::endpoint or a
+     * local::stream_protocol::endpoint for a Unix domain socket
+     * @return An error_code. Empty if the operation was successful.
+     */
+    auto connect(typename protocol::endpoint endpoint)
+        -> boost::asio::awaitable<boost::system::error_code> {
+      return connectWith(endpoint,
+                         boost::asio::as_tuple(boost::asio::bind_allocator(
+                             _alloc, boost::asio::use_awaitable)));
     }
 
     /**
-     * @brief Connect to a listener
+     * @brief Connect to a listener. Only available for IP protocols.
      *
      * @param ip The ip of the remote endpoint
      * @param port The port of the remote endpoint
      * @return An error_code. Empty if the operation was successful.
      */
     auto connect(std::string_view ip, boost::asio::ip::port_type port)
-        -> boost::asio::awaitable<boost::system::error_code> {
+        -> boost::asio::awaitable<boost::system::error_code>
+      requires std::constructible_from<typename protocol::endpoint,
+                                       boost::asio::ip::address,
+                                       boost::asio::ip::port_type>
+    {
+      // copy to a stack buffer to guarantee a trailing 0 without allocating
+      std::array<char, MAX_ADDRESS_LENGTH + 1> ipStr{};
+      if (ip.size() > MAX_ADDRESS_LENGTH) {
+        co_return boost::asio::error::invalid_argument;
+      }
+      std::ranges::copy(ip, ipStr.begin());
       boost::system::error_code ec{};
-      // copy to string to guarantee trailing 0
-      std::pmr::string ipStr(ip.data(), ip.size(), _alloc);
-      auto address = boost::asio::ip::make_address(ipStr.c_str(), ec);
+      auto address = boost::asio::ip::make_address(ipStr.data(), ec);
       if (ec) {
         co_return ec;
       }
+      co_return co_await connect(typename protocol::endpoint(address, port));
+    }
 
-      auto allocatorBoundHandler =
-          boost::asio::bind_allocator(_alloc, boost::asio::use_awaitable);
-      typename protocol::endpoint ep(address, port);
-      std::tie(ec) = co_await _socket.async_connect(
-          ep, boost::asio::as_tuple(allocatorBoundHandler));
+    /**
+     * @brief Connect to a listener, giving up after a timeout
+     *
+     * @param endpoint The remote endpoint
+     * @param timeout The longest time the attempt may take
+     * @return An error_code. Empty if the operation was successful, timed_out
+     * if the timeout expired.
+     */
+    auto connect(typename protocol::endpoint endpoint,
+                 std::chrono::steady_clock::duration timeout)
+        -> boost::asio::awaitable<boost::system::error_code> {
+      arm(_writeDeadline, timeout);
+      auto ec = co_await connectWith(endpoint, timed(_writeDeadline));
+      disarm(_writeDeadline, ec);
       co_return ec;
     }
 
+    /**
+     * @brief Connect to the first of several endpoints which accepts, racing
+     * the attempts like happy eyeballs (RFC 8305). The next endpoint is tried
+     * when the previous attempt failed or did not complete within the attempt
+     * delay, earlier attempts keep running. Once one succeeds the others are
+     * closed. Each attempt is tuned like connect(endpoint).
+     *
+     * @param endpoints The endpoints in the order to try them, see
+     * Resolver::resolve()
+     * @param attemptDelay The time to wait for an attempt before starting the
+     * next, RFC 8305 recommends 250 ms
+     * @return An error_code. Empty if a connection was made, otherwise the
+     * error of the last attempt.
+     */
+    auto connect(std::span<const typename protocol::endpoint> endpoints,
+                 std::chrono::steady_clock::duration attemptDelay)
+        -> boost::asio::awaitable<boost::system::error_code>
+      requires std::constructible_from<Socket,
+                                       typename Socket::executor_type>
+    {
+      if (endpoints.empty()) {
+        co_return boost::asio::error::host_not_found;
+      }
+
+      /**
+       * @brief A connection attempt
+       *
+       */
+      struct Attempt {
+        /// The socket of the attempt
+        Socket socket;
+
+        /// Result of the attempt, valid once finished
+        boost::system::error_code ec;
+
+        /// Set once the connect handler ran
+        bool finished{};
+      };
+
+      // reserved up front, a running attempt never moves
+      std::pmr::vector<Attempt> attempts(_alloc.resource());
+      attempts.reserve(endpoints.size());
+      boost::asio::steady_timer wake(_socket.get_executor());
+      std::optional<std::size_t> winner;
+      std::size_t finished = 0;
+      std::size_t failed = 0;
+
+      const auto finish = [&](std::size_t i,
+                              const boost::system::error_code& ec) {
+        attempts[i].ec = ec;
+        attempts[i].finished = true;
+        ++finished;
+        if (ec) {
+          ++failed;
+        } else if (!winner) {
+          winner = i;
+        }
+        wake.cancel();
+      };
+      const auto start = [&] {
+        const auto i = attempts.size();
+        auto& attempt = attempts.emplace_back(
+            Attempt{Socket(_socket.get_executor()), {}, false});
+        boost::system::error_code ec{};
+        attempt.socket.open(endpoints[i].protocol(), ec);
+        if constexpr (TunableSocket<Socket>) {
+          if (!ec && _tuning != SocketTuning::system()) {
+            _tuningError = applyTuning(attempt.socket, _tuning);
+          }
+        }
+        if (ec) {
+          finish(i, ec);
+          return;
+        }
+        attempt.socket.async_connect(
+            endpoints[i],
+            boost::asio::bind_allocator(
+                _alloc, [&finish, i](const boost::system::error_code& e) {
+                  finish(i, e);
+                }));
+      };
+
+      auto handler =
+          boost::asio::bind_allocator(_alloc, boost::asio::use_awaitable);
+      std::size_t seenFailed = 0;
+      bool delayExpired = true;
+      // every started attempt must finish before its handler's state goes
+      while (finished < attempts.size() ||
+             (!winner && attempts.size() < endpoints.size())) {
+        if (winner) {
+          for (std::size_t i = 0; i < attempts.size(); ++i) {
+            if (i != *winner) {
+              boost::system::error_code ignored;
+              attempts[i].socket.close(ignored);
+            }
+          }
+        } else if ((delayExpired || failed > seenFailed) &&
+                   attempts.size() < endpoints.size()) {
+          seenFailed = failed;
+          delayExpired = false;
+          start();
+          continue;
+        }
+        if (finished == attempts.size()) {
+          continue;
+        }
+        if (!winner && attempts.size() < endpoints.size()) {
+          wake.expires_after(attemptDelay);
+        } else {
+          wake.expires_at(boost::asio::steady_timer::time_point::max());
+        }
+        auto [ec] = co_await wake.async_wait(boost::asio::as_tuple(handler));
+        delayExpired = !ec;
+      }
+
+      if (!winner) {
+        co_return attempts.back().ec;
+      }
+      disconnect();
+      _socket = std::move(attempts[*winner].socket);
+      co_return boost::system::error_code{};
+    }
+
     /**
      * @brief Disconnect from the server
      *
@@ -128,6 +327,65 @@ namespace brilliant::snapcast {
                                      boost::asio::as_tuple(handler));
     }
 
+    /**
+     * @brief Read data into a registered buffer. With the io_uring backend the
+     * read is submitted as a fixed buffer operation.
+     *
+     * @param buffer The registered buffer to read into
+     * @return An error_code and the number of bytes read. The error_code is
+     * empty if the operation was successful.
+     */
+    auto read(const boost::asio::mutable_registered_buffer& buffer)
+        -> boost::asio::awaitable<
+            std::tuple<boost::system::error_code, std::size_t>> {
+      auto handler =
+          boost::asio::bind_allocator(_alloc, boost::asio::use_awaitable);
+      return boost::asio::async_read(_socket, buffer,
+                                     boost::asio::as_tuple(handler));
+    }
+
+    /**
+     * @brief Read data into a buffer, giving up after a timeout
+     *
+     * @tparam Extent The extent of the buffer
+     * @param buffer The buffer to read into
+     * @param timeout The longest time the read may take
+     * @return An error_code and the number of bytes read. The error_code is
+     * empty if the operation was successful, timed_out if the timeout
+     * expired.
+     */
+    template <std::size_t Extent>
+    auto read(std::span<std::byte, Extent> buffer,
+              std::chrono::steady_clock::duration timeout)
+        -> boost::asio::awaitable<
+            std::tuple<boost::system::error_code, std::size_t>> {
+      arm(_readDeadline, timeout);
+      auto result = co_await boost::asio::async_read(
+          _socket, boost::asio::buffer(buffer), timed(_readDeadline));
+      disarm(_readDeadline, std::get<0>(result));
+      co_return result;
+    }
+
+    /**
+     * @brief Read data into a registered buffer, giving up after a timeout
+     *
+     * @param buffer The registered buffer to read into
+     * @param timeout The longest time the read may take
+     * @return An error_code and the number of bytes read. The error_code is
+     * empty if the operation was successful, timed_out if the timeout
+     * expired.
+     */
+    auto read(const boost::asio::mutable_registered_buffer& buffer,
+              std::chrono::steady_clock::duration timeout)
+        -> boost::asio::awaitable<
+            std::tuple<boost::system::error_code, std::size_t>> {
+      arm(_readDeadline, timeout);
+      auto result = co_await boost::asio::async_read(_socket, buffer,
+                                                     timed(_readDeadline));
+      disarm(_readDeadline, std::get<0>(result));
+      co_return result;
+    }
+
     /**
      * @brief Write
      *
@@ -146,6 +404,150 @@ namespace brilliant::snapcast {
                                       boost::asio::as_tuple(handler));
     }
 
+    /**
+     * @brief Write data, giving up after a timeout
+     *
+     * @tparam Extent The extent of the buffer
+     * @param buffer The data to write
+     * @param timeout The longest time the write may take
+     * @return An error_code and the number of bytes written. The error_code
+     * is empty if the operation was successful, timed_out if the timeout
+     * expired.
+     */
+    template <std::size_t Extent>
+    auto write(std::span<std::byte, Extent> buffer,
+               std::chrono::steady_clock::duration timeout)
+        -> boost::asio::awaitable<
+            std::tuple<boost::system::error_code, std::size_t>> {
+      arm(_writeDeadline, timeout);
+      auto result = co_await boost::asio::async_write(
+          _socket, boost::asio::buffer(buffer), timed(_writeDeadline));
+      disarm(_writeDeadline, std::get<0>(result));
+      co_return result;
+    }
+
+    /**
+     * @brief Write a sequence of buffers with a single gathered write
+     *
+     * @tparam ConstBufferSequence The buffer sequence type
+     * @param buffers The buffers to write. The data the buffers refer to must
+     * remain valid until the operation completes.
+     * @return An error_code and the number of bytes written. The error_code is
+     * empty if the operation was successful.
+     */
+    template <class ConstBufferSequence>
+      requires boost::asio::is_const_buffer_sequence<ConstBufferSequence>::value
+    auto write(const ConstBufferSequence& buffers)
+        -> boost::asio::awaitable<
+            std::tuple<boost::system::error_code, std::size_t>> {
+      auto handler =
+          boost::asio::bind_allocator(_alloc, boost::asio::use_awaitable);
+      return boost::asio::async_write(_socket, buffers,
+                                      boost::asio::as_tuple(handler));
+    }
+
+    /**
+     * @brief Set the socket options applied by every following connect. Only
+     * TCP sockets are tuned.
+     *
+     * @param tuning The options, SocketTuning::system() to leave the
+     * system's settings
+     */
+    void setTuning(const SocketTuning& tuning) { _tuning = tuning; }
+
+    /**
+     * @brief Get the socket options applied by connect
+     *
+     * @return The tuning
+     */
+    [[nodiscard]] auto tuning() const -> const SocketTuning& {
+      return _tuning;
+    }
+
+    /**
+     * @brief Get the first option the system rejected during the last
+     * connect, e.g. operation_not_permitted for busy polling without
+     * CAP_NET_ADMIN
+     *
+     * @return The error, empty if all options were set
+     */
+    [[nodiscard]] auto tuningError() const -> boost::system::error_code {
+      return _tuningError;
+    }
+
+    /**
+     * @brief Set an option on the socket
+     *
+     * @tparam SettableSocketOption The option type, e.g.
+     * boost::asio::ip::tcp::no_delay
+     * @param option The option
+     * @return An error_code. Empty if the operation was successful.
+     */
+    template <class SettableSocketOption>
+    auto setOption(const SettableSocketOption& option)
+        -> boost::system::error_code {
+      boost::system::error_code ec;
+      _socket.set_option(option, ec);
+      return ec;
+    }
+
+    /**
+     * @brief Read an option of the socket
+     *
+     * @tparam GettableSocketOption The option type
+     * @param option The option to read into
+     * @return An error_code. Empty if the operation was successful.
+     */
+    template <class GettableSocketOption>
+    auto getOption(GettableSocketOption& option) const
+        -> boost::system::error_code {
+      boost::system::error_code ec;
+      _socket.get_option(option, ec);
+      return ec;
+    }
+
+    /**
+     * @brief Acknowledge the next received data at once if the tuning asks
+     * for quick ACKs. Linux returns to delayed ACKs by itself, this is called
+     * after every Time message so the reply is acknowledged without delay.
+     *
+     */
+    void quickAck() {
+#ifdef TCP_QUICKACK
+      if constexpr (TunableSocket<Socket>) {
+        if (_tuning.quickAck && _socket.is_open()) {
+          boost::system::error_code ignored;
+          _socket.set_option(IntegerOption<IPPROTO_TCP, TCP_QUICKACK>(1),
+                             ignored);
+        }
+      }
+#endif
+    }
+
+    /**
+     * @brief Get the native handle of the socket, e.g. for a UtilProvider
+     * looking up the interface of the connection
+     *
+     * @return The handle, -1 if the socket is closed or has no handle
+     */
+    [[nodiscard]] auto nativeHandle() -> int {
+      if constexpr (requires {
+                      { _socket.native_handle() } -> std::convertible_to<int>;
+                    }) {
+        if (_socket.is_open()) {
+          return _socket.native_handle();
+        }
+      }
+      return -1;
+    }
+
+    /**
+     * @brief Get the executor of the socket
+     *
+     * @return The executor
+     */
+    [[nodiscard]] auto getExecutor() { return _socket.get_executor(); }
+
     /**
      * @brief Get the Allocator object
      *
@@ -167,11 +569,182 @@ namespace brilliant::snapcast {
     }
 
   private:
+    /**
+     * @brief The timeout of the current operation in one direction
+     *
+     */
+    struct Deadline {
+      /// Emits the signal when it expires
+      boost::asio::steady_timer timer;
+
+      /// Connected to the slot of the current operation only
+      boost::asio::cancellation_signal signal{};
+
+      /// Incremented when an operation completes, a wait completing after
+      /// its operation is ignored
+      std::uint64_t generation{};
+
+      /// Set if the timer of the current operation expired
+      bool expired{};
+    };
+
+    /**
+     * @brief Apply the tuning and connect to a listener
+     *
+     * @tparam CompletionToken The token type, completing with a tuple
+     * @param endpoint The remote endpoint
+     * @param token The completion token of the connect operation
+     * @return An error_code. Empty if the operation was successful.
+     */
+    template <class CompletionToken>
+    auto connectWith(typename protocol::endpoint endpoint,
+                     CompletionToken token)
+        -> boost::asio::awaitable<boost::system::error_code> {
+      boost::system::error_code ec{};
+      if constexpr (TunableSocket<Socket>) {
+        if (_tuning != SocketTuning::system()) {
+          // the receive buffer must be set before the handshake to size the
+          // advertised window
+          if (!_socket.is_open()) {
+            _socket.open(endpoint.protocol(), ec);
+            if (ec) {
+              co_return ec;
+            }
+          }
+          _tuningError = applyTuning(_socket, _tuning);
+        }
+      }
+      std::tie(ec) = co_await _socket.async_connect(endpoint, token);
+      co_return ec;
+    }
+
+    /**
+     * @brief Get the completion token of an operation with a deadline. It is
+     * bound to the deadline's cancellation slot, expiry cancels only this
+     * operation.
+     *
+     * @param deadline The deadline of the operation's direction
+     * @return The token, completing with a tuple
+     */
+    auto timed(Deadline& deadline) {
+      return boost::asio::as_tuple(boost::asio::bind_cancellation_slot(
+          deadline.signal.slot(),
+          boost::asio::bind_allocator(_alloc, boost::asio::use_awaitable)));
+    }
+
+    /**
+     * @brief Start the timer of an operation. Its handler is allocated with
+     * the allocator of this object and completes once the timer expires or
+     * is cancelled by disarm().
+     *
+     * @param deadline The deadline of the operation's direction
+     * @param timeout The longest time the operation may take
+     */
+    void arm(Deadline& deadline, std::chrono::steady_clock::duration timeout) {
+      deadline.expired = false;
+      deadline.timer.expires_after(timeout);
+      deadline.timer.async_wait(boost::asio::bind_allocator(
+          _alloc, [&deadline, generation = deadline.generation](
+                      const boost::system::error_code& ec) {
+            if (!ec && generation == deadline.generation) {
+              deadline.expired = true;
+              deadline.signal.emit(boost::asio::cancellation_type::terminal);
+            }
+          }));
+    }
+
+    /**
+     * @brief Stop the timer of a completed operation
+     *
+     * @param deadline The deadline of the operation's direction
+     * @param ec The result of the operation, operation_aborted becomes
+     * timed_out if the timer expired
+     */
+    void disarm(Deadline& deadline, boost::system::error_code& ec) {
+      ++deadline.generation;
+      deadline.timer.cancel();
+      if (deadline.expired && ec == boost::asio::error::operation_aborted) {
+        ec = boost::asio::error::timed_out;
+      }
+    }
+
+    /**
+     * @brief Cancel the timer of a deadline without an operation, a wait
+     * still pending completes without effect
+     *
+     * @param deadline The deadline
+     */
+    static void cancel(Deadline& deadline) {
+      ++deadline.generation;
+      deadline.expired = false;
+      deadline.timer.cancel();
+    }
+
+    /// Longest accepted ip string, an IPv6 address with a scope id
+    static constexpr std::size_t MAX_ADDRESS_LENGTH = 63;
+
     /// The socket used for network operations
     Socket _socket;
 
     /// The allocator used for async operations
     std::pmr::polymorphic_allocator<void> _alloc;
+
+    /// Socket options applied by connect
+    SocketTuning _tuning;
+
+    /// First option rejected during the last connect
+    boost::system::error_code _tuningError;
+
+    /// Timeout of the current read
+    Deadline _readDeadline;
+
+    /// Timeout of the current write or connect
+    Deadline _writeDeadline;
   };
 
-}  // namespace brilliant::snapcast
\ No newline at end of file
+#ifdef BRILLIANT_SNAPCAST_SEPARATE_COMPILATION
+  // instantiated once in the compiled library, see src/TcpClient.cpp
+  extern template class TcpClient<boost::asio::ip::tcp::socket>;
+
+  extern template auto TcpClient<boost::asio::ip::tcp::socket>::read(
+      std::span<std::byte> buffer)
+      -> boost::asio::awaitable<
+          std::tuple<boost::system::error_code, std::size_t>>;
+
+  extern template auto TcpClient<boost::asio::ip::tcp::socket>::write(
+      std::span<std::byte> buffer)
+      -> boost::asio::awaitable<
+          std::tuple<boost::system::error_code, std::size_t>>;
+
+  extern template auto TcpClient<boost::asio::ip::tcp::socket>::read(
+      std::span<std::byte> buffer, std::chrono::steady_clock::duration timeout)
+      -> boost::asio::awaitable<
+          std::tuple<boost::system::error_code, std::size_t>>;
+
+  extern template auto TcpClient<boost::asio::ip::tcp::socket>::write(
+      std::span<std::byte> buffer, std::chrono::steady_clock::duration timeout)
+      -> boost::asio::awaitable<
+          std::tuple<boost::system::error_code, std::size_t>>;
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+  extern template class TcpClient<boost::asio::local::stream_protocol::socket>;
+#endif
+#endif
+
+}  // namespace brilliant::snapcast
+
+#if BRILLIANT_SNAPCAST_PMR_FRAMES
+/**
+ * @brief Allocate the frames of TcpClient coroutines from its memory resource
+ *
+ */
+// NOLINTBEGIN(cert-dcl58-cpp)
+template <class T, class Executor, class Socket, class... Args>
+struct std::coroutine_traits<boost::asio::awaitable<T, Executor>,
+                             brilliant::snapcast::TcpClient<Socket>&, Args...> {
+  /// Type alias for the promise type
+  using promise_type = brilliant::snapcast::PmrAwaitableFrame<
+      T, Executor, brilliant::snapcast::TcpClient<Socket>, Args...>;
+};
+// NOLINTEND(cert-dcl58-cpp)
+#endif
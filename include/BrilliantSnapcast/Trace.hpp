@@ -0,0 +1,333 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace brilliant::snapcast::trace {
+
+  /**
+   * @brief A single traced interval. Records are fixed size so the hot path is
+   * a few stores into a preallocated ring.
+   *
+   */
+  struct Record {
+    /// Name of the trace point. Must be a string with static storage duration.
+    const char* name;
+
+    /// Start time in nanoseconds
+    std::uint64_t begin;
+
+    /// End time in nanoseconds
+    std::uint64_t end;
+
+    /// Identifies the flow the interval belongs to, 0 for a synchronous
+    /// interval on the recording thread
+    std::uint64_t id;
+  };
+
+  /// Number of records each thread can hold before new records are dropped
+  inline constexpr std::size_t RING_CAPACITY = 1U << 14U;
+
+  /**
+   * @brief Single producer single consumer ring of records. The owning thread
+   * pushes and the drain consumes, no locks are taken on either side.
+   *
+   */
+  class Ring {
+  public:
+    /**
+     * @brief Construct a new Ring object
+     *
+     * @param tid The thread id reported in exported traces
+     */
+    explicit Ring(std::uint32_t tid) : _tid(tid) {}
+
+    /**
+     * @brief Push a record. Called by the owning thread only. The record is
+     * dropped if the ring is full.
+     *
+     * @param record The record
+     */
+    void push(const Record& record) {
+      const auto head = _head.load(std::memory_order_relaxed);
+      if (head - _tail.load(std::memory_order_acquire) == RING_CAPACITY) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      _records[head & (RING_CAPACITY - 1)] = record;
+      _head.store(head + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Move all pushed records to a vector. Called by one drain at a
+     * time.
+     *
+     * @param out The vector to append to
+     * @return The number of records appended
+     */
+    auto drain(std::pmr::vector<Record>& out) -> std::size_t {
+      const auto tail = _tail.load(std::memory_order_relaxed);
+      const auto head = _head.load(std::memory_order_acquire);
+      for (auto i = tail; i != head; ++i) {
+        out.push_back(_records[i & (RING_CAPACITY - 1)]);
+      }
+      _tail.store(head, std::memory_order_release);
+      return head - tail;
+    }
+
+    /**
+     * @brief Get the thread id
+     *
+     * @return The thread id
+     */
+    [[nodiscard]] auto tid() const -> std::uint32_t { return _tid; }
+
+    /**
+     * @brief Get the number of records dropped because the ring was full
+     *
+     * @return The number of dropped records
+     */
+    [[nodiscard]] auto dropped() const -> std::uint64_t {
+      return _dropped.load(std::memory_order_relaxed);
+    }
+
+  private:
+    /// Thread id
+    std::uint32_t _tid;
+
+    /// Index of the next record to write
+    alignas(64) std::atomic<std::size_t> _head{};
+
+    /// Index of the next record to drain
+    alignas(64) std::atomic<std::size_t> _tail{};
+
+    /// Number of dropped records
+    std::atomic<std::uint64_t> _dropped{};
+
+    /// Record storage
+    std::array<Record, RING_CAPACITY> _records{};
+  };
+
+  /**
+   * @brief Owns the rings of all threads which recorded an event. Rings
+   * outlive their threads so late records can still be drained.
+   *
+   */
+  class Registry {
+  public:
+    /**
+     * @brief Get the process wide registry
+     *
+     * @return The registry
+     */
+    static auto instance() -> Registry& {
+      static Registry registry;
+      return registry;
+    }
+
+    /**
+     * @brief Get the ring of the calling thread, creating it on first use
+     *
+     * @return The ring
+     */
+    auto local() -> Ring& {
+      thread_local Ring* ring = create();
+      return *ring;
+    }
+
+    /**
+     * @brief Drain the records of all threads
+     *
+     * @param out The vector to append to
+     * @param tids The vector receiving the thread id of each appended record
+     */
+    void drain(std::pmr::vector<Record>& out,
+               std::pmr::vector<std::uint32_t>& tids) {
+      const std::scoped_lock lock(_mutex);
+      for (const auto& ring : _rings) {
+        const auto count = ring->drain(out);
+        tids.insert(tids.end(), count, ring->tid());
+      }
+    }
+
+    /**
+     * @brief Get the number of records dropped on all threads
+     *
+     * @return The number of dropped records
+     */
+    auto dropped() -> std::uint64_t {
+      const std::scoped_lock lock(_mutex);
+      std::uint64_t total = 0;
+      for (const auto& ring : _rings) {
+        total += ring->dropped();
+      }
+      return total;
+    }
+
+  private:
+    /**
+     * @brief Create and register a ring for the calling thread
+     *
+     * @return The ring
+     */
+    auto create() -> Ring* {
+      const std::scoped_lock lock(_mutex);
+      const auto tid = static_cast<std::uint32_t>(_rings.size() + 1);
+      return _rings.emplace_back(std::make_unique<Ring>(tid)).get();
+    }
+
+    /// Guards the list of rings
+    std::mutex _mutex;
+
+    /// All rings
+    std::vector<std::unique_ptr<Ring>> _rings;
+  };
+
+  /**
+   * @brief Get the trace timestamp
+   *
+   * @return Nanoseconds on the steady clock
+   */
+  inline auto now() -> std::uint64_t {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+  }
+
+  /**
+   * @brief Records the lifetime of the object as one interval on the ring of
+   * the thread that destroys it
+   *
+   */
+  class Scope {
+  public:
+    /**
+     * @brief Construct a new Scope object and start the interval
+     *
+     * @param name The name of the trace point. Must have static storage
+     * duration.
+     * @param id Identifies the flow, e.g. the address of a session. Intervals
+     * of a flow nest and may span suspension points.
+     */
+    explicit Scope(const char* name, const void* id = nullptr)
+        : _name(name),
+          _id(reinterpret_cast<std::uintptr_t>(id)),  // NOLINT
+          _begin(now()) {}
+
+    /**
+     * @brief Destroy the Scope object and record the interval
+     *
+     */
+    ~Scope() { Registry::instance().local().push({_name, _begin, now(), _id}); }
+
+    /**
+     * @brief Deleted copy constructor
+     *
+     */
+    Scope(const Scope&) = delete;
+
+    /**
+     * @brief Deleted move constructor
+     *
+     */
+    Scope(Scope&&) = delete;
+
+    /**
+     * @brief Deleted copy assignment operator
+     *
+     * @return Scope&
+     */
+    auto operator=(const Scope&) -> Scope& = delete;
+
+    /**
+     * @brief Deleted move assignment operator
+     *
+     * @return Scope&
+     */
+    auto operator=(Scope&&) -> Scope& = delete;
+
+  private:
+    /// Name of the trace point
+    const char* _name;
+
+    /// Flow id
+    std::uint64_t _id;
+
+    /// Start time
+    std::uint64_t _begin;
+  };
+
+  /**
+   * @brief Drain all recorded intervals and write them as Chrome trace event
+   * JSON, loadable in chrome://tracing and Perfetto. Intervals with a flow id
+   * are written as nestable async events, others as complete events.
+   *
+   * @param out The stream to write to
+   * @param mr A pointer to the memory resource used for drained records
+   * @return The number of intervals written
+   */
+  inline auto writeChromeTrace(std::ostream& out,
+                               std::pmr::memory_resource* mr =
+                                   std::pmr::get_default_resource())
+      -> std::size_t {
+    std::pmr::vector<Record> records(mr);
+    std::pmr::vector<std::uint32_t> tids(mr);
+    Registry::instance().drain(records, tids);
+
+    constexpr double NSEC_PER_USEC = 1000.0;
+    const auto usec = [](std::uint64_t ns) {
+      return static_cast<double>(ns) / NSEC_PER_USEC;
+    };
+
+    out << R"({"displayTimeUnit":"ns","traceEvents":[)";
+    const char* separator = "";
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      const auto& record = records[i];
+      out << separator;
+      separator = ",";
+      if (record.id == 0) {
+        out << R"({"name":")" << record.name
+            << R"(","cat":"snapcast","ph":"X","pid":1,"tid":)" << tids[i]
+            << R"(,"ts":)" << usec(record.begin)
+            << R"(,"dur":)" << usec(record.end - record.begin) << '}';
+        continue;
+      }
+      for (const auto& [phase, ts] :
+           {std::pair{'b', record.begin}, std::pair{'e', record.end}}) {
+        out << R"({"name":")" << record.name
+            << R"(","cat":"snapcast","ph":")" << phase
+            << R"(","pid":1,"tid":)" << tids[i] << R"(,"id":")" << std::hex
+            << record.id << std::dec << R"(","ts":)" << usec(ts) << '}'
+            << (phase == 'b' ? "," : "");
+      }
+    }
+    out << "]}";
+    return records.size();
+  }
+
+}  // namespace brilliant::snapcast::trace
+
+#define BRILLIANT_TRACE_CONCAT_IMPL(a, b) a##b
+#define BRILLIANT_TRACE_CONCAT(a, b) BRILLIANT_TRACE_CONCAT_IMPL(a, b)
+
+#ifdef BRILLIANT_SNAPCAST_TRACE
+/// Record the rest of the enclosing block as an interval
+#define BRILLIANT_TRACE_SCOPE(name, id)             \
+  const ::brilliant::snapcast::trace::Scope         \
+  BRILLIANT_TRACE_CONCAT(_brilliantTrace, __LINE__) \
+  {                                                 \
+    name, id                                        \
+  }
+#else
+/// Tracing is compiled out
+#define BRILLIANT_TRACE_SCOPE(name, id) static_cast<void>(0)
+#endif
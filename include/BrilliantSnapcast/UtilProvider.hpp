@@ -21,7 +21,7 @@ namespace brilliant::snapcast {
     /**
      * @brief Get the MAC Address as a string
      *
-     * @param sock The socket handle
+     * @param sock The socket handle of the connection, -1 if there is none
      * @param mr A pointer to the memory resource used to allocate the string
      * @return The MAC address as a string
      */
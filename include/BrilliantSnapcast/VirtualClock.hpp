@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <vector>
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief A simulated clock. Time only advances when run() reaches the next
+   * scheduled event, so hours of simulated time complete as fast as the
+   * scheduled work executes.
+   *
+   */
+  class VirtualClock {
+  public:
+    /// Type alias for the clock duration
+    using duration = std::chrono::microseconds;
+
+    /// Type alias for the clock representation
+    using rep = duration::rep;
+
+    /// Type alias for the clock period
+    using period = duration::period;
+
+    /// Type alias for the clock time point
+    using time_point = std::chrono::time_point<VirtualClock, duration>;
+
+    /// Virtual time never goes backwards
+    static constexpr bool is_steady = true;
+
+    /**
+     * @brief Construct a new Virtual Clock object starting at time 0
+     *
+     * @param mr A pointer to the memory resource used for the event queue
+     */
+    explicit VirtualClock(std::pmr::memory_resource* mr) : _events(mr) {}
+
+    /**
+     * @brief Get the current virtual time
+     *
+     * @return The current time
+     */
+    [[nodiscard]] auto now() const -> time_point { return _now; }
+
+    /**
+     * @brief Schedule a function to be called when the clock reaches a time.
+     * Functions scheduled for the same time are called in the order they were
+     * scheduled.
+     *
+     * @param at The time to call the function. Times in the past are called on
+     * the next step of run().
+     * @param fn The function
+     */
+    void schedule(time_point at, std::move_only_function<void()> fn) {
+      _events.push_back({std::max(at, _now), _sequence++, std::move(fn)});
+      std::ranges::push_heap(_events, std::greater{});
+    }
+
+    /**
+     * @brief Wait for a virtual duration
+     *
+     * @tparam Executor The executor type
+     * @tparam CompletionToken The completion token type
+     * @param exec The executor the completion is posted to
+     * @param d The duration to wait
+     * @param token The completion token
+     * @return Depends on the completion token
+     */
+    template <class Executor, class CompletionToken>
+    auto asyncWait(Executor exec, duration d, CompletionToken&& token) {
+      return boost::asio::async_initiate<CompletionToken,
+                                         void(boost::system::error_code)>(
+          [this, exec, d](auto handler) {
+            schedule(_now + d, [exec, h = std::move(handler)] mutable {
+              boost::asio::post(exec, std::bind(std::move(h),
+                                                boost::system::error_code{}));
+            });
+          },
+          token);
+    }
+
+    /**
+     * @brief Run the io_context and advance the clock. Ready handlers are run,
+     * then the clock jumps to the earliest scheduled event, repeatedly, until
+     * no events are left or the next event is after a limit.
+     *
+     * @param context The io_context running the simulated work
+     * @param until Stop before events scheduled after this time
+     * @return The number of events processed
+     */
+    auto run(boost::asio::io_context& context,
+             time_point until = time_point::max()) -> std::size_t {
+      std::size_t processed = 0;
+      while (true) {
+        context.restart();
+        context.poll();
+        if (_events.empty() || _events.front().at > until) {
+          break;
+        }
+        std::ranges::pop_heap(_events, std::greater{});
+        auto event = std::move(_events.back());
+        _events.pop_back();
+        _now = event.at;
+        event.fn();
+        ++processed;
+      }
+      if (until != time_point::max()) {
+        _now = std::max(_now, until);
+      }
+      return processed;
+    }
+
+  private:
+    /**
+     * @brief A scheduled function
+     *
+     */
+    struct Event {
+      /// Time to call the function
+      time_point at;
+
+      /// Orders events scheduled for the same time
+      std::uint64_t sequence;
+
+      /// The function
+      std::move_only_function<void()> fn;
+
+      /**
+       * @brief Order events by time, then by sequence
+       *
+       * @param other The event to compare to
+       * @return True if this event is after other
+       */
+      auto operator>(const Event& other) const -> bool {
+        return at != other.at ? at > other.at : sequence > other.sequence;
+      }
+    };
+
+    /// The current time
+    time_point _now{};
+
+    /// Next event sequence number
+    std::uint64_t _sequence{};
+
+    /// Min heap of scheduled events
+    std::pmr::vector<Event> _events;
+  };
+
+}  // namespace brilliant::snapcast
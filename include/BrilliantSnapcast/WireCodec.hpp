@@ -0,0 +1,551 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "BrilliantSnapcast/Message.hpp"
+
+namespace brilliant::snapcast {
+
+  /**
+   * @brief Lists the members of a struct in wire order
+   *
+   * @tparam Members Pointers to the members
+   */
+  template <auto... Members>
+  struct Fields {};
+
+  /**
+   * @brief Describes the wire layout of a fixed size struct. Specializations
+   * define a Fields alias named fields, encode and decode are generated from
+   * it.
+   *
+   * @tparam T The struct type
+   */
+  template <class T>
+  struct WireLayout;
+
+  /**
+   * @brief Wire layout of Time
+   *
+   */
+  template <>
+  struct WireLayout<Time> {
+    /// The fields in wire order
+    using fields = Fields<&Time::sec, &Time::usec>;
+  };
+
+  /**
+   * @brief Wire layout of Base
+   *
+   */
+  template <>
+  struct WireLayout<Base> {
+    /// The fields in wire order
+    using fields = Fields<&Base::type, &Base::id, &Base::refersTo, &Base::sent,
+                          &Base::received, &Base::size>;
+  };
+
+  /// Satisfied by structs with a WireLayout
+  template <class T>
+  concept WireStruct = requires { typename WireLayout<T>::fields; };
+
+  /// Satisfied by integers and enums, stored little endian on the wire
+  template <class T>
+  concept WireScalar = std::integral<T> || std::is_enum_v<T>;
+
+  namespace detail {
+    /**
+     * @brief Get the number of bytes a fixed size field occupies on the wire
+     *
+     * @tparam T The field type
+     * @return The wire size
+     */
+    template <class T>
+    consteval auto fieldSize() -> std::size_t;
+
+    /**
+     * @brief Get the wire size of a list of fields
+     *
+     * @tparam T The struct type
+     * @tparam Members Pointers to the members
+     * @return The sum of the field sizes
+     */
+    template <class T, auto... Members>
+    consteval auto fieldsSize(Fields<Members...> /*fields*/) -> std::size_t {
+      return (fieldSize<std::remove_cvref_t<decltype(std::declval<T&>().*
+                                                     Members)>>() +
+              ... + 0);
+    }
+
+    template <class T>
+    consteval auto fieldSize() -> std::size_t {
+      if constexpr (WireScalar<T>) {
+        return sizeof(T);
+      } else {
+        return fieldsSize<T>(typename WireLayout<T>::fields{});
+      }
+    }
+  }  // namespace detail
+
+  /**
+   * @brief Number of bytes a fixed size struct or scalar occupies on the
+   * wire. Independent of the struct's padding.
+   *
+   * @tparam T The type
+   */
+  template <class T>
+    requires WireScalar<T> || WireStruct<T>
+  inline constexpr std::size_t WIRE_SIZE = detail::fieldSize<T>();
+
+  static_assert(WIRE_SIZE<Time> == 8, "Time is 8 bytes on the wire");
+  static_assert(WIRE_SIZE<Base> == 26, "Base is 26 bytes on the wire");
+
+  /// Number of bytes of the header in front of every message
+  inline constexpr std::size_t HEADER_SIZE = WIRE_SIZE<Base>;
+
+  namespace detail {
+    /**
+     * @brief Set every field of a struct to the 1 based wire offsets of its
+     * bytes, stored little endian
+     *
+     * @tparam T The struct type
+     * @tparam Members Pointers to the members
+     * @param value The struct to fill
+     * @param offset The wire offset of the struct
+     */
+    template <class T, auto... Members>
+    constexpr void fillOffsets(Fields<Members...> /*fields*/, T& value,
+                               std::size_t offset);
+
+    /**
+     * @brief Set one field to the 1 based wire offsets of its bytes
+     *
+     * @tparam F The field type
+     * @param field The field
+     * @param offset The wire offset of the field, advanced past it
+     */
+    template <class F>
+    constexpr void fillOffset(F& field, std::size_t& offset) {
+      if constexpr (std::is_enum_v<F>) {
+        std::underlying_type_t<F> integer{};
+        fillOffset(integer, offset);
+        field = static_cast<F>(integer);
+      } else if constexpr (WireScalar<F>) {
+        std::make_unsigned_t<F> pattern = 0;
+        for (std::size_t i = 0; i < sizeof(F); ++i) {
+          pattern |= static_cast<std::make_unsigned_t<F>>((offset + i + 1)
+                                                          << (8 * i));
+        }
+        field = static_cast<F>(pattern);
+        offset += sizeof(F);
+      } else {
+        fillOffsets(typename WireLayout<F>::fields{}, field, offset);
+        offset += WIRE_SIZE<F>;
+      }
+    }
+
+    template <class T, auto... Members>
+    constexpr void fillOffsets(Fields<Members...> /*fields*/, T& value,
+                               std::size_t offset) {
+      (fillOffset(value.*Members, offset), ...);
+    }
+
+    /**
+     * @brief A run of bytes stored in the same order in a struct and on the
+     * wire
+     *
+     */
+    struct WireRun {
+      /// Offset of the run in the struct
+      std::size_t object;
+
+      /// Offset of the run on the wire
+      std::size_t wire;
+
+      /// Length of the run
+      std::size_t size;
+    };
+
+    /**
+     * @brief Get the number of scalars a field consists of
+     *
+     * @tparam T The field type
+     * @return The number of scalars
+     */
+    template <class T>
+    consteval auto scalarCount() -> std::size_t;
+
+    /**
+     * @brief Get the number of scalars of a list of fields
+     *
+     * @tparam T The struct type
+     * @tparam Members Pointers to the members
+     * @return The sum of the scalar counts
+     */
+    template <class T, auto... Members>
+    consteval auto scalarsCount(Fields<Members...> /*fields*/) -> std::size_t {
+      return (scalarCount<std::remove_cvref_t<decltype(std::declval<T&>().*
+                                                       Members)>>() +
+              ... + 0);
+    }
+
+    template <class T>
+    consteval auto scalarCount() -> std::size_t {
+      if constexpr (WireScalar<T>) {
+        return 1;
+      } else {
+        return scalarsCount<T>(typename WireLayout<T>::fields{});
+      }
+    }
+
+    /**
+     * @brief Lay out a list of fields by the standard layout rules, every
+     * member aligned in wire order
+     *
+     * @tparam T The struct type
+     * @tparam N The capacity of the scalar list
+     * @tparam Members Pointers to the members
+     * @param scalars Receives the object and wire offset of every scalar
+     * @param count The number of scalars in the list, advanced
+     * @param object The object offset of the struct
+     * @param wire The wire offset of the struct, advanced past it
+     */
+    template <class T, std::size_t N, auto... Members>
+    constexpr void layoutFields(Fields<Members...> /*fields*/,
+                                std::array<WireRun, N>& scalars,
+                                std::size_t& count, std::size_t object,
+                                std::size_t& wire);
+
+    /**
+     * @brief Lay out one field
+     *
+     * @tparam F The field type
+     * @tparam N The capacity of the scalar list
+     * @param scalars Receives the object and wire offset of every scalar
+     * @param count The number of scalars in the list, advanced
+     * @param object The object offset, advanced past the field
+     * @param wire The wire offset, advanced past the field
+     */
+    template <class F, std::size_t N>
+    constexpr void layoutField(std::array<WireRun, N>& scalars,
+                               std::size_t& count, std::size_t& object,
+                               std::size_t& wire) {
+      object = (object + alignof(F) - 1) / alignof(F) * alignof(F);
+      if constexpr (WireScalar<F>) {
+        scalars.at(count++) = {object, wire, sizeof(F)};
+        wire += sizeof(F);
+      } else {
+        layoutFields<F>(typename WireLayout<F>::fields{}, scalars, count,
+                        object, wire);
+      }
+      object += sizeof(F);
+    }
+
+    template <class T, std::size_t N, auto... Members>
+    constexpr void layoutFields(Fields<Members...> /*fields*/,
+                                std::array<WireRun, N>& scalars,
+                                std::size_t& count, std::size_t object,
+                                std::size_t& wire) {
+      (layoutField<std::remove_cvref_t<decltype(std::declval<T&>().*
+                                                Members)>>(scalars, count,
+                                                           object, wire),
+       ...);
+    }
+
+    /**
+     * @brief The runs a struct is copied to and from the wire in
+     *
+     * @tparam T The struct type
+     */
+    template <class T>
+    struct WireRuns {
+      /// The runs in wire order
+      std::array<WireRun, scalarCount<T>()> runs{};
+
+      /// The number of runs, zero if the struct is copied field by field
+      std::size_t count{};
+    };
+
+    /**
+     * @brief Find the runs of bytes a struct shares with its wire
+     * representation on this host. Requires a little endian host and a
+     * standard layout struct whose members are declared in wire order;
+     * adjacent scalars merge into one run unless padding separates them.
+     *
+     * @tparam T The struct type
+     * @return The runs, none if the struct cannot be copied in runs
+     */
+    template <class T>
+    consteval auto findRuns() -> WireRuns<T> {
+      WireRuns<T> result;
+      if constexpr (std::endian::native == std::endian::little &&
+                    std::is_trivially_copyable_v<T> &&
+                    std::is_standard_layout_v<T>) {
+        std::array<WireRun, scalarCount<T>()> scalars{};
+        std::size_t count = 0;
+        std::size_t wire = 0;
+        layoutFields<T>(typename WireLayout<T>::fields{}, scalars, count, 0,
+                        wire);
+        // only the bytes of the scalars are read, padding has no value
+        T value{};
+        fillOffsets(typename WireLayout<T>::fields{}, value, 0);
+        const auto bytes =
+            std::bit_cast<std::array<unsigned char, sizeof(T)>>(value);
+        for (const auto& scalar : scalars) {
+          if (scalar.object + scalar.size > sizeof(T)) {
+            return WireRuns<T>{};
+          }
+          for (std::size_t i = 0; i < scalar.size; ++i) {
+            if (bytes.at(scalar.object + i) != scalar.wire + i + 1) {
+              return WireRuns<T>{};
+            }
+          }
+          auto& last = result.runs.at(result.count == 0 ? 0 : result.count - 1);
+          if (result.count != 0 && last.object + last.size == scalar.object &&
+              last.wire + last.size == scalar.wire) {
+            last.size += scalar.size;
+          } else {
+            result.runs.at(result.count++) = scalar;
+          }
+        }
+      }
+      return result;
+    }
+
+    /// The runs of a struct, computed once
+    template <class T>
+    inline constexpr WireRuns<T> WIRE_RUNS = findRuns<T>();
+  }  // namespace detail
+
+  /**
+   * @brief Satisfied by structs whose object representation is their wire
+   * representation on this host apart from padding. They are encoded and
+   * decoded with one copy per run of bytes between padding instead of field
+   * by field.
+   *
+   * Base qualifies on little endian hosts with two runs: Time is 4 byte
+   * aligned, so the compiler pads the 6 bytes of type, id and refersTo to 8
+   * and the remaining 20 bytes follow the padding.
+   *
+   * @tparam T The struct type
+   */
+  template <class T>
+  concept WireCopyable = WireStruct<T> && detail::WIRE_RUNS<T>.count != 0;
+
+  /**
+   * @brief Satisfied by structs whose object representation is their wire
+   * representation on this host. They are encoded and decoded with a single
+   * copy. Time qualifies on little endian hosts, Base does not.
+   *
+   * @tparam T The struct type
+   */
+  template <class T>
+  concept WireIdentical = WireCopyable<T> && detail::WIRE_RUNS<T>.count == 1 &&
+                          sizeof(T) == WIRE_SIZE<T>;
+
+  /**
+   * @brief Load a little endian scalar. The bytes are copied into an aligned
+   * local and swapped on big endian hosts, the swap compiles away on little
+   * endian hosts.
+   *
+   * @tparam T The scalar type
+   * @tparam Host The byte order of the host, only overridden by tests
+   * @param data Pointer to the wire bytes, no alignment required
+   * @return The value
+   */
+  template <WireScalar T, std::endian Host = std::endian::native>
+  auto loadLittle(const std::byte* data) -> T {
+    if constexpr (std::is_enum_v<T>) {
+      return static_cast<T>(loadLittle<std::underlying_type_t<T>, Host>(data));
+    } else {
+      T value{};
+      std::memcpy(&value, data, sizeof(T));
+      if constexpr (Host == std::endian::big && sizeof(T) > 1) {
+        value = std::byteswap(value);
+      }
+      return value;
+    }
+  }
+
+  /**
+   * @brief Store a scalar little endian
+   *
+   * @tparam T The scalar type
+   * @tparam Host The byte order of the host, only overridden by tests
+   * @param data Pointer to the wire bytes, no alignment required
+   * @param value The value
+   */
+  template <WireScalar T, std::endian Host = std::endian::native>
+  void storeLittle(std::byte* data, T value) {
+    if constexpr (std::is_enum_v<T>) {
+      storeLittle<std::underlying_type_t<T>, Host>(
+          data, static_cast<std::underlying_type_t<T>>(value));
+    } else {
+      if constexpr (Host == std::endian::big && sizeof(T) > 1) {
+        value = std::byteswap(value);
+      }
+      std::memcpy(data, &value, sizeof(T));
+    }
+  }
+
+  /**
+   * @brief Decode a struct from its wire representation, field by field or
+   * with one copy per run if it is WireCopyable
+   *
+   * @tparam T The struct type
+   * @tparam Host The byte order of the host, only overridden by tests
+   * @param data Pointer to WIRE_SIZE<T> bytes
+   * @param value The struct to decode into
+   */
+  template <WireStruct T, std::endian Host = std::endian::native>
+  void decodeWire(const std::byte* data, T& value);
+
+  /**
+   * @brief Encode a struct into its wire representation, field by field or
+   * with one copy per run if it is WireCopyable
+   *
+   * @tparam T The struct type
+   * @tparam Host The byte order of the host, only overridden by tests
+   * @param data Pointer to WIRE_SIZE<T> bytes
+   * @param value The struct to encode
+   */
+  template <WireStruct T, std::endian Host = std::endian::native>
+  void encodeWire(std::byte* data, const T& value);
+
+  namespace detail {
+    /**
+     * @brief Decode one field and advance the data pointer
+     *
+     * @tparam Host The byte order of the host
+     * @tparam F The field type
+     * @param data The data pointer
+     * @param field The field
+     */
+    template <std::endian Host, class F>
+    void decodeField(const std::byte*& data, F& field) {
+      if constexpr (WireScalar<F>) {
+        field = loadLittle<F, Host>(data);
+      } else {
+        decodeWire<F, Host>(data, field);
+      }
+      data += WIRE_SIZE<F>;
+    }
+
+    /**
+     * @brief Encode one field and advance the data pointer
+     *
+     * @tparam Host The byte order of the host
+     * @tparam F The field type
+     * @param data The data pointer
+     * @param field The field
+     */
+    template <std::endian Host, class F>
+    void encodeField(std::byte*& data, const F& field) {
+      if constexpr (WireScalar<F>) {
+        storeLittle<F, Host>(data, field);
+      } else {
+        encodeWire<F, Host>(data, field);
+      }
+      data += WIRE_SIZE<F>;
+    }
+
+    /**
+     * @brief Decode a list of fields
+     *
+     * @tparam Host The byte order of the host
+     * @tparam T The struct type
+     * @tparam Members Pointers to the members
+     * @param data Pointer to the wire bytes
+     * @param value The struct to decode into
+     */
+    template <std::endian Host, class T, auto... Members>
+    void decodeFields(Fields<Members...> /*fields*/, const std::byte* data,
+                      T& value) {
+      (decodeField<Host>(data, value.*Members), ...);
+    }
+
+    /**
+     * @brief Encode a list of fields
+     *
+     * @tparam Host The byte order of the host
+     * @tparam T The struct type
+     * @tparam Members Pointers to the members
+     * @param data Pointer to the wire bytes
+     * @param value The struct to encode
+     */
+    template <std::endian Host, class T, auto... Members>
+    void encodeFields(Fields<Members...> /*fields*/, std::byte* data,
+                      const T& value) {
+      (encodeField<Host>(data, value.*Members), ...);
+    }
+
+    /**
+     * @brief Copy the runs of a struct from the wire, the sizes are
+     * constants so each copy compiles to a few loads and stores
+     *
+     * @tparam T The struct type
+     * @tparam Runs Indices of the runs
+     * @param data Pointer to the wire bytes
+     * @param value The struct to decode into
+     */
+    template <class T, std::size_t... Runs>
+    void decodeRuns(std::index_sequence<Runs...> /*runs*/,
+                    const std::byte* data, T& value) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      auto* object = reinterpret_cast<std::byte*>(&value);
+      (std::memcpy(object + WIRE_RUNS<T>.runs[Runs].object,
+                   data + WIRE_RUNS<T>.runs[Runs].wire,
+                   WIRE_RUNS<T>.runs[Runs].size),
+       ...);
+    }
+
+    /**
+     * @brief Copy the runs of a struct to the wire
+     *
+     * @tparam T The struct type
+     * @tparam Runs Indices of the runs
+     * @param data Pointer to the wire bytes
+     * @param value The struct to encode
+     */
+    template <class T, std::size_t... Runs>
+    void encodeRuns(std::index_sequence<Runs...> /*runs*/, std::byte* data,
+                    const T& value) {
+      // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+      const auto* object = reinterpret_cast<const std::byte*>(&value);
+      (std::memcpy(data + WIRE_RUNS<T>.runs[Runs].wire,
+                   object + WIRE_RUNS<T>.runs[Runs].object,
+                   WIRE_RUNS<T>.runs[Runs].size),
+       ...);
+    }
+  }  // namespace detail
+
+  template <WireStruct T, std::endian Host>
+  void decodeWire(const std::byte* data, T& value) {
+    if constexpr (Host == std::endian::native && WireCopyable<T>) {
+      detail::decodeRuns(std::make_index_sequence<detail::WIRE_RUNS<T>.count>{},
+                         data, value);
+    } else {
+      detail::decodeFields<Host>(typename WireLayout<T>::fields{}, data,
+                                 value);
+    }
+  }
+
+  template <WireStruct T, std::endian Host>
+  void encodeWire(std::byte* data, const T& value) {
+    if constexpr (Host == std::endian::native && WireCopyable<T>) {
+      detail::encodeRuns(std::make_index_sequence<detail::WIRE_RUNS<T>.count>{},
+                         data, value);
+    } else {
+      detail::encodeFields<Host>(typename WireLayout<T>::fields{}, data,
+                                 value);
+    }
+  }
+
+}  // namespace brilliant::snapcast
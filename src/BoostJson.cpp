@@ -0,0 +1,4 @@
+// Compiles Boost.Json once for the library instead of in every translation
+// unit including SnapClient.hpp.
+
+#include <boost/json/src.hpp>
@@ -0,0 +1,35 @@
+#include "BrilliantSnapcast/SnapClient.hpp"
+
+namespace brilliant::snapcast {
+
+  template class SnapClient<boost::asio::ip::tcp::socket>;
+
+  template auto SnapClient<boost::asio::ip::tcp::socket>::send(
+      std::uint16_t id, Message message, std::span<std::byte> buffer,
+      std::optional<std::chrono::steady_clock::duration> timeout)
+      -> boost::asio::awaitable<
+          std::expected<Time, boost::system::error_code>>;
+
+  template auto SnapClient<boost::asio::ip::tcp::socket>::sendJson(
+      uint16_t id, MessageType type, boost::json::object& object,
+      boost::json::serializer& serializer, std::span<std::byte> buffer)
+      -> boost::asio::awaitable<
+          std::expected<Time, boost::system::error_code>>;
+
+  template auto SnapClient<boost::asio::ip::tcp::socket>::sendHello(
+      UtilProvider& utilProvider, boost::json::serializer& serializer,
+      std::span<std::byte> buffer)
+      -> boost::asio::awaitable<
+          std::expected<Time, boost::system::error_code>>;
+
+  template auto SnapClient<boost::asio::ip::tcp::socket>::read(
+      std::span<std::byte> buffer,
+      std::optional<std::chrono::steady_clock::duration> timeout)
+      -> boost::asio::awaitable<std::expected<std::tuple<Base, Message>,
+                                              boost::system::error_code>>;
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+  template class SnapClient<boost::asio::local::stream_protocol::socket>;
+#endif
+
+}  // namespace brilliant::snapcast
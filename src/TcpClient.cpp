@@ -0,0 +1,31 @@
+#include "BrilliantSnapcast/TcpClient.hpp"
+
+namespace brilliant::snapcast {
+
+  template class TcpClient<boost::asio::ip::tcp::socket>;
+
+  template auto TcpClient<boost::asio::ip::tcp::socket>::read(
+      std::span<std::byte> buffer)
+      -> boost::asio::awaitable<
+          std::tuple<boost::system::error_code, std::size_t>>;
+
+  template auto TcpClient<boost::asio::ip::tcp::socket>::write(
+      std::span<std::byte> buffer)
+      -> boost::asio::awaitable<
+          std::tuple<boost::system::error_code, std::size_t>>;
+
+  template auto TcpClient<boost::asio::ip::tcp::socket>::read(
+      std::span<std::byte> buffer, std::chrono::steady_clock::duration timeout)
+      -> boost::asio::awaitable<
+          std::tuple<boost::system::error_code, std::size_t>>;
+
+  template auto TcpClient<boost::asio::ip::tcp::socket>::write(
+      std::span<std::byte> buffer, std::chrono::steady_clock::duration timeout)
+      -> boost::asio::awaitable<
+          std::tuple<boost::system::error_code, std::size_t>>;
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+  template class TcpClient<boost::asio::local::stream_protocol::socket>;
+#endif
+
+}  // namespace brilliant::snapcast
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+class CountingResource : public std::pmr::memory_resource {
+public:
+  explicit CountingResource(
+      std::pmr::memory_resource* next = std::pmr::new_delete_resource())
+      : upstream(next) {}
+
+  std::size_t allocations{};
+  std::size_t deallocations{};
+  std::size_t outstanding{};
+
+private:
+  auto do_allocate(std::size_t bytes, std::size_t alignment) -> void* override {
+    ++allocations;
+    outstanding += bytes;
+    return upstream->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, std::size_t bytes,
+                     std::size_t alignment) override {
+    ++deallocations;
+    outstanding -= bytes;
+    upstream->deallocate(p, bytes, alignment);
+  }
+
+  [[nodiscard]] auto do_is_equal(const std::pmr::memory_resource& other)
+      const noexcept -> bool override {
+    return this == &other;
+  }
+
+  std::pmr::memory_resource* upstream;
+};
@@ -0,0 +1,231 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+#include <cstdio>
+#include <string>
+
+#include "BrilliantSnapcast/Capture.hpp"
+#include "BrilliantSnapcast/ProtocolSession.hpp"
+#include "BrilliantSnapcast/ReplaySocket.hpp"
+#include "BrilliantSnapcast/SnapClient.hpp"
+#include "FakeSocket.hpp"
+
+struct TestCapture : testing::Test {
+  TestCapture()
+      : path(testing::TempDir() + "TestCapture.cap"),
+        indexPath(testing::TempDir() + "TestCapture.idx") {
+    std::remove(path.c_str());
+    std::remove(indexPath.c_str());
+  }
+
+  ~TestCapture() override {
+    std::remove(path.c_str());
+    std::remove(indexPath.c_str());
+  }
+
+  TestCapture(const TestCapture&) = delete;
+  TestCapture(TestCapture&&) = delete;
+  auto operator=(const TestCapture&) -> TestCapture& = delete;
+  auto operator=(TestCapture&&) -> TestCapture& = delete;
+
+  static auto encodeTime(std::uint16_t id) -> std::vector<std::byte> {
+    std::vector<std::byte> data(brilliant::snapcast::HEADER_SIZE +
+                                sizeof(brilliant::snapcast::Time));
+    brilliant::snapcast::Message message = brilliant::snapcast::Time{};
+    std::ignore = brilliant::snapcast::ProtocolSession::encode(
+        id, message, {}, std::span(data));
+    return data;
+  }
+
+  void writeCapture(std::uint32_t count) {
+    auto writer = brilliant::snapcast::CaptureWriter::open(path.c_str(),
+                                                           indexPath.c_str());
+    ASSERT_TRUE(writer.has_value());
+    for (std::uint32_t i = 0; i < count; ++i) {
+      const auto data = encodeTime(static_cast<std::uint16_t>(i));
+      const auto header = brilliant::snapcast::HEADER_SIZE;
+      writer->record(brilliant::snapcast::Time{.sec = i, .usec = 0},
+                     std::span(data).first(header),
+                     std::span(data).subspan(header));
+    }
+    EXPECT_FALSE(writer->error());
+  }
+
+  std::string path;
+  std::string indexPath;
+  boost::asio::io_context context;
+};
+
+TEST_F(TestCapture, testCaptureSnapClientRead) {
+  auto writer =
+      brilliant::snapcast::CaptureWriter::open(path.c_str(), indexPath.c_str());
+  ASSERT_TRUE(writer.has_value());
+
+  SocketState state;
+  state.inData = encodeTime(3);
+  brilliant::snapcast::TcpClient<FakeSocket<boost::asio::ip::tcp>> tcpClient(
+      FakeSocket<boost::asio::ip::tcp>{context.get_executor(), &state},
+      std::pmr::get_default_resource());
+  brilliant::snapcast::SnapClient<FakeSocket<boost::asio::ip::tcp>> snapClient(
+      tcpClient);
+  snapClient.setCapture(&writer.value());
+
+  const auto expected = state.inData;
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [&snapClient] -> boost::asio::awaitable<void> {
+        constexpr auto bufSize = 128;
+        std::vector<std::byte> buffer(bufSize);
+        auto result = co_await snapClient.read(std::span(buffer));
+        EXPECT_TRUE(result.has_value());
+      },
+      boost::asio::detached);
+  context.run();
+
+  auto capture =
+      brilliant::snapcast::CaptureFile::open(path.c_str(), indexPath.c_str());
+  ASSERT_TRUE(capture.has_value());
+  auto rec = capture->at(brilliant::snapcast::CaptureFile::begin());
+  ASSERT_TRUE(rec.has_value());
+  EXPECT_THAT(rec->bytes, testing::ElementsAreArray(expected));
+  EXPECT_FALSE(capture->at(rec->next).has_value());
+}
+
+TEST_F(TestCapture, testSeek) {
+  constexpr std::uint32_t count = 10;
+  writeCapture(count);
+
+  auto indexed =
+      brilliant::snapcast::CaptureFile::open(path.c_str(), indexPath.c_str());
+  auto scanned = brilliant::snapcast::CaptureFile::open(path.c_str());
+  ASSERT_TRUE(indexed.has_value());
+  ASSERT_TRUE(scanned.has_value());
+
+  constexpr std::uint64_t usecPerSec = 1'000'000;
+  for (const auto& capture : {&indexed.value(), &scanned.value()}) {
+    auto rec = capture->at(capture->seek((4 * usecPerSec) + 1));
+    ASSERT_TRUE(rec.has_value());
+    EXPECT_EQ(rec->timestamp, 5 * usecPerSec);
+    EXPECT_EQ(capture->seek(count * usecPerSec), capture->size());
+  }
+}
+
+TEST_F(TestCapture, testLittleEndianFiles) {
+  writeCapture(2);
+
+  // record and index entry bytes do not depend on the host byte order
+  const auto load = [](const std::string& file) {
+    std::vector<unsigned char> bytes;
+    std::FILE* f = std::fopen(file.c_str(), "rb");
+    for (int c = 0; f && (c = std::fgetc(f)) != EOF;) {
+      bytes.push_back(static_cast<unsigned char>(c));
+    }
+    if (f) {
+      std::fclose(f);
+    }
+    return bytes;
+  };
+  const auto data = load(path);
+  const auto index = load(indexPath);
+  ASSERT_EQ(index.size(), 32);
+
+  // the second record, received at 1 s = 0x0F4240 us, follows the magic,
+  // the first record's header and its 34 frame bytes padded to 40
+  EXPECT_THAT(std::vector(index.begin() + 16, index.end()),  // NOLINT
+              testing::ElementsAre(0x40, 0x42, 0x0F, 0, 0, 0, 0, 0,  // NOLINT
+                                   0x40, 0, 0, 0, 0, 0, 0, 0));
+  ASSERT_GE(data.size(), 0x40 + 16);  // NOLINT
+  EXPECT_THAT(std::vector(data.begin() + 0x40, data.begin() + 0x50),  // NOLINT
+              testing::ElementsAre(0x40, 0x42, 0x0F, 0, 0, 0, 0, 0,  // NOLINT
+                                   0x22, 0, 0, 0, 0, 0, 0, 0));
+}
+
+TEST_F(TestCapture, testStopsAfterWriteError) {
+  // every write to /dev/full fails with ENOSPC
+  auto writer =
+      brilliant::snapcast::CaptureWriter::open(path.c_str(), "/dev/full");
+  ASSERT_TRUE(writer.has_value());
+  for (std::uint16_t i = 0; i < 2; ++i) {
+    const auto data = encodeTime(i);
+    writer->record({}, std::span(data).first(brilliant::snapcast::HEADER_SIZE),
+                   std::span(data).subspan(brilliant::snapcast::HEADER_SIZE));
+    EXPECT_EQ(writer->error(), boost::system::errc::no_space_on_device);
+  }
+
+  // the record after the error was not written
+  auto capture = brilliant::snapcast::CaptureFile::open(path.c_str());
+  ASSERT_TRUE(capture.has_value());
+  auto rec = capture->at(capture->seek(0));
+  ASSERT_TRUE(rec.has_value());
+  EXPECT_EQ(rec->next, capture->size());
+}
+
+TEST_F(TestCapture, testReplay) {
+  constexpr std::uint32_t count = 4;
+  writeCapture(count);
+  auto capture =
+      brilliant::snapcast::CaptureFile::open(path.c_str(), indexPath.c_str());
+  ASSERT_TRUE(capture.has_value());
+
+  using Socket = brilliant::snapcast::ReplaySocket<>;
+  brilliant::snapcast::TcpClient<Socket> tcpClient(
+      Socket(context.get_executor(), capture.value(),
+             brilliant::snapcast::ReplayMode::FAST),
+      std::pmr::get_default_resource());
+  brilliant::snapcast::SnapClient<Socket> snapClient(tcpClient);
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [&snapClient] -> boost::asio::awaitable<void> {
+        constexpr auto bufSize = 128;
+        std::vector<std::byte> buffer(bufSize);
+        for (std::uint32_t i = 0; i < count; ++i) {
+          auto result = co_await snapClient.read(std::span(buffer));
+          EXPECT_TRUE(result.has_value());
+          if (result) {
+            EXPECT_EQ(std::get<0>(result.value()).id, i);
+          }
+        }
+        auto result = co_await snapClient.read(std::span(buffer));
+        EXPECT_FALSE(result.has_value());
+        EXPECT_EQ(result.error(), boost::asio::error::eof);
+      },
+      boost::asio::detached);
+  context.run();
+}
+
+TEST_F(TestCapture, testRealtimeReplayReadTimesOut) {
+  writeCapture(2);
+  auto capture =
+      brilliant::snapcast::CaptureFile::open(path.c_str(), indexPath.c_str());
+  ASSERT_TRUE(capture.has_value());
+
+  using Socket = brilliant::snapcast::ReplaySocket<>;
+  brilliant::snapcast::TcpClient<Socket> tcpClient(
+      Socket(context.get_executor(), capture.value(),
+             brilliant::snapcast::ReplayMode::REALTIME),
+      std::pmr::get_default_resource());
+
+  boost::system::error_code first;
+  boost::system::error_code second;
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [&] -> boost::asio::awaitable<void> {
+        using namespace std::chrono_literals;
+        std::vector<std::byte> buffer(encodeTime(0).size());
+        std::tie(first, std::ignore) =
+            co_await tcpClient.read(std::span(buffer), 1s);
+        // the second record is due a second after the first
+        std::tie(second, std::ignore) =
+            co_await tcpClient.read(std::span(buffer), 20ms);
+      },
+      boost::asio::detached);
+  context.run();
+
+  EXPECT_FALSE(first);
+  EXPECT_EQ(second, boost::asio::error::timed_out);
+}
@@ -0,0 +1,177 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "BrilliantSnapcast/ClockSync.hpp"
+
+using namespace std::chrono_literals;
+
+struct TestClockSync : testing::Test {
+  TestClockSync() : path(testing::TempDir() + "TestClockSync.state") {
+    std::remove(path.c_str());
+  }
+
+  ~TestClockSync() override { std::remove(path.c_str()); }
+
+  TestClockSync(const TestClockSync&) = delete;
+  auto operator=(const TestClockSync&) -> TestClockSync& = delete;
+  TestClockSync(TestClockSync&&) = delete;
+  auto operator=(TestClockSync&&) -> TestClockSync& = delete;
+
+  // the offset of a server clock starting at 1 s ahead and drifting by
+  // 50 ppm
+  static auto trueOffset(std::chrono::steady_clock::duration elapsed)
+      -> std::int64_t {
+    constexpr std::int64_t START = 1'000'000;
+    constexpr double DRIFT = 50e-6;
+    return START +
+           std::llround(DRIFT * static_cast<double>(
+                                    std::chrono::duration_cast<
+                                        std::chrono::microseconds>(elapsed)
+                                        .count()));
+  }
+
+  // feeds one reply per second for a number of seconds
+  void feed(brilliant::snapcast::ClockSync& sync, int seconds) {
+    for (int i = 0; i < seconds; ++i) {
+      now += 1s;
+      sync.update(trueOffset(now - start), now);
+    }
+  }
+
+  std::string path;
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point now = start;
+  std::uint64_t server = brilliant::snapcast::ClockSync::serverId(
+      boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(),
+                                     1704));  // NOLINT
+};
+
+TEST_F(TestClockSync, testAveragesFirstReplies) {
+  brilliant::snapcast::ClockSync sync;
+  EXPECT_FALSE(sync.offset(now));
+  EXPECT_TRUE(sync.update(5100, now));  // NOLINT
+  EXPECT_EQ(sync.offset(now), 5100);
+  EXPECT_TRUE(sync.update(4900, now));  // NOLINT
+  EXPECT_EQ(sync.offset(now), 5000);
+  EXPECT_EQ(sync.confidence(), 2);
+}
+
+TEST_F(TestClockSync, testEstimatesDrift) {
+  brilliant::snapcast::ClockSync sync;
+  feed(sync, 600);  // NOLINT
+  EXPECT_NEAR(sync.driftPpm(), 50, 1);  // NOLINT
+  EXPECT_NEAR(static_cast<double>(*sync.offset(now)),
+              static_cast<double>(trueOffset(now - start)), 10);  // NOLINT
+
+  // the drift carries the offset between replies
+  const auto later = now + 10s;
+  EXPECT_NEAR(static_cast<double>(*sync.offset(later)),
+              static_cast<double>(trueOffset(later - start)), 20);  // NOLINT
+}
+
+TEST_F(TestClockSync, testSavesAndRestores) {
+  brilliant::snapcast::ClockSync sync;
+  feed(sync, 600);  // NOLINT
+  const auto state = sync.state(server);
+  EXPECT_EQ(state.server, server);
+  EXPECT_EQ(state.confidence, 600);
+  EXPECT_NEAR(static_cast<double>(state.driftPpb), 50000, 1000);  // NOLINT
+
+  ASSERT_FALSE(brilliant::snapcast::ClockSync::save(path.c_str(), state));
+  const auto loaded = brilliant::snapcast::ClockSync::load(path.c_str());
+  ASSERT_TRUE(loaded);
+  EXPECT_EQ(*loaded, state);
+
+  // a restart five minutes later predicts the offset at once
+  now += 5min;
+  brilliant::snapcast::ClockSync restored;
+  ASSERT_TRUE(restored.restore(*loaded, server, now));
+  EXPECT_TRUE(restored.validating());
+  EXPECT_NEAR(static_cast<double>(*restored.offset(now)),
+              static_cast<double>(trueOffset(now - start)), 50);  // NOLINT
+
+  // the first replies validate the estimate
+  feed(restored, 3);
+  EXPECT_FALSE(restored.validating());
+  EXPECT_EQ(restored.confidence(), 603);
+}
+
+TEST_F(TestClockSync, testIgnoresUnusableState) {
+  brilliant::snapcast::ClockSync sync;
+  feed(sync, 4);
+  const auto weak = sync.state(server);
+  feed(sync, 4);
+  const auto state = sync.state(server);
+
+  brilliant::snapcast::ClockSync restored;
+  EXPECT_FALSE(restored.restore(weak, server, now));
+  EXPECT_FALSE(restored.restore(state, server + 1, now));
+  EXPECT_FALSE(restored.restore(state, server, now + 25h));
+  EXPECT_FALSE(restored.restore(state, server, now - 1h));
+  auto otherBoot = state;
+  ++otherBoot.bootLow;
+  EXPECT_FALSE(restored.restore(otherBoot, server, now));
+  EXPECT_FALSE(restored.offset(now));
+  EXPECT_TRUE(restored.restore(state, server, now));
+
+  // a missing or cut short file
+  EXPECT_EQ(brilliant::snapcast::ClockSync::load(path.c_str()).error(),
+            boost::system::errc::no_such_file_or_directory);
+  std::FILE* file = std::fopen(path.c_str(), "w");
+  ASSERT_NE(file, nullptr);
+  std::fputs("BSCLK001", file);
+  std::fclose(file);
+  EXPECT_EQ(brilliant::snapcast::ClockSync::load(path.c_str()).error(),
+            boost::system::errc::illegal_byte_sequence);
+}
+
+TEST_F(TestClockSync, testSavesAtomically) {
+  brilliant::snapcast::ClockSync sync;
+  feed(sync, 8);  // NOLINT
+  auto state = sync.state(server);
+  ASSERT_FALSE(brilliant::snapcast::ClockSync::save(path.c_str(), state));
+
+  // a second save replaces the file without leaving the temporary file
+  ++state.confidence;
+  ASSERT_FALSE(brilliant::snapcast::ClockSync::save(path.c_str(), state));
+  EXPECT_EQ(brilliant::snapcast::ClockSync::load(path.c_str()), state);
+  const auto temporary = path + "." + std::to_string(::getpid()) + ".tmp";
+  EXPECT_NE(::access(temporary.c_str(), F_OK), 0);
+
+  // a save into a missing directory fails
+  const auto missing = testing::TempDir() + "missing/state";
+  EXPECT_EQ(brilliant::snapcast::ClockSync::save(missing.c_str(), state),
+            boost::system::errc::no_such_file_or_directory);
+}
+
+TEST_F(TestClockSync, testIdentifiesHost) {
+  using brilliant::snapcast::ClockSync;
+  EXPECT_EQ(ClockSync::serverId("snapserver", 1704),  // NOLINT
+            ClockSync::serverId("snapserver", 1704));  // NOLINT
+  EXPECT_NE(ClockSync::serverId("snapserver", 1704),  // NOLINT
+            ClockSync::serverId("snapserver", 1705));  // NOLINT
+  EXPECT_NE(ClockSync::serverId("snapserver", 1704),  // NOLINT
+            ClockSync::serverId("other", 1704));  // NOLINT
+}
+
+TEST_F(TestClockSync, testDiscardsContradictedState) {
+  brilliant::snapcast::ClockSync sync;
+  feed(sync, 10);  // NOLINT
+  brilliant::snapcast::ClockSync restored;
+  ASSERT_TRUE(restored.restore(sync.state(server), server, now));
+
+  // the server restarted with another clock
+  now += 1s;
+  EXPECT_FALSE(restored.update(-42, now));  // NOLINT
+  EXPECT_FALSE(restored.validating());
+  EXPECT_EQ(restored.confidence(), 1);
+  EXPECT_EQ(restored.offset(now), -42);
+}
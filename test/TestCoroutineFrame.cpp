@@ -0,0 +1,105 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+#include <vector>
+
+#include "BrilliantSnapcast/ProtocolSession.hpp"
+#include "BrilliantSnapcast/SnapClient.hpp"
+#include "CountingResource.hpp"
+#include "FakeSocket.hpp"
+
+struct TestCoroutineFrame : testing::Test {
+  TestCoroutineFrame()
+      : tcpClient(
+            FakeSocket<boost::asio::ip::tcp>{context.get_executor(), &state},
+            &counting),
+        snapClient(tcpClient) {}
+
+  void SetUp() override {
+    if (!BRILLIANT_SNAPCAST_PMR_FRAMES) {
+      GTEST_SKIP() << "frames use Asio's allocation with this Boost version";
+    }
+  }
+
+  template <class Coroutine>
+  void run(Coroutine coroutine) {
+    boost::asio::co_spawn(context, std::move(coroutine),
+                          boost::asio::detached);
+    context.run();
+    context.restart();
+  }
+
+  CountingResource counting;
+  SocketState state;
+  boost::asio::io_context context;
+  brilliant::snapcast::TcpClient<FakeSocket<boost::asio::ip::tcp>> tcpClient;
+  brilliant::snapcast::SnapClient<FakeSocket<boost::asio::ip::tcp>> snapClient;
+};
+
+TEST_F(TestCoroutineFrame, testConnectFrame) {
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+  run([this] -> boost::asio::awaitable<void> {
+    auto ec = co_await tcpClient.connect("127.0.0.1", 1704);  // NOLINT
+    EXPECT_FALSE(ec);
+  });
+  EXPECT_GE(counting.allocations, 1);
+  EXPECT_EQ(counting.allocations, counting.deallocations);
+  EXPECT_EQ(counting.outstanding, 0);
+}
+
+TEST_F(TestCoroutineFrame, testSendFrame) {
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+  run([this] -> boost::asio::awaitable<void> {
+    std::vector<std::byte> buffer(64);  // NOLINT
+    auto result = co_await snapClient.send(0, brilliant::snapcast::Time{},
+                                           std::span(buffer));
+    EXPECT_TRUE(result.has_value());
+  });
+  EXPECT_GE(counting.allocations, 1);
+  EXPECT_EQ(counting.allocations, counting.deallocations);
+  EXPECT_EQ(counting.outstanding, 0);
+}
+
+TEST_F(TestCoroutineFrame, testReadFrame) {
+  state.inData.resize(brilliant::snapcast::HEADER_SIZE +
+                      sizeof(brilliant::snapcast::Time));
+  brilliant::snapcast::Message message = brilliant::snapcast::Time{};
+  std::ignore = brilliant::snapcast::ProtocolSession::encode(
+      0, message, {}, std::span(state.inData));
+
+  std::size_t peak = 0;
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+  run([this, &peak] -> boost::asio::awaitable<void> {
+    std::vector<std::byte> buffer(64);  // NOLINT
+    auto result = co_await snapClient.read(std::span(buffer));
+    EXPECT_TRUE(result.has_value());
+    peak = counting.allocations;
+  });
+  // the frame is alive while the read is awaited
+  EXPECT_GE(peak, 1);
+  EXPECT_EQ(counting.allocations, counting.deallocations);
+  EXPECT_EQ(counting.outstanding, 0);
+}
+
+#if BRILLIANT_SNAPCAST_PMR_FRAMES
+TEST_F(TestCoroutineFrame, testAllocatesFrameFromResource) {
+  using Frame = brilliant::snapcast::PmrAwaitableFrame<
+      void, boost::asio::any_io_executor,
+      brilliant::snapcast::TcpClient<FakeSocket<boost::asio::ip::tcp>>>;
+  constexpr std::size_t size = 200;
+
+  void* frame = Frame::operator new(size, tcpClient);
+  EXPECT_EQ(counting.allocations, 1);
+  // the frame and the resource pointer in front of it
+  EXPECT_GE(counting.outstanding, size + sizeof(std::pmr::memory_resource*));
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(frame) %  // NOLINT
+                __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+            0);
+
+  // released without the owner
+  Frame::operator delete(frame, size);
+  EXPECT_EQ(counting.deallocations, 1);
+  EXPECT_EQ(counting.outstanding, 0);
+}
+#endif
@@ -0,0 +1,132 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <ifaddrs.h>
+#include <sys/utsname.h>
+
+#include <array>
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "BrilliantSnapcast/LinuxUtilProvider.hpp"
+#include "BrilliantSnapcast/SnapClient.hpp"
+#include "CountingResource.hpp"
+
+struct TestLinuxUtilProvider : testing::Test {
+  using Socket = boost::asio::ip::tcp::socket;
+
+  // the hardware address of the interface with an address, from sysfs
+  static auto sysfsAddress(const boost::asio::ip::address& address)
+      -> std::string {
+    ifaddrs* list = nullptr;
+    if (::getifaddrs(&list) != 0) {
+      return {};
+    }
+    std::string name;
+    for (auto* entry = list; entry != nullptr; entry = entry->ifa_next) {
+      if (entry->ifa_addr == nullptr) {
+        continue;
+      }
+      boost::asio::ip::udp::endpoint endpoint;
+      if (entry->ifa_addr->sa_family == AF_INET) {
+        std::memcpy(endpoint.data(), entry->ifa_addr, sizeof(sockaddr_in));
+      } else if (entry->ifa_addr->sa_family == AF_INET6) {
+        std::memcpy(endpoint.data(), entry->ifa_addr, sizeof(sockaddr_in6));
+      } else {
+        continue;
+      }
+      if (endpoint.address() == address) {
+        name = entry->ifa_name;
+        break;
+      }
+    }
+    ::freeifaddrs(list);
+    std::string result;
+    std::ifstream("/sys/class/net/" + name + "/address") >> result;
+    return result;
+  }
+
+  boost::asio::io_context context;
+  brilliant::snapcast::LinuxUtilProvider provider;
+};
+
+TEST_F(TestLinuxUtilProvider, testReadsPlatformInfo) {
+  utsname names{};
+  ASSERT_EQ(::uname(&names), 0);
+  EXPECT_EQ(provider.arch(), names.machine);
+  EXPECT_FALSE(provider.os().empty());
+  EXPECT_FALSE(provider.os().starts_with('"'));
+
+  CountingResource resource;
+  EXPECT_EQ(provider.getArch(&resource), provider.arch());
+  EXPECT_EQ(provider.getOS(&resource), provider.os());
+}
+
+TEST_F(TestLinuxUtilProvider, testFindsInterfaceOfSocket) {
+  // a connected UDP socket has the local address of the route to the peer
+  boost::asio::ip::udp::socket socket(context);
+  boost::system::error_code ec;
+  socket.open(boost::asio::ip::udp::v4(), ec);
+  ASSERT_FALSE(ec);
+  socket.connect({boost::asio::ip::make_address_v4("192.0.2.1"), 9}, ec);
+  if (ec) {
+    GTEST_SKIP() << "no route: " << ec.message();
+  }
+  const auto expected = sysfsAddress(socket.local_endpoint().address());
+  if (expected.empty() ||
+      expected == brilliant::snapcast::LinuxUtilProvider::NO_MAC) {
+    GTEST_SKIP() << "the interface has no hardware address";
+  }
+
+  EXPECT_EQ(provider.macAddress(socket.native_handle()), expected);
+  // kept for later calls without a socket
+  EXPECT_EQ(provider.macAddress(-1), expected);
+
+  CountingResource resource;
+  EXPECT_EQ(std::string_view(provider.getMacAddress(-1, &resource)), expected);
+  EXPECT_EQ(resource.allocations, 1);
+}
+
+TEST_F(TestLinuxUtilProvider, testFallsBackWithoutInterface) {
+  const auto first = std::string(provider.macAddress(-1));
+  EXPECT_THAT(first, testing::MatchesRegex("([0-9a-f]{2}:){5}[0-9a-f]{2}"));
+
+  // the loopback interface has no hardware address of its own
+  brilliant::snapcast::TcpClient<Socket> tcpClient(
+      Socket(context), std::pmr::get_default_resource());
+  EXPECT_EQ(tcpClient.nativeHandle(), -1);
+  boost::asio::ip::tcp::acceptor acceptor(
+      context, {boost::asio::ip::address_v4::loopback(), 0});
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [&tcpClient, &acceptor] -> boost::asio::awaitable<void> {
+        auto accepted = acceptor.async_accept(boost::asio::use_awaitable);
+        EXPECT_FALSE(co_await tcpClient.connect(acceptor.local_endpoint()));
+        auto peer = co_await std::move(accepted);
+      },
+      boost::asio::detached);
+  context.run();
+  ASSERT_GE(tcpClient.nativeHandle(), 0);
+  EXPECT_EQ(provider.macAddress(tcpClient.nativeHandle()), first);
+
+  // the Hello message asks for the address of the connection
+  brilliant::snapcast::SnapClient<Socket> client(tcpClient);
+  const auto hello = client.helloObject(provider, {});
+  boost::json::serializer serializer;
+  serializer.reset(&hello);
+  std::string json;
+  std::array<char, 512> buffer{};  // NOLINT
+  while (!serializer.done()) {
+    json.append(serializer.read(buffer.data(), buffer.size()));
+  }
+  EXPECT_THAT(json, testing::HasSubstr("\"MAC\":\"" + first + "\""));
+  EXPECT_THAT(json, testing::HasSubstr("\"Arch\":\"" +
+                                       std::string(provider.arch()) + "\""));
+
+  provider.forgetMacAddress();
+  EXPECT_EQ(provider.macAddress(-1), first);
+}
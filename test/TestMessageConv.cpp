@@ -33,7 +33,7 @@ TEST(TestMessageConv, testConvTime) {
 }
 
 TEST(TestMessageConv, testConvBase) {
-  std::array<std::byte, sizeof(brilliant::snapcast::Base)> buffer{};
+  std::array<std::byte, brilliant::snapcast::HEADER_SIZE> buffer{};
   brilliant::snapcast::Base base{
       .type = brilliant::snapcast::MessageType::SERVER_SETTINGS,
       .id = 4,
@@ -94,8 +94,8 @@ TEST(TestMessageConv, testConvHello) {
             std::byte{'b'},  std::byte{'a'},  std::byte{'0'},  std::byte{'1'},
             std::byte{'2'},  std::byte{'3'}};
 
-  message = brilliant::snapcast::read(std::span(buffer),
-                                      brilliant::snapcast::MessageType::HELLO);
+  message = *brilliant::snapcast::read(
+      std::span(buffer), brilliant::snapcast::MessageType::HELLO);
 
   auto& msg = std::get<brilliant::snapcast::Hello>(message);
   EXPECT_EQ(msg.size, 10);
@@ -164,7 +164,7 @@ TEST(TestMessageConv, testConvCodecHeader) {
           std::byte{'i'}, std::byte{'n'}, std::byte{'g'}));
 
   message = brilliant::snapcast::CodecHeader{};
-  message = brilliant::snapcast::read(
+  message = *brilliant::snapcast::read(
       std::span(buffer), brilliant::snapcast::MessageType::CODEC_HEADER);
 
   {
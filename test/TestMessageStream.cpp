@@ -0,0 +1,123 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <vector>
+
+#include "BrilliantSnapcast/MessageStream.hpp"
+#include "BrilliantSnapcast/ProtocolSession.hpp"
+#include "BrilliantSnapcast/SimulatedSocket.hpp"
+#include "BrilliantSnapcast/VirtualClock.hpp"
+
+using namespace std::chrono_literals;
+
+struct TestMessageStream : testing::Test {
+  using Socket = brilliant::snapcast::SimulatedSocket<>;
+
+  TestMessageStream()
+      : connection(clock, {.latency = 5ms}, {},
+                   std::pmr::get_default_resource()),
+        tcpClient(connection.client(executor()),
+                  std::pmr::get_default_resource()),
+        snapClient(tcpClient),
+        server(connection.server(executor())) {}
+
+  auto executor() -> boost::asio::any_io_executor {
+    return context.get_executor();
+  }
+
+  // the server sends count Time messages 1ms apart, then closes
+  void serve(std::uint16_t count) {
+    boost::asio::co_spawn(
+        context,
+        // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+        [this, count] -> boost::asio::awaitable<void> {
+          std::vector<std::byte> data(brilliant::snapcast::HEADER_SIZE +
+                                      sizeof(brilliant::snapcast::Time));
+          for (std::uint16_t i = 0; i < count; ++i) {
+            brilliant::snapcast::Message message =
+                brilliant::snapcast::Time{};
+            std::ignore = brilliant::snapcast::ProtocolSession::encode(
+                i, message, {}, std::span(data));
+            co_await boost::asio::async_write(
+                server, boost::asio::buffer(data), boost::asio::use_awaitable);
+            co_await clock.asyncWait(executor(), 1ms,
+                                     boost::asio::use_awaitable);
+          }
+          server.close();
+        },
+        boost::asio::detached);
+  }
+
+  boost::asio::io_context context;
+  brilliant::snapcast::VirtualClock clock{std::pmr::get_default_resource()};
+  brilliant::snapcast::SimulatedConnection connection;
+  brilliant::snapcast::TcpClient<Socket> tcpClient;
+  brilliant::snapcast::SnapClient<Socket> snapClient;
+  Socket server;
+};
+
+TEST_F(TestMessageStream, testReadAhead) {
+  constexpr std::uint16_t count = 20;
+  constexpr std::size_t depth = 4;
+  serve(count);
+
+  std::vector<std::byte> storage(depth * 64);
+  brilliant::snapcast::MessageStream<Socket, depth> stream(snapClient,
+                                                          std::span(storage));
+  boost::system::error_code runResult;
+  boost::asio::co_spawn(context, stream.run(),
+                        [&runResult](std::exception_ptr,
+                                     boost::system::error_code ec) {
+                          runResult = ec;
+                        });
+
+  std::uint16_t received = 0;
+  std::size_t maxBuffered = 0;
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [&] -> boost::asio::awaitable<void> {
+        while (true) {
+          auto result = co_await stream.next();
+          if (!result) {
+            EXPECT_EQ(result.error(), boost::asio::error::eof);
+            co_return;
+          }
+          EXPECT_EQ(std::get<0>(result.value()).id, received);
+          ++received;
+          // processing is slower than the server sends
+          co_await clock.asyncWait(executor(), 3ms,
+                                   boost::asio::use_awaitable);
+          maxBuffered = std::max(maxBuffered, stream.buffered());
+        }
+      },
+      boost::asio::detached);
+  clock.run(context);
+
+  EXPECT_EQ(received, count);
+  EXPECT_EQ(runResult, boost::asio::error::eof);
+  EXPECT_EQ(maxBuffered, depth);
+  // consuming takes 3ms per message, reading overlapped with it
+  EXPECT_LT(clock.now().time_since_epoch(), (count * 3ms) + 10ms);
+}
+
+TEST_F(TestMessageStream, testClose) {
+  std::vector<std::byte> storage(256);
+  brilliant::snapcast::MessageStream<Socket> stream(snapClient,
+                                                    std::span(storage));
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [&] -> boost::asio::awaitable<void> {
+        auto result = co_await stream.next();
+        EXPECT_FALSE(result.has_value());
+        EXPECT_EQ(result.error(), boost::asio::error::operation_aborted);
+      },
+      boost::asio::detached);
+  context.poll();
+  stream.close();
+  clock.run(context);
+}
@@ -0,0 +1,172 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "BrilliantSnapcast/Pipeline.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+  // handles are move only like the frame handles passed between stages
+  using Handle = std::unique_ptr<int>;
+
+  auto waitFor(const std::atomic<std::size_t>& counter, std::size_t value)
+      -> bool {
+    for (int i = 0; i < 5000 && counter.load() < value; ++i) {
+      std::this_thread::sleep_for(1ms);
+    }
+    return counter.load() == value;
+  }
+}  // namespace
+
+TEST(TestPipeline, testStagesPreserveOrder) {
+  auto* mr = std::pmr::get_default_resource();
+  brilliant::snapcast::StageQueue<Handle> decodeQueue(16, mr);
+  brilliant::snapcast::StageQueue<Handle> outputQueue(16, mr);
+
+  auto decode = [&outputQueue](std::span<Handle> batch,
+                               std::stop_token stop) {
+    for (auto& handle : batch) {
+      *handle *= 2;
+      outputQueue.push(std::move(handle), stop);
+    }
+  };
+  std::vector<int> played;
+  std::atomic<std::size_t> playedCount{};
+  auto output = [&played, &playedCount](std::span<Handle> batch,
+                                        std::stop_token) {
+    for (auto& handle : batch) {
+      played.push_back(*handle);
+    }
+    playedCount += batch.size();
+  };
+
+  brilliant::snapcast::PipelineStage decodeStage(decodeQueue, decode, {}, mr);
+  brilliant::snapcast::StageOptions options;
+  options.batchSize = 4;
+  brilliant::snapcast::PipelineStage outputStage(outputQueue, output, options,
+                                                 mr);
+  decodeStage.start();
+  outputStage.start();
+
+  constexpr int count = 1000;
+  for (int i = 0; i < count; ++i) {
+    decodeQueue.push(std::make_unique<int>(i), {});
+  }
+  ASSERT_TRUE(waitFor(playedCount, count));
+  decodeStage.stop();
+  outputStage.stop();
+
+  ASSERT_EQ(played.size(), count);
+  for (int i = 0; i < count; ++i) {
+    EXPECT_EQ(played[static_cast<std::size_t>(i)], 2 * i);
+  }
+
+  decltype(outputStage)::Snapshot stats;
+  outputStage.snapshot(stats);
+  EXPECT_EQ(stats.items, count);
+  EXPECT_LE(stats.batches, count);
+  EXPECT_EQ(stats.service.count, stats.batches);
+
+  auto queueStats =
+      std::make_unique<brilliant::snapcast::StageQueue<Handle>::Snapshot>();
+  decodeQueue.snapshot(*queueStats);
+  EXPECT_EQ(queueStats->size, 0);
+  EXPECT_EQ(queueStats->capacity, 16);
+  EXPECT_EQ(queueStats->wait.count, count);
+}
+
+TEST(TestPipeline, testBackpressure) {
+  auto* mr = std::pmr::get_default_resource();
+  brilliant::snapcast::StageQueue<Handle> queue(2, mr);
+  brilliant::snapcast::StageOptions options;
+  options.batchSize = 1;
+  std::atomic<std::size_t> consumed{};
+  brilliant::snapcast::PipelineStage slow(
+      queue,
+      [&consumed](std::span<Handle> batch, std::stop_token) {
+        std::this_thread::sleep_for(1ms);
+        consumed += batch.size();
+      },
+      options, mr);
+  slow.start();
+
+  constexpr std::size_t count = 20;
+  std::size_t rejected = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    Handle handle = std::make_unique<int>(0);
+    if (!queue.tryPush(handle)) {
+      ++rejected;
+      queue.push(std::move(handle), {});
+    }
+  }
+  ASSERT_TRUE(waitFor(consumed, count));
+
+  auto stats =
+      std::make_unique<brilliant::snapcast::StageQueue<Handle>::Snapshot>();
+  queue.snapshot(*stats);
+  EXPECT_GT(rejected, 0);
+  EXPECT_EQ(stats->rejected, rejected);
+  EXPECT_GT(stats->stalls, 0);
+  EXPECT_LE(stats->maxSize, 2);
+}
+
+TEST(TestPipeline, testStopWhileBlocked) {
+  auto* mr = std::pmr::get_default_resource();
+  brilliant::snapcast::StageQueue<Handle> input(4, mr);
+  brilliant::snapcast::StageQueue<Handle> full(1, mr);
+  Handle first = std::make_unique<int>(0);
+  ASSERT_TRUE(full.tryPush(first));
+
+  // the stage blocks pushing into a full queue nobody drains
+  brilliant::snapcast::PipelineStage stage(
+      input,
+      [&full](std::span<Handle> batch, std::stop_token stop) {
+        for (auto& handle : batch) {
+          EXPECT_FALSE(full.push(std::move(handle), stop));
+        }
+      },
+      {}, mr);
+  stage.start();
+  input.push(std::make_unique<int>(1), {});
+  std::this_thread::sleep_for(10ms);
+  stage.stop();
+
+  // a stage waiting on an empty queue stops too
+  brilliant::snapcast::PipelineStage idle(
+      input, [](std::span<Handle>, std::stop_token) {}, {}, mr);
+  idle.start();
+  idle.stop();
+}
+
+TEST(TestPipeline, testReportsThreadOptionErrors) {
+  auto* mr = std::pmr::get_default_resource();
+  brilliant::snapcast::StageQueue<Handle> input(4, mr);
+  brilliant::snapcast::StageOptions options;
+  options.core = std::numeric_limits<std::size_t>::max();
+  std::atomic<std::size_t> processed{};
+  brilliant::snapcast::PipelineStage stage(
+      input,
+      [&processed](std::span<Handle> batch, std::stop_token) {
+        processed += batch.size();
+      },
+      options, mr);
+
+  const auto ec = stage.start();
+#if defined(__linux__)
+  EXPECT_EQ(ec, boost::system::errc::invalid_argument);
+#else
+  EXPECT_FALSE(ec);
+#endif
+
+  // the stage runs without the option
+  input.push(std::make_unique<int>(1), {});
+  EXPECT_TRUE(waitFor(processed, 1));
+  stage.stop();
+}
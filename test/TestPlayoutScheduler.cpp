@@ -0,0 +1,117 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "BrilliantSnapcast/PlayoutScheduler.hpp"
+
+using namespace std::chrono_literals;
+
+struct TestPlayoutScheduler : testing::Test {
+  TestPlayoutScheduler()
+      : producer(*brilliant::snapcast::SharedPcmRing::create(128, 16)),
+        consumer(*brilliant::snapcast::SharedPcmRing::open(
+            ::dup(producer.fd()))) {}
+
+  brilliant::snapcast::SharedPcmRing producer;
+  brilliant::snapcast::SharedPcmRing consumer;
+};
+
+TEST_F(TestPlayoutScheduler, testCoalescesWakeups) {
+  brilliant::snapcast::PlayoutOptions options;
+  options.period = 20ms;
+  options.slack = 100ms;
+  brilliant::snapcast::PlayoutScheduler scheduler(consumer, options);
+
+  // 400 ms of audio in 5 ms frames, queued ahead like a network buffer
+  constexpr int count = 80;
+  const auto start = std::chrono::steady_clock::now() + 50ms;
+  const std::vector<std::byte> samples(16);
+  for (int i = 0; i < count; ++i) {
+    ASSERT_TRUE(producer.tryPublish(samples, start + i * 5ms));
+  }
+
+  std::stop_source stop;
+  std::vector<std::chrono::nanoseconds> leads;
+  const auto written = scheduler.run(
+      [&](const brilliant::snapcast::PcmSlot& slot) {
+        leads.push_back(slot.playout - std::chrono::steady_clock::now());
+        if (leads.size() == count) {
+          stop.request_stop();
+        }
+      },
+      stop.get_token());
+  EXPECT_EQ(written, count);
+
+  // every frame is written at least a period ahead, none earlier than the
+  // slack
+  for (const auto lead : leads) {
+    EXPECT_GT(lead, 0ns);
+    EXPECT_LE(lead, options.slack);
+  }
+
+  brilliant::snapcast::PlayoutScheduler::Snapshot stats;
+  scheduler.snapshot(stats);
+  EXPECT_EQ(stats.frames, count);
+  EXPECT_EQ(stats.late, 0);
+  // a timer per frame would wake 80 times
+  EXPECT_LT(stats.wakeups, 15);
+}
+
+TEST_F(TestPlayoutScheduler, testCountsLateFrames) {
+  brilliant::snapcast::PlayoutScheduler scheduler(consumer, {});
+  brilliant::snapcast::SessionMetrics metrics;
+  scheduler.setMetrics(&metrics);
+
+  const std::vector<std::byte> samples(16);
+  ASSERT_TRUE(producer.tryPublish(samples,
+                                  std::chrono::steady_clock::now() - 10ms));
+  std::stop_source stop;
+  scheduler.run(
+      [&](const brilliant::snapcast::PcmSlot&) { stop.request_stop(); },
+      stop.get_token());
+
+  brilliant::snapcast::PlayoutScheduler::Snapshot stats;
+  scheduler.snapshot(stats);
+  EXPECT_EQ(stats.late, 1);
+  brilliant::snapcast::SessionMetrics::Snapshot result;
+  metrics.snapshot(result);
+  EXPECT_EQ(result.lateChunks, 1);
+}
+
+TEST_F(TestPlayoutScheduler, testSleepsWhileIdle) {
+  brilliant::snapcast::PlayoutScheduler scheduler(consumer, {});
+
+  std::stop_source stop;
+  std::jthread stopper([&stop] {
+    std::this_thread::sleep_for(50ms);
+    stop.request_stop();
+  });
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(scheduler.run([](const auto&) {}, stop.get_token()), 0);
+  // the idle wait ends with the stop request
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+
+  brilliant::snapcast::PlayoutScheduler::Snapshot stats;
+  scheduler.snapshot(stats);
+  EXPECT_EQ(stats.wakeups, 1);
+}
+
+TEST_F(TestPlayoutScheduler, testWakesForFramesAfterIdle) {
+  brilliant::snapcast::PlayoutScheduler scheduler(consumer, {});
+
+  std::stop_source stop;
+  std::jthread publisher([this] {
+    std::this_thread::sleep_for(20ms);
+    const std::vector<std::byte> samples(16);
+    producer.tryPublish(samples, std::chrono::steady_clock::now() + 50ms);
+  });
+  const auto written = scheduler.run(
+      [&](const brilliant::snapcast::PcmSlot&) { stop.request_stop(); },
+      stop.get_token());
+  EXPECT_EQ(written, 1);
+}
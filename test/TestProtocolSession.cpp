@@ -0,0 +1,284 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <initializer_list>
+#include <string_view>
+#include <vector>
+
+#include "BrilliantSnapcast/Message.hpp"
+#include "BrilliantSnapcast/MessageConv.hpp"
+#include "BrilliantSnapcast/ProtocolSession.hpp"
+
+namespace {
+  auto encodeTime(std::uint16_t id, brilliant::snapcast::Time time)
+      -> std::vector<std::byte> {
+    std::vector<std::byte> data(brilliant::snapcast::HEADER_SIZE +
+                                sizeof(brilliant::snapcast::Time));
+    brilliant::snapcast::Message message = brilliant::snapcast::Time{};
+    auto result = brilliant::snapcast::ProtocolSession::encode(
+        id, message, time, std::span(data));
+    EXPECT_TRUE(result.has_value());
+    return data;
+  }
+
+  // a frame with a raw body, little endian sizes are written by the test
+  auto encodeRaw(brilliant::snapcast::MessageType type,
+                 std::initializer_list<std::uint8_t> body)
+      -> std::vector<std::byte> {
+    std::vector<std::byte> data(brilliant::snapcast::HEADER_SIZE);
+    brilliant::snapcast::Base base{};
+    base.type = type;
+    base.size = static_cast<std::uint32_t>(body.size());
+    brilliant::snapcast::write(std::span(data), base);
+    for (const auto byte : body) {
+      data.push_back(std::byte{byte});
+    }
+    return data;
+  }
+}  // namespace
+
+TEST(TestProtocolSession, testEncode) {
+  std::vector<std::byte> buffer(brilliant::snapcast::HEADER_SIZE + 1);
+  brilliant::snapcast::Message message = brilliant::snapcast::Time{};
+  const brilliant::snapcast::Time sent{.sec = 5, .usec = 6};
+
+  auto result = brilliant::snapcast::ProtocolSession::encode(
+      3, message, sent, std::span(buffer));
+  EXPECT_FALSE(result.has_value());
+  EXPECT_EQ(result.error().value(), boost::system::errc::no_buffer_space);
+
+  buffer.resize(64);  // NOLINT
+  result = brilliant::snapcast::ProtocolSession::encode(3, message, sent,
+                                                       std::span(buffer));
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(result->size(), brilliant::snapcast::HEADER_SIZE +
+                                sizeof(brilliant::snapcast::Time));
+
+  brilliant::snapcast::Base base{};
+  brilliant::snapcast::read(*result, base);
+  EXPECT_EQ(base.type, brilliant::snapcast::MessageType::TIME);
+  EXPECT_EQ(base.id, 3);
+  EXPECT_EQ(base.sent.sec, sent.sec);
+  EXPECT_EQ(base.sent.usec, sent.usec);
+  EXPECT_EQ(base.size, sizeof(brilliant::snapcast::Time));
+
+  // a Time message carries the sent time
+  auto& time = std::get<brilliant::snapcast::Time>(message);
+  EXPECT_EQ(time.sec, sent.sec);
+  EXPECT_EQ(time.usec, sent.usec);
+}
+
+TEST(TestProtocolSession, testEncodeFixedSize) {
+  static_assert(brilliant::snapcast::FRAME_SIZE<brilliant::snapcast::Time> ==
+                brilliant::snapcast::HEADER_SIZE +
+                    sizeof(brilliant::snapcast::Time));
+  static_assert(
+      brilliant::snapcast::WireTraits<brilliant::snapcast::WireChunk>::TYPE ==
+      brilliant::snapcast::MessageType::WIRE_CHUNK);
+  static_assert(
+      !brilliant::snapcast::WireTraits<brilliant::snapcast::Hello>::FIXED_SIZE);
+
+  // larger than needed, the frame is a prefix
+  std::array<std::byte, 64> buffer{};
+  brilliant::snapcast::Time time{};
+  const brilliant::snapcast::Time sent{.sec = 5, .usec = 6};
+  const auto frame = brilliant::snapcast::ProtocolSession::encode(
+      3, time, sent, std::span(buffer), 2);
+  static_assert(decltype(frame)::extent ==
+                brilliant::snapcast::FRAME_SIZE<brilliant::snapcast::Time>);
+  EXPECT_EQ(frame.data(), buffer.data());
+  EXPECT_EQ(time.sec, sent.sec);
+  EXPECT_EQ(time.usec, sent.usec);
+
+  // same bytes as the variant path
+  std::vector<std::byte> expected(frame.size());
+  brilliant::snapcast::Message message = brilliant::snapcast::Time{};
+  ASSERT_TRUE(brilliant::snapcast::ProtocolSession::encode(
+      3, message, sent, std::span(expected), 2));
+  EXPECT_TRUE(std::ranges::equal(frame, expected));
+}
+
+TEST(TestProtocolSession, testFeedByteByByte) {
+  const auto data = encodeTime(1, {.sec = 12, .usec = 34});
+
+  std::vector<std::byte> storage(128);  // NOLINT
+  brilliant::snapcast::ProtocolSession session(storage);
+
+  for (std::size_t i = 0; i < data.size(); ++i) {
+    auto frame = session.next();
+    ASSERT_TRUE(frame.has_value());
+    EXPECT_FALSE(frame->has_value());
+    EXPECT_EQ(session.feed(std::span(data).subspan(i, 1),
+                           brilliant::snapcast::Time{.sec = 7, .usec = 8}),
+              1);
+  }
+
+  auto frame = session.next();
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_TRUE(frame->has_value());
+  const auto& [base, message] = frame->value();
+  EXPECT_EQ(base.type, brilliant::snapcast::MessageType::TIME);
+  EXPECT_EQ(base.received.sec, 7);
+  EXPECT_EQ(base.received.usec, 8);
+  const auto& time = std::get<brilliant::snapcast::Time>(message);
+  EXPECT_EQ(time.sec, 12);
+  EXPECT_EQ(time.usec, 34);
+}
+
+TEST(TestProtocolSession, testFeedMultipleFrames) {
+  auto data = encodeTime(1, {.sec = 1, .usec = 0});
+  const auto second = encodeTime(2, {.sec = 2, .usec = 0});
+  data.insert(data.end(), second.begin(), second.end());
+
+  std::vector<std::byte> storage(128);  // NOLINT
+  brilliant::snapcast::ProtocolSession session(storage);
+
+  std::span<const std::byte> remaining(data);
+  for (const std::uint16_t id : {std::uint16_t{1}, std::uint16_t{2}}) {
+    const auto consumed = session.feed(remaining);
+    EXPECT_EQ(consumed, second.size());
+    remaining = remaining.subspan(consumed);
+
+    auto frame = session.next();
+    ASSERT_TRUE(frame.has_value());
+    ASSERT_TRUE(frame->has_value());
+    EXPECT_EQ(frame->value().base.id, id);
+  }
+  EXPECT_TRUE(remaining.empty());
+}
+
+TEST(TestProtocolSession, testPrepareCommit) {
+  const auto data = encodeTime(4, {.sec = 9, .usec = 10});  // NOLINT
+
+  std::vector<std::byte> storage(128);  // NOLINT
+  brilliant::snapcast::ProtocolSession session(storage);
+
+  auto region = session.prepare();
+  ASSERT_EQ(region.size(), brilliant::snapcast::HEADER_SIZE);
+  std::memcpy(region.data(), data.data(), region.size());
+  session.commit(region.size());
+  EXPECT_EQ(session.state(), brilliant::snapcast::ProtocolSession::State::BODY);
+
+  region = session.prepare();
+  ASSERT_EQ(region.size(), sizeof(brilliant::snapcast::Time));
+  std::memcpy(region.data(), data.data() + brilliant::snapcast::HEADER_SIZE,
+              region.size());
+  session.commit(region.size());
+  EXPECT_EQ(session.state(),
+            brilliant::snapcast::ProtocolSession::State::FRAME);
+  EXPECT_TRUE(session.prepare().empty());
+
+  auto frame = session.next();
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_TRUE(frame->has_value());
+  EXPECT_EQ(std::get<brilliant::snapcast::Time>(frame->value().message).sec,
+            9);
+}
+
+TEST(TestProtocolSession, testInsufficientStorage) {
+  std::vector<std::byte> storage(brilliant::snapcast::HEADER_SIZE - 1);
+  {
+    brilliant::snapcast::ProtocolSession session(storage);
+    EXPECT_TRUE(session.prepare().empty());
+    auto frame = session.next();
+    EXPECT_FALSE(frame.has_value());
+    EXPECT_EQ(frame.error().value(), boost::system::errc::no_buffer_space);
+  }
+
+  // an oversized message is reported and skipped, the following message is
+  // decoded
+  std::vector<std::byte> payload(64);  // NOLINT
+  std::vector<std::byte> data(brilliant::snapcast::HEADER_SIZE + 4 +
+                              payload.size());
+  brilliant::snapcast::Message message =
+      brilliant::snapcast::ClientInfo{std::string_view(
+          reinterpret_cast<const char*>(payload.data()),  // NOLINT
+          payload.size())};
+  ASSERT_TRUE(brilliant::snapcast::ProtocolSession::encode(0, message, {},
+                                                          std::span(data)));
+  const auto time = encodeTime(5, {});  // NOLINT
+  data.insert(data.end(), time.begin(), time.end());
+
+  storage.resize(brilliant::snapcast::HEADER_SIZE + 2);
+  brilliant::snapcast::ProtocolSession session(storage);
+  EXPECT_EQ(session.feed(data), data.size());
+
+  auto frame = session.next();
+  EXPECT_FALSE(frame.has_value());
+  EXPECT_EQ(frame.error().value(), boost::system::errc::no_buffer_space);
+
+  frame = session.next();
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_TRUE(frame->has_value());
+  EXPECT_EQ(frame->value().base.id, 5);
+
+  // every oversized message fed before next() is reported
+  std::vector<std::byte> twice(
+      data.begin(), data.end() - static_cast<std::ptrdiff_t>(time.size()));
+  twice.insert(twice.end(), data.begin(), data.end());
+  EXPECT_EQ(session.feed(twice), twice.size());
+  for (int i = 0; i < 2; ++i) {
+    frame = session.next();
+    EXPECT_FALSE(frame.has_value());
+  }
+  frame = session.next();
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_TRUE(frame->has_value());
+  EXPECT_EQ(frame->value().base.id, 5);
+}
+
+TEST(TestProtocolSession, testRejectsMalformedFrames) {
+  using brilliant::snapcast::MessageType;
+  const std::vector<std::vector<std::byte>> malformed{
+      // a type no message has
+      encodeRaw(MessageType::BASE, {}),
+      encodeRaw(static_cast<MessageType>(99), {0, 0, 0, 0}),  // NOLINT
+      // shorter than the fixed fields
+      encodeRaw(MessageType::TIME, {1, 0, 0, 0}),
+      encodeRaw(MessageType::WIRE_CHUNK, {0, 0, 0, 0, 0, 0, 0, 0}),
+      encodeRaw(MessageType::HELLO, {0, 0}),
+      // sizes past the end of the body
+      encodeRaw(MessageType::HELLO, {3, 0, 0, 0, '{', '}'}),
+      encodeRaw(MessageType::WIRE_CHUNK,
+                {0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 1}),
+      encodeRaw(MessageType::CODEC_HEADER,
+                {0xFF, 0xFF, 0xFF, 0x7F, 0, 0, 0, 0}),  // NOLINT
+      encodeRaw(MessageType::CODEC_HEADER,
+                {1, 0, 0, 0, 'p', 1, 0, 0, 0}),
+      encodeRaw(MessageType::ERROR,
+                {0, 0, 0, 0, 9, 0, 0, 0, 0, 0, 0, 0}),  // NOLINT
+      encodeRaw(MessageType::ERROR,
+                {0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0}),
+  };
+
+  std::vector<std::byte> storage(128);  // NOLINT
+  brilliant::snapcast::ProtocolSession session(storage);
+  for (const auto& data : malformed) {
+    EXPECT_EQ(session.feed(data), data.size());
+    auto frame = session.next();
+    ASSERT_FALSE(frame.has_value());
+    EXPECT_EQ(frame.error(), boost::system::errc::bad_message);
+  }
+
+  // the frame after a malformed one is decoded
+  const auto data = encodeTime(9, {.sec = 1, .usec = 2});  // NOLINT
+  EXPECT_EQ(session.feed(data), data.size());
+  auto frame = session.next();
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_TRUE(frame->has_value());
+  EXPECT_EQ(frame->value().base.id, 9);
+
+  // sizes which exactly fill the body are accepted
+  const auto exact = encodeRaw(MessageType::CODEC_HEADER,
+                               {1, 0, 0, 0, 'p', 1, 0, 0, 0, 7});  // NOLINT
+  EXPECT_EQ(session.feed(exact), exact.size());
+  frame = session.next();
+  ASSERT_TRUE(frame.has_value());
+  ASSERT_TRUE(frame->has_value());
+  const auto& header =
+      std::get<brilliant::snapcast::CodecHeader>(frame->value().message);
+  EXPECT_EQ(std::string_view(header.codec, header.codecSize), "p");
+  EXPECT_EQ(header.size, 1);
+}
@@ -0,0 +1,586 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "BrilliantSnapcast/ReconnectSupervisor.hpp"
+#include "BrilliantSnapcast/SnapServerSession.hpp"
+#include "FakeUtilProvider.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+  using Protocol = boost::asio::local::stream_protocol;
+  using Socket = Protocol::socket;
+
+  class PcmDecoder : public brilliant::snapcast::Decoder {
+  public:
+    [[nodiscard]] auto format() const
+        -> brilliant::snapcast::AudioFormat override {
+      return {48000, 16, 2};  // NOLINT
+    }
+
+    auto decode(std::span<const std::byte> payload,
+                std::pmr::vector<std::byte>& out)
+        -> boost::system::error_code override {
+      out.insert(out.end(), payload.begin(), payload.end());
+      return {};
+    }
+  };
+
+  class Factory : public brilliant::snapcast::DecoderFactory {
+  public:
+    auto create(const brilliant::snapcast::CodecHeader&,
+                std::pmr::memory_resource* mr)
+        -> std::expected<brilliant::snapcast::Decoder*,
+                         boost::system::error_code> override {
+      return std::pmr::polymorphic_allocator<>(mr).new_object<PcmDecoder>();
+    }
+  };
+
+  // reports a MAC address only for a connected socket
+  struct SocketUtilProvider : FakeUtilProvider {
+    auto getMacAddress(int sock, std::pmr::memory_resource* mr)
+        -> std::pmr::string override {
+      return {sock >= 0 ? "aa:bb:cc:dd:ee:ff" : "00:00:00:00:00:00", mr};
+    }
+  };
+}  // namespace
+
+struct TestReconnectSupervisor : testing::Test {
+  TestReconnectSupervisor()
+      : path(testing::TempDir() + "TestReconnectSupervisor.sock"),
+        clockPath(testing::TempDir() + "TestReconnectSupervisor.clock"),
+        tcpClient(Socket(context), mr),
+        decoder(factory, output, 1024, mr),  // NOLINT
+        supervisor(tcpClient, decoder, chunks, options()) {
+    std::remove(path.c_str());
+    std::remove(clockPath.c_str());
+    supervisor.cacheHello(utilProvider, serializer);
+  }
+
+  auto options() -> brilliant::snapcast::ReconnectOptions {
+    brilliant::snapcast::ReconnectOptions result;
+    result.initialBackoff = 5ms;
+    result.maxBackoff = 20ms;
+    result.clockStatePath = clockPath.c_str();
+    return result;
+  }
+
+  // saves a clock state for the server, whose clock is the local clock
+  void saveClockState(std::int64_t offset) {
+    brilliant::snapcast::ClockSync sync;
+    const auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < 8; ++i) {  // NOLINT
+      sync.update(offset, now);
+    }
+    ASSERT_FALSE(brilliant::snapcast::ClockSync::save(
+        clockPath.c_str(),
+        sync.state(brilliant::snapcast::ClockSync::serverId(
+            Protocol::endpoint(path)))));
+  }
+
+  // serves one connection: checks the Hello, optionally answers the Time
+  // message, sends the settings, a codec header and a chunk and waits until
+  // the chunk is queued
+  auto serve(Protocol::acceptor& acceptor, bool replyTime, bool settings,
+             std::size_t queued) -> boost::asio::awaitable<void> {
+    brilliant::snapcast::TcpClient<Socket> peer(
+        co_await acceptor.async_accept(boost::asio::use_awaitable), mr);
+    brilliant::snapcast::SnapServerSession<Socket> session(peer);
+    std::vector<std::byte> buffer(1024);  // NOLINT
+
+    auto hello = co_await session.read(std::span(buffer));
+    EXPECT_TRUE(hello);
+    if (!hello) {
+      co_return;
+    }
+    const auto& [helloBase, helloMessage] = *hello;
+    const auto* json = std::get_if<brilliant::snapcast::Hello>(&helloMessage);
+    EXPECT_NE(json, nullptr);
+    if (json) {
+      helloJson.assign(json->payload, json->size);
+      EXPECT_THAT(helloJson, testing::HasSubstr("\"OS\":\"Ubuntu\""));
+    }
+
+    auto time = co_await session.read(std::span(buffer));
+    EXPECT_TRUE(time);
+    if (!time) {
+      co_return;
+    }
+    if (replyTime) {
+      co_await session.replyTime(std::get<0>(*time), std::span(buffer));
+    }
+    if (settings) {
+      co_await session.send(
+          0,
+          brilliant::snapcast::ServerSettings(
+              R"({"bufferMs":1000,"latency":10,"muted":false,"volume":100})"),
+          std::span(buffer));
+    }
+    std::string_view codec("pcm");
+    co_await session.send(
+        0, brilliant::snapcast::CodecHeader(codec, std::span(codecPayload)),
+        std::span(buffer));
+    brilliant::snapcast::WireChunk chunk{std::span(chunkPayload)};
+    chunk.timestamp = brilliant::snapcast::SnapClient<Socket>::currentTime();
+    co_await session.send(0, chunk, std::span(buffer));
+
+    auto exec = co_await boost::asio::this_coro::executor;
+    while (chunks.size() < queued) {
+      co_await boost::asio::post(exec, boost::asio::use_awaitable);
+    }
+  }
+
+  auto drain() -> std::pmr::vector<brilliant::snapcast::StreamChunk> {
+    std::pmr::vector<brilliant::snapcast::StreamChunk> result;
+    while (chunks.size() > 0) {
+      chunks.popBatch(result, chunks.size(), {});
+    }
+    return result;
+  }
+
+  std::pmr::memory_resource* mr = std::pmr::get_default_resource();
+  std::string path;
+  std::string clockPath;
+  std::string helloJson;
+  boost::asio::io_context context;
+  brilliant::snapcast::TcpClient<Socket> tcpClient;
+  Factory factory;
+  brilliant::snapcast::StageQueue<brilliant::snapcast::PcmFrame> output{16,
+                                                                        mr};
+  brilliant::snapcast::StageQueue<brilliant::snapcast::StreamChunk> chunks{
+      16, mr};
+  brilliant::snapcast::StreamDecoder decoder;
+  brilliant::snapcast::ReconnectSupervisor<Socket> supervisor;
+  FakeUtilProvider utilProvider;
+  boost::json::serializer serializer;
+  std::vector<std::byte> codecPayload{std::byte{1}, std::byte{2}};
+  std::vector<std::byte> chunkPayload{std::byte{3}, std::byte{4}};
+};
+
+TEST_F(TestReconnectSupervisor, testQueuesChunkAfterTimeSync) {
+  Protocol::acceptor acceptor(context, Protocol::endpoint(path));
+  std::vector<std::byte> buffer(1024);  // NOLINT
+
+  boost::system::error_code runResult;
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &buffer, &runResult] -> boost::asio::awaitable<void> {
+        runResult = co_await supervisor.run(Protocol::endpoint(path),
+                                            std::span(buffer));
+      },
+      boost::asio::detached);
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &acceptor] -> boost::asio::awaitable<void> {
+        co_await serve(acceptor, true, true, 1);
+        supervisor.stop();
+      },
+      boost::asio::detached);
+  const auto start = std::chrono::steady_clock::now();
+  context.run();
+  EXPECT_EQ(runResult, boost::asio::error::operation_aborted);
+
+  const auto queued = drain();
+  ASSERT_EQ(queued.size(), 1);
+  EXPECT_THAT(std::vector<std::byte>(queued[0].payload.begin(),
+                                     queued[0].payload.end()),
+              testing::ElementsAreArray(chunkPayload));
+  // bufferMs minus latency after the chunk's timestamp
+  EXPECT_GT(queued[0].playout, start + 980ms);
+  EXPECT_LT(queued[0].playout, std::chrono::steady_clock::now() + 1s);
+  EXPECT_TRUE(supervisor.clockOffset());
+
+  brilliant::snapcast::ReconnectSupervisor<Socket>::Snapshot stats;
+  supervisor.snapshot(stats);
+  EXPECT_EQ(stats.connects, 1);
+  EXPECT_EQ(stats.rebuilds, 1);
+  EXPECT_EQ(stats.dropped, 0);
+  EXPECT_EQ(stats.timeToFirstAudio.count, 1);
+  EXPECT_GT(stats.lastTimeToFirstAudio, 0);
+}
+
+TEST_F(TestReconnectSupervisor, testCountsDroppedChunks) {
+  Protocol::acceptor acceptor(context, Protocol::endpoint(path));
+  std::vector<std::byte> buffer(1024);  // NOLINT
+  auto metrics = std::make_unique<brilliant::snapcast::SessionMetrics>();
+  supervisor.setMetrics(metrics.get());
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &buffer] -> boost::asio::awaitable<void> {
+        co_await supervisor.run(Protocol::endpoint(path), std::span(buffer));
+      },
+      boost::asio::detached);
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &acceptor] -> boost::asio::awaitable<void> {
+        // without a Time reply there is no clock offset to schedule by
+        co_await serve(acceptor, false, true, 0);
+        auto exec = co_await boost::asio::this_coro::executor;
+        brilliant::snapcast::ReconnectSupervisor<Socket>::Snapshot stats;
+        do {
+          co_await boost::asio::post(exec, boost::asio::use_awaitable);
+          supervisor.snapshot(stats);
+        } while (stats.dropped == 0);
+        supervisor.stop();
+      },
+      boost::asio::detached);
+  context.run();
+
+  EXPECT_TRUE(drain().empty());
+  auto result =
+      std::make_unique<brilliant::snapcast::SessionMetrics::Snapshot>();
+  metrics->snapshot(*result);
+  EXPECT_EQ(result->droppedChunks, 1);
+  EXPECT_EQ(result->messagesReceived[static_cast<std::size_t>(
+                brilliant::snapcast::MessageType::WIRE_CHUNK)],
+            1);
+}
+
+TEST_F(TestReconnectSupervisor, testDropsChunksWithoutSlab) {
+  // the queued chunk holds the only slab, the next chunk is dropped
+  auto slabOptions = options();
+  slabOptions.slabCount = 1;
+  brilliant::snapcast::ReconnectSupervisor<Socket> slabSupervisor(
+      tcpClient, decoder, chunks, slabOptions);
+  slabSupervisor.cacheHello(utilProvider, serializer);
+  Protocol::acceptor acceptor(context, Protocol::endpoint(path));
+  std::vector<std::byte> buffer(1024);  // NOLINT
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &slabSupervisor, &buffer] -> boost::asio::awaitable<void> {
+        co_await slabSupervisor.run(Protocol::endpoint(path),
+                                    std::span(buffer));
+      },
+      boost::asio::detached);
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &slabSupervisor, &acceptor] -> boost::asio::awaitable<void> {
+        co_await serve(acceptor, true, true, 1);
+        co_await serve(acceptor, true, true, 0);
+        auto exec = co_await boost::asio::this_coro::executor;
+        brilliant::snapcast::ReconnectSupervisor<Socket>::Snapshot stats;
+        do {
+          co_await boost::asio::post(exec, boost::asio::use_awaitable);
+          slabSupervisor.snapshot(stats);
+        } while (stats.dropped == 0);
+        slabSupervisor.stop();
+      },
+      boost::asio::detached);
+  context.run();
+
+  EXPECT_EQ(drain().size(), 1);
+  brilliant::snapcast::ReconnectSupervisor<Socket>::Snapshot stats;
+  slabSupervisor.snapshot(stats);
+  EXPECT_EQ(stats.connects, 2);
+  EXPECT_EQ(stats.dropped, 1);
+  EXPECT_EQ(stats.timeToFirstAudio.count, 1);
+}
+
+TEST_F(TestReconnectSupervisor, testKeepsStateAcrossReconnect) {
+  Protocol::acceptor acceptor(context, Protocol::endpoint(path));
+  std::vector<std::byte> buffer(1024);  // NOLINT
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &buffer] -> boost::asio::awaitable<void> {
+        co_await supervisor.run(Protocol::endpoint(path), std::span(buffer));
+      },
+      boost::asio::detached);
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &acceptor] -> boost::asio::awaitable<void> {
+        co_await serve(acceptor, true, true, 1);
+        // the second server neither answers the Time message nor sends
+        // settings, the chunk is queued with the cached state
+        co_await serve(acceptor, false, false, 2);
+        supervisor.stop();
+      },
+      boost::asio::detached);
+  context.run();
+
+  const auto queued = drain();
+  ASSERT_EQ(queued.size(), 2);
+  // the decoder stream survived the reconnect
+  EXPECT_EQ(queued[0].stream, queued[1].stream);
+
+  brilliant::snapcast::ReconnectSupervisor<Socket>::Snapshot stats;
+  supervisor.snapshot(stats);
+  EXPECT_EQ(stats.connects, 2);
+  EXPECT_EQ(stats.failures, 0);
+  EXPECT_EQ(stats.rebuilds, 1);
+  EXPECT_EQ(stats.dropped, 0);
+  EXPECT_EQ(stats.timeToFirstAudio.count, 2);
+}
+
+TEST_F(TestReconnectSupervisor, testBacksOffWhileServerIsDown) {
+  std::vector<std::byte> buffer(1024);  // NOLINT
+  boost::asio::steady_timer timer(context, 150ms);
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &buffer] -> boost::asio::awaitable<void> {
+        co_await supervisor.run(Protocol::endpoint(path), std::span(buffer));
+      },
+      boost::asio::detached);
+  timer.async_wait([this](auto) { supervisor.stop(); });
+  context.run();
+
+  brilliant::snapcast::ReconnectSupervisor<Socket>::Snapshot stats;
+  supervisor.snapshot(stats);
+  EXPECT_EQ(stats.connects, 0);
+  // waits of 5, 10 and 20 ms, then 20 ms each, instead of a busy loop
+  EXPECT_GE(stats.failures, 4);
+  EXPECT_LE(stats.failures, 10);
+  EXPECT_EQ(stats.timeToFirstAudio.count, 0);
+}
+
+TEST_F(TestReconnectSupervisor, testDropsIdleConnection) {
+  Protocol::acceptor acceptor(context, Protocol::endpoint(path));
+  std::vector<std::byte> buffer(1024);  // NOLINT
+  std::chrono::steady_clock::duration silence{};
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &buffer] -> boost::asio::awaitable<void> {
+        co_await supervisor.run(Protocol::endpoint(path), std::span(buffer));
+      },
+      boost::asio::detached);
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &acceptor, &silence] -> boost::asio::awaitable<void> {
+        brilliant::snapcast::TcpClient<Socket> peer(
+            co_await acceptor.async_accept(boost::asio::use_awaitable), mr);
+        brilliant::snapcast::SnapServerSession<Socket> session(peer);
+        std::vector<std::byte> serverBuffer(1024);  // NOLINT
+        co_await session.read(std::span(serverBuffer));
+        auto time = co_await session.read(std::span(serverBuffer));
+        if (time) {
+          co_await session.replyTime(std::get<0>(*time),
+                                     std::span(serverBuffer));
+        }
+        // a 200 ms buffer, the connection may stay silent for 50 ms
+        co_await session.send(
+            0,
+            brilliant::snapcast::ServerSettings(
+                R"({"bufferMs":200,"latency":0,"muted":false,"volume":100})"),
+            std::span(serverBuffer));
+
+        // stalls: reads the probes without answering until the client
+        // drops the connection
+        const auto start = std::chrono::steady_clock::now();
+        while (co_await session.read(std::span(serverBuffer))) {
+        }
+        silence = std::chrono::steady_clock::now() - start;
+        supervisor.stop();
+      },
+      boost::asio::detached);
+  context.run();
+
+  // probed after 50 ms, dropped 50 ms later, before the buffer runs out
+  EXPECT_GE(silence, 100ms);
+  EXPECT_LT(silence, 200ms);
+
+  brilliant::snapcast::ReconnectSupervisor<Socket>::Snapshot stats;
+  supervisor.snapshot(stats);
+  EXPECT_EQ(stats.idleDrops, 1);
+}
+
+TEST_F(TestReconnectSupervisor, testRestoresClockState) {
+  saveClockState(0);
+  Protocol::acceptor acceptor(context, Protocol::endpoint(path));
+  std::vector<std::byte> buffer(1024);  // NOLINT
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &buffer] -> boost::asio::awaitable<void> {
+        co_await supervisor.run(Protocol::endpoint(path), std::span(buffer));
+      },
+      boost::asio::detached);
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &acceptor] -> boost::asio::awaitable<void> {
+        // without a Time reply the chunk is queued with the restored offset
+        co_await serve(acceptor, false, true, 1);
+        supervisor.stop();
+      },
+      boost::asio::detached);
+  context.run();
+
+  EXPECT_EQ(drain().size(), 1);
+  EXPECT_EQ(supervisor.clockOffset(), 0us);
+  EXPECT_TRUE(supervisor.clockSync().validating());
+
+  brilliant::snapcast::ReconnectSupervisor<Socket>::Snapshot stats;
+  supervisor.snapshot(stats);
+  EXPECT_EQ(stats.clockRestores, 1);
+  EXPECT_EQ(stats.clockRejects, 0);
+  EXPECT_EQ(stats.dropped, 0);
+}
+
+TEST_F(TestReconnectSupervisor, testDiscardsContradictedClockState) {
+  // the server restarted since the state was saved
+  saveClockState(std::chrono::microseconds(1h).count());
+  Protocol::acceptor acceptor(context, Protocol::endpoint(path));
+  std::vector<std::byte> buffer(1024);  // NOLINT
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &buffer] -> boost::asio::awaitable<void> {
+        co_await supervisor.run(Protocol::endpoint(path), std::span(buffer));
+      },
+      boost::asio::detached);
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &acceptor] -> boost::asio::awaitable<void> {
+        co_await serve(acceptor, true, true, 1);
+        supervisor.stop();
+      },
+      boost::asio::detached);
+  context.run();
+
+  // the chunk is scheduled with the offset of the reply
+  const auto queued = drain();
+  ASSERT_EQ(queued.size(), 1);
+  EXPECT_LT(queued[0].playout, std::chrono::steady_clock::now() + 1s);
+  EXPECT_EQ(supervisor.clockSync().confidence(), 1);
+
+  brilliant::snapcast::ReconnectSupervisor<Socket>::Snapshot stats;
+  supervisor.snapshot(stats);
+  EXPECT_EQ(stats.clockRestores, 1);
+  EXPECT_EQ(stats.clockRejects, 1);
+}
+
+TEST_F(TestReconnectSupervisor, testKeysClockStateOnHost) {
+  // the state of a host survives the host moving to another address
+  const auto host = brilliant::snapcast::ClockSync::serverId("snapserver",
+                                                             1704);  // NOLINT
+  brilliant::snapcast::ClockSync sync;
+  const auto now = std::chrono::steady_clock::now();
+  for (int i = 0; i < 8; ++i) {  // NOLINT
+    sync.update(0, now);
+  }
+  ASSERT_FALSE(brilliant::snapcast::ClockSync::save(clockPath.c_str(),
+                                                    sync.state(host)));
+  auto hostOptions = options();
+  hostOptions.clockServer = host;
+  brilliant::snapcast::ReconnectSupervisor<Socket> hostSupervisor(
+      tcpClient, decoder, chunks, hostOptions);
+  hostSupervisor.cacheHello(utilProvider, serializer);
+  Protocol::acceptor acceptor(context, Protocol::endpoint(path));
+  std::vector<std::byte> buffer(1024);  // NOLINT
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &hostSupervisor, &buffer] -> boost::asio::awaitable<void> {
+        co_await hostSupervisor.run(Protocol::endpoint(path),
+                                    std::span(buffer));
+      },
+      boost::asio::detached);
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &hostSupervisor, &acceptor] -> boost::asio::awaitable<void> {
+        co_await serve(acceptor, false, true, 1);
+        hostSupervisor.stop();
+      },
+      boost::asio::detached);
+  context.run();
+
+  EXPECT_EQ(drain().size(), 1);
+  brilliant::snapcast::ReconnectSupervisor<Socket>::Snapshot stats;
+  hostSupervisor.snapshot(stats);
+  EXPECT_EQ(stats.clockRestores, 1);
+}
+
+TEST_F(TestReconnectSupervisor, testCountsFailedClockSaves) {
+  const std::string missing = testing::TempDir() + "missing/state";
+  auto failingOptions = options();
+  failingOptions.clockStatePath = missing.c_str();
+  failingOptions.clockSync.minConfidence = 1;
+  brilliant::snapcast::ReconnectSupervisor<Socket> failingSupervisor(
+      tcpClient, decoder, chunks, failingOptions);
+  failingSupervisor.cacheHello(utilProvider, serializer);
+  Protocol::acceptor acceptor(context, Protocol::endpoint(path));
+  std::vector<std::byte> buffer(1024);  // NOLINT
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &failingSupervisor, &buffer] -> boost::asio::awaitable<void> {
+        co_await failingSupervisor.run(Protocol::endpoint(path),
+                                       std::span(buffer));
+      },
+      boost::asio::detached);
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &failingSupervisor, &acceptor] -> boost::asio::awaitable<void> {
+        co_await serve(acceptor, true, true, 1);
+        failingSupervisor.stop();
+      },
+      boost::asio::detached);
+  context.run();
+  // queued chunks hold slabs of the local supervisor
+  drain();
+
+  // the first Time reply is saved at once and again when the session ends
+  brilliant::snapcast::ReconnectSupervisor<Socket>::Snapshot stats;
+  failingSupervisor.snapshot(stats);
+  EXPECT_GE(stats.clockSaveFailures, 1);
+}
+
+TEST_F(TestReconnectSupervisor, testBuildsHelloOnConnection) {
+  // cached before connecting, the Hello is built again on the connection
+  SocketUtilProvider socketProvider;
+  brilliant::snapcast::ReconnectSupervisor<Socket> socketSupervisor(
+      tcpClient, decoder, chunks, options());
+  socketSupervisor.cacheHello(socketProvider, serializer);
+  Protocol::acceptor acceptor(context, Protocol::endpoint(path));
+  std::vector<std::byte> buffer(1024);  // NOLINT
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &socketSupervisor, &buffer] -> boost::asio::awaitable<void> {
+        co_await socketSupervisor.run(Protocol::endpoint(path),
+                                      std::span(buffer));
+      },
+      boost::asio::detached);
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &socketSupervisor, &acceptor] -> boost::asio::awaitable<void> {
+        co_await serve(acceptor, true, true, 1);
+        socketSupervisor.stop();
+      },
+      boost::asio::detached);
+  context.run();
+  // queued chunks hold slabs of the local supervisor
+  drain();
+
+  EXPECT_THAT(helloJson, testing::HasSubstr("\"MAC\":\"aa:bb:cc:dd:ee:ff\""));
+}
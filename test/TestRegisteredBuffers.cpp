@@ -0,0 +1,82 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+
+#include "BrilliantSnapcast/ProtocolSession.hpp"
+#include "BrilliantSnapcast/RegisteredBuffers.hpp"
+#include "BrilliantSnapcast/SnapClient.hpp"
+
+// Uses real loopback sockets so the configured backend (epoll or io_uring) is
+// exercised
+struct TestRegisteredBuffers : testing::Test {
+  TestRegisteredBuffers()
+      : testing::Test(),
+        acceptor(context, {boost::asio::ip::address_v4::loopback(), 0}),
+        storage(bufferCount * bufferSize),
+        buffers(context, std::span(storage), bufferCount, mr),
+        tcpClient(boost::asio::ip::tcp::socket(context), mr),
+        snapClient(tcpClient),
+        peer(context) {}
+
+  static constexpr std::size_t bufferCount = 4;
+  static constexpr std::size_t bufferSize = 128;
+
+  std::pmr::memory_resource* mr = std::pmr::get_default_resource();
+  boost::asio::io_context context;
+  boost::asio::ip::tcp::acceptor acceptor;
+  std::vector<std::byte> storage;
+  brilliant::snapcast::RegisteredBuffers buffers;
+  brilliant::snapcast::TcpClient<boost::asio::ip::tcp::socket> tcpClient;
+  brilliant::snapcast::SnapClient<boost::asio::ip::tcp::socket> snapClient;
+  boost::asio::ip::tcp::socket peer;
+};
+
+TEST_F(TestRegisteredBuffers, testBuffers) {
+  ASSERT_EQ(buffers.size(), bufferCount);
+  for (std::size_t i = 0; i < bufferCount; ++i) {
+    EXPECT_EQ(buffers[i].data(), buffers.span(i).data());
+    EXPECT_EQ(buffers[i].size(), bufferSize);
+    EXPECT_EQ(buffers.span(i).data(), storage.data() + (i * bufferSize));
+  }
+}
+
+TEST_F(TestRegisteredBuffers, testRead) {
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this] -> boost::asio::awaitable<void> {
+        const auto endpoint = acceptor.local_endpoint();
+        auto ec = co_await tcpClient.connect(
+            endpoint.address().to_string(), endpoint.port());
+        EXPECT_FALSE(ec);
+        peer = co_await acceptor.async_accept(boost::asio::use_awaitable);
+
+        std::vector<std::byte> data(brilliant::snapcast::HEADER_SIZE +
+                                    sizeof(brilliant::snapcast::Time));
+        brilliant::snapcast::Message message = brilliant::snapcast::Time{};
+        std::ignore = brilliant::snapcast::ProtocolSession::encode(
+            2, message, {.sec = 3, .usec = 4}, std::span(data));
+        co_await boost::asio::async_write(peer, boost::asio::buffer(data),
+                                          boost::asio::use_awaitable);
+
+        auto result = co_await snapClient.read(buffers[1]);
+        EXPECT_TRUE(result.has_value());
+        if (!result) {
+          co_return;
+        }
+        auto [base, msg] = result.value();
+        EXPECT_EQ(base.type, brilliant::snapcast::MessageType::TIME);
+        EXPECT_EQ(base.id, 2);
+        const auto time = std::get<brilliant::snapcast::Time>(msg);
+        EXPECT_EQ(time.sec, 3);
+        EXPECT_EQ(time.usec, 4);
+
+        // the frame was read into the registered buffer's storage
+        brilliant::snapcast::Time stored{};
+        brilliant::snapcast::read(buffers.span(1), stored);
+        EXPECT_EQ(stored.sec, 3);
+      },
+      boost::asio::detached);
+  context.run();
+}
@@ -0,0 +1,543 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <array>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <optional>
+#include <vector>
+
+#include "BrilliantSnapcast/Resolver.hpp"
+#include "BrilliantSnapcast/TcpClient.hpp"
+#include "CountingResource.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+  using udp = boost::asio::ip::udp;
+  using tcp = boost::asio::ip::tcp;
+
+  // builds the answer to a query, echoing the question
+  auto answer(std::span<const std::byte> query, std::uint16_t rcode,
+              const std::vector<boost::asio::ip::address>& addresses,
+              std::span<std::byte> out) -> std::size_t {
+    std::size_t offset = 12;  // NOLINT header size
+    brilliant::snapcast::detail::skipName(query, offset);
+    const auto type = brilliant::snapcast::detail::loadBig16(
+        query.data() + offset);  // NOLINT
+    offset += 4;
+    std::ranges::copy(query.first(offset), out.begin());
+
+    std::size_t size = offset;
+    std::uint16_t count = 0;
+    const auto put16 = [&out, &size](std::uint16_t value) {
+      brilliant::snapcast::detail::storeBig16(out.data() + size,
+                                              value);  // NOLINT
+      size += 2;
+    };
+    for (const auto& address : addresses) {
+      const auto v6 = address.is_v6();
+      if (type != static_cast<std::uint16_t>(
+                      v6 ? brilliant::snapcast::DnsType::AAAA
+                         : brilliant::snapcast::DnsType::A)) {
+        continue;
+      }
+      ++count;
+      put16(0xC00C);  // NOLINT pointer to the question's name
+      put16(type);
+      put16(1);  // class IN
+      put16(0);  // ttl
+      put16(60);  // NOLINT
+      if (v6) {
+        const auto bytes = address.to_v6().to_bytes();
+        put16(static_cast<std::uint16_t>(bytes.size()));
+        for (auto b : bytes) {
+          out[size++] = static_cast<std::byte>(b);
+        }
+      } else {
+        const auto bytes = address.to_v4().to_bytes();
+        put16(static_cast<std::uint16_t>(bytes.size()));
+        for (auto b : bytes) {
+          out[size++] = static_cast<std::byte>(b);
+        }
+      }
+    }
+    brilliant::snapcast::detail::storeBig16(
+        out.data() + 2, static_cast<std::uint16_t>(0x8180 | rcode));  // NOLINT
+    brilliant::snapcast::detail::storeBig16(out.data() + 6, count);  // NOLINT
+    return size;
+  }
+
+  // a DNS server on the loopback interface answering every query with the
+  // same addresses, or not at all if silent
+  struct StubDns {
+    explicit StubDns(boost::asio::io_context& context)
+        : socket(context, udp::endpoint(
+                              boost::asio::ip::address_v4::loopback(), 0)) {}
+
+    auto serve() -> boost::asio::awaitable<void> {
+      std::array<std::byte, brilliant::snapcast::DNS_UDP_SIZE> query{};
+      std::array<std::byte, brilliant::snapcast::DNS_UDP_SIZE> response{};
+      udp::endpoint sender;
+      while (true) {
+        auto [ec, size] = co_await socket.async_receive_from(
+            boost::asio::buffer(query), sender,
+            boost::asio::as_tuple(boost::asio::use_awaitable));
+        if (ec) {
+          co_return;
+        }
+        ++queries;
+        ports.push_back(sender.port());
+        std::size_t offset = 12;  // NOLINT header size
+        brilliant::snapcast::detail::skipName(std::span(query).first(size),
+                                              offset);
+        if (silent ||
+            (ignored && brilliant::snapcast::detail::loadBig16(
+                            query.data() + offset) ==  // NOLINT
+                            static_cast<std::uint16_t>(*ignored))) {
+          continue;
+        }
+        const auto n =
+            answer(std::span(query).first(size), rcode, addresses, response);
+        if (truncated) {
+          response[2] |= std::byte{0x02};  // TC
+        }
+        if (foreign) {
+          response[13] ^= std::byte{0x20};  // NOLINT the question's name
+        }
+        co_await socket.async_send_to(
+            boost::asio::buffer(response.data(), n), sender,
+            boost::asio::as_tuple(boost::asio::use_awaitable));
+      }
+    }
+
+    udp::socket socket;
+    std::vector<boost::asio::ip::address> addresses;
+    std::uint16_t rcode{};
+    bool silent{};
+    // queries of this type are not answered
+    std::optional<brilliant::snapcast::DnsType> ignored;
+    // sets the truncation flag
+    bool truncated{};
+    // answers a different question
+    bool foreign{};
+    int queries{};
+    std::vector<boost::asio::ip::port_type> ports;
+  };
+}  // namespace
+
+struct TestResolver : testing::Test {
+  auto configFor(std::initializer_list<StubDns*> servers)
+      -> brilliant::snapcast::ResolverConfig {
+    brilliant::snapcast::ResolverConfig config(&mr);
+    for (auto* server : servers) {
+      config.nameservers.push_back(server->socket.local_endpoint());
+    }
+    config.timeout = 100ms;
+    config.attempts = 1;
+    return config;
+  }
+
+  // resolves a name and stops the stub servers
+  auto resolve(brilliant::snapcast::Resolver& resolver, std::string_view host,
+               std::initializer_list<StubDns*> servers)
+      -> std::expected<brilliant::snapcast::Resolver::endpoints_type,
+                       boost::system::error_code> {
+    std::optional<std::expected<brilliant::snapcast::Resolver::endpoints_type,
+                                boost::system::error_code>>
+        result;
+    for (auto* server : servers) {
+      boost::asio::co_spawn(context, server->serve(), boost::asio::detached);
+    }
+    boost::asio::co_spawn(
+        context,
+        // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+        [&] -> boost::asio::awaitable<void> {
+          result.emplace(co_await resolver.resolve(host, PORT));
+          for (auto* server : servers) {
+            server->socket.close();
+          }
+        },
+        boost::asio::detached);
+    context.run();
+    context.restart();
+    return std::move(*result);
+  }
+
+  static constexpr boost::asio::ip::port_type PORT = 1704;
+
+  CountingResource mr;
+  boost::asio::io_context context;
+};
+
+TEST_F(TestResolver, testEncodeQuery) {
+  std::array<std::byte, brilliant::snapcast::DNS_UDP_SIZE> buffer{};
+  auto size = brilliant::snapcast::encodeDnsQuery(
+      0x1234, "snap.local.", brilliant::snapcast::DnsType::AAAA,  // NOLINT
+      buffer);
+  ASSERT_TRUE(size);
+  const std::array<std::uint8_t, 28> expected{
+      0x12, 0x34, 0x01, 0x00, 0, 1, 0, 0,   0,   0,   0, 0, 4,  's',
+      'n',  'a',  'p',  5,    'l', 'o', 'c', 'a', 'l', 0, 0, 28, 0,   1};
+  ASSERT_EQ(*size, expected.size());
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(std::to_integer<std::uint8_t>(buffer.at(i)), expected.at(i))
+        << i;
+  }
+
+  EXPECT_EQ(brilliant::snapcast::encodeDnsQuery(
+                1, "a..b", brilliant::snapcast::DnsType::A, buffer)
+                .error(),
+            boost::asio::error::invalid_argument);
+  EXPECT_EQ(brilliant::snapcast::encodeDnsQuery(
+                1, "snap.local", brilliant::snapcast::DnsType::A,
+                std::span(buffer).first(20))  // NOLINT
+                .error(),
+            boost::system::errc::no_buffer_space);
+}
+
+TEST_F(TestResolver, testDecodeResponse) {
+  std::array<std::byte, brilliant::snapcast::DNS_UDP_SIZE> query{};
+  std::array<std::byte, brilliant::snapcast::DNS_UDP_SIZE> response{};
+  const auto querySize = *brilliant::snapcast::encodeDnsQuery(
+      7, "snap.local", brilliant::snapcast::DnsType::A, query);  // NOLINT
+  const auto address = boost::asio::ip::make_address("192.168.1.10");
+  const auto size = answer(std::span(query).first(querySize), 0,
+                           {address, address}, response);
+
+  std::pmr::vector<boost::asio::ip::address> out(&mr);
+  EXPECT_EQ(brilliant::snapcast::dnsMessageId(std::span(response)), 7);
+  EXPECT_FALSE(brilliant::snapcast::decodeDnsResponse(
+      std::span(response).first(size), out));
+  EXPECT_THAT(out, testing::ElementsAre(address, address));
+
+  // the second record is cut off
+  out.clear();
+  EXPECT_FALSE(brilliant::snapcast::decodeDnsResponse(
+      std::span(response).first(size - 1), out));
+  EXPECT_THAT(out, testing::ElementsAre(address));
+
+  // the question is cut off
+  EXPECT_EQ(brilliant::snapcast::decodeDnsResponse(
+                std::span(response).first(14), out),  // NOLINT
+            boost::system::errc::illegal_byte_sequence);
+
+  // a query is no response
+  EXPECT_EQ(brilliant::snapcast::decodeDnsResponse(
+                std::span(query).first(querySize), out),
+            boost::system::errc::illegal_byte_sequence);
+
+  answer(std::span(query).first(querySize), 3, {}, response);
+  EXPECT_EQ(brilliant::snapcast::decodeDnsResponse(
+                std::span(response).first(querySize), out),
+            boost::asio::error::host_not_found);
+
+  // a truncated answer needs TCP, another server is asked instead
+  answer(std::span(query).first(querySize), 0, {address}, response);
+  response[2] |= std::byte{0x02};
+  EXPECT_EQ(brilliant::snapcast::decodeDnsResponse(std::span(response), out),
+            boost::asio::error::host_not_found_try_again);
+}
+
+TEST_F(TestResolver, testMatchesAnswerToQuery) {
+  std::array<std::byte, brilliant::snapcast::DNS_UDP_SIZE> query{};
+  std::array<std::byte, brilliant::snapcast::DNS_UDP_SIZE> response{};
+  const auto querySize = *brilliant::snapcast::encodeDnsQuery(
+      7, "snap.local", brilliant::snapcast::DnsType::A, query);  // NOLINT
+  const auto sent = std::span(query).first(querySize);
+  const auto size = answer(sent, 0, {}, response);
+  EXPECT_TRUE(brilliant::snapcast::dnsAnswers(
+      std::span(response).first(size), sent));
+
+  // another id
+  response[1] ^= std::byte{1};
+  EXPECT_FALSE(brilliant::snapcast::dnsAnswers(
+      std::span(response).first(size), sent));
+  response[1] ^= std::byte{1};
+
+  // another name or type
+  response[13] ^= std::byte{0x20};  // NOLINT
+  EXPECT_FALSE(brilliant::snapcast::dnsAnswers(
+      std::span(response).first(size), sent));
+  response[13] ^= std::byte{0x20};  // NOLINT
+  response[querySize - 3] = std::byte{28};  // NOLINT AAAA
+  EXPECT_FALSE(brilliant::snapcast::dnsAnswers(
+      std::span(response).first(size), sent));
+}
+
+TEST_F(TestResolver, testParseConfig) {
+  brilliant::snapcast::ResolverConfig config(&mr);
+  config.parseResolvConf(
+      "# generated\n"
+      "search lan\n"
+      "nameserver 192.168.1.1\n"
+      "nameserver\tfd00::1 ; router\n"
+      "nameserver not-an-address\n"
+      "nameserver 9.9.9.9\n"
+      "nameserver 1.1.1.1\n"
+      "options ndots:2 timeout:1 attempts:9\n");
+  EXPECT_THAT(config.nameservers,
+              testing::ElementsAre(
+                  udp::endpoint(boost::asio::ip::make_address("192.168.1.1"),
+                                53),  // NOLINT
+                  udp::endpoint(boost::asio::ip::make_address("fd00::1"),
+                                53),  // NOLINT
+                  udp::endpoint(boost::asio::ip::make_address("9.9.9.9"),
+                                53)));  // NOLINT
+  EXPECT_EQ(config.timeout, 1s);
+  EXPECT_EQ(config.attempts, 5);
+
+  std::pmr::vector<boost::asio::ip::address> out(&mr);
+  brilliant::snapcast::findHosts(
+      "127.0.0.1 localhost\n"
+      "# 10.0.0.1 snapserver\n"
+      "10.0.0.2\tmusic SnapServer.lan snapserver\n"
+      "fd00::2 snapserver # ipv6\n",
+      "snapserver", out);
+  EXPECT_THAT(out, testing::ElementsAre(
+                       boost::asio::ip::make_address("10.0.0.2"),
+                       boost::asio::ip::make_address("fd00::2")));
+
+  // a missing resolv.conf queries a local server
+  const auto loaded = brilliant::snapcast::ResolverConfig::load(
+      &mr, "/nonexistent/resolv.conf", "/nonexistent/hosts");
+  EXPECT_THAT(loaded.nameservers,
+              testing::ElementsAre(udp::endpoint(
+                  boost::asio::ip::address_v4::loopback(), 53)));  // NOLINT
+  EXPECT_TRUE(loaded.hosts.empty());
+}
+
+TEST_F(TestResolver, testResolvesLiteralsAndHosts) {
+  auto config = configFor({});
+  config.hosts = "10.0.0.2 snapserver\nfd00::2 snapserver\n10.0.0.3 snapserver";
+  brilliant::snapcast::Resolver resolver(context.get_executor(),
+                                         std::move(config), &mr);
+
+  auto literal = resolve(resolver, "::1", {});
+  ASSERT_TRUE(literal);
+  EXPECT_THAT(*literal,
+              testing::ElementsAre(tcp::endpoint(
+                  boost::asio::ip::address_v6::loopback(), PORT)));
+
+  // alternating families, starting with IPv6
+  auto hosts = resolve(resolver, "snapserver", {});
+  ASSERT_TRUE(hosts);
+  EXPECT_THAT(
+      *hosts,
+      testing::ElementsAre(
+          tcp::endpoint(boost::asio::ip::make_address("fd00::2"), PORT),
+          tcp::endpoint(boost::asio::ip::make_address("10.0.0.2"), PORT),
+          tcp::endpoint(boost::asio::ip::make_address("10.0.0.3"), PORT)));
+
+  // no server to ask
+  EXPECT_EQ(resolve(resolver, "other", {}).error(),
+            boost::asio::error::host_not_found);
+}
+
+TEST_F(TestResolver, testQueriesServer) {
+  {
+    StubDns server(context);
+    server.addresses = {boost::asio::ip::make_address("192.168.1.10"),
+                        boost::asio::ip::make_address("fd00::10"),
+                        boost::asio::ip::make_address("192.168.1.11")};
+    brilliant::snapcast::Resolver resolver(context.get_executor(),
+                                           configFor({&server}), &mr);
+
+    auto result = resolve(resolver, "snapserver.lan", {&server});
+    ASSERT_TRUE(result) << result.error().message();
+    EXPECT_EQ(server.queries, 2);
+    EXPECT_THAT(
+        *result,
+        testing::ElementsAre(
+            tcp::endpoint(boost::asio::ip::make_address("fd00::10"), PORT),
+            tcp::endpoint(boost::asio::ip::make_address("192.168.1.10"), PORT),
+            tcp::endpoint(boost::asio::ip::make_address("192.168.1.11"),
+                          PORT)));
+    EXPECT_GT(mr.allocations, 0);
+  }
+  // frames, handlers and results all came from the resource
+  EXPECT_EQ(mr.outstanding, 0);
+}
+
+TEST_F(TestResolver, testSkipsSilentServer) {
+  StubDns silent(context);
+  silent.silent = true;
+  StubDns server(context);
+  server.addresses = {boost::asio::ip::make_address("192.168.1.10")};
+  brilliant::snapcast::Resolver resolver(context.get_executor(),
+                                         configFor({&silent, &server}), &mr);
+
+  const auto start = std::chrono::steady_clock::now();
+  auto result = resolve(resolver, "snapserver.lan", {&silent, &server});
+  ASSERT_TRUE(result) << result.error().message();
+  EXPECT_GE(std::chrono::steady_clock::now() - start, 100ms);
+  EXPECT_THAT(*result, testing::ElementsAre(tcp::endpoint(
+                           boost::asio::ip::make_address("192.168.1.10"),
+                           PORT)));
+}
+
+TEST_F(TestResolver, testKeepsPartialAnswer) {
+  // the AAAA query times out, the A answer is used without asking the next
+  // server and without duplicates
+  StubDns partial(context);
+  partial.ignored = brilliant::snapcast::DnsType::AAAA;
+  partial.addresses = {boost::asio::ip::make_address("192.168.1.10")};
+  StubDns server(context);
+  server.addresses = partial.addresses;
+  brilliant::snapcast::Resolver resolver(context.get_executor(),
+                                         configFor({&partial, &server}), &mr);
+
+  auto result = resolve(resolver, "snapserver.lan", {&partial, &server});
+  ASSERT_TRUE(result) << result.error().message();
+  EXPECT_EQ(partial.queries, 2);
+  EXPECT_EQ(server.queries, 0);
+  EXPECT_THAT(*result, testing::ElementsAre(tcp::endpoint(
+                           boost::asio::ip::make_address("192.168.1.10"),
+                           PORT)));
+}
+
+TEST_F(TestResolver, testReportsErrors) {
+  StubDns server(context);
+  brilliant::snapcast::Resolver resolver(context.get_executor(),
+                                         configFor({&server}), &mr);
+
+  EXPECT_EQ(resolve(resolver, "snapserver.lan", {&server}).error(),
+            boost::asio::error::no_data);
+
+  StubDns missing(context);
+  missing.rcode = 3;
+  brilliant::snapcast::Resolver nxdomain(context.get_executor(),
+                                         configFor({&missing}), &mr);
+  EXPECT_EQ(resolve(nxdomain, "snapserver.lan", {&missing}).error(),
+            boost::asio::error::host_not_found);
+
+  StubDns silent(context);
+  silent.silent = true;
+  brilliant::snapcast::Resolver timeout(context.get_executor(),
+                                        configFor({&silent}), &mr);
+  EXPECT_EQ(resolve(timeout, "snapserver.lan", {&silent}).error(),
+            boost::asio::error::timed_out);
+}
+
+TEST_F(TestResolver, testRejectsForeignAnswers) {
+  // answers to another question are dropped until the timeout
+  StubDns foreign(context);
+  foreign.foreign = true;
+  foreign.addresses = {boost::asio::ip::make_address("10.6.6.6")};
+  brilliant::snapcast::Resolver spoofed(context.get_executor(),
+                                        configFor({&foreign}), &mr);
+  EXPECT_EQ(resolve(spoofed, "snapserver.lan", {&foreign}).error(),
+            boost::asio::error::timed_out);
+
+  // a truncated answer moves on to the next server
+  StubDns truncated(context);
+  truncated.truncated = true;
+  StubDns server(context);
+  server.addresses = {boost::asio::ip::make_address("192.168.1.10")};
+  brilliant::snapcast::Resolver resolver(
+      context.get_executor(), configFor({&truncated, &server}), &mr);
+  auto result = resolve(resolver, "snapserver.lan", {&truncated, &server});
+  ASSERT_TRUE(result) << result.error().message();
+  EXPECT_GE(truncated.queries, 1);
+  EXPECT_THAT(*result, testing::ElementsAre(tcp::endpoint(
+                           boost::asio::ip::make_address("192.168.1.10"),
+                           PORT)));
+
+  // every resolve asks from a new source port
+  StubDns again(context);
+  again.addresses = server.addresses;
+  brilliant::snapcast::Resolver twice(context.get_executor(),
+                                      configFor({&again}), &mr);
+  const auto endpoint = again.socket.local_endpoint();
+  ASSERT_TRUE(resolve(twice, "snapserver.lan", {&again}));
+  again.socket = udp::socket(context, endpoint);
+  ASSERT_TRUE(resolve(twice, "snapserver.lan", {&again}));
+  ASSERT_EQ(again.ports.size(), 4);
+  EXPECT_EQ(again.ports[0], again.ports[1]);
+  EXPECT_NE(again.ports[0], again.ports[2]);
+}
+
+struct TestHappyEyeballs : testing::Test {
+  using Socket = tcp::socket;
+
+  // connects to endpoints and accepts on the good acceptor
+  auto connect(brilliant::snapcast::TcpClient<Socket>& tcpClient,
+               std::span<const tcp::endpoint> endpoints,
+               std::chrono::steady_clock::duration attemptDelay)
+      -> boost::system::error_code {
+    boost::system::error_code result;
+    boost::asio::co_spawn(
+        context,
+        // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+        [&] -> boost::asio::awaitable<void> {
+          result = co_await tcpClient.connect(endpoints, attemptDelay);
+          if (!result) {
+            accepted.emplace(co_await good.async_accept(
+                boost::asio::use_awaitable));
+          }
+        },
+        boost::asio::detached);
+    context.run();
+    context.restart();
+    return result;
+  }
+
+  // an endpoint refusing connections
+  auto refused() -> tcp::endpoint {
+    tcp::acceptor closed(context, {boost::asio::ip::address_v4::loopback(), 0});
+    return closed.local_endpoint();
+  }
+
+  CountingResource mr;
+  boost::asio::io_context context;
+  tcp::acceptor good{context, {boost::asio::ip::address_v4::loopback(), 0}};
+  std::optional<Socket> accepted;
+};
+
+TEST_F(TestHappyEyeballs, testFailureStartsNextAttempt) {
+  brilliant::snapcast::TcpClient<Socket> tcpClient(Socket(context), &mr);
+  const std::array endpoints{refused(), good.local_endpoint()};
+
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(connect(tcpClient, endpoints, 10s));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+  EXPECT_TRUE(tcpClient.isConnected());
+  EXPECT_TRUE(accepted);
+
+  brilliant::snapcast::TcpClient<Socket> failing(Socket(context), &mr);
+  const std::array bad{refused(), refused()};
+  EXPECT_EQ(connect(failing, bad, 10s), boost::asio::error::connection_refused);
+  EXPECT_FALSE(failing.isConnected());
+  EXPECT_EQ(connect(failing, {}, 10s), boost::asio::error::host_not_found);
+}
+
+TEST_F(TestHappyEyeballs, testStalledAttemptIsRaced) {
+  // a full backlog drops the SYN of further connections
+  tcp::acceptor stalled(context);
+  stalled.open(tcp::v4());
+  stalled.bind({boost::asio::ip::address_v4::loopback(), 0});
+  stalled.listen(0);
+  Socket filler(context);
+  filler.connect(stalled.local_endpoint());
+
+  {
+    brilliant::snapcast::TcpClient<Socket> tcpClient(Socket(context), &mr);
+    tcpClient.setTuning(brilliant::snapcast::SocketTuning::interactive());
+    const std::array endpoints{stalled.local_endpoint(),
+                               good.local_endpoint()};
+
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(connect(tcpClient, endpoints, 50ms));
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_GE(elapsed, 50ms);
+    EXPECT_LT(elapsed, 1s);
+    EXPECT_TRUE(accepted);
+
+    // the winner is tuned like a single connect
+    tcp::no_delay noDelay;
+    EXPECT_FALSE(tcpClient.getOption(noDelay));
+    EXPECT_TRUE(noDelay.value());
+  }
+  // the stalled attempt was closed and its handler released
+  EXPECT_EQ(mr.outstanding, 0);
+}
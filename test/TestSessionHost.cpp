@@ -0,0 +1,116 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <future>
+#include <latch>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "BrilliantSnapcast/SessionHost.hpp"
+
+TEST(TestSessionHost, testPlacement) {
+  brilliant::snapcast::SessionHost host(3, std::pmr::new_delete_resource(),
+                                        std::pmr::get_default_resource());
+  ASSERT_EQ(host.size(), 3);
+
+  // sessions are not run until the host is started so every placement sees the
+  // previous ones
+  constexpr std::size_t sessionCount = 9;
+  for (std::size_t i = 0; i < sessionCount; ++i) {
+    host.spawn(
+        [](brilliant::snapcast::SessionHost::Shard&)
+            -> boost::asio::awaitable<void> { co_return; },
+        boost::asio::detached);
+  }
+
+  for (std::size_t i = 0; i < host.size(); ++i) {
+    EXPECT_EQ(host[i].sessions(), sessionCount / host.size());
+  }
+}
+
+TEST(TestSessionHost, testSessionsRunOnHomeShard) {
+  brilliant::snapcast::SessionHost host(2, std::pmr::new_delete_resource(),
+                                        std::pmr::get_default_resource());
+  host.start();
+
+  constexpr std::ptrdiff_t sessionCount = 16;
+  std::latch done(sessionCount);
+  std::atomic<std::size_t> onHomeShard{};
+
+  for (std::ptrdiff_t i = 0; i < sessionCount; ++i) {
+    host.spawn(
+        // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+        [&onHomeShard](brilliant::snapcast::SessionHost::Shard& shard)
+            -> boost::asio::awaitable<void> {
+          // allocations from the shard resource happen on the shard thread
+          std::pmr::vector<int> data(32, shard.resource());  // NOLINT
+          auto exec = co_await boost::asio::this_coro::executor;
+          co_await boost::asio::post(exec, boost::asio::use_awaitable);
+          if (shard.runningInThisThread()) {
+            onHomeShard.fetch_add(1, std::memory_order_relaxed);
+          }
+        },
+        [&done](const std::exception_ptr&) { done.count_down(); });
+  }
+
+  done.wait();
+  EXPECT_EQ(onHomeShard.load(), sessionCount);
+  host.stop();
+
+  for (std::size_t i = 0; i < host.size(); ++i) {
+    EXPECT_EQ(host[i].sessions(), 0);
+  }
+}
+
+TEST(TestSessionHost, testAbandonsSessions) {
+  brilliant::snapcast::SessionHost host(0, std::pmr::new_delete_resource(),
+                                        std::pmr::get_default_resource());
+  ASSERT_EQ(host.size(), 1);
+  host.start();
+  host.stop();
+
+  // the io_context destroys the handler, which frees into the shard's
+  // resource, before the resource is destroyed
+  auto& shard = host[0];
+  boost::asio::post(shard.getExecutor(),
+                    [state = std::pmr::vector<int>(64, shard.resource())] {});
+}
+
+TEST(TestSessionHost, testRestartsAfterStop) {
+  brilliant::snapcast::SessionHost host(1, std::pmr::new_delete_resource(),
+                                        std::pmr::get_default_resource());
+  host.start();
+  host.stop();
+  host.start();
+
+  std::atomic<int> cpu{-1};
+  auto done = host.spawn(
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [&cpu](brilliant::snapcast::SessionHost::Shard&)
+          -> boost::asio::awaitable<void> {
+#if defined(__linux__)
+        cpu = sched_getcpu();
+#endif
+        co_return;
+      },
+      boost::asio::use_future);
+  ASSERT_EQ(done.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+  host.stop();
+
+  // the thread is pinned to its core unless the cpuset excludes the core
+  const auto pinned = host[0].pinError();
+#if defined(__linux__)
+  if (pinned) {
+    EXPECT_EQ(pinned, boost::system::errc::invalid_argument);
+  } else {
+    EXPECT_EQ(cpu.load(), static_cast<int>(host[0].core()));
+  }
+#else
+  EXPECT_EQ(pinned, boost::system::errc::operation_not_supported);
+#endif
+}
@@ -0,0 +1,227 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "BrilliantSnapcast/ProtocolSession.hpp"
+#include "BrilliantSnapcast/SessionMetrics.hpp"
+#include "BrilliantSnapcast/SnapClient.hpp"
+#include "FakeSocket.hpp"
+
+using Histogram = brilliant::snapcast::Histogram;
+
+TEST(TestHistogram, testBuckets) {
+  for (std::uint64_t value = 0; value < 4096; ++value) {
+    const auto index = Histogram::bucket(value);
+    EXPECT_LE(value, Histogram::upperBound(index));
+    if (index > 0) {
+      EXPECT_GT(value, Histogram::upperBound(index - 1));
+    }
+  }
+  EXPECT_EQ(Histogram::bucket(Histogram::MAX_VALUE), Histogram::BUCKETS - 1);
+  EXPECT_EQ(Histogram::bucket(~std::uint64_t{}), Histogram::BUCKETS - 1);
+}
+
+TEST(TestHistogram, testPercentile) {
+  auto histogram = std::make_unique<Histogram>();
+  for (std::uint64_t value = 1; value <= 1000; ++value) {
+    histogram->record(value);
+  }
+  auto snapshot = std::make_unique<Histogram::Snapshot>();
+  histogram->snapshot(*snapshot);
+
+  EXPECT_EQ(snapshot->count, 1000);
+  EXPECT_EQ(snapshot->max, 1000);
+  EXPECT_DOUBLE_EQ(snapshot->mean(), 500.5);
+  // bucket bounds are within 12.5% of the value
+  EXPECT_NEAR(static_cast<double>(snapshot->percentile(0.5)), 500, 63);
+  EXPECT_NEAR(static_cast<double>(snapshot->percentile(0.99)), 990, 124);
+  EXPECT_EQ(snapshot->percentile(1.0), 1000);
+}
+
+TEST(TestHistogram, testConcurrentRecord) {
+  auto histogram = std::make_unique<Histogram>();
+  constexpr std::uint64_t perThread = 10000;
+  {
+    std::vector<std::jthread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&histogram] {
+        for (std::uint64_t value = 0; value < perThread; ++value) {
+          histogram->record(value);
+        }
+      });
+    }
+  }
+  auto snapshot = std::make_unique<Histogram::Snapshot>();
+  histogram->snapshot(*snapshot);
+  EXPECT_EQ(snapshot->count, 4 * perThread);
+  EXPECT_EQ(snapshot->max, perThread - 1);
+}
+
+struct TestSessionMetrics : testing::Test {
+  TestSessionMetrics()
+      : tcpClient(
+            FakeSocket<boost::asio::ip::tcp>{context.get_executor(), &state},
+            std::pmr::get_default_resource()),
+        snapClient(tcpClient) {
+    snapClient.setMetrics(metrics.get());
+  }
+
+  void snapshot() { metrics->snapshot(*result); }
+
+  static constexpr auto index(brilliant::snapcast::MessageType type) {
+    return static_cast<std::size_t>(type);
+  }
+
+  boost::asio::io_context context;
+  SocketState state;
+  brilliant::snapcast::TcpClient<FakeSocket<boost::asio::ip::tcp>> tcpClient;
+  brilliant::snapcast::SnapClient<FakeSocket<boost::asio::ip::tcp>>
+      snapClient;
+  std::unique_ptr<brilliant::snapcast::SessionMetrics> metrics =
+      std::make_unique<brilliant::snapcast::SessionMetrics>();
+  std::unique_ptr<brilliant::snapcast::SessionMetrics::Snapshot> result =
+      std::make_unique<brilliant::snapcast::SessionMetrics::Snapshot>();
+};
+
+TEST_F(TestSessionMetrics, testSendAndReadTime) {
+  // server to client latency 3ms, client to server latency 5ms
+  state.inData.resize(brilliant::snapcast::HEADER_SIZE +
+                      sizeof(brilliant::snapcast::Time));
+  brilliant::snapcast::Message reply = brilliant::snapcast::Time{};
+  const auto now = brilliant::snapcast::SnapClient<
+      FakeSocket<boost::asio::ip::tcp>>::currentTime();
+  const auto sentUsec = brilliant::snapcast::toSignedMicroseconds(now) - 3000;
+  std::ignore = brilliant::snapcast::ProtocolSession::encode(
+      1, reply,
+      {.sec = static_cast<std::uint32_t>(sentUsec / 1'000'000),
+       .usec = static_cast<std::uint32_t>(sentUsec % 1'000'000)},
+      std::span(state.inData));
+  // encode() stamps Time messages with the sent time, replace it with the
+  // latency the server measured
+  const brilliant::snapcast::Time c2s{.sec = 0, .usec = 5000};
+  std::memcpy(state.inData.data() + brilliant::snapcast::HEADER_SIZE, &c2s,
+              sizeof(c2s));
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this] -> boost::asio::awaitable<void> {
+        std::vector<std::byte> buffer(64);
+        auto sent = co_await snapClient.send(0, brilliant::snapcast::Time{},
+                                             std::span(buffer));
+        EXPECT_TRUE(sent.has_value());
+        auto read = co_await snapClient.read(std::span(buffer));
+        EXPECT_TRUE(read.has_value());
+      },
+      boost::asio::detached);
+  context.run();
+  snapshot();
+
+  const auto time = index(brilliant::snapcast::MessageType::TIME);
+  const auto frameSize =
+      brilliant::snapcast::HEADER_SIZE + sizeof(brilliant::snapcast::Time);
+  EXPECT_EQ(result->messagesSent[time], 1);
+  EXPECT_EQ(result->bytesSent[time], frameSize);
+  EXPECT_EQ(result->messagesReceived[time], 1);
+  EXPECT_EQ(result->bytesReceived[time], frameSize);
+  EXPECT_EQ(result->roundTrip.count, 1);
+  // the time between encoding the reply and reading it adds to the server
+  // to client latency, up to 2 ms keep the offset positive
+  constexpr double SLACK = 2000;
+  EXPECT_GT(result->roundTrip.mean(), 8000 - 100);  // NOLINT
+  EXPECT_LT(result->roundTrip.mean(), 8000 + SLACK);  // NOLINT
+  EXPECT_EQ(result->clockOffsetPositive.count, 1);
+  EXPECT_EQ(result->clockOffsetNegative.count, 0);
+  EXPECT_LT(static_cast<double>(result->clockOffsetSum), 1000 + 100);
+  EXPECT_GT(static_cast<double>(result->clockOffsetSum),
+            1000 - (SLACK / 2));  // NOLINT
+  EXPECT_EQ(result->readToDispatch.count, 1);
+}
+
+TEST_F(TestSessionMetrics, testKeepsClockOffsetSign) {
+  // server to client latency 10ms, client to server latency 2ms
+  brilliant::snapcast::Base base{};
+  base.sent = {.sec = 1, .usec = 0};
+  base.received = {.sec = 1, .usec = 10000};  // NOLINT
+  const brilliant::snapcast::Time c2s{.sec = 0, .usec = 2000};
+  metrics->timeReply(base, c2s);
+  snapshot();
+
+  EXPECT_EQ(result->clockOffsetPositive.count, 0);
+  EXPECT_EQ(result->clockOffsetNegative.count, 1);
+  EXPECT_NEAR(static_cast<double>(result->clockOffsetNegative.mean()), 4000,
+              500);
+  EXPECT_EQ(result->clockOffsetSum, -4000);
+}
+
+TEST_F(TestSessionMetrics, testNegativeLatency) {
+  // the server clock is 1.5 s behind: the client to server latency it
+  // measured is -1.5 s + 2 ms, encoded as sec -2 and usec 502000
+  brilliant::snapcast::Base base{};
+  base.sent = {.sec = 10, .usec = 0};  // NOLINT
+  base.received = {.sec = 10, .usec = 2000};  // NOLINT
+  const brilliant::snapcast::Time c2s{
+      .sec = static_cast<std::uint32_t>(-2), .usec = 502000};  // NOLINT
+  EXPECT_EQ(brilliant::snapcast::toSignedMicroseconds(c2s), -1498000);
+  EXPECT_EQ(brilliant::snapcast::clockOffset(base, c2s), -750000);
+
+  // a usec outside [0, 1e6) is normalized
+  const brilliant::snapcast::Time unnormalized{
+      .sec = 0, .usec = static_cast<std::uint32_t>(-1000)};  // NOLINT
+  EXPECT_EQ(brilliant::snapcast::toSignedMicroseconds(unnormalized), -1000);
+
+  // converted back with usec in [0, 1e6)
+  const auto normalized = brilliant::snapcast::fromSignedMicroseconds(-1000);
+  EXPECT_EQ(normalized.sec, static_cast<std::uint32_t>(-1));
+  EXPECT_EQ(normalized.usec, 999000);  // NOLINT
+  const auto roundTrip = brilliant::snapcast::fromSignedMicroseconds(
+      brilliant::snapcast::toSignedMicroseconds(c2s));
+  EXPECT_EQ(roundTrip.sec, c2s.sec);
+  EXPECT_EQ(roundTrip.usec, c2s.usec);
+
+  metrics->timeReply(base, c2s);
+  snapshot();
+  EXPECT_EQ(result->clockOffsetPositive.count, 0);
+  EXPECT_EQ(result->clockOffsetNegative.count, 1);
+  EXPECT_EQ(result->clockOffsetSum, -750000);
+}
+
+TEST_F(TestSessionMetrics, testErrors) {
+  state.inData.resize(brilliant::snapcast::HEADER_SIZE + 1234);
+  brilliant::snapcast::Base base{};
+  base.type = brilliant::snapcast::MessageType::ERROR;
+  base.size = 1234;  // NOLINT
+  brilliant::snapcast::write(std::span(state.inData), base);
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this] -> boost::asio::awaitable<void> {
+        std::vector<std::byte> buffer(64);
+        auto read = co_await snapClient.read(std::span(buffer));
+        EXPECT_FALSE(read.has_value());
+
+        state.ec = boost::asio::error::connection_reset;
+        read = co_await snapClient.read(std::span(buffer));
+        EXPECT_FALSE(read.has_value());
+        auto sent = co_await snapClient.send(0, brilliant::snapcast::Time{},
+                                             std::span(buffer));
+        EXPECT_FALSE(sent.has_value());
+      },
+      boost::asio::detached);
+  context.run();
+  metrics->lateChunk();
+  metrics->droppedChunk();
+  snapshot();
+
+  EXPECT_EQ(result->bufferSpaceErrors, 1);
+  EXPECT_EQ(result->readErrors, 1);
+  EXPECT_EQ(result->writeErrors, 1);
+  EXPECT_EQ(result->lateChunks, 1);
+  EXPECT_EQ(result->droppedChunks, 1);
+}
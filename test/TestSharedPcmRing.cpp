@@ -0,0 +1,149 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "BrilliantSnapcast/Pipeline.hpp"
+#include "BrilliantSnapcast/SharedPcmRing.hpp"
+
+using namespace std::chrono_literals;
+
+struct TestSharedPcmRing : testing::Test {
+  TestSharedPcmRing()
+      : producer(*brilliant::snapcast::SharedPcmRing::create(4, 64)),
+        consumer(*brilliant::snapcast::SharedPcmRing::open(
+            ::dup(producer.fd()))) {}
+
+  static auto bytes(int value) -> std::vector<std::byte> {
+    std::vector<std::byte> data(sizeof(value));
+    std::memcpy(data.data(), &value, sizeof(value));
+    return data;
+  }
+
+  static auto value(std::span<const std::byte> data) -> int {
+    int v{};
+    std::memcpy(&v, data.data(), sizeof(v));
+    return v;
+  }
+
+  // the consumer maps the memfd a second time, like the player process
+  brilliant::snapcast::SharedPcmRing producer;
+  brilliant::snapcast::SharedPcmRing consumer;
+};
+
+TEST_F(TestSharedPcmRing, testPublishAcrossMappings) {
+  EXPECT_EQ(consumer.slotCount(), 4);
+  EXPECT_EQ(consumer.slotSize(), 64);
+  EXPECT_FALSE(consumer.peek());
+
+  const auto playout = std::chrono::steady_clock::now() + 5ms;
+  auto storage = producer.tryAcquire();
+  ASSERT_EQ(storage.size(), 64);
+  std::memset(storage.data(), 7, 16);
+  producer.commit(16, playout);
+  EXPECT_EQ(consumer.size(), 1);
+
+  const auto frame = consumer.peek();
+  ASSERT_TRUE(frame);
+  EXPECT_EQ(frame->playout, playout);
+  ASSERT_EQ(frame->samples.size(), 16);
+  EXPECT_EQ(frame->samples[15], std::byte{7});
+  consumer.release();
+  EXPECT_EQ(producer.size(), 0);
+  EXPECT_FALSE(consumer.peek());
+}
+
+TEST_F(TestSharedPcmRing, testFullRing) {
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(producer.tryPublish(bytes(i), {}));
+  }
+  EXPECT_FALSE(producer.tryPublish(bytes(4), {}));
+  EXPECT_TRUE(producer.tryAcquire().empty());
+  EXPECT_EQ(producer.stalls(), 2);
+  EXPECT_FALSE(producer.waitForSpace(1ms));
+
+  consumer.release();
+  EXPECT_TRUE(producer.waitForSpace(1ms));
+  EXPECT_TRUE(producer.tryPublish(bytes(4), {}));
+  for (int i = 1; i <= 4; ++i) {
+    ASSERT_TRUE(consumer.waitForFrame(1ms));
+    EXPECT_EQ(value(consumer.peek()->samples), i);
+    consumer.release();
+  }
+  EXPECT_FALSE(consumer.waitForFrame(1ms));
+}
+
+TEST_F(TestSharedPcmRing, testWaitForFrameUntilStop) {
+  std::stop_source stop;
+  std::jthread publisher([this] {
+    std::this_thread::sleep_for(10ms);
+    producer.tryPublish(bytes(1), {});
+  });
+  EXPECT_TRUE(consumer.waitForFrame(stop.get_token()));
+  consumer.release();
+
+  // a stop request ends the wait although nothing was published
+  std::jthread stopper([&stop] {
+    std::this_thread::sleep_for(10ms);
+    stop.request_stop();
+  });
+  EXPECT_FALSE(consumer.waitForFrame(stop.get_token()));
+}
+
+TEST_F(TestSharedPcmRing, testOpenRejectsInvalidMapping) {
+  const int fd = ::memfd_create("TestSharedPcmRing", MFD_CLOEXEC);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(::ftruncate(fd, 4096), 0);
+  const auto ring = brilliant::snapcast::SharedPcmRing::open(fd);
+  ASSERT_FALSE(ring);
+  EXPECT_EQ(ring.error(), boost::system::errc::illegal_byte_sequence);
+
+  EXPECT_FALSE(brilliant::snapcast::SharedPcmRing::open(-1));
+}
+
+TEST_F(TestSharedPcmRing, testOutputStage) {
+  constexpr int count = 100;
+  std::vector<int> played;
+  std::atomic<std::size_t> consumed{};
+  std::jthread player([this, &played, &consumed](std::stop_token stop) {
+    brilliant::snapcast::consumePcm(
+        consumer,
+        [&played, &consumed](const brilliant::snapcast::PcmSlot& slot) {
+          played.push_back(value(slot.samples));
+          consumed.fetch_add(1, std::memory_order_release);
+        },
+        stop);
+  });
+
+  auto* mr = std::pmr::get_default_resource();
+  brilliant::snapcast::StageQueue<brilliant::snapcast::PcmFrame> queue(8, mr);
+  brilliant::snapcast::PipelineStage output(
+      queue, brilliant::snapcast::SharedPcmOutput(producer), {}, mr);
+  output.start();
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; ++i) {
+    auto data = bytes(i);
+    queue.push({start + (i * 10us), {data.begin(), data.end(), mr}}, {});
+  }
+  // a frame taken from the queue is in neither the queue nor the ring
+  // until the stage publishes it, so wait for the player
+  for (int i = 0; i < 5000 && consumed.load(std::memory_order_acquire) < count;
+       ++i) {
+    std::this_thread::sleep_for(1ms);
+  }
+  output.stop();
+  player.request_stop();
+  player.join();
+
+  ASSERT_EQ(played.size(), count);
+  for (int i = 0; i < count; ++i) {
+    EXPECT_EQ(played[static_cast<std::size_t>(i)], i);
+  }
+}
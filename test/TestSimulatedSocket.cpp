@@ -0,0 +1,233 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <tuple>
+#include <vector>
+
+#include "BrilliantSnapcast/ProtocolSession.hpp"
+#include "BrilliantSnapcast/SimulatedSocket.hpp"
+#include "BrilliantSnapcast/SnapClient.hpp"
+#include "BrilliantSnapcast/VirtualClock.hpp"
+
+using namespace std::chrono_literals;
+
+struct TestSimulatedSocket : testing::Test {
+  using Socket = brilliant::snapcast::SimulatedSocket<>;
+
+  auto connect(const brilliant::snapcast::ImpairmentProfile& profile)
+      -> brilliant::snapcast::SimulatedConnection& {
+    connection.emplace(clock, profile, brilliant::snapcast::ImpairmentProfile{},
+                       std::pmr::get_default_resource());
+    return connection.value();
+  }
+
+  auto executor() -> boost::asio::any_io_executor {
+    return context.get_executor();
+  }
+
+  boost::asio::io_context context;
+  brilliant::snapcast::VirtualClock clock{std::pmr::get_default_resource()};
+  std::optional<brilliant::snapcast::SimulatedConnection> connection;
+};
+
+TEST_F(TestSimulatedSocket, testLatency) {
+  auto& conn = connect({.latency = 50ms});
+  auto server = conn.server(executor());
+  auto client = conn.client(executor());
+
+  const std::vector<std::byte> data(10, std::byte{1});
+  std::vector<std::byte> buffer(data.size());
+  brilliant::snapcast::VirtualClock::time_point completed{};
+  std::size_t received = 0;
+  server.async_write_some(boost::asio::buffer(data), boost::asio::detached);
+  client.async_read_some(
+      boost::asio::buffer(buffer),
+      [&](boost::system::error_code ec, std::size_t n) {
+        EXPECT_FALSE(ec);
+        received = n;
+        completed = clock.now();
+      });
+  clock.run(context);
+
+  EXPECT_EQ(received, data.size());
+  EXPECT_EQ(completed.time_since_epoch(), 50ms);
+  EXPECT_EQ(buffer, data);
+}
+
+TEST_F(TestSimulatedSocket, testBandwidth) {
+  auto& conn = connect({.bandwidth = 1000});
+  auto server = conn.server(executor());
+  auto client = conn.client(executor());
+
+  const std::vector<std::byte> data(100);
+  std::vector<std::byte> buffer(data.size());
+  brilliant::snapcast::VirtualClock::time_point completed{};
+  server.async_write_some(boost::asio::buffer(data), boost::asio::detached);
+  server.async_write_some(boost::asio::buffer(data), boost::asio::detached);
+  boost::asio::async_read(
+      client, boost::asio::buffer(buffer),
+      [&](boost::system::error_code ec, std::size_t) {
+        EXPECT_FALSE(ec);
+        completed = clock.now();
+      });
+  clock.run(context);
+
+  EXPECT_EQ(completed.time_since_epoch(), 100ms);
+  EXPECT_EQ(conn.toClient().pending(), data.size());
+}
+
+TEST_F(TestSimulatedSocket, testShortReads) {
+  auto& conn = connect({.maxReadSize = 4});
+  auto server = conn.server(executor());
+  auto client = conn.client(executor());
+
+  const std::vector<std::byte> data(10);
+  std::vector<std::byte> buffer(data.size());
+  server.async_write_some(boost::asio::buffer(data), boost::asio::detached);
+  boost::asio::async_read(client, boost::asio::buffer(buffer),
+                          [](boost::system::error_code ec, std::size_t n) {
+                            EXPECT_FALSE(ec);
+                            EXPECT_EQ(n, 10);
+                          });
+  clock.run(context);
+
+  EXPECT_EQ(conn.toClient().reads(), 3);
+}
+
+TEST_F(TestSimulatedSocket, testCloseDeliversEof) {
+  auto& conn = connect({.latency = 5ms});
+  auto server = conn.server(executor());
+  auto client = conn.client(executor());
+
+  const std::vector<std::byte> data(4);
+  std::vector<std::byte> buffer(16);
+  boost::system::error_code result;
+  std::size_t received = 0;
+  server.async_write_some(boost::asio::buffer(data), boost::asio::detached);
+  server.close();
+  boost::asio::async_read(client, boost::asio::buffer(buffer),
+                          [&](boost::system::error_code ec, std::size_t n) {
+                            result = ec;
+                            received = n;
+                          });
+  clock.run(context);
+
+  EXPECT_EQ(result, boost::asio::error::eof);
+  EXPECT_EQ(received, data.size());
+}
+
+TEST_F(TestSimulatedSocket, testCloseAbortsScheduledRead) {
+  auto& conn = connect({.latency = 50ms});
+  auto server = conn.server(executor());
+  auto client = conn.client(executor());
+
+  const std::vector<std::byte> data(4);
+  std::vector<std::byte> buffer(data.size());
+  boost::system::error_code result;
+  brilliant::snapcast::VirtualClock::time_point completed{};
+  server.async_write_some(boost::asio::buffer(data), boost::asio::detached);
+  client.async_read_some(boost::asio::buffer(buffer),
+                         [&](boost::system::error_code ec, std::size_t) {
+                           result = ec;
+                           completed = clock.now();
+                         });
+  clock.run(context, brilliant::snapcast::VirtualClock::time_point(10ms));
+
+  // the read waits for the arrival at 50ms, closing does not
+  client.close();
+  clock.run(context);
+
+  EXPECT_EQ(result, boost::asio::error::operation_aborted);
+  EXPECT_EQ(completed.time_since_epoch(), 10ms);
+}
+
+TEST_F(TestSimulatedSocket, testReadTimesOutOnStalledLink) {
+  auto& conn = connect({});
+  auto server = conn.server(executor());
+  brilliant::snapcast::TcpClient<Socket> tcpClient(
+      conn.client(executor()), std::pmr::get_default_resource());
+
+  std::vector<std::byte> buffer(4);
+  boost::system::error_code stalled;
+  boost::system::error_code resumed;
+  std::size_t received = 0;
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [&] -> boost::asio::awaitable<void> {
+        // nothing is sent, the timeout cancels the read
+        std::tie(stalled, std::ignore) =
+            co_await tcpClient.read(std::span(buffer), 20ms);
+
+        // only the read was cancelled, the link still delivers
+        const std::vector<std::byte> data(buffer.size());
+        server.async_write_some(boost::asio::buffer(data),
+                                boost::asio::detached);
+        std::tie(resumed, received) =
+            co_await tcpClient.read(std::span(buffer), 1s);
+      },
+      boost::asio::detached);
+  context.run();
+
+  EXPECT_EQ(stalled, boost::asio::error::timed_out);
+  EXPECT_FALSE(resumed);
+  EXPECT_EQ(received, buffer.size());
+}
+
+TEST_F(TestSimulatedSocket, testSimulatedHour) {
+  auto& conn = connect({.latency = 20ms,
+                        .jitter = 5ms,
+                        .distribution =
+                            brilliant::snapcast::LatencyDistribution::NORMAL,
+                        .shortReadProbability = 0.5,
+                        .stallProbability = 0.01,
+                        .stallDuration = 200ms});
+  brilliant::snapcast::TcpClient<Socket> tcpClient(
+      conn.client(executor()), std::pmr::get_default_resource());
+  brilliant::snapcast::SnapClient<Socket> snapClient(tcpClient);
+  auto server = conn.server(executor());
+
+  constexpr std::uint16_t count = 3600;
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &server] -> boost::asio::awaitable<void> {
+        std::vector<std::byte> data(brilliant::snapcast::HEADER_SIZE +
+                                    sizeof(brilliant::snapcast::Time));
+        for (std::uint16_t i = 0; i < count; ++i) {
+          brilliant::snapcast::Message message = brilliant::snapcast::Time{};
+          std::ignore = brilliant::snapcast::ProtocolSession::encode(
+              i, message, {}, std::span(data));
+          co_await boost::asio::async_write(server, boost::asio::buffer(data),
+                                            boost::asio::use_awaitable);
+          co_await clock.asyncWait(executor(), 1s, boost::asio::use_awaitable);
+        }
+        server.close();
+      },
+      boost::asio::detached);
+
+  std::uint16_t received = 0;
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [&snapClient, &received] -> boost::asio::awaitable<void> {
+        constexpr auto bufSize = 128;
+        std::vector<std::byte> buffer(bufSize);
+        while (true) {
+          auto result = co_await snapClient.read(std::span(buffer));
+          if (!result) {
+            EXPECT_EQ(result.error(), boost::asio::error::eof);
+            co_return;
+          }
+          EXPECT_EQ(std::get<0>(result.value()).id, received);
+          ++received;
+        }
+      },
+      boost::asio::detached);
+  clock.run(context);
+
+  EXPECT_EQ(received, count);
+  EXPECT_GE(clock.now().time_since_epoch(), 1h);
+}
@@ -0,0 +1,78 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "BrilliantSnapcast/SlabPool.hpp"
+#include "CountingResource.hpp"
+
+TEST(TestSlabPool, testHandlesShareSlab) {
+  CountingResource mr;
+  {
+    brilliant::snapcast::SlabPool pool(100, 4, &mr);
+    EXPECT_EQ(mr.allocations, 1);
+    EXPECT_EQ(pool.capacity(), 4);
+    EXPECT_EQ(pool.available(), 4);
+
+    auto slab = pool.acquire();
+    ASSERT_TRUE(slab);
+    EXPECT_EQ(slab->data().size(), 100);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(slab->data().data()) % 64,
+              0);
+    EXPECT_EQ(pool.available(), 3);
+
+    auto copy = *slab;
+    EXPECT_EQ(copy.useCount(), 2);
+    EXPECT_EQ(copy.data().data(), slab->data().data());
+    slab->data()[99] = std::byte{7};
+
+    // the slab stays out of the pool while a copy is alive
+    *slab = {};
+    EXPECT_FALSE(*slab);
+    EXPECT_EQ(pool.available(), 3);
+    EXPECT_EQ(copy.data()[99], std::byte{7});
+    copy = {};
+    EXPECT_EQ(pool.available(), 4);
+  }
+  EXPECT_EQ(mr.outstanding, 0);
+}
+
+TEST(TestSlabPool, testExhausted) {
+  CountingResource mr;
+  brilliant::snapcast::SlabPool pool(32, 2, &mr);
+  auto first = pool.acquire();
+  auto second = pool.acquire();
+  ASSERT_TRUE(first);
+  ASSERT_TRUE(second);
+  EXPECT_NE(first->data().data(), second->data().data());
+
+  const auto third = pool.acquire();
+  ASSERT_FALSE(third);
+  EXPECT_EQ(third.error(), boost::system::errc::no_buffer_space);
+
+  const auto* data = first->data().data();
+  *first = {};
+  auto reused = pool.acquire();
+  ASSERT_TRUE(reused);
+  EXPECT_EQ(reused->data().data(), data);
+  EXPECT_EQ(mr.allocations, 1);
+}
+
+TEST(TestSlabPool, testReleaseOnOtherThreads) {
+  CountingResource mr;
+  brilliant::snapcast::SlabPool pool(64, 8, &mr);
+  constexpr int rounds = 1000;
+  for (int i = 0; i < rounds; ++i) {
+    std::vector<brilliant::snapcast::Slab> batch;
+    while (auto slab = pool.acquire()) {
+      batch.push_back(std::move(*slab));
+    }
+    ASSERT_EQ(batch.size(), 8);
+    // every handle is copied to a consumer thread, the originals are dropped
+    // here while the copies are dropped there
+    std::jthread consumer([copies = batch] mutable { copies.clear(); });
+    batch.clear();
+  }
+  EXPECT_EQ(pool.available(), 8);
+}
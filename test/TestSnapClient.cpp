@@ -2,11 +2,25 @@
 #include <gtest/gtest.h>
 
 #include <boost/asio.hpp>
+#include <chrono>
 
 #include "BrilliantSnapcast/SnapClient.hpp"
 #include "FakeSocket.hpp"
 #include "FakeUtilProvider.hpp"
 
+// a clock which only moves when a test sets it
+struct ManualClock {
+  using duration = std::chrono::microseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<ManualClock, duration>;
+  static constexpr bool is_steady = true;
+
+  static auto now() -> time_point { return current; }
+
+  static inline time_point current{};
+};
+
 struct TestSnapClient : testing::Test {
   TestSnapClient()
       : testing::Test(),
@@ -42,9 +56,9 @@ TEST_F(TestSnapClient, testSendTime) {
         brilliant::snapcast::read(std::span(state.outData), base);
         EXPECT_EQ(base.type, brilliant::snapcast::MessageType::TIME);
 
-        auto msg = brilliant::snapcast::read(
+        auto msg = *brilliant::snapcast::read(
             std::span(state.outData)
-                .subspan(sizeof(brilliant::snapcast::Base), base.size),
+                .subspan(brilliant::snapcast::HEADER_SIZE, base.size),
             base.type);
         std::visit(
             [&sentTime](const auto& m) {
@@ -62,6 +76,35 @@ TEST_F(TestSnapClient, testSendTime) {
   context.run();
 }
 
+TEST_F(TestSnapClient, testSendTimeStaticExtent) {
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this] -> boost::asio::awaitable<void> {
+        std::array<std::byte,
+                   brilliant::snapcast::FRAME_SIZE<brilliant::snapcast::Time>>
+            buffer{};
+        auto result = co_await snapClient.send(0, brilliant::snapcast::Time{},
+                                               std::span(buffer));
+        EXPECT_TRUE(result.has_value());
+        EXPECT_EQ(state.outData.size(), buffer.size());
+
+        brilliant::snapcast::Base base{};
+        brilliant::snapcast::read(std::span(state.outData), base);
+        EXPECT_EQ(base.type, brilliant::snapcast::MessageType::TIME);
+        EXPECT_EQ(base.size, sizeof(brilliant::snapcast::Time));
+
+        brilliant::snapcast::Time time{};
+        brilliant::snapcast::read(
+            std::span(state.outData).subspan(brilliant::snapcast::HEADER_SIZE),
+            time);
+        EXPECT_EQ(time.sec, result->sec);
+        EXPECT_EQ(time.usec, result->usec);
+      },
+      boost::asio::detached);
+  context.run();
+}
+
 TEST_F(TestSnapClient, testSendJsonMessage) {
   boost::asio::co_spawn(
       context,
@@ -77,9 +120,9 @@ TEST_F(TestSnapClient, testSendJsonMessage) {
         brilliant::snapcast::read(std::span(state.outData), base);
         EXPECT_EQ(base.type, brilliant::snapcast::MessageType::HELLO);
 
-        auto msg = brilliant::snapcast::read(
+        auto msg = *brilliant::snapcast::read(
             std::span(state.outData)
-                .subspan(sizeof(brilliant::snapcast::Base), base.size),
+                .subspan(brilliant::snapcast::HEADER_SIZE, base.size),
             base.type);
         std::visit(
             [](const auto& m) {
@@ -117,9 +160,9 @@ TEST_F(TestSnapClient, testSendWireChunk) {
         brilliant::snapcast::read(std::span(state.outData), base);
         EXPECT_EQ(base.type, brilliant::snapcast::MessageType::WIRE_CHUNK);
 
-        auto msg = brilliant::snapcast::read(
+        auto msg = *brilliant::snapcast::read(
             std::span(state.outData)
-                .subspan(sizeof(brilliant::snapcast::Base), base.size),
+                .subspan(brilliant::snapcast::HEADER_SIZE, base.size),
             base.type);
         std::visit(
             [&payload](const auto& m) {
@@ -142,14 +185,14 @@ TEST_F(TestSnapClient, testSendInsufficientBuffer) {
       context,
       // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
       [this] -> boost::asio::awaitable<void> {
-        std::vector<std::byte> buffer(sizeof(brilliant::snapcast::Base) - 1);
+        std::vector<std::byte> buffer(brilliant::snapcast::HEADER_SIZE - 1);
 
         auto result = co_await snapClient.send(0, brilliant::snapcast::Time{},
                                                std::span(buffer));
         EXPECT_FALSE(result.has_value());
         EXPECT_EQ(result.error().value(), boost::system::errc::no_buffer_space);
 
-        buffer.resize(sizeof(brilliant::snapcast::Base) + 2);
+        buffer.resize(brilliant::snapcast::HEADER_SIZE + 2);
         result = co_await snapClient.send(0, brilliant::snapcast::Time{},
                                           std::span(buffer));
         EXPECT_FALSE(result.has_value());
@@ -177,12 +220,12 @@ TEST_F(TestSnapClient, testRead) {
             .size = sizeof(brilliant::snapcast::Time)};
         const brilliant::snapcast::Time time{.sec = 12, .usec = 34};
 
-        state.inData.resize(sizeof(brilliant::snapcast::Base) +
+        state.inData.resize(brilliant::snapcast::HEADER_SIZE +
                             sizeof(brilliant::snapcast::Time));
         brilliant::snapcast::write(std::span(state.inData), base);
         brilliant::snapcast::write(
             std::span(state.inData)
-                .subspan(sizeof(brilliant::snapcast::Base),
+                .subspan(brilliant::snapcast::HEADER_SIZE,
                          sizeof(brilliant::snapcast::Time)),
             time);
 
@@ -203,12 +246,56 @@ TEST_F(TestSnapClient, testRead) {
   context.run();
 }
 
+TEST_F(TestSnapClient, testReadIntoSlab) {
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this] -> boost::asio::awaitable<void> {
+        constexpr auto frameSize =
+            brilliant::snapcast::FRAME_SIZE<brilliant::snapcast::Time>;
+        state.inData.resize(2 * frameSize);
+        for (std::uint32_t i = 0; i < 2; ++i) {
+          // a Time message carries the sent time
+          brilliant::snapcast::Time time{};
+          auto frame = std::span(state.inData).subspan(i * frameSize);
+          brilliant::snapcast::ProtocolSession::encode(
+              0, time, brilliant::snapcast::Time{.sec = i, .usec = 0},
+              frame.first<frameSize>());
+        }
+
+        brilliant::snapcast::SlabPool pool(frameSize, 2, mr);
+        auto first = co_await snapClient.read(pool);
+        auto second = co_await snapClient.read(pool);
+        EXPECT_TRUE(first.has_value());
+        EXPECT_TRUE(second.has_value());
+        if (!first || !second) {
+          co_return;
+        }
+        // the first message is intact after the second read
+        EXPECT_EQ(std::get<brilliant::snapcast::Time>(first->message).sec, 0);
+        EXPECT_EQ(std::get<brilliant::snapcast::Time>(second->message).sec, 1);
+        EXPECT_EQ(pool.available(), 0);
+
+        auto exhausted = co_await snapClient.read(pool);
+        EXPECT_FALSE(exhausted.has_value());
+        EXPECT_EQ(exhausted.error(), boost::system::errc::no_buffer_space);
+
+        auto queued = *first;
+        first = std::unexpected(boost::system::error_code{});
+        EXPECT_EQ(pool.available(), 0);
+        queued.slab = {};
+        EXPECT_EQ(pool.available(), 1);
+      },
+      boost::asio::detached);
+  context.run();
+}
+
 TEST_F(TestSnapClient, testReadInsufficientBuffer) {
   boost::asio::co_spawn(
       context,
       // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
       [this] -> boost::asio::awaitable<void> {
-        std::vector<std::byte> buffer(sizeof(brilliant::snapcast::Base) - 1);
+        std::vector<std::byte> buffer(brilliant::snapcast::HEADER_SIZE - 1);
 
         auto result = co_await snapClient.read(std::span(buffer));
         EXPECT_FALSE(result.has_value());
@@ -222,7 +309,7 @@ TEST_F(TestSnapClient, testReadInsufficientBuffer) {
         // NOLINTEND
         brilliant::snapcast::write(std::span(state.inData), base);
 
-        buffer.resize(sizeof(brilliant::snapcast::Base) + 2);
+        buffer.resize(brilliant::snapcast::HEADER_SIZE + 2);
         result = co_await snapClient.read(std::span(buffer));
         EXPECT_FALSE(result.has_value());
         EXPECT_EQ(result.error().value(), boost::system::errc::no_buffer_space);
@@ -230,3 +317,163 @@ TEST_F(TestSnapClient, testReadInsufficientBuffer) {
       boost::asio::detached);
   context.run();
 }
+
+TEST_F(TestSnapClient, testReadSkipsOversizedMessage) {
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this] -> boost::asio::awaitable<void> {
+        constexpr auto oversized = 35;
+        constexpr auto frameSize =
+            brilliant::snapcast::FRAME_SIZE<brilliant::snapcast::Time>;
+        brilliant::snapcast::Base base{};
+        base.type = brilliant::snapcast::MessageType::SERVER_SETTINGS;
+        base.size = oversized;
+        state.inData.resize(brilliant::snapcast::HEADER_SIZE + oversized +
+                            frameSize);
+        brilliant::snapcast::write(std::span(state.inData), base);
+        brilliant::snapcast::Time time{};
+        brilliant::snapcast::ProtocolSession::encode(
+            7, time, brilliant::snapcast::Time{.sec = 3, .usec = 0},  // NOLINT
+            std::span(state.inData)
+                .subspan<brilliant::snapcast::HEADER_SIZE + oversized,
+                         frameSize>());
+
+        std::vector<std::byte> buffer(frameSize);
+        auto result = co_await snapClient.read(std::span(buffer));
+        EXPECT_FALSE(result.has_value());
+        if (!result) {
+          EXPECT_EQ(result.error(), boost::system::errc::no_buffer_space);
+        }
+
+        // the body was skipped, the next read starts at a header
+        result = co_await snapClient.read(std::span(buffer));
+        EXPECT_TRUE(result.has_value());
+        if (!result) {
+          co_return;
+        }
+        EXPECT_EQ(std::get<0>(*result).id, 7);
+        EXPECT_EQ(std::get<brilliant::snapcast::Time>(std::get<1>(*result)).sec,
+                  3);
+      },
+      boost::asio::detached);
+  context.run();
+}
+
+TEST_F(TestSnapClient, testSlabReadSkipsOversizedMessage) {
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this] -> boost::asio::awaitable<void> {
+        constexpr auto oversized = 35;
+        constexpr auto frameSize =
+            brilliant::snapcast::FRAME_SIZE<brilliant::snapcast::Time>;
+        brilliant::snapcast::Base base{};
+        base.type = brilliant::snapcast::MessageType::SERVER_SETTINGS;
+        base.size = oversized;
+        state.inData.resize(brilliant::snapcast::HEADER_SIZE + oversized +
+                            frameSize);
+        brilliant::snapcast::write(std::span(state.inData), base);
+        brilliant::snapcast::Time time{};
+        brilliant::snapcast::ProtocolSession::encode(
+            7, time, brilliant::snapcast::Time{.sec = 3, .usec = 0},  // NOLINT
+            std::span(state.inData)
+                .subspan<brilliant::snapcast::HEADER_SIZE + oversized,
+                         frameSize>());
+
+        brilliant::snapcast::SlabPool pool(frameSize, 1, mr);
+        auto result = co_await snapClient.read(pool);
+        EXPECT_FALSE(result.has_value());
+        if (!result) {
+          EXPECT_EQ(result.error(), boost::system::errc::no_buffer_space);
+        }
+        EXPECT_EQ(pool.available(), 1);
+
+        // the body was skipped, the next read starts at a header
+        result = co_await snapClient.read(pool);
+        EXPECT_TRUE(result.has_value());
+        if (!result) {
+          co_return;
+        }
+        EXPECT_EQ(result->base.id, 7);
+        EXPECT_EQ(std::get<brilliant::snapcast::Time>(result->message).sec, 3);
+      },
+      boost::asio::detached);
+  context.run();
+}
+
+TEST_F(TestSnapClient, testReadTimesOut) {
+  using Protocol = boost::asio::local::stream_protocol;
+  Protocol::socket peer(context);
+  Protocol::socket socket(context);
+  boost::asio::local::connect_pair(socket, peer);
+  brilliant::snapcast::TcpClient localClient(std::move(socket), mr);
+  brilliant::snapcast::SnapClient localSnapClient(localClient);
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [&localSnapClient, &peer] -> boost::asio::awaitable<void> {
+        // only the header arrives, the timeout covers the whole message
+        std::array<std::byte, brilliant::snapcast::HEADER_SIZE> header{};
+        brilliant::snapcast::Base base{};
+        base.type = brilliant::snapcast::MessageType::SERVER_SETTINGS;
+        base.size = 8;  // NOLINT
+        brilliant::snapcast::write(std::span(header), base);
+        co_await boost::asio::async_write(peer, boost::asio::buffer(header),
+                                          boost::asio::use_awaitable);
+
+        std::vector<std::byte> buffer(64);  // NOLINT
+        const auto start = std::chrono::steady_clock::now();
+        auto result = co_await localSnapClient.read(
+            std::span(buffer), std::chrono::milliseconds(20));  // NOLINT
+        EXPECT_FALSE(result.has_value());
+        if (!result) {
+          EXPECT_EQ(result.error(), boost::asio::error::timed_out);
+        }
+        EXPECT_GE(std::chrono::steady_clock::now() - start,
+                  std::chrono::milliseconds(20));  // NOLINT
+      },
+      boost::asio::detached);
+  context.run();
+}
+
+TEST_F(TestSnapClient, testUsesInjectedClock) {
+  using namespace std::chrono_literals;
+  ManualClock::current = ManualClock::time_point(5s + 7us);
+  brilliant::snapcast::SnapClient<FakeSocket<boost::asio::ip::tcp>,
+                                  ManualClock>
+      manualClient(tcpClient);
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &manualClient] -> boost::asio::awaitable<void> {
+        std::array<std::byte,
+                   brilliant::snapcast::FRAME_SIZE<brilliant::snapcast::Time>>
+            buffer{};
+        auto sent = co_await manualClient.send(0, brilliant::snapcast::Time{},
+                                               std::span(buffer));
+        EXPECT_TRUE(sent.has_value());
+        if (!sent) {
+          co_return;
+        }
+        EXPECT_EQ(sent->sec, 5);
+        EXPECT_EQ(sent->usec, 7);
+
+        // the reply is stamped when it is read
+        ManualClock::current += 2s;
+        state.inData = state.outData;
+        std::vector<std::byte> storage(64);  // NOLINT
+        auto result = co_await manualClient.read(std::span(storage), 1s);
+        EXPECT_TRUE(result.has_value());
+        if (!result) {
+          co_return;
+        }
+        const auto& base = std::get<0>(*result);
+        EXPECT_EQ(base.received.sec, 7);
+        EXPECT_EQ(base.received.usec, 7);
+      },
+      boost::asio::detached);
+  context.run();
+}
@@ -0,0 +1,180 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+
+#include "BrilliantSnapcast/SharedFrame.hpp"
+#include "BrilliantSnapcast/SnapServerSession.hpp"
+#include "FakeSocket.hpp"
+
+using ServerSession =
+    brilliant::snapcast::SnapServerSession<FakeSocket<boost::asio::ip::tcp>,
+                                           2>;
+
+struct TestSnapServerSession : testing::Test {
+  TestSnapServerSession()
+      : testing::Test(),
+        mr(std::pmr::get_default_resource()),
+        tcpClient(
+            FakeSocket<boost::asio::ip::tcp>{context.get_executor(), &state},
+            mr),
+        session(tcpClient) {}
+
+  auto makeChunk(std::uint16_t id) -> brilliant::snapcast::SharedFrame {
+    auto frame = brilliant::snapcast::SharedFrame::make(
+        id, brilliant::snapcast::WireChunk{std::span(payload)}, {}, mr);
+    EXPECT_TRUE(frame.has_value());
+    return frame.value();
+  }
+
+  std::pmr::memory_resource* mr;
+  SocketState state;
+  boost::asio::io_context context;
+  brilliant::snapcast::TcpClient<FakeSocket<boost::asio::ip::tcp>> tcpClient;
+  ServerSession session;
+  // NOLINTNEXTLINE
+  std::vector<std::byte> payload{std::byte{0x01}, std::byte{0x02}};
+};
+
+TEST_F(TestSnapServerSession, testSharedFrame) {
+  auto frame = makeChunk(7);  // NOLINT
+  EXPECT_EQ(frame.useCount(), 1);
+  EXPECT_EQ(frame.bytes().size(), brilliant::snapcast::HEADER_SIZE +
+                                      sizeof(brilliant::snapcast::Time) +
+                                      sizeof(std::uint32_t) + payload.size());
+  {
+    auto copy = frame;
+    EXPECT_EQ(frame.useCount(), 2);
+    EXPECT_EQ(copy.bytes().data(), frame.bytes().data());
+  }
+  EXPECT_EQ(frame.useCount(), 1);
+
+  brilliant::snapcast::Base base{};
+  std::vector<std::byte> bytes(frame.bytes().begin(), frame.bytes().end());
+  brilliant::snapcast::read(std::span(bytes), base);
+  EXPECT_EQ(base.type, brilliant::snapcast::MessageType::WIRE_CHUNK);
+  EXPECT_EQ(base.id, 7);
+}
+
+TEST_F(TestSnapServerSession, testQueueDropsWhenFull) {
+  auto first = makeChunk(1);
+  auto second = makeChunk(2);
+  EXPECT_TRUE(session.enqueue(first));
+  EXPECT_TRUE(session.enqueue(second));
+  EXPECT_FALSE(session.enqueue(makeChunk(3)));
+  EXPECT_EQ(session.dropped(), 1);
+  EXPECT_EQ(session.queued(), 2);
+  EXPECT_EQ(first.useCount(), 2);
+
+  boost::system::error_code runResult;
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &runResult] -> boost::asio::awaitable<void> {
+        runResult = co_await session.run();
+      },
+      boost::asio::detached);
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &first, &second] -> boost::asio::awaitable<void> {
+        auto exec = co_await boost::asio::this_coro::executor;
+        co_await boost::asio::post(exec, boost::asio::use_awaitable);
+
+        // both frames were sent by a single gathered write
+        std::vector<std::byte> expected(first.bytes().begin(),
+                                        first.bytes().end());
+        expected.insert(expected.end(), second.bytes().begin(),
+                        second.bytes().end());
+        EXPECT_EQ(state.outData, expected);
+        EXPECT_EQ(session.queued(), 0);
+        EXPECT_EQ(first.useCount(), 1);
+        session.close();
+      },
+      boost::asio::detached);
+  context.run();
+  EXPECT_EQ(runResult, boost::asio::error::operation_aborted);
+}
+
+TEST_F(TestSnapServerSession, testReplyTime) {
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this] -> boost::asio::awaitable<void> {
+        brilliant::snapcast::Base request{};
+        request.type = brilliant::snapcast::MessageType::TIME;
+        request.id = 9;  // NOLINT
+        request.sent = {.sec = 1, .usec = 900'000};
+        request.received = {.sec = 3, .usec = 100'000};
+
+        constexpr auto bufSize = 64;
+        std::vector<std::byte> buffer(bufSize);
+        auto result = co_await session.replyTime(request, std::span(buffer));
+        EXPECT_TRUE(result.has_value());
+
+        brilliant::snapcast::Base base{};
+        brilliant::snapcast::read(std::span(state.outData), base);
+        EXPECT_EQ(base.type, brilliant::snapcast::MessageType::TIME);
+        EXPECT_EQ(base.refersTo, 9);
+
+        brilliant::snapcast::Time latency{};
+        brilliant::snapcast::read(
+            std::span(state.outData).subspan(brilliant::snapcast::HEADER_SIZE),
+            latency);
+        EXPECT_EQ(latency.sec, 1);
+        EXPECT_EQ(latency.usec, 200'000);
+      },
+      boost::asio::detached);
+  context.run();
+}
+
+TEST_F(TestSnapServerSession, testReplyTimeClientAhead) {
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this] -> boost::asio::awaitable<void> {
+        // the client clock is 1.5 s ahead of the server clock
+        brilliant::snapcast::Base request{};
+        request.type = brilliant::snapcast::MessageType::TIME;
+        request.sent = {.sec = 5, .usec = 200'000};
+        request.received = {.sec = 3, .usec = 700'000};
+
+        constexpr auto bufSize = 64;
+        std::vector<std::byte> buffer(bufSize);
+        auto result = co_await session.replyTime(request, std::span(buffer));
+        EXPECT_TRUE(result.has_value());
+
+        brilliant::snapcast::Time latency{};
+        brilliant::snapcast::read(
+            std::span(state.outData).subspan(brilliant::snapcast::HEADER_SIZE),
+            latency);
+        EXPECT_EQ(static_cast<std::int32_t>(latency.sec), -2);
+        EXPECT_EQ(latency.usec, 500'000);
+        EXPECT_EQ(brilliant::snapcast::toSignedMicroseconds(latency),
+                  -1'500'000);
+      },
+      boost::asio::detached);
+  context.run();
+}
+
+TEST_F(TestSnapServerSession, testFanOut) {
+  SocketState otherState;
+  brilliant::snapcast::TcpClient<FakeSocket<boost::asio::ip::tcp>> otherClient(
+      FakeSocket<boost::asio::ip::tcp>{context.get_executor(), &otherState},
+      mr);
+  ServerSession other(otherClient);
+
+  brilliant::snapcast::FanOut<ServerSession> fanOut(mr);
+  fanOut.add(session);
+  fanOut.add(other);
+  EXPECT_EQ(fanOut.size(), 2);
+
+  auto frame = makeChunk(1);
+  EXPECT_EQ(fanOut.publish(frame), 2);
+  EXPECT_EQ(frame.useCount(), 3);
+
+  fanOut.remove(other);
+  EXPECT_EQ(fanOut.publish(frame), 1);
+  EXPECT_EQ(fanOut.publish(frame), 0);
+  EXPECT_EQ(session.dropped(), 1);
+}
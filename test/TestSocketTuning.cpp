@@ -0,0 +1,128 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+#include <chrono>
+
+#include "BrilliantSnapcast/SnapClient.hpp"
+#include "BrilliantSnapcast/SocketTuning.hpp"
+
+using namespace std::chrono_literals;
+
+struct TestSocketTuning : testing::Test {
+  using Socket = boost::asio::ip::tcp::socket;
+
+  std::pmr::memory_resource* mr = std::pmr::get_default_resource();
+  boost::asio::io_context context;
+  boost::asio::ip::tcp::acceptor acceptor{
+      context, {boost::asio::ip::address_v4::loopback(), 0}};
+};
+
+TEST_F(TestSocketTuning, testReceiveBufferFor) {
+  // one second of 48 kHz 16 bit stereo PCM
+  EXPECT_EQ(brilliant::snapcast::SocketTuning::receiveBufferFor(1000ms,
+                                                                192000),
+            192000);
+  // never below 16 KiB
+  EXPECT_EQ(brilliant::snapcast::SocketTuning::receiveBufferFor(20ms, 1000),
+            16 * 1024);
+
+  const auto tuning =
+      brilliant::snapcast::SocketTuning::lowLatency(500ms, 192000);
+  EXPECT_TRUE(tuning.noDelay);
+  EXPECT_TRUE(tuning.quickAck);
+  EXPECT_EQ(tuning.receiveBuffer, 96000);
+  EXPECT_EQ(tuning.userTimeout, 500ms);
+  EXPECT_EQ(brilliant::snapcast::SocketTuning::system(),
+            brilliant::snapcast::SocketTuning{});
+}
+
+TEST_F(TestSocketTuning, testConnectAppliesTuning) {
+  brilliant::snapcast::TcpClient<Socket> tcpClient(Socket(context), mr);
+  auto tuning = brilliant::snapcast::SocketTuning::interactive();
+  tuning.receiveBuffer = 64 * 1024;  // NOLINT
+  tuning.userTimeout = 750ms;
+  tcpClient.setTuning(tuning);
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &tcpClient] -> boost::asio::awaitable<void> {
+        auto accepted = acceptor.async_accept(boost::asio::use_awaitable);
+        const auto ec = co_await tcpClient.connect(acceptor.local_endpoint());
+        EXPECT_FALSE(ec);
+        EXPECT_FALSE(tcpClient.tuningError());
+        auto peer = co_await std::move(accepted);
+      },
+      boost::asio::detached);
+  context.run();
+
+  boost::asio::ip::tcp::no_delay noDelay;
+  EXPECT_FALSE(tcpClient.getOption(noDelay));
+  EXPECT_TRUE(noDelay.value());
+
+  // the kernel may double the requested size for bookkeeping
+  boost::asio::socket_base::receive_buffer_size receiveBuffer;
+  EXPECT_FALSE(tcpClient.getOption(receiveBuffer));
+  EXPECT_GE(receiveBuffer.value(), 64 * 1024);
+
+#ifdef TCP_USER_TIMEOUT
+  brilliant::snapcast::IntegerOption<IPPROTO_TCP, TCP_USER_TIMEOUT>
+      userTimeout(0);
+  EXPECT_FALSE(tcpClient.getOption(userTimeout));
+  EXPECT_EQ(userTimeout.value(), 750);
+#endif
+}
+
+TEST_F(TestSocketTuning, testSystemTuningSetsNothing) {
+  brilliant::snapcast::TcpClient<Socket> tcpClient(Socket(context), mr);
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &tcpClient] -> boost::asio::awaitable<void> {
+        auto accepted = acceptor.async_accept(boost::asio::use_awaitable);
+        EXPECT_FALSE(co_await tcpClient.connect(acceptor.local_endpoint()));
+        auto peer = co_await std::move(accepted);
+      },
+      boost::asio::detached);
+  context.run();
+
+  boost::asio::ip::tcp::no_delay noDelay;
+  EXPECT_FALSE(tcpClient.getOption(noDelay));
+  EXPECT_FALSE(noDelay.value());
+}
+
+TEST_F(TestSocketTuning, testTimeMessageSendsQuickAck) {
+  brilliant::snapcast::TcpClient<Socket> tcpClient(Socket(context), mr);
+  tcpClient.setTuning(brilliant::snapcast::SocketTuning::interactive());
+  brilliant::snapcast::SnapClient<Socket> snapClient(tcpClient);
+
+  boost::asio::co_spawn(
+      context,
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+      [this, &tcpClient, &snapClient] -> boost::asio::awaitable<void> {
+        auto accepted = acceptor.async_accept(boost::asio::use_awaitable);
+        EXPECT_FALSE(co_await tcpClient.connect(acceptor.local_endpoint()));
+        auto peer = co_await std::move(accepted);
+
+#ifdef TCP_QUICKACK
+        // clear quick ACK mode, the Time message enables it again
+        EXPECT_FALSE(tcpClient.setOption(
+            brilliant::snapcast::IntegerOption<IPPROTO_TCP, TCP_QUICKACK>(0)));
+#endif
+        std::array<std::byte, brilliant::snapcast::FRAME_SIZE<
+                                  brilliant::snapcast::Time>>
+            buffer{};
+        EXPECT_TRUE(co_await snapClient.send(0, brilliant::snapcast::Time{},
+                                             std::span(buffer)));
+#ifdef TCP_QUICKACK
+        brilliant::snapcast::IntegerOption<IPPROTO_TCP, TCP_QUICKACK>
+            quickAck(0);
+        EXPECT_FALSE(tcpClient.getOption(quickAck));
+        EXPECT_EQ(quickAck.value(), 1);
+#endif
+      },
+      boost::asio::detached);
+  context.run();
+}
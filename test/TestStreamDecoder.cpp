@@ -0,0 +1,342 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "BrilliantSnapcast/Pipeline.hpp"
+#include "BrilliantSnapcast/StreamDecoder.hpp"
+#include "CountingResource.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+  // 1 kHz mono 16 bit, one frame per millisecond
+  constexpr brilliant::snapcast::AudioFormat pcmFormat{1000, 16, 1};
+
+  // outputs two priming frames and holds the last two frames of each chunk
+  // back until the next one, like a codec with a delay
+  class DelayDecoder : public brilliant::snapcast::Decoder {
+  public:
+    DelayDecoder(std::pmr::memory_resource* mr, std::atomic<int>& live)
+        : _held(2 * pcmFormat.frameSize(), std::byte{}, mr), _live(&live) {
+      ++*_live;
+    }
+
+    ~DelayDecoder() override { --*_live; }
+
+    DelayDecoder(const DelayDecoder&) = delete;
+    DelayDecoder(DelayDecoder&&) = delete;
+    auto operator=(const DelayDecoder&) -> DelayDecoder& = delete;
+    auto operator=(DelayDecoder&&) -> DelayDecoder& = delete;
+
+    [[nodiscard]] auto format() const
+        -> brilliant::snapcast::AudioFormat override {
+      return pcmFormat;
+    }
+
+    [[nodiscard]] auto delay() const -> std::size_t override { return 2; }
+
+    auto decode(std::span<const std::byte> payload,
+                std::pmr::vector<std::byte>& out)
+        -> boost::system::error_code override {
+      out.insert(out.end(), _held.begin(), _held.end());
+      const auto keep = payload.size() - _held.size();
+      out.insert(out.end(), payload.begin(),
+                 payload.begin() + static_cast<std::ptrdiff_t>(keep));
+      std::copy(payload.begin() + static_cast<std::ptrdiff_t>(keep),
+                payload.end(), _held.begin());
+      return {};
+    }
+
+    void flush(std::pmr::vector<std::byte>& out) override {
+      out.insert(out.end(), _held.begin(), _held.end());
+    }
+
+  private:
+    std::pmr::vector<std::byte> _held;
+    std::atomic<int>* _live;
+  };
+
+  // passes the payload through
+  class PcmDecoder : public brilliant::snapcast::Decoder {
+  public:
+    explicit PcmDecoder(std::atomic<int>& live) : _live(&live) { ++*_live; }
+
+    ~PcmDecoder() override { --*_live; }
+
+    PcmDecoder(const PcmDecoder&) = delete;
+    PcmDecoder(PcmDecoder&&) = delete;
+    auto operator=(const PcmDecoder&) -> PcmDecoder& = delete;
+    auto operator=(PcmDecoder&&) -> PcmDecoder& = delete;
+
+    [[nodiscard]] auto format() const
+        -> brilliant::snapcast::AudioFormat override {
+      return pcmFormat;
+    }
+
+    auto decode(std::span<const std::byte> payload,
+                std::pmr::vector<std::byte>& out)
+        -> boost::system::error_code override {
+      out.insert(out.end(), payload.begin(), payload.end());
+      return {};
+    }
+
+  private:
+    std::atomic<int>* _live;
+  };
+
+  class Factory : public brilliant::snapcast::DecoderFactory {
+  public:
+    auto create(const brilliant::snapcast::CodecHeader& header,
+                std::pmr::memory_resource* mr)
+        -> std::expected<brilliant::snapcast::Decoder*,
+                         boost::system::error_code> override {
+      resources.push_back(mr);
+      maxLive = std::max(maxLive, live.load() + 1);
+      const std::string_view codec(header.codec, header.codecSize);
+      std::pmr::polymorphic_allocator<> alloc(mr);
+      if (codec == "delay") {
+        return alloc.new_object<DelayDecoder>(mr, live);
+      }
+      if (codec == "pcm") {
+        return alloc.new_object<PcmDecoder>(live);
+      }
+      if (codec == "greedy") {
+        // more than the slot holds, the arena throws
+        static_cast<void>(alloc.allocate_bytes(4096));
+      }
+      if (codec == "slow") {
+        std::this_thread::sleep_for(20ms);
+        return alloc.new_object<PcmDecoder>(live);
+      }
+      return std::unexpected(boost::system::errc::make_error_code(
+          boost::system::errc::not_supported));
+    }
+
+    std::atomic<int> live{};
+    int maxLive{};
+    std::vector<std::pmr::memory_resource*> resources;
+  };
+
+  auto header(std::string_view codec) -> brilliant::snapcast::CodecHeader {
+    return {codec, std::span<std::byte>{}};
+  }
+
+  auto chunk(std::uint32_t stream,
+             std::chrono::steady_clock::time_point playout,
+             std::initializer_list<std::int16_t> samples)
+      -> brilliant::snapcast::StreamChunk {
+    static brilliant::snapcast::SlabPool pool(
+        64, 256, std::pmr::new_delete_resource());  // NOLINT
+    auto slab = pool.acquire();
+    EXPECT_TRUE(slab);
+    const auto size = samples.size() * sizeof(std::int16_t);
+    std::memcpy(slab->data().data(), samples.begin(), size);
+    const std::span<const std::byte> payload = slab->data().first(size);
+    return {stream, playout, payload, std::move(*slab)};
+  }
+
+  auto samples(const brilliant::snapcast::PcmFrame& frame)
+      -> std::vector<std::int16_t> {
+    std::vector<std::int16_t> result(frame.samples.size() /
+                                     sizeof(std::int16_t));
+    std::memcpy(result.data(), frame.samples.data(), frame.samples.size());
+    return result;
+  }
+}  // namespace
+
+struct TestStreamDecoder : testing::Test {
+  auto drain() -> std::pmr::vector<brilliant::snapcast::PcmFrame> {
+    std::pmr::vector<brilliant::snapcast::PcmFrame> frames;
+    while (output.size() > 0) {
+      output.popBatch(frames, output.size(), {});
+    }
+    return frames;
+  }
+
+  CountingResource mr;
+  Factory factory;
+  brilliant::snapcast::StageQueue<brilliant::snapcast::PcmFrame> output{64,
+                                                                        &mr};
+};
+
+TEST_F(TestStreamDecoder, testSwitchIsSampleAccurate) {
+  brilliant::snapcast::StreamDecoder decoder(factory, output, 1024, &mr);
+  const auto t0 = std::chrono::steady_clock::now();
+
+  const auto first = decoder.prepare(header("delay"));
+  ASSERT_TRUE(first);
+  std::vector<brilliant::snapcast::StreamChunk> chunks;
+  chunks.push_back(chunk(*first, t0, {1, 2, 3, 4}));
+  decoder(chunks, {});
+
+  // the next stream is built while the old stream's chunks are decoded
+  const auto second = decoder.prepare(header("pcm"));
+  ASSERT_TRUE(second);
+  chunks.clear();
+  chunks.push_back(chunk(*first, t0 + 4ms, {5, 6, 7, 8}));
+  chunks.push_back(chunk(*second, t0 + 7ms, {100, 101, 102, 103}));
+  decoder(chunks, {});
+
+  const auto frames = drain();
+  ASSERT_EQ(frames.size(), 4);
+  // priming frames are discarded, the first sample plays at the chunk time
+  EXPECT_EQ(frames[0].playout, t0);
+  EXPECT_THAT(samples(frames[0]), testing::ElementsAre(1, 2));
+  EXPECT_EQ(frames[1].playout, t0 + 2ms);
+  EXPECT_THAT(samples(frames[1]), testing::ElementsAre(3, 4, 5, 6));
+  // the flushed tail stops where the new stream starts
+  EXPECT_EQ(frames[2].playout, t0 + 6ms);
+  EXPECT_THAT(samples(frames[2]), testing::ElementsAre(7));
+  EXPECT_EQ(frames[3].playout, t0 + 7ms);
+  EXPECT_THAT(samples(frames[3]), testing::ElementsAre(100, 101, 102, 103));
+
+  brilliant::snapcast::StreamDecoder::Snapshot stats;
+  decoder.snapshot(stats);
+  EXPECT_EQ(stats.switches, 2);
+  EXPECT_EQ(stats.dropped, 0);
+}
+
+TEST_F(TestStreamDecoder, testDecodersUseBoundedPool) {
+  const auto outstanding = mr.outstanding;
+  {
+    brilliant::snapcast::StreamDecoder decoder(factory, output, 1024, &mr);
+    const auto poolAllocations = mr.allocations;
+    const auto t0 = std::chrono::steady_clock::now();
+
+    std::vector<brilliant::snapcast::StreamChunk> chunks;
+    for (int i = 0; i < 10; ++i) {
+      const auto stream = decoder.prepare(header(i % 2 ? "pcm" : "delay"));
+      ASSERT_TRUE(stream);
+      chunks.clear();
+      chunks.push_back(chunk(*stream, t0 + i * 10ms, {1, 2, 3, 4}));
+      decoder(chunks, {});
+      drain();
+    }
+
+    // the decoders and their state never leave the two pool slots
+    EXPECT_EQ(factory.resources.size(), 10);
+    for (auto* resource : factory.resources) {
+      EXPECT_NE(resource, &mr);
+    }
+    EXPECT_LE(factory.maxLive, 2);
+    // only the copied headers and the decoded frames use the resource
+    EXPECT_GT(mr.allocations, poolAllocations);
+
+    brilliant::snapcast::StreamDecoder::Snapshot stats;
+    decoder.snapshot(stats);
+    EXPECT_EQ(stats.switches, 10);
+  }
+  EXPECT_EQ(factory.live, 0);
+  EXPECT_EQ(mr.outstanding, outstanding);
+}
+
+TEST_F(TestStreamDecoder, testPrepareBusyUntilStreamStarts) {
+  brilliant::snapcast::StreamDecoder decoder(factory, output, 1024, &mr);
+  const auto first = decoder.prepare(header("pcm"));
+  ASSERT_TRUE(first);
+  const auto busy = decoder.prepare(header("pcm"));
+  ASSERT_FALSE(busy);
+  EXPECT_EQ(busy.error(), boost::system::errc::device_or_resource_busy);
+
+  std::vector<brilliant::snapcast::StreamChunk> chunks;
+  chunks.push_back(chunk(*first, std::chrono::steady_clock::now(), {1}));
+  decoder(chunks, {});
+  EXPECT_TRUE(decoder.prepare(header("pcm")));
+}
+
+TEST_F(TestStreamDecoder, testUnknownCodecDropsChunks) {
+  brilliant::snapcast::StreamDecoder decoder(factory, output, 1024, &mr);
+  const auto t0 = std::chrono::steady_clock::now();
+
+  const auto unknown = decoder.prepare(header("flac"));
+  ASSERT_TRUE(unknown);
+  std::vector<brilliant::snapcast::StreamChunk> chunks;
+  chunks.push_back(chunk(*unknown, t0, {1, 2}));
+  chunks.push_back(chunk(*unknown + 5, t0, {1, 2}));
+  decoder(chunks, {});
+  EXPECT_TRUE(drain().empty());
+
+  // a failed stream does not block the next one
+  const auto next = decoder.prepare(header("pcm"));
+  ASSERT_TRUE(next);
+  chunks.clear();
+  chunks.push_back(chunk(*next, t0 + 2ms, {3, 4}));
+  decoder(chunks, {});
+  const auto frames = drain();
+  ASSERT_EQ(frames.size(), 1);
+  EXPECT_THAT(samples(frames[0]), testing::ElementsAre(3, 4));
+
+  brilliant::snapcast::StreamDecoder::Snapshot stats;
+  decoder.snapshot(stats);
+  EXPECT_EQ(stats.switches, 1);
+  EXPECT_EQ(stats.dropped, 2);
+}
+
+TEST_F(TestStreamDecoder, testStageWaitsForSlowBuild) {
+  brilliant::snapcast::StreamDecoder decoder(factory, output, 1024, &mr);
+  brilliant::snapcast::StageQueue<brilliant::snapcast::StreamChunk> input(
+      16, &mr);
+  brilliant::snapcast::PipelineStage stage(input, std::ref(decoder), {}, &mr);
+  stage.start();
+
+  const auto stream = decoder.prepare(header("slow"));
+  ASSERT_TRUE(stream);
+  input.push(chunk(*stream, std::chrono::steady_clock::now(), {9}), {});
+  for (int i = 0; i < 5000 && output.size() == 0; ++i) {
+    std::this_thread::sleep_for(1ms);
+  }
+  stage.stop();
+
+  const auto frames = drain();
+  ASSERT_EQ(frames.size(), 1);
+  EXPECT_THAT(samples(frames[0]), testing::ElementsAre(9));
+  brilliant::snapcast::StreamDecoder::Snapshot stats;
+  decoder.snapshot(stats);
+  EXPECT_EQ(stats.waits, 1);
+}
+
+TEST_F(TestStreamDecoder, testOversizedStreamFails) {
+  brilliant::snapcast::StreamDecoder decoder(factory, output, 1024, &mr);
+  const auto t0 = std::chrono::steady_clock::now();
+
+  // the header alone does not fit in the slot
+  std::vector<std::byte> payload(2048);
+  const auto oversized = decoder.prepare({"pcm", std::span(payload)});
+  ASSERT_TRUE(oversized);
+  std::vector<brilliant::snapcast::StreamChunk> chunks;
+  chunks.push_back(chunk(*oversized, t0, {1, 2}));
+  decoder(chunks, {});
+
+  // the decoder exhausts the slot while it is created
+  const auto greedy = decoder.prepare(header("greedy"));
+  ASSERT_TRUE(greedy);
+  chunks.clear();
+  chunks.push_back(chunk(*greedy, t0 + 2ms, {3, 4}));
+  decoder(chunks, {});
+  EXPECT_TRUE(drain().empty());
+
+  const auto next = decoder.prepare(header("pcm"));
+  ASSERT_TRUE(next);
+  chunks.clear();
+  chunks.push_back(chunk(*next, t0 + 4ms, {5, 6}));
+  decoder(chunks, {});
+  const auto frames = drain();
+  ASSERT_EQ(frames.size(), 1);
+  EXPECT_THAT(samples(frames[0]), testing::ElementsAre(5, 6));
+
+  brilliant::snapcast::StreamDecoder::Snapshot stats;
+  decoder.snapshot(stats);
+  EXPECT_EQ(stats.switches, 1);
+  EXPECT_EQ(stats.dropped, 2);
+  EXPECT_EQ(factory.live, 1);
+}
@@ -1,9 +1,15 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <vector>
+
 #include "BrilliantSnapcast/TcpClient.hpp"
+#include "CountingResource.hpp"
 #include "FakeSocket.hpp"
 
+using namespace std::chrono_literals;
+
 class TestTcpClient : public testing::Test {
 public:
   auto makeTcpClient()
@@ -38,6 +44,14 @@ TEST_F(TestTcpClient, testConnect) {
         socketState.ec = boost::system::error_code{};
         ec = co_await tcpClient.connect("192.168.0.1", port);
         EXPECT_FALSE(ec);
+
+        // longer than any ip address
+        ec = co_await tcpClient.connect(std::string(128, '1'), port);
+        EXPECT_EQ(ec, boost::asio::error::invalid_argument);
+
+        ec = co_await tcpClient.connect(
+            {boost::asio::ip::address_v6::loopback(), port});
+        EXPECT_FALSE(ec);
       },
       boost::asio::detached);
   context.run();
@@ -105,3 +119,179 @@ TEST_F(TestTcpClient, testWrite) {
       boost::asio::detached);
   context.run();
 }
+
+TEST_F(TestTcpClient, testLocalSocket) {
+  using Protocol = boost::asio::local::stream_protocol;
+  const auto path = testing::TempDir() + "TestTcpClient.sock";
+  std::remove(path.c_str());
+  Protocol::acceptor acceptor(context, Protocol::endpoint(path));
+  brilliant::snapcast::TcpClient tcpClient(Protocol::socket(context), mr);
+
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+  boost::asio::co_spawn(
+      context,
+      [&acceptor] -> boost::asio::awaitable<void> {
+        auto peer = co_await acceptor.async_accept(boost::asio::use_awaitable);
+        std::array<std::byte, 4> echo{};
+        co_await boost::asio::async_read(peer, boost::asio::buffer(echo),
+                                         boost::asio::use_awaitable);
+        co_await boost::asio::async_write(peer, boost::asio::buffer(echo),
+                                          boost::asio::use_awaitable);
+      },
+      boost::asio::detached);
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+  boost::asio::co_spawn(
+      context,
+      [&tcpClient, &path] -> boost::asio::awaitable<void> {
+        auto ec = co_await tcpClient.connect(Protocol::endpoint(path));
+        EXPECT_FALSE(ec);
+
+        std::array data{std::byte{1}, std::byte{2}, std::byte{3},
+                        std::byte{4}};
+        std::size_t size{};
+        std::tie(ec, size) = co_await tcpClient.write(std::span(data));
+        EXPECT_FALSE(ec);
+
+        std::array<std::byte, 4> received{};
+        std::tie(ec, size) = co_await tcpClient.read(std::span(received));
+        EXPECT_FALSE(ec);
+        EXPECT_EQ(size, received.size());
+        EXPECT_EQ(received, data);
+      },
+      boost::asio::detached);
+  context.run();
+  std::remove(path.c_str());
+}
+
+TEST_F(TestTcpClient, testReadTimesOut) {
+  using Protocol = boost::asio::local::stream_protocol;
+  CountingResource counting;
+  Protocol::socket peer(context);
+  Protocol::socket socket(context);
+  boost::asio::local::connect_pair(socket, peer);
+  brilliant::snapcast::TcpClient tcpClient(std::move(socket), &counting);
+
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+  boost::asio::co_spawn(
+      context,
+      [&tcpClient, &peer] -> boost::asio::awaitable<void> {
+        std::array<std::byte, 4> received{};
+        const auto start = std::chrono::steady_clock::now();
+        auto [ec, size] = co_await tcpClient.read(std::span(received), 20ms);
+        EXPECT_EQ(ec, boost::asio::error::timed_out);
+        EXPECT_GE(std::chrono::steady_clock::now() - start, 20ms);
+
+        // a read which completes in time is not affected by its timer
+        std::array data{std::byte{1}, std::byte{2}, std::byte{3},
+                        std::byte{4}};
+        co_await boost::asio::async_write(peer, boost::asio::buffer(data),
+                                          boost::asio::use_awaitable);
+        std::tie(ec, size) = co_await tcpClient.read(std::span(received), 20ms);
+        EXPECT_FALSE(ec);
+        EXPECT_EQ(received, data);
+
+        // nor is the next read once the timer would have expired
+        auto exec = co_await boost::asio::this_coro::executor;
+        boost::asio::steady_timer timer(exec, 40ms);
+        timer.async_wait([&peer, &data](auto) {
+          boost::asio::write(peer, boost::asio::buffer(data));
+        });
+        std::tie(ec, size) = co_await tcpClient.read(std::span(received));
+        EXPECT_FALSE(ec);
+        EXPECT_EQ(size, received.size());
+      },
+      boost::asio::detached);
+  context.run();
+  // the frames and timer handlers were returned to the resource
+  EXPECT_EQ(counting.outstanding, 0);
+  EXPECT_GT(counting.allocations, 0);
+}
+
+TEST_F(TestTcpClient, testMoveAssignment) {
+  using Protocol = boost::asio::local::stream_protocol;
+  Protocol::socket peer(context);
+  Protocol::socket socket(context);
+  boost::asio::local::connect_pair(socket, peer);
+  brilliant::snapcast::TcpClient source(std::move(socket), mr);
+  source.setTuning(brilliant::snapcast::SocketTuning::interactive());
+  brilliant::snapcast::TcpClient target(Protocol::socket(context), mr);
+
+  target = std::move(source);
+  EXPECT_TRUE(target.isConnected());
+  EXPECT_FALSE(source.isConnected());  // NOLINT(bugprone-use-after-move)
+  EXPECT_EQ(target.tuning(), brilliant::snapcast::SocketTuning::interactive());
+
+  // the deadlines moved with the socket
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+  boost::asio::co_spawn(
+      context,
+      [&target] -> boost::asio::awaitable<void> {
+        std::array<std::byte, 4> received{};
+        auto [ec, size] = co_await target.read(std::span(received), 20ms);
+        EXPECT_EQ(ec, boost::asio::error::timed_out);
+      },
+      boost::asio::detached);
+  context.run();
+}
+
+TEST_F(TestTcpClient, testWriteTimesOut) {
+  using Protocol = boost::asio::local::stream_protocol;
+  CountingResource counting;
+  Protocol::socket peer(context);
+  Protocol::socket socket(context);
+  boost::asio::local::connect_pair(socket, peer);
+  brilliant::snapcast::TcpClient tcpClient(std::move(socket), &counting);
+
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+  boost::asio::co_spawn(
+      context,
+      [&tcpClient] -> boost::asio::awaitable<void> {
+        // larger than the socket buffers, the peer never reads
+        std::vector<std::byte> data(16 * 1024 * 1024);  // NOLINT
+        auto [ec, size] = co_await tcpClient.write(std::span(data), 20ms);
+        EXPECT_EQ(ec, boost::asio::error::timed_out);
+        EXPECT_LT(size, data.size());
+      },
+      boost::asio::detached);
+  context.run();
+  EXPECT_EQ(counting.outstanding, 0);
+}
+
+TEST_F(TestTcpClient, testTimeoutCancelsOnlyItsOperation) {
+  using Protocol = boost::asio::local::stream_protocol;
+  Protocol::socket peer(context);
+  Protocol::socket socket(context);
+  boost::asio::local::connect_pair(socket, peer);
+  brilliant::snapcast::TcpClient tcpClient(std::move(socket), mr);
+
+  // larger than the socket buffers, the write waits for the peer
+  std::vector<std::byte> data(4 * 1024 * 1024);  // NOLINT
+  boost::system::error_code writeError = boost::asio::error::would_block;
+  std::size_t written = 0;
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+  boost::asio::co_spawn(
+      context,
+      [&tcpClient, &data, &writeError,
+       &written] -> boost::asio::awaitable<void> {
+        std::tie(writeError, written) =
+            co_await tcpClient.write(std::span(data));
+      },
+      boost::asio::detached);
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-capturing-lambda-coroutines)
+  boost::asio::co_spawn(
+      context,
+      [&tcpClient, &peer, &data] -> boost::asio::awaitable<void> {
+        std::array<std::byte, 4> received{};
+        auto [ec, size] = co_await tcpClient.read(std::span(received), 20ms);
+        EXPECT_EQ(ec, boost::asio::error::timed_out);
+
+        // the write in flight was not cancelled with the read
+        std::vector<std::byte> drained(data.size());
+        co_await boost::asio::async_read(peer, boost::asio::buffer(drained),
+                                         boost::asio::use_awaitable);
+      },
+      boost::asio::detached);
+  context.run();
+  EXPECT_FALSE(writeError);
+  EXPECT_EQ(written, data.size());
+}
@@ -0,0 +1,58 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+
+#include "BrilliantSnapcast/Trace.hpp"
+
+TEST(TestTrace, testRingDropsWhenFull) {
+  brilliant::snapcast::trace::Ring ring(1);
+  for (std::size_t i = 0; i < brilliant::snapcast::trace::RING_CAPACITY + 2;
+       ++i) {
+    ring.push({"push", i, i + 1, 0});
+  }
+  EXPECT_EQ(ring.dropped(), 2);
+
+  std::pmr::vector<brilliant::snapcast::trace::Record> records;
+  EXPECT_EQ(ring.drain(records), brilliant::snapcast::trace::RING_CAPACITY);
+  EXPECT_EQ(records.front().begin, 0);
+  EXPECT_EQ(records.back().begin,
+            brilliant::snapcast::trace::RING_CAPACITY - 1);
+
+  ring.push({"push", 0, 1, 0});
+  records.clear();
+  EXPECT_EQ(ring.drain(records), 1);
+}
+
+TEST(TestTrace, testChromeTraceExport) {
+  // discard records of earlier tests
+  std::ostringstream discard;
+  brilliant::snapcast::trace::writeChromeTrace(discard);
+
+  const int flow = 0;
+  {
+    const brilliant::snapcast::trace::Scope outer("outer", &flow);
+    { const brilliant::snapcast::trace::Scope inner("inner"); }
+  }
+  std::jthread([] {
+    const brilliant::snapcast::trace::Scope other("other");
+  }).join();
+
+  std::ostringstream out;
+  EXPECT_EQ(brilliant::snapcast::trace::writeChromeTrace(out), 3);
+  const auto json = out.str();
+  EXPECT_THAT(json, testing::StartsWith(R"({"displayTimeUnit")"));
+  EXPECT_THAT(json, testing::EndsWith("]}"));
+  EXPECT_THAT(json, testing::HasSubstr(
+                        R"("name":"outer","cat":"snapcast","ph":"b")"));
+  EXPECT_THAT(json, testing::HasSubstr(
+                        R"("name":"outer","cat":"snapcast","ph":"e")"));
+  EXPECT_THAT(json, testing::HasSubstr(
+                        R"("name":"inner","cat":"snapcast","ph":"X")"));
+  EXPECT_THAT(json, testing::HasSubstr(R"("name":"other")"));
+
+  std::ostringstream empty;
+  EXPECT_EQ(brilliant::snapcast::trace::writeChromeTrace(empty), 0);
+  EXPECT_EQ(empty.str(), R"({"displayTimeUnit":"ns","traceEvents":[]})");
+}
@@ -0,0 +1,151 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+#include "BrilliantSnapcast/Message.hpp"
+#include "BrilliantSnapcast/MessageConv.hpp"
+#include "BrilliantSnapcast/WireCodec.hpp"
+
+namespace {
+  auto makeBase() -> brilliant::snapcast::Base {
+    return {.type = brilliant::snapcast::MessageType::TIME,
+            .id = 0x0102,
+            .refersTo = 0x0304,
+            .sent = {.sec = 0x05060708, .usec = 0x090A0B0C},
+            .received = {.sec = 0x0D0E0F10, .usec = 0x11121314},
+            .size = 0x15161718};
+  }
+
+  // the header of makeBase() as snapcast puts it on the wire, little endian
+  constexpr std::array<unsigned char, brilliant::snapcast::HEADER_SIZE>
+      WIRE_BASE{0x04, 0x00, 0x02, 0x01, 0x04, 0x03, 0x08, 0x07, 0x06,
+                0x05, 0x0C, 0x0B, 0x0A, 0x09, 0x10, 0x0F, 0x0E, 0x0D,
+                0x14, 0x13, 0x12, 0x11, 0x18, 0x17, 0x16, 0x15};
+
+  // two fields declared in the reverse of their wire order
+  struct Reversed {
+    std::uint32_t second;
+    std::uint32_t first;
+  };
+
+  auto equal(const brilliant::snapcast::Base& lhs,
+             const brilliant::snapcast::Base& rhs) -> bool {
+    return lhs.type == rhs.type && lhs.id == rhs.id &&
+           lhs.refersTo == rhs.refersTo && lhs.sent.sec == rhs.sent.sec &&
+           lhs.sent.usec == rhs.sent.usec &&
+           lhs.received.sec == rhs.received.sec &&
+           lhs.received.usec == rhs.received.usec && lhs.size == rhs.size;
+  }
+}  // namespace
+
+template <>
+struct brilliant::snapcast::WireLayout<Reversed> {
+  using fields = Fields<&Reversed::first, &Reversed::second>;
+};
+
+// checks the real byte order of the host, run it on a big endian target with
+// cmake/toolchains/s390x-linux-gnu.cmake
+TEST(TestWireCodec, testWireBytes) {
+  static_assert(sizeof(brilliant::snapcast::Base) >=
+                brilliant::snapcast::HEADER_SIZE);
+
+  std::array<std::byte, brilliant::snapcast::HEADER_SIZE> bytes{};
+  brilliant::snapcast::write(std::span(bytes), makeBase());
+  EXPECT_TRUE(std::ranges::equal(bytes, WIRE_BASE, {}, {}, [](auto b) {
+    return static_cast<std::byte>(b);
+  }));
+
+  brilliant::snapcast::Base base{};
+  brilliant::snapcast::read(std::span(bytes), base);
+  EXPECT_TRUE(equal(base, makeBase()));
+}
+
+TEST(TestWireCodec, testUnalignedFields) {
+  std::array<std::byte, 8> bytes{};
+  brilliant::snapcast::storeLittle(bytes.data() + 1, std::uint32_t{0x01020304});
+  EXPECT_EQ(bytes[1], std::byte{0x04});
+  EXPECT_EQ(bytes[4], std::byte{0x01});
+  EXPECT_EQ(brilliant::snapcast::loadLittle<std::uint32_t>(bytes.data() + 1),
+            0x01020304);
+}
+
+// simulates a big endian host on any host: the fields are swapped on the
+// way in and out and the round trip is lossless
+TEST(TestWireCodec, testSimulatedBigEndianHost) {
+  constexpr auto big = std::endian::big;
+  constexpr auto little = std::endian::little;
+  std::array<std::byte, brilliant::snapcast::HEADER_SIZE> swapped{};
+  std::array<std::byte, brilliant::snapcast::HEADER_SIZE> plain{};
+  brilliant::snapcast::encodeWire<brilliant::snapcast::Base, big>(
+      swapped.data(), makeBase());
+  brilliant::snapcast::encodeWire<brilliant::snapcast::Base, little>(
+      plain.data(), makeBase());
+
+  // every multi byte field is reversed relative to the other host
+  EXPECT_EQ(swapped[0], plain[1]);
+  EXPECT_EQ(swapped[6], plain[9]);
+  EXPECT_EQ(swapped[25], plain[22]);
+
+  brilliant::snapcast::Base base{};
+  brilliant::snapcast::decodeWire<brilliant::snapcast::Base, big>(
+      swapped.data(), base);
+  EXPECT_TRUE(equal(base, makeBase()));
+}
+
+TEST(TestWireCodec, testVariableSizeFields) {
+  std::array<std::byte, 64> bytes{};
+  const std::string_view json = "{}";
+  brilliant::snapcast::Message message = brilliant::snapcast::Hello(json);
+  brilliant::snapcast::write(std::span(bytes), message);
+  EXPECT_EQ(bytes[0], std::byte{2});
+  EXPECT_EQ(bytes[3], std::byte{0});
+
+  auto decoded = brilliant::snapcast::read(
+      std::span(bytes), brilliant::snapcast::MessageType::HELLO);
+  ASSERT_TRUE(decoded);
+  const auto& hello = std::get<brilliant::snapcast::Hello>(*decoded);
+  EXPECT_EQ(std::string_view(hello.payload, hello.size), json);
+}
+
+// structs laid out like the wire are copied as a whole on little endian
+// hosts, padded ones in runs between the padding, the others field by field
+TEST(TestWireCodec, testCopiesIdenticalLayouts) {
+  using brilliant::snapcast::WireCopyable;
+  using brilliant::snapcast::WireIdentical;
+  constexpr bool little = std::endian::native == std::endian::little;
+  static_assert(WireIdentical<brilliant::snapcast::Time> == little);
+  static_assert(!WireIdentical<brilliant::snapcast::Base>);
+  static_assert(WireCopyable<brilliant::snapcast::Base> == little);
+  static_assert(!WireCopyable<Reversed>);
+  if constexpr (little) {
+    // type, id and refersTo, then sent, received and size after the padding
+    constexpr auto runs = brilliant::snapcast::detail::WIRE_RUNS<
+        brilliant::snapcast::Base>;
+    static_assert(runs.count == 2);
+    static_assert(runs.runs[0].object == 0 && runs.runs[0].size == 6);
+    static_assert(runs.runs[1].object == 8 && runs.runs[1].wire == 6 &&
+                  runs.runs[1].size == 20);
+  }
+
+  std::array<std::byte, 8> bytes{};
+  brilliant::snapcast::encodeWire(bytes.data(), Reversed{.second = 2,
+                                                         .first = 1});
+  EXPECT_EQ(bytes[0], std::byte{1});
+  EXPECT_EQ(bytes[4], std::byte{2});
+  Reversed reversed{};
+  brilliant::snapcast::decodeWire(bytes.data(), reversed);
+  EXPECT_EQ(reversed.first, 1);
+  EXPECT_EQ(reversed.second, 2);
+
+  brilliant::snapcast::encodeWire(
+      bytes.data(), brilliant::snapcast::Time{.sec = 0x01020304, .usec = 5});
+  EXPECT_EQ(bytes[0], std::byte{0x04});
+  EXPECT_EQ(bytes[4], std::byte{5});
+  brilliant::snapcast::Time time{};
+  brilliant::snapcast::decodeWire(bytes.data(), time);
+  EXPECT_EQ(time.sec, 0x01020304);
+  EXPECT_EQ(time.usec, 5);
+}